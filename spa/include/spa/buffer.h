@@ -101,6 +101,18 @@ static inline void *spa_buffer_find_meta(struct spa_buffer *b, uint32_t type)
 	return NULL;
 }
 
+/** Find the metadata element of \a type, for metadata with a variable size */
+static inline struct spa_meta *spa_buffer_get_meta(struct spa_buffer *b, uint32_t type)
+{
+	uint32_t i;
+
+	for (i = 0; i < b->n_metas; i++)
+		if (b->metas[i].type == type)
+			return &b->metas[i];
+
+	return NULL;
+}
+
 #ifdef __cplusplus
 }  /* extern "C" */
 #endif
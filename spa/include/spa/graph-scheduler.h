@@ -0,0 +1,325 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_GRAPH_SCHEDULER_H__
+#define __SPA_GRAPH_SCHEDULER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <spa/graph.h>
+
+struct spa_graph_scheduler;
+
+/** A node in a compiled plan, the nodes are stored in topological order */
+struct spa_graph_plan_node {
+	struct spa_graph_node *node;
+	const struct spa_graph_node_callbacks *callbacks;
+	void *callbacks_data;
+	uint32_t flags;			/**< the node flags */
+	uint32_t required_in;
+	uint32_t in_index;		/**< first input in the links array */
+	uint32_t n_in;
+	uint32_t out_index;		/**< first output in the links array */
+	uint32_t n_out;
+#define SPA_GRAPH_PLAN_IDLE	0
+#define SPA_GRAPH_PLAN_ACTIVE	1	/**< pulled or pushed in this cycle */
+#define SPA_GRAPH_PLAN_DONE	2	/**< output was processed in this cycle */
+#define SPA_GRAPH_PLAN_SOURCE	3	/**< output will be processed by the executor */
+	uint32_t state;
+	int32_t pending;		/**< active inputs that still need to run, this
+					  *  is updated atomically in parallel runs */
+};
+
+/** A linked port of a node in a compiled plan */
+struct spa_graph_plan_link {
+	struct spa_port_io *io;		/**< io of the port of the node */
+	struct spa_port_io *peer_io;	/**< io of the linked port */
+	uint32_t peer;			/**< index of the linked node */
+};
+
+/** The graph flattened in topological order, the links of each node are
+ * stored next to each other so that a cycle is a walk over two arrays */
+struct spa_graph_plan {
+	uint32_t version;		/**< graph version the plan was made for */
+	bool valid;
+	struct spa_graph_plan_node *nodes;
+	uint32_t n_nodes;
+	uint32_t max_nodes;
+	struct spa_graph_plan_link *links;
+	uint32_t n_links;
+	uint32_t max_links;
+	struct spa_graph_node **order;	/**< scratch space for sorting */
+	uint32_t *degree;		/**< unsorted inputs of each node while sorting */
+	uint32_t *ready;		/**< nodes that can run in a parallel run */
+	int32_t remaining;		/**< nodes left to run in a parallel run */
+};
+
+/** Runs the nodes of a plan on several threads
+ *
+ * The scheduler marks the nodes that need to run in a cycle and passes
+ * the nodes without pending inputs to \a run. The executor should call
+ * spa_graph_plan_run_node() for them and for the nodes that it reports
+ * ready, and return when the remaining count of the plan dropped to 0.
+ */
+struct spa_graph_executor {
+#define SPA_VERSION_GRAPH_EXECUTOR	0
+	uint32_t version;
+
+	void (*run) (void *data, struct spa_graph_plan *plan,
+		     const uint32_t *ready, uint32_t n_ready);
+};
+
+/** A scheduler implementation */
+struct spa_graph_scheduler_methods {
+#define SPA_VERSION_GRAPH_SCHEDULER_METHODS	0
+	uint32_t version;
+
+	const char *name;
+
+	/** start pulling data into \a node */
+	void (*pull) (struct spa_graph_scheduler *sched, struct spa_graph_node *node);
+	/** start pushing the data of \a node into the graph */
+	void (*push) (struct spa_graph_scheduler *sched, struct spa_graph_node *node);
+	/** do the next step of a pull or push, returns false when done.
+	 *  NULL when pull and push run the graph completely */
+	bool (*iterate) (struct spa_graph_scheduler *sched);
+	/** pull all \a targets in one cycle, NULL to pull them one by one */
+	void (*cycle) (struct spa_graph_scheduler *sched,
+		       struct spa_graph_node **targets, uint32_t n_targets);
+};
+
+/** Schedules the nodes of a graph with one of the implementations */
+struct spa_graph_scheduler {
+	struct spa_graph *graph;
+	const struct spa_graph_scheduler_methods *methods;
+	struct spa_graph_node *node;	/**< the node that is pulled or pushed */
+	struct spa_list ready;		/**< nodes to run for the queue schedulers */
+	struct spa_list pending;
+	struct spa_graph_plan plans[2];	/**< compiled graphs for the plan scheduler */
+	struct spa_graph_plan *plan;	/**< the plan for the next cycle */
+	struct spa_graph_plan *active;	/**< the plan of the running cycle */
+	uint32_t released;		/**< futex, changed when a waited for plan is released */
+	int32_t waiters;		/**< threads waiting for the active plan */
+	const struct spa_graph_executor *executor;
+	void *executor_data;
+};
+
+static inline int spa_graph_node_scheduler_input(void *data)
+{
+	struct spa_node *n = data;
+	return spa_node_process_input(n);
+}
+
+static inline int spa_graph_node_scheduler_output(void *data)
+{
+	struct spa_node *n = data;
+	return spa_node_process_output(n);
+}
+
+
+static const struct spa_graph_node_callbacks spa_graph_node_scheduler_default = {
+	SPA_VERSION_GRAPH_NODE_CALLBACKS,
+	spa_graph_node_scheduler_input,
+	spa_graph_node_scheduler_output,
+};
+
+static inline int spa_graph_port_scheduler_reuse_buffer(void *data,
+							uint32_t buffer_id)
+{
+	struct spa_graph_port *port = data;
+	struct spa_node *node = port->node->callbacks_data;
+	debug("port %p reuse buffer %d\n", port, buffer_id);
+	return spa_node_port_reuse_buffer(node, port->port_id, buffer_id);
+}
+
+static const struct spa_graph_port_callbacks spa_graph_port_scheduler_default = {
+	SPA_VERSION_GRAPH_PORT_CALLBACKS,
+	spa_graph_port_scheduler_reuse_buffer,
+};
+
+#include <spa/graph-scheduler1.h>
+#include <spa/graph-scheduler2.h>
+#include <spa/graph-scheduler3.h>
+
+static const struct spa_graph_scheduler_methods *spa_graph_schedulers[] = {
+	&spa_graph_scheduler_plan,
+	&spa_graph_scheduler_recursive,
+	&spa_graph_scheduler_queue,
+	&spa_graph_scheduler_pending,
+};
+
+/** Find the scheduler implementation called \a name, NULL when unknown */
+static inline const struct spa_graph_scheduler_methods *
+spa_graph_scheduler_find(const char *name)
+{
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(spa_graph_schedulers); i++) {
+		if (strcmp(spa_graph_schedulers[i]->name, name) == 0)
+			return spa_graph_schedulers[i];
+	}
+	return NULL;
+}
+
+/** Initialize \a sched for \a graph with the default implementation, the
+ * first one in spa_graph_schedulers */
+static inline void spa_graph_scheduler_init(struct spa_graph_scheduler *sched,
+					    struct spa_graph *graph)
+{
+	sched->graph = graph;
+	sched->methods = spa_graph_schedulers[0];
+	sched->node = NULL;
+	spa_list_init(&sched->ready);
+	spa_list_init(&sched->pending);
+	spa_zero(sched->plans);
+	sched->plan = &sched->plans[0];
+	sched->active = NULL;
+	sched->released = 0;
+	sched->waiters = 0;
+	sched->executor = NULL;
+	sched->executor_data = NULL;
+}
+
+/** Use another implementation, this should be done when the graph is idle.
+ * The plan scheduler needs spa_graph_scheduler_update() after this. */
+static inline void
+spa_graph_scheduler_set_methods(struct spa_graph_scheduler *sched,
+				const struct spa_graph_scheduler_methods *methods)
+{
+	sched->methods = methods;
+	spa_list_init(&sched->ready);
+	spa_list_init(&sched->pending);
+	sched->plans[0].valid = false;
+	sched->plans[1].valid = false;
+}
+
+/** Pull nodes in parallel with \a executor, this is used by the plan scheduler */
+static inline void
+spa_graph_scheduler_set_executor(struct spa_graph_scheduler *sched,
+				 const struct spa_graph_executor *executor,
+				 void *data)
+{
+	sched->executor = executor;
+	sched->executor_data = data;
+}
+
+static inline void spa_graph_scheduler_clear(struct spa_graph_scheduler *sched)
+{
+	uint32_t i;
+
+	for (i = 0; i < 2; i++) {
+		free(sched->plans[i].nodes);
+		free(sched->plans[i].links);
+		free(sched->plans[i].order);
+		free(sched->plans[i].ready);
+		free(sched->plans[i].degree);
+	}
+	spa_zero(sched->plans);
+	sched->plan = &sched->plans[0];
+}
+
+static inline void spa_graph_scheduler_pull(struct spa_graph_scheduler *sched,
+					    struct spa_graph_node *node)
+{
+	sched->methods->pull(sched, node);
+}
+
+static inline void spa_graph_scheduler_push(struct spa_graph_scheduler *sched,
+					    struct spa_graph_node *node)
+{
+	sched->methods->push(sched, node);
+}
+
+/** Run the next step of a pull or push, call this until it returns false */
+static inline bool spa_graph_scheduler_iterate(struct spa_graph_scheduler *sched)
+{
+	return sched->methods->iterate ? sched->methods->iterate(sched) : false;
+}
+
+/** Pull all \a targets for one period of a driver. With the plan scheduler
+ * the nodes they need run in a single pass, once each. */
+static inline void spa_graph_scheduler_cycle(struct spa_graph_scheduler *sched,
+					     struct spa_graph_node **targets,
+					     uint32_t n_targets)
+{
+	uint32_t i;
+
+	if (sched->methods->cycle) {
+		sched->methods->cycle(sched, targets, n_targets);
+		return;
+	}
+	for (i = 0; i < n_targets; i++) {
+		sched->methods->pull(sched, targets[i]);
+		while (spa_graph_scheduler_iterate(sched));
+	}
+}
+
+/** Compile a plan for the current graph and make the data thread use it from
+ * its next cycle on.
+ *
+ * This is called by the thread that changes the graph, after a change. The
+ * data thread never compiles plans itself, it runs the graph with the
+ * recursive walk while the graph is newer than the published plan. The plan
+ * is made in the plan that is not used for the next cycle and published with
+ * one pointer store. This sleeps only when the data thread is still running a
+ * cycle with that plan, after two updates in one cycle, until the cycle
+ * released it.
+ */
+static inline int spa_graph_scheduler_update(struct spa_graph_scheduler *sched)
+{
+	struct spa_graph_plan *plan;
+	int res;
+
+	if (sched->methods != &spa_graph_scheduler_plan)
+		return SPA_RESULT_OK;
+
+	plan = sched->plan == &sched->plans[0] ? &sched->plans[1] : &sched->plans[0];
+	while (__atomic_load_n(&sched->active, __ATOMIC_SEQ_CST) == plan) {
+		uint32_t released = __atomic_load_n(&sched->released, __ATOMIC_SEQ_CST);
+
+		/* the data thread sees the waiter or we see the release */
+		__atomic_add_fetch(&sched->waiters, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&sched->active, __ATOMIC_SEQ_CST) == plan)
+			syscall(SYS_futex, &sched->released, FUTEX_WAIT_PRIVATE,
+				released, NULL, NULL, 0);
+		__atomic_sub_fetch(&sched->waiters, 1, __ATOMIC_SEQ_CST);
+	}
+
+	if ((res = spa_graph_plan_compile(plan, sched->graph)) != SPA_RESULT_OK)
+		return res;
+
+	__atomic_store_n(&sched->plan, plan, __ATOMIC_SEQ_CST);
+
+	return SPA_RESULT_OK;
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_GRAPH_SCHEDULER_H__ */
@@ -17,59 +17,27 @@
  * Boston, MA 02110-1301, USA.
  */
 
-#ifndef __SPA_GRAPH_SCHEDULER_H__
-#define __SPA_GRAPH_SCHEDULER_H__
+#ifndef __SPA_GRAPH_SCHEDULER1_H__
+#define __SPA_GRAPH_SCHEDULER1_H__
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#include <spa/graph.h>
+#include <spa/graph-scheduler.h>
 
-struct spa_graph_scheduler {
-	struct spa_graph *graph;
-        struct spa_list ready;
-        struct spa_list pending;
-        struct spa_graph_node *node;
-};
-
-static inline void spa_graph_scheduler_init(struct spa_graph_scheduler *sched,
-					    struct spa_graph *graph)
-{
-	sched->graph = graph;
-	spa_list_init(&sched->ready);
-	spa_list_init(&sched->pending);
-	sched->node = NULL;
-}
-
-static inline int spa_graph_scheduler_input(void *data)
-{
-	struct spa_node *n = data;
-	return spa_node_process_input(n);
-}
-
-static inline int spa_graph_scheduler_output(void *data)
-{
-	struct spa_node *n = data;
-	return spa_node_process_output(n);
-}
-
-static const struct spa_graph_node_callbacks spa_graph_scheduler_default = {
-	SPA_VERSION_GRAPH_NODE_CALLBACKS,
-	spa_graph_scheduler_input,
-	spa_graph_scheduler_output,
-};
-
-static inline void spa_scheduler_port_check(struct spa_graph_scheduler *sched, struct spa_graph_port *port)
+static inline void spa_graph_queue_port_check(struct spa_graph_scheduler *sched,
+					      struct spa_graph_port *port)
 {
 	struct spa_graph_node *node = port->node;
+	uint32_t required = spa_graph_node_required_in(node);
 
 	if (port->io->status == SPA_RESULT_HAVE_BUFFER)
 		node->ready_in++;
 
-	debug("port %p node %p check %d %d %d\n", port, node, port->io->status, node->ready_in, node->required_in);
+	debug("port %p node %p check %d %d %d\n", port, node, port->io->status, node->ready_in, required);
 
-	if (node->required_in > 0 && node->ready_in == node->required_in) {
+	if (required > 0 && node->ready_in == required) {
 		node->action = SPA_GRAPH_ACTION_IN;
 		if (node->ready_link.next == NULL)
 			spa_list_insert(sched->ready.prev, &node->ready_link);
@@ -79,7 +47,7 @@ static inline void spa_scheduler_port_check(struct spa_graph_scheduler *sched, s
 	}
 }
 
-static inline bool spa_graph_scheduler_iterate(struct spa_graph_scheduler *sched)
+static inline bool spa_graph_queue_iterate(struct spa_graph_scheduler *sched)
 {
 	bool res;
 	struct spa_graph_port *p;
@@ -115,10 +83,14 @@ static inline bool spa_graph_scheduler_iterate(struct spa_graph_scheduler *sched
 			if (n->state == SPA_RESULT_NEED_BUFFER) {
 				n->ready_in = 0;
 				spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
-					struct spa_graph_node *pn = p->peer->node;
+					struct spa_graph_node *pn;
+					if (p->peer == NULL)
+						continue;
+					pn = p->peer->node;
 					if (p->io->status == SPA_RESULT_NEED_BUFFER) {
-						if (pn != sched->node
-						    || pn->flags & SPA_GRAPH_NODE_FLAG_ASYNC) {
+						if ((pn != sched->node
+						    || pn->flags & SPA_GRAPH_NODE_FLAG_ASYNC) &&
+						    pn->ready_link.next == NULL) {
 							pn->action = SPA_GRAPH_ACTION_OUT;
 							spa_list_insert(sched->ready.prev,
 									&pn->ready_link);
@@ -128,7 +100,8 @@ static inline bool spa_graph_scheduler_iterate(struct spa_graph_scheduler *sched
 				}
 			} else if (n->state == SPA_RESULT_HAVE_BUFFER) {
 				spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link)
-					spa_scheduler_port_check(sched, p->peer);
+					if (p->peer)
+						spa_graph_queue_port_check(sched, p->peer);
 			}
 			break;
 
@@ -140,7 +113,7 @@ static inline bool spa_graph_scheduler_iterate(struct spa_graph_scheduler *sched
 	return res;
 }
 
-static inline void spa_graph_scheduler_pull(struct spa_graph_scheduler *sched, struct spa_graph_node *node)
+static inline void spa_graph_queue_pull(struct spa_graph_scheduler *sched, struct spa_graph_node *node)
 {
 	debug("node %p start pull\n", node);
 	node->action = SPA_GRAPH_ACTION_CHECK;
@@ -150,7 +123,7 @@ static inline void spa_graph_scheduler_pull(struct spa_graph_scheduler *sched, s
 		spa_list_insert(sched->ready.prev, &node->ready_link);
 }
 
-static inline void spa_graph_scheduler_push(struct spa_graph_scheduler *sched, struct spa_graph_node *node)
+static inline void spa_graph_queue_push(struct spa_graph_scheduler *sched, struct spa_graph_node *node)
 {
 	debug("node %p start push\n", node);
 	node->action = SPA_GRAPH_ACTION_OUT;
@@ -159,8 +132,18 @@ static inline void spa_graph_scheduler_push(struct spa_graph_scheduler *sched, s
 		spa_list_insert(sched->ready.prev, &node->ready_link);
 }
 
+/** Runs one node per iteration from a queue of ready nodes */
+static const struct spa_graph_scheduler_methods spa_graph_scheduler_queue = {
+	SPA_VERSION_GRAPH_SCHEDULER_METHODS,
+	"queue",
+	spa_graph_queue_pull,
+	spa_graph_queue_push,
+	spa_graph_queue_iterate,
+	NULL,
+};
+
 #ifdef __cplusplus
 }  /* extern "C" */
 #endif
 
-#endif /* __SPA_GRAPH_SCHEDULER_H__ */
+#endif /* __SPA_GRAPH_SCHEDULER1_H__ */
@@ -17,50 +17,52 @@
  * Boston, MA 02110-1301, USA.
  */
 
-#ifndef __SPA_GRAPH_SCHEDULER_H__
-#define __SPA_GRAPH_SCHEDULER_H__
+#ifndef __SPA_GRAPH_SCHEDULER2_H__
+#define __SPA_GRAPH_SCHEDULER2_H__
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#include <spa/graph.h>
+#include <spa/graph-scheduler.h>
 
-static inline int spa_graph_scheduler_default(struct spa_graph_node *node)
+static inline int spa_graph_pending_schedule(struct spa_graph_node *node)
 {
 	int res;
-	struct spa_node *n = node->user_data;
 
 	if (node->action == SPA_GRAPH_ACTION_IN)
-		res = spa_node_process_input(n);
+		res = node->callbacks->process_input(node->callbacks_data);
 	else if (node->action == SPA_GRAPH_ACTION_OUT)
-		res = spa_node_process_output(n);
+		res = node->callbacks->process_output(node->callbacks_data);
 	else
 		res = SPA_RESULT_ERROR;
 
 	return res;
 }
 
-static inline void spa_graph_port_check(struct spa_graph *graph, struct spa_graph_port *port)
+static inline void spa_graph_pending_port_check(struct spa_graph_scheduler *sched,
+						struct spa_graph_port *port)
 {
 	struct spa_graph_node *node = port->node;
+	uint32_t required = spa_graph_node_required_in(node);
 
 	if (port->io->status == SPA_RESULT_HAVE_BUFFER)
 		node->ready_in++;
 
-	debug("port %p node %p check %d %d %d\n", port, node, port->io->status, node->ready_in, node->required_in);
+	debug("port %p node %p check %d %d %d\n", port, node, port->io->status, node->ready_in, required);
 
-	if (node->required_in > 0 && node->ready_in == node->required_in) {
+	if (required > 0 && node->ready_in == required) {
 		node->action = SPA_GRAPH_ACTION_IN;
 		if (node->ready_link.next == NULL)
-			spa_list_insert(graph->ready.prev, &node->ready_link);
+			spa_list_insert(sched->ready.prev, &node->ready_link);
 	} else if (node->ready_link.next) {
 		spa_list_remove(&node->ready_link);
 		node->ready_link.next = NULL;
 	}
 }
 
-static inline void spa_graph_node_update(struct spa_graph *graph, struct spa_graph_node *node) {
+static inline void spa_graph_pending_node_update(struct spa_graph_scheduler *sched,
+						 struct spa_graph_node *node) {
 	struct spa_graph_port *p;
 
 	node->ready_in = 0;
@@ -71,7 +73,7 @@ static inline void spa_graph_node_update(struct spa_graph *graph, struct spa_gra
 	debug("node %p update %d ready\n", node, node->ready_in);
 }
 
-static inline bool spa_graph_scheduler_iterate(struct spa_graph *graph)
+static inline bool spa_graph_pending_iterate(struct spa_graph_scheduler *sched)
 {
 	bool empty;
 	struct spa_graph_port *p;
@@ -80,17 +82,17 @@ static inline bool spa_graph_scheduler_iterate(struct spa_graph *graph)
 	uint32_t action;
 
 next:
-	empty = spa_list_is_empty(&graph->ready);
-	if (empty && !spa_list_is_empty(&graph->pending)) {
+	empty = spa_list_is_empty(&sched->ready);
+	if (empty && !spa_list_is_empty(&sched->pending)) {
 		debug("copy pending\n");
-		spa_list_insert_list(&graph->ready, &graph->pending);
-		spa_list_init(&graph->pending);
+		spa_list_insert_list(&sched->ready, &sched->pending);
+		spa_list_init(&sched->pending);
 		empty = false;
 	}
 	if (iter-- == 0 || empty)
 		return !empty;
 
-	n = spa_list_first(&graph->ready, struct spa_graph_node, ready_link);
+	n = spa_list_first(&sched->ready, struct spa_graph_node, ready_link);
 	spa_list_remove(&n->ready_link);
 	n->ready_link.next = NULL;
 
@@ -105,19 +107,19 @@ next:
 		if (action == SPA_GRAPH_ACTION_END)
 			n->action = SPA_GRAPH_ACTION_OUT;
 
-		n->state = n->schedule(n);
+		n->state = spa_graph_pending_schedule(n);
 		debug("node %p schedule %d res %d\n", n, action, n->state);
 
-		if (action == SPA_GRAPH_ACTION_IN && n == graph->node)
+		if (action == SPA_GRAPH_ACTION_IN && n == sched->node)
 			break;
 
 		if (action != SPA_GRAPH_ACTION_END) {
 			debug("node %p add ready for CHECK\n", n);
 			n->action = SPA_GRAPH_ACTION_CHECK;
-			spa_list_insert(graph->ready.prev, &n->ready_link);
+			spa_list_insert(sched->ready.prev, &n->ready_link);
 		}
 		else {
-			spa_graph_node_update(graph, n);
+			spa_graph_pending_node_update(sched, n);
 		}
 		break;
 
@@ -125,13 +127,17 @@ next:
 		if (n->state == SPA_RESULT_NEED_BUFFER) {
 			n->ready_in = 0;
 			spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
-				struct spa_graph_node *pn = p->peer->node;
+				struct spa_graph_node *pn;
+				if (p->peer == NULL)
+					continue;
+				pn = p->peer->node;
 				if (p->io->status == SPA_RESULT_NEED_BUFFER) {
-					if (pn != graph->node
-					    || pn->flags & SPA_GRAPH_NODE_FLAG_ASYNC) {
+					if ((pn != sched->node
+					    || pn->flags & SPA_GRAPH_NODE_FLAG_ASYNC) &&
+					    pn->ready_link.next == NULL) {
 						pn->action = SPA_GRAPH_ACTION_OUT;
 						debug("node %p add ready OUT\n", n);
-						spa_list_insert(graph->ready.prev,
+						spa_list_insert(sched->ready.prev,
 								&pn->ready_link);
 					}
 				} else if (p->io->status == SPA_RESULT_OK)
@@ -140,14 +146,15 @@ next:
 		}
 		else if (n->state == SPA_RESULT_HAVE_BUFFER) {
 			spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link)
-				spa_graph_port_check(graph, p->peer);
+				if (p->peer)
+					spa_graph_pending_port_check(sched, p->peer);
 
 			debug("node %p add pending\n", n);
 			n->action = SPA_GRAPH_ACTION_END;
-			spa_list_insert(&graph->pending, &n->ready_link);
+			spa_list_insert(&sched->pending, &n->ready_link);
 		}
 		else if (n->state == SPA_RESULT_OK) {
-			spa_graph_node_update(graph, n);
+			spa_graph_pending_node_update(sched, n);
 		}
 		break;
 
@@ -157,27 +164,38 @@ next:
 	goto next;
 }
 
-static inline void spa_graph_scheduler_pull(struct spa_graph *graph, struct spa_graph_node *node)
+static inline void spa_graph_pending_pull(struct spa_graph_scheduler *sched, struct spa_graph_node *node)
 {
 	node->action = SPA_GRAPH_ACTION_CHECK;
 	node->state = SPA_RESULT_NEED_BUFFER;
-	graph->node = node;
+	sched->node = node;
 	debug("node %p start pull\n", node);
 	if (node->ready_link.next == NULL)
-		spa_list_insert(graph->ready.prev, &node->ready_link);
+		spa_list_insert(sched->ready.prev, &node->ready_link);
 }
 
-static inline void spa_graph_scheduler_push(struct spa_graph *graph, struct spa_graph_node *node)
+static inline void spa_graph_pending_push(struct spa_graph_scheduler *sched, struct spa_graph_node *node)
 {
 	node->action = SPA_GRAPH_ACTION_OUT;
-	graph->node = node;
+	sched->node = node;
 	debug("node %p start push\n", node);
 	if (node->ready_link.next == NULL)
-		spa_list_insert(graph->ready.prev, &node->ready_link);
+		spa_list_insert(sched->ready.prev, &node->ready_link);
 }
 
+/** Like the queue scheduler but nodes that produced output are run again
+ * only after the ready queue is empty */
+static const struct spa_graph_scheduler_methods spa_graph_scheduler_pending = {
+	SPA_VERSION_GRAPH_SCHEDULER_METHODS,
+	"pending",
+	spa_graph_pending_pull,
+	spa_graph_pending_push,
+	spa_graph_pending_iterate,
+	NULL,
+};
+
 #ifdef __cplusplus
 }  /* extern "C" */
 #endif
 
-#endif /* __SPA_GRAPH_SCHEDULER_H__ */
+#endif /* __SPA_GRAPH_SCHEDULER2_H__ */
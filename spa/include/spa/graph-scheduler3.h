@@ -17,121 +17,96 @@
  * Boston, MA 02110-1301, USA.
  */
 
-#ifndef __SPA_GRAPH_SCHEDULER_H__
-#define __SPA_GRAPH_SCHEDULER_H__
+#ifndef __SPA_GRAPH_SCHEDULER3_H__
+#define __SPA_GRAPH_SCHEDULER3_H__
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#include <spa/graph.h>
+#include <stdlib.h>
 
-struct spa_graph_scheduler {
-	struct spa_graph *graph;
-        struct spa_graph_node *node;
-};
-
-static inline void spa_graph_scheduler_init(struct spa_graph_scheduler *sched,
-					    struct spa_graph *graph)
-{
-	sched->graph = graph;
-	sched->node = NULL;
-}
-
-static inline int spa_graph_node_scheduler_input(void *data)
-{
-	struct spa_node *n = data;
-	return spa_node_process_input(n);
-}
+#include <spa/graph-scheduler.h>
 
-static inline int spa_graph_node_scheduler_output(void *data)
+/* the required inputs of a node, counted from the list that the walk sees
+ * while ports are added in another thread */
+static inline uint32_t spa_graph_node_count_required(struct spa_graph_node *node)
 {
-	struct spa_node *n = data;
-	return spa_node_process_output(n);
-}
-
-
-static const struct spa_graph_node_callbacks spa_graph_node_scheduler_default = {
-	SPA_VERSION_GRAPH_NODE_CALLBACKS,
-	spa_graph_node_scheduler_input,
-	spa_graph_node_scheduler_output,
-};
+	struct spa_graph_port *p;
+	uint32_t required = 0;
 
-static inline int spa_graph_port_scheduler_reuse_buffer(void *data,
-							uint32_t buffer_id)
-{
-	struct spa_graph_port *port = data;
-	struct spa_node *node = port->node->callbacks_data;
-	debug("port %p reuse buffer %d\n", port, buffer_id);
-	return spa_node_port_reuse_buffer(node, port->port_id, buffer_id);
+	spa_graph_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link)
+		if (!(p->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
+			required++;
+	return required;
 }
 
-static const struct spa_graph_port_callbacks spa_graph_port_scheduler_default = {
-	SPA_VERSION_GRAPH_PORT_CALLBACKS,
-	spa_graph_port_scheduler_reuse_buffer,
-};
-
-static inline void spa_graph_scheduler_pull(struct spa_graph_scheduler *sched, struct spa_graph_node *node)
+static inline void spa_graph_scheduler_walk_pull(struct spa_graph_scheduler *sched,
+						 struct spa_graph_node *node)
 {
 	struct spa_graph_port *p;
 	struct spa_graph_node *n, *t;
 	struct spa_list ready;
+	uint32_t required = 0;
 
 	debug("node %p start pull\n", node);
 
 	spa_list_init(&ready);
 
-	node->ready_in = 0;
-	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+	spa_graph_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
 		struct spa_graph_port *pport;
 		struct spa_graph_node *pnode;
-		if ((pport = p->peer) == NULL)
+		if (!(p->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
+			required++;
+		if ((pport = spa_graph_port_peer(p)) == NULL)
 			continue;
 		pnode = pport->node;
 		debug("node %p peer %p io %d\n", node, pnode, pport->io->status);
-		if (pport->io->status == SPA_RESULT_NEED_BUFFER) {
+		if (pport->io->status == SPA_RESULT_NEED_BUFFER)
 			spa_list_insert(ready.prev, &pnode->ready_link);
-		}
-		else if (pport->io->status == SPA_RESULT_OK && !(pnode->flags & SPA_GRAPH_NODE_FLAG_ASYNC))
-			node->ready_in++;
 	}
 
 	spa_list_for_each_safe(n, t, &ready, ready_link) {
 		n->state = n->callbacks->process_output(n->callbacks_data);
 		debug("peer %p processed out %d\n", n, n->state);
 		if (n->state == SPA_RESULT_NEED_BUFFER)
-			spa_graph_scheduler_pull(sched, n);
-		else {
-			spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
-				if (p->io->status == SPA_RESULT_HAVE_BUFFER)
-			                node->ready_in++;
-			}
-		}
+			spa_graph_scheduler_walk_pull(sched, n);
 		spa_list_remove(&n->ready_link);
 		n->ready_link.next = NULL;
 	}
 
-	debug("node %p %d %d\n", node, node->ready_in, node->required_in);
+	/* count the inputs after the peers ran, a peer that is shared with a
+	 * node that was pulled before in this cycle can have its output ready
+	 * without running again */
+	node->ready_in = 0;
+	spa_graph_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		struct spa_graph_port *pport;
+		if ((pport = spa_graph_port_peer(p)) == NULL)
+			continue;
+		if (pport->io->status == SPA_RESULT_HAVE_BUFFER ||
+		    (pport->io->status == SPA_RESULT_OK &&
+		     !(pport->node->flags & SPA_GRAPH_NODE_FLAG_ASYNC)))
+			node->ready_in++;
+	}
+
+	debug("node %p %d %d\n", node, node->ready_in, required);
 
-	if (node->required_in > 0 && node->ready_in == node->required_in) {
+	if (required > 0 && node->ready_in == required) {
 		node->state = node->callbacks->process_input(node->callbacks_data);
 		debug("node %p processed in %d\n", node, node->state);
 		if (node->state == SPA_RESULT_HAVE_BUFFER) {
-			spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+			spa_graph_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+				struct spa_graph_port *pport = spa_graph_port_peer(p);
 				if (p->io->status == SPA_RESULT_HAVE_BUFFER)
-					if (p->peer)
-				                p->peer->node->ready_in++;
+					if (pport)
+				                pport->node->ready_in++;
 			}
 		}
 	}
 }
 
-static inline bool spa_graph_scheduler_iterate(struct spa_graph_scheduler *sched)
-{
-	return false;
-}
-
-static inline void spa_graph_scheduler_push(struct spa_graph_scheduler *sched, struct spa_graph_node *node);
+static inline void spa_graph_scheduler_walk_push(struct spa_graph_scheduler *sched,
+						 struct spa_graph_node *node);
 
 static inline void spa_graph_scheduler_chain(struct spa_graph_scheduler *sched,
 					     struct spa_list *ready)
@@ -144,10 +119,10 @@ static inline void spa_graph_scheduler_chain(struct spa_graph_scheduler *sched,
 		n->state = n->callbacks->process_input(n->callbacks_data);
 		debug("node %p chain processed in %d\n", n, n->state);
 		if (n->state == SPA_RESULT_HAVE_BUFFER)
-			spa_graph_scheduler_push(sched, n);
+			spa_graph_scheduler_walk_push(sched, n);
 		else {
 			n->ready_in = 0;
-			spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
+			spa_graph_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
 				if (p->io->status == SPA_RESULT_OK && !(n->flags & SPA_GRAPH_NODE_FLAG_ASYNC))
 			                n->ready_in++;
 			}
@@ -157,7 +132,8 @@ static inline void spa_graph_scheduler_chain(struct spa_graph_scheduler *sched,
 	}
 }
 
-static inline void spa_graph_scheduler_push(struct spa_graph_scheduler *sched, struct spa_graph_node *node)
+static inline void spa_graph_scheduler_walk_push(struct spa_graph_scheduler *sched,
+						 struct spa_graph_node *node)
 {
 	struct spa_graph_port *p;
 	struct spa_list ready;
@@ -166,19 +142,21 @@ static inline void spa_graph_scheduler_push(struct spa_graph_scheduler *sched, s
 
 	spa_list_init(&ready);
 
-	spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+	spa_graph_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
 		struct spa_graph_port *pport;
 		struct spa_graph_node *pnode;
-		if ((pport = p->peer) == NULL)
+		uint32_t required;
+		if ((pport = spa_graph_port_peer(p)) == NULL)
 			continue;
 		pnode = pport->node;
 		if (pport->io->status == SPA_RESULT_HAVE_BUFFER)
 			pnode->ready_in++;
 
+		required = spa_graph_node_count_required(pnode);
 		debug("node %p peer %p io %d %d %d\n", node, pnode, pport->io->status,
-				pnode->ready_in, pnode->required_in);
+				pnode->ready_in, required);
 
-		if (pnode->required_in > 0 && pnode->ready_in == pnode->required_in)
+		if (required > 0 && pnode->ready_in == required)
                         spa_list_insert(ready.prev, &pnode->ready_link);
 	}
 
@@ -188,15 +166,530 @@ static inline void spa_graph_scheduler_push(struct spa_graph_scheduler *sched, s
 	debug("node %p processed out %d\n", node, node->state);
 	if (node->state == SPA_RESULT_NEED_BUFFER) {
 		node->ready_in = 0;
-		spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		spa_graph_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
 			if (p->io->status == SPA_RESULT_OK && !(node->flags & SPA_GRAPH_NODE_FLAG_ASYNC))
 				node->ready_in++;
 		}
 	}
 }
 
+/* make room for n_nodes and n_links in the plan */
+static inline int spa_graph_plan_ensure(struct spa_graph_plan *plan,
+					uint32_t n_nodes, uint32_t n_links)
+{
+	void *p;
+
+	if (n_nodes > plan->max_nodes) {
+		if ((p = realloc(plan->nodes, n_nodes * sizeof(struct spa_graph_plan_node))) == NULL)
+			return SPA_RESULT_NO_MEMORY;
+		plan->nodes = p;
+		if ((p = realloc(plan->order, n_nodes * sizeof(struct spa_graph_node *))) == NULL)
+			return SPA_RESULT_NO_MEMORY;
+		plan->order = p;
+		if ((p = realloc(plan->ready, n_nodes * sizeof(uint32_t))) == NULL)
+			return SPA_RESULT_NO_MEMORY;
+		plan->ready = p;
+		if ((p = realloc(plan->degree, n_nodes * sizeof(uint32_t))) == NULL)
+			return SPA_RESULT_NO_MEMORY;
+		plan->degree = p;
+		plan->max_nodes = n_nodes;
+	}
+	if (n_links > plan->max_links) {
+		if ((p = realloc(plan->links, n_links * sizeof(struct spa_graph_plan_link))) == NULL)
+			return SPA_RESULT_NO_MEMORY;
+		plan->links = p;
+		plan->max_links = n_links;
+	}
+	return SPA_RESULT_OK;
+}
+
+static inline bool spa_graph_plan_is_linked(struct spa_graph *graph, struct spa_graph_port *port)
+{
+	struct spa_graph_port *peer = spa_graph_port_peer(port);
+	return peer != NULL && peer->node->graph == graph;
+}
+
+/** Sort the nodes of the graph in topological order and store them with
+ * their links in the plan. Nodes that are part of a cycle are added after
+ * the sorted nodes.
+ *
+ * This allocates memory when the graph grew since the last compile. The nodes
+ * only get their index in the plan as a hint for spa_graph_plan_find_node(),
+ * the sorting is done in the plan so that a cycle that runs at the same time
+ * sees consistent nodes.
+ */
+static inline int spa_graph_plan_compile(struct spa_graph_plan *plan, struct spa_graph *graph)
+{
+	struct spa_graph_node *n;
+	struct spa_graph_port *p;
+	uint32_t i, head, tail, n_nodes = 0, n_links = 0;
+	uint32_t version = __atomic_load_n(&graph->version, __ATOMIC_ACQUIRE);
+	int res;
+
+	plan->valid = false;
+
+	spa_graph_list_for_each(n, &graph->nodes, link) {
+		n_nodes++;
+		spa_graph_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link)
+			if (spa_graph_plan_is_linked(graph, p))
+				n_links++;
+		spa_graph_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link)
+			if (spa_graph_plan_is_linked(graph, p))
+				n_links++;
+	}
+	if ((res = spa_graph_plan_ensure(plan, n_nodes, n_links)) < 0)
+		return res;
+
+	/* count the linked inputs of each node, degree holds the number of
+	 * inputs that still need to be sorted */
+	i = tail = 0;
+	spa_graph_list_for_each(n, &graph->nodes, link) {
+		n->sort_index = i;
+		plan->degree[i] = 0;
+		spa_graph_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link)
+			if (spa_graph_plan_is_linked(graph, p))
+				plan->degree[i]++;
+		if (plan->degree[i] == 0)
+			plan->order[tail++] = n;
+		i++;
+	}
+	for (head = 0; head < tail; head++) {
+		spa_graph_list_for_each(p, &plan->order[head]->ports[SPA_DIRECTION_OUTPUT], link) {
+			if (!spa_graph_plan_is_linked(graph, p))
+				continue;
+			n = p->peer->node;
+			if (plan->degree[n->sort_index] > 0 && --plan->degree[n->sort_index] == 0)
+				plan->order[tail++] = n;
+		}
+	}
+	if (tail < n_nodes) {
+		spa_graph_list_for_each(n, &graph->nodes, link)
+			if (plan->degree[n->sort_index] > 0) {
+				plan->degree[n->sort_index] = 0;
+				plan->order[tail++] = n;
+			}
+	}
+	for (i = 0; i < n_nodes; i++)
+		plan->order[i]->sort_index = i;
+
+	n_links = 0;
+	for (i = 0; i < n_nodes; i++) {
+		struct spa_graph_plan_node *pn = &plan->nodes[i];
+
+		n = plan->order[i];
+		pn->node = n;
+		pn->callbacks = n->callbacks;
+		pn->callbacks_data = n->callbacks_data;
+		pn->flags = n->flags;
+		pn->required_in = 0;
+		pn->state = SPA_GRAPH_PLAN_IDLE;
+		pn->pending = 0;
+
+		pn->in_index = n_links;
+		spa_graph_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
+			if (!(p->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
+				pn->required_in++;
+			if (!spa_graph_plan_is_linked(graph, p))
+				continue;
+			plan->links[n_links].io = p->io;
+			plan->links[n_links].peer_io = p->peer->io;
+			plan->links[n_links].peer = p->peer->node->sort_index;
+			n_links++;
+		}
+		pn->n_in = n_links - pn->in_index;
+
+		pn->out_index = n_links;
+		spa_graph_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
+			if (!spa_graph_plan_is_linked(graph, p))
+				continue;
+			plan->links[n_links].io = p->io;
+			plan->links[n_links].peer_io = p->peer->io;
+			plan->links[n_links].peer = p->peer->node->sort_index;
+			n_links++;
+		}
+		pn->n_out = n_links - pn->out_index;
+
+		__atomic_store_n(&n->plan_index, i, __ATOMIC_RELAXED);
+	}
+	plan->n_nodes = n_nodes;
+	plan->n_links = n_links;
+	plan->version = version;
+	plan->valid = true;
+
+	debug("plan %p compiled %d nodes %d links\n", plan, n_nodes, n_links);
+
+	return SPA_RESULT_OK;
+}
+
+/* count the inputs of a node that have data, or that are done and
+ * come from a synchronous node */
+static inline uint32_t spa_graph_plan_ready_in(struct spa_graph_plan *plan,
+					       struct spa_graph_plan_node *pn)
+{
+	struct spa_graph_plan_link *l = &plan->links[pn->in_index];
+	uint32_t i, ready = 0;
+
+	for (i = 0; i < pn->n_in; i++, l++) {
+		if (l->peer_io->status == SPA_RESULT_HAVE_BUFFER ||
+		    (l->peer_io->status == SPA_RESULT_OK &&
+		     !(plan->nodes[l->peer].flags & SPA_GRAPH_NODE_FLAG_ASYNC)))
+			ready++;
+	}
+	pn->node->ready_in = ready;
+	return ready;
+}
+
+/** Run node \a index of a parallel pull and release the nodes that use
+ * its output. This can be called from any thread.
+ *
+ * \param plan a plan
+ * \param index the node to run, it should have no pending inputs
+ * \param ready called with each node that can run now
+ * \param data data passed to \a ready
+ */
+static inline void spa_graph_plan_run_node(struct spa_graph_plan *plan, uint32_t index,
+					   void (*ready) (void *data, uint32_t index),
+					   void *data)
+{
+	struct spa_graph_plan_node *nodes = plan->nodes, *pn = &nodes[index], *peer;
+	struct spa_graph_plan_link *l;
+	uint32_t j;
+
+	if (pn->state == SPA_GRAPH_PLAN_SOURCE) {
+		pn->node->state = pn->callbacks->process_output(pn->callbacks_data);
+		debug("node %p parallel processed out %d\n", pn->node, pn->node->state);
+	}
+	else if (pn->required_in > 0 && spa_graph_plan_ready_in(plan, pn) == pn->required_in) {
+		pn->node->state = pn->callbacks->process_input(pn->callbacks_data);
+		debug("node %p parallel processed in %d\n", pn->node, pn->node->state);
+	}
+
+	for (j = 0, l = &plan->links[pn->out_index]; j < pn->n_out; j++, l++) {
+		peer = &nodes[l->peer];
+		if (l->peer <= index || peer->state != SPA_GRAPH_PLAN_ACTIVE)
+			continue;
+		if (__atomic_sub_fetch(&peer->pending, 1, __ATOMIC_ACQ_REL) == 0)
+			ready(data, l->peer);
+	}
+	__atomic_sub_fetch(&plan->remaining, 1, __ATOMIC_RELEASE);
+}
+
+/* Pull the active nodes up to \a last with an executor. The output of the
+ * peers that have inputs themselves is processed in order to find the
+ * nodes that need to run, like in the sequential pull. The sources and the
+ * nodes that need input are then run by the executor as soon as the active
+ * nodes before them are done, so that independent branches of the graph
+ * run at the same time. */
+static inline void spa_graph_scheduler_plan_pull_parallel(struct spa_graph_scheduler *sched,
+							  struct spa_graph_plan *plan,
+							  uint32_t last)
+{
+	struct spa_graph_plan_node *nodes = plan->nodes, *pn, *peer;
+	struct spa_graph_plan_link *l;
+	uint32_t i, j, first = last, n_ready = 0;
+	int32_t remaining = 0;
+
+	for (i = last + 1; i-- > 0;) {
+		pn = &nodes[i];
+		if (pn->state != SPA_GRAPH_PLAN_ACTIVE)
+			continue;
+
+		first = SPA_MIN(first, i);
+		for (j = 0, l = &plan->links[pn->in_index]; j < pn->n_in; j++, l++) {
+			if (l->peer >= i || l->peer_io->status != SPA_RESULT_NEED_BUFFER)
+				continue;
+			peer = &nodes[l->peer];
+			if (peer->state != SPA_GRAPH_PLAN_IDLE)
+				continue;
+
+			first = SPA_MIN(first, l->peer);
+			if (peer->n_in == 0) {
+				/* sources produce when the executor runs them */
+				peer->state = SPA_GRAPH_PLAN_SOURCE;
+				continue;
+			}
+			peer->node->state = peer->callbacks->process_output(peer->callbacks_data);
+			debug("peer %p processed out %d\n", peer->node, peer->node->state);
+			peer->state = peer->node->state == SPA_RESULT_NEED_BUFFER ?
+				SPA_GRAPH_PLAN_ACTIVE : SPA_GRAPH_PLAN_DONE;
+		}
+	}
+
+	for (i = first; i <= last; i++) {
+		pn = &nodes[i];
+		if (pn->state != SPA_GRAPH_PLAN_ACTIVE && pn->state != SPA_GRAPH_PLAN_SOURCE)
+			continue;
+
+		pn->pending = 0;
+		for (j = 0, l = &plan->links[pn->in_index]; j < pn->n_in; j++, l++) {
+			if (l->peer < i &&
+			    (nodes[l->peer].state == SPA_GRAPH_PLAN_ACTIVE ||
+			     nodes[l->peer].state == SPA_GRAPH_PLAN_SOURCE))
+				pn->pending++;
+		}
+		if (pn->pending == 0)
+			plan->ready[n_ready++] = i;
+		remaining++;
+	}
+	__atomic_store_n(&plan->remaining, remaining, __ATOMIC_RELEASE);
+
+	sched->executor->run(sched->executor_data, plan, plan->ready, n_ready);
+
+	for (i = first; i <= last; i++)
+		nodes[i].state = SPA_GRAPH_PLAN_IDLE;
+}
+
+/* end the cycle with the active plan, the system call is only made when
+ * spa_graph_scheduler_update() waits for it */
+static inline void spa_graph_scheduler_release_plan(struct spa_graph_scheduler *sched)
+{
+	__atomic_store_n(&sched->active, NULL, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&sched->waiters, __ATOMIC_SEQ_CST) > 0) {
+		__atomic_add_fetch(&sched->released, 1, __ATOMIC_SEQ_CST);
+		syscall(SYS_futex, &sched->released, FUTEX_WAKE_PRIVATE,
+			INT32_MAX, NULL, NULL, 0);
+	}
+}
+
+/* Get the plan for a cycle, NULL when spa_graph_scheduler_update() did not
+ * publish a plan for the current graph yet. The plan is marked active so
+ * that the next update makes the new plan in the other one. */
+static inline struct spa_graph_plan *
+spa_graph_scheduler_acquire_plan(struct spa_graph_scheduler *sched)
+{
+	struct spa_graph_plan *plan;
+	uint32_t version = __atomic_load_n(&sched->graph->version, __ATOMIC_ACQUIRE);
+
+	do {
+		plan = __atomic_load_n(&sched->plan, __ATOMIC_SEQ_CST);
+		__atomic_store_n(&sched->active, plan, __ATOMIC_SEQ_CST);
+	} while (plan != __atomic_load_n(&sched->plan, __ATOMIC_SEQ_CST));
+
+	/* the graph changed and the plan for it is not published yet */
+	if (!plan->valid || plan->version != version) {
+		spa_graph_scheduler_release_plan(sched);
+		return NULL;
+	}
+	return plan;
+}
+
+/* the index of \a node in \a plan or SPA_ID_INVALID, the index in the node
+ * can be of a newer plan that is being compiled */
+static inline uint32_t spa_graph_plan_find_node(struct spa_graph_plan *plan,
+						struct spa_graph_node *node)
+{
+	uint32_t i = __atomic_load_n(&node->plan_index, __ATOMIC_RELAXED);
+
+	if (i < plan->n_nodes && plan->nodes[i].node == node)
+		return i;
+
+	for (i = 0; i < plan->n_nodes; i++) {
+		if (plan->nodes[i].node == node)
+			return i;
+	}
+	return SPA_ID_INVALID;
+}
+
+/* The same as the recursive pull, but as two straight loops over the plan.
+ * Walking backwards from the last active node, the output of the peers that
+ * need a buffer is processed and the peers that need input themselves are
+ * marked active. Walking forwards again, the active nodes with all inputs
+ * ready are processed. */
+static inline void spa_graph_scheduler_plan_pull(struct spa_graph_scheduler *sched,
+						 struct spa_graph_plan *plan,
+						 uint32_t last)
+{
+	struct spa_graph_plan_node *nodes = plan->nodes, *pn, *peer;
+	struct spa_graph_plan_link *l;
+	uint32_t i, j, first = last;
+
+	for (i = last + 1; i-- > 0;) {
+		pn = &nodes[i];
+		if (pn->state != SPA_GRAPH_PLAN_ACTIVE)
+			continue;
+
+		first = SPA_MIN(first, i);
+		for (j = 0, l = &plan->links[pn->in_index]; j < pn->n_in; j++, l++) {
+			/* peers after the node are part of a cycle */
+			if (l->peer >= i || l->peer_io->status != SPA_RESULT_NEED_BUFFER)
+				continue;
+			peer = &nodes[l->peer];
+			if (peer->state != SPA_GRAPH_PLAN_IDLE)
+				continue;
+
+			peer->node->state = peer->callbacks->process_output(peer->callbacks_data);
+			debug("peer %p processed out %d\n", peer->node, peer->node->state);
+			peer->state = peer->node->state == SPA_RESULT_NEED_BUFFER ?
+				SPA_GRAPH_PLAN_ACTIVE : SPA_GRAPH_PLAN_DONE;
+			first = SPA_MIN(first, l->peer);
+		}
+	}
+
+	for (i = first; i <= last; i++) {
+		pn = &nodes[i];
+		if (pn->state == SPA_GRAPH_PLAN_IDLE)
+			continue;
+
+		if (pn->state == SPA_GRAPH_PLAN_ACTIVE &&
+		    pn->required_in > 0 && spa_graph_plan_ready_in(plan, pn) == pn->required_in) {
+			pn->node->state = pn->callbacks->process_input(pn->callbacks_data);
+			debug("node %p processed in %d\n", pn->node, pn->node->state);
+		}
+		pn->state = SPA_GRAPH_PLAN_IDLE;
+	}
+}
+
+/* The same as the recursive push, as two straight loops over the plan.
+ * Walking forwards from the node, the input of the nodes that got a
+ * buffer from a pushed node is processed, they are pushed further when
+ * they produced output. Walking backwards, the output of all pushed nodes
+ * is processed. */
+static inline void spa_graph_scheduler_plan_push(struct spa_graph_scheduler *sched,
+						 struct spa_graph_plan *plan,
+						 uint32_t source)
+{
+	struct spa_graph_plan_node *nodes = plan->nodes, *pn;
+	struct spa_graph_plan_link *l;
+	uint32_t i, j, last;
+	bool pushed;
+
+	debug("node %p start plan push\n", nodes[source].node);
+
+	last = source;
+	nodes[source].state = SPA_GRAPH_PLAN_ACTIVE;
+
+	for (i = source + 1; i < plan->n_nodes; i++) {
+		pn = &nodes[i];
+
+		for (j = 0, pushed = false, l = &plan->links[pn->in_index]; j < pn->n_in; j++, l++)
+			if (nodes[l->peer].state == SPA_GRAPH_PLAN_ACTIVE)
+				pushed = true;
+		if (!pushed)
+			continue;
+
+		if (pn->required_in > 0 && spa_graph_plan_ready_in(plan, pn) == pn->required_in) {
+			pn->node->state = pn->callbacks->process_input(pn->callbacks_data);
+			debug("node %p plan processed in %d\n", pn->node, pn->node->state);
+			if (pn->node->state == SPA_RESULT_HAVE_BUFFER) {
+				pn->state = SPA_GRAPH_PLAN_ACTIVE;
+				last = i;
+			}
+		}
+	}
+
+	for (i = last + 1; i-- > source;) {
+		pn = &nodes[i];
+		if (pn->state != SPA_GRAPH_PLAN_ACTIVE)
+			continue;
+
+		pn->node->state = pn->callbacks->process_output(pn->callbacks_data);
+		debug("node %p plan processed out %d\n", pn->node, pn->node->state);
+		if (pn->node->state == SPA_RESULT_NEED_BUFFER)
+			spa_graph_plan_ready_in(plan, pn);
+
+		pn->state = SPA_GRAPH_PLAN_IDLE;
+	}
+}
+
+static inline void spa_graph_scheduler_plan_run(struct spa_graph_scheduler *sched,
+						struct spa_graph_plan *plan,
+						uint32_t last)
+{
+	if (sched->executor)
+		spa_graph_scheduler_plan_pull_parallel(sched, plan, last);
+	else
+		spa_graph_scheduler_plan_pull(sched, plan, last);
+}
+
+/* run from the plan, fall back to the recursive walk when there is no plan */
+static inline void spa_graph_scheduler_compiled_pull(struct spa_graph_scheduler *sched,
+						     struct spa_graph_node *node)
+{
+	struct spa_graph_plan *plan;
+	uint32_t index;
+
+	if (node->graph == sched->graph &&
+	    (plan = spa_graph_scheduler_acquire_plan(sched)) != NULL) {
+		if ((index = spa_graph_plan_find_node(plan, node)) != SPA_ID_INVALID) {
+			debug("node %p start plan pull\n", node);
+			plan->nodes[index].state = SPA_GRAPH_PLAN_ACTIVE;
+			spa_graph_scheduler_plan_run(sched, plan, index);
+			spa_graph_scheduler_release_plan(sched);
+			return;
+		}
+		spa_graph_scheduler_release_plan(sched);
+	}
+	spa_graph_scheduler_walk_pull(sched, node);
+}
+
+/* pull all the targets in one pass, each node runs at most once */
+static inline void spa_graph_scheduler_compiled_cycle(struct spa_graph_scheduler *sched,
+						      struct spa_graph_node **targets,
+						      uint32_t n_targets)
+{
+	struct spa_graph_plan *plan;
+	uint32_t i, index, last = 0;
+	bool active = false;
+
+	if ((plan = spa_graph_scheduler_acquire_plan(sched)) == NULL) {
+		for (i = 0; i < n_targets; i++)
+			spa_graph_scheduler_walk_pull(sched, targets[i]);
+		return;
+	}
+	for (i = 0; i < n_targets; i++) {
+		if (targets[i]->graph != sched->graph ||
+		    (index = spa_graph_plan_find_node(plan, targets[i])) == SPA_ID_INVALID)
+			continue;
+		plan->nodes[index].state = SPA_GRAPH_PLAN_ACTIVE;
+		last = SPA_MAX(last, index);
+		active = true;
+	}
+	if (active)
+		spa_graph_scheduler_plan_run(sched, plan, last);
+	spa_graph_scheduler_release_plan(sched);
+}
+
+static inline void spa_graph_scheduler_compiled_push(struct spa_graph_scheduler *sched,
+						     struct spa_graph_node *node)
+{
+	struct spa_graph_plan *plan;
+	uint32_t index;
+
+	if (node->graph == sched->graph &&
+	    (plan = spa_graph_scheduler_acquire_plan(sched)) != NULL) {
+		if ((index = spa_graph_plan_find_node(plan, node)) != SPA_ID_INVALID) {
+			spa_graph_scheduler_plan_push(sched, plan, index);
+			spa_graph_scheduler_release_plan(sched);
+			return;
+		}
+		spa_graph_scheduler_release_plan(sched);
+	}
+	spa_graph_scheduler_walk_push(sched, node);
+}
+
+/** Recursively pulls and pushes along the links */
+static const struct spa_graph_scheduler_methods spa_graph_scheduler_recursive = {
+	SPA_VERSION_GRAPH_SCHEDULER_METHODS,
+	"recursive",
+	spa_graph_scheduler_walk_pull,
+	spa_graph_scheduler_walk_push,
+	NULL,
+	NULL,
+};
+
+/** Walks a plan of the graph in topological order, in parallel when there
+ * is an executor */
+static const struct spa_graph_scheduler_methods spa_graph_scheduler_plan = {
+	SPA_VERSION_GRAPH_SCHEDULER_METHODS,
+	"plan",
+	spa_graph_scheduler_compiled_pull,
+	spa_graph_scheduler_compiled_push,
+	NULL,
+	spa_graph_scheduler_compiled_cycle,
+};
+
 #ifdef __cplusplus
 }  /* extern "C" */
 #endif
 
-#endif /* __SPA_GRAPH_SCHEDULER_H__ */
+#endif /* __SPA_GRAPH_SCHEDULER3_H__ */
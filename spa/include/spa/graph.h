@@ -25,6 +25,7 @@ extern "C" {
 #endif
 
 #include <stdio.h>
+#include <time.h>
 
 #include <spa/defs.h>
 #include <spa/list.h>
@@ -42,6 +43,7 @@ struct spa_graph_port;
 
 struct spa_graph {
 	struct spa_list nodes;
+	uint32_t version;	/**< incremented when nodes, ports or links change */
 };
 
 struct spa_graph_node_callbacks {
@@ -59,7 +61,28 @@ struct spa_graph_port_callbacks {
 	int (*reuse_buffer) (void *data, uint32_t buffer_id);
 };
 
+/** Timing of a callback of a node, in nanoseconds. The stats are written
+ * by the thread that runs the node, other threads read them with
+ * spa_graph_stats_read() */
+struct spa_graph_stats {
+	uint32_t seq;		/**< odd while the stats are written */
+	uint64_t count;		/**< number of calls */
+	uint64_t last;		/**< duration of the last call */
+	uint64_t min;		/**< shortest call */
+	uint64_t max;		/**< longest call */
+	uint64_t total;		/**< duration of all calls */
+};
+
+/** Timing of a profiled node, see spa_graph_node_set_profile() */
+struct spa_graph_node_profile {
+	struct spa_graph_stats input;	/**< process_input */
+	struct spa_graph_stats output;	/**< process_output */
+	const struct spa_graph_node_callbacks *callbacks;	/**< the profiled callbacks */
+	void *callbacks_data;
+};
+
 struct spa_graph_node {
+	struct spa_graph *graph;
 	struct spa_list link;
 	struct spa_list ready_link;
 	struct spa_list ports[2];
@@ -69,12 +92,16 @@ struct spa_graph_node {
 #define SPA_GRAPH_ACTION_CHECK   0
 #define SPA_GRAPH_ACTION_IN      1
 #define SPA_GRAPH_ACTION_OUT     2
+#define SPA_GRAPH_ACTION_END     3
 	uint32_t action;
 	uint32_t max_in;
 	uint32_t required_in;
 	uint32_t ready_in;
 	const struct spa_graph_node_callbacks *callbacks;
 	void *callbacks_data;
+	uint32_t plan_index;	/**< position in the last compiled plan */
+	uint32_t sort_index;	/**< position while a plan is compiled */
+	struct spa_graph_node_profile *profile;	/**< timing of the node or NULL */
 };
 
 struct spa_graph_port {
@@ -92,6 +119,46 @@ struct spa_graph_port {
 static inline void spa_graph_init(struct spa_graph *graph)
 {
 	spa_list_init(&graph->nodes);
+	graph->version = 0;
+}
+
+/* let schedulers that cache the topology know about the change */
+static inline void spa_graph_node_changed(struct spa_graph_node *node)
+{
+	if (node && node->graph)
+		__atomic_add_fetch(&node->graph->version, 1, __ATOMIC_RELEASE);
+}
+
+/* Nodes and ports can be added while another thread walks the lists of the
+ * graph. The element is complete before it becomes reachable from the list,
+ * a reader walking forwards sees it or not. */
+static inline void spa_graph_list_append(struct spa_list *list, struct spa_list *elem)
+{
+	elem->prev = list->prev;
+	elem->next = list;
+	__atomic_store_n(&list->prev->next, elem, __ATOMIC_RELEASE);
+	list->prev = elem;
+}
+
+/* walk a list with acquire loads, pairs with spa_graph_list_append() */
+#define spa_graph_list_for_each(pos, head, member)					\
+	for (pos = SPA_CONTAINER_OF(__atomic_load_n(&(head)->next, __ATOMIC_ACQUIRE),	\
+				    __typeof__(*pos), member);				\
+	     &pos->member != (head);							\
+	     pos = SPA_CONTAINER_OF(__atomic_load_n(&pos->member.next, __ATOMIC_ACQUIRE),	\
+				    __typeof__(*pos), member))
+
+/* the required inputs of a node, pairs with spa_graph_port_add() and
+ * spa_graph_port_remove() that change them from another thread */
+static inline uint32_t spa_graph_node_required_in(struct spa_graph_node *node)
+{
+	return __atomic_load_n(&node->required_in, __ATOMIC_ACQUIRE);
+}
+
+/* the peer of a port, pairs with spa_graph_port_link() */
+static inline struct spa_graph_port *spa_graph_port_peer(struct spa_graph_port *port)
+{
+	return __atomic_load_n(&port->peer, __ATOMIC_ACQUIRE);
 }
 
 static inline void
@@ -99,18 +166,138 @@ spa_graph_node_init(struct spa_graph_node *node)
 {
 	spa_list_init(&node->ports[SPA_DIRECTION_INPUT]);
 	spa_list_init(&node->ports[SPA_DIRECTION_OUTPUT]);
+	node->graph = NULL;
 	node->flags = 0;
 	node->max_in = node->required_in = node->ready_in = 0;
+	node->profile = NULL;
 	debug("node %p init\n", node);
 }
 
+static inline uint64_t spa_graph_get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+/* the fields of the stats are stored one by one between an odd and an
+ * even seq, a reader retries when the seq changed while it copied them */
+static inline void spa_graph_stats_store(struct spa_graph_stats *stats, uint64_t count,
+					 uint64_t last, uint64_t min, uint64_t max,
+					 uint64_t total)
+{
+	uint32_t seq = stats->seq;
+
+	__atomic_store_n(&stats->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&stats->count, count, __ATOMIC_RELAXED);
+	__atomic_store_n(&stats->last, last, __ATOMIC_RELAXED);
+	__atomic_store_n(&stats->min, min, __ATOMIC_RELAXED);
+	__atomic_store_n(&stats->max, max, __ATOMIC_RELAXED);
+	__atomic_store_n(&stats->total, total, __ATOMIC_RELAXED);
+	__atomic_store_n(&stats->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static inline void spa_graph_stats_reset(struct spa_graph_stats *stats)
+{
+	spa_graph_stats_store(stats, 0, 0, UINT64_MAX, 0, 0);
+}
+
+static inline void spa_graph_stats_add(struct spa_graph_stats *stats, uint64_t elapsed)
+{
+	spa_graph_stats_store(stats, stats->count + 1, elapsed,
+			      SPA_MIN(stats->min, elapsed), SPA_MAX(stats->max, elapsed),
+			      stats->total + elapsed);
+}
+
+/** Copy \a stats that are written by another thread into \a copy */
+static inline void spa_graph_stats_read(const struct spa_graph_stats *stats,
+					struct spa_graph_stats *copy)
+{
+	uint32_t seq;
+
+	do {
+		seq = __atomic_load_n(&stats->seq, __ATOMIC_ACQUIRE);
+		copy->count = __atomic_load_n(&stats->count, __ATOMIC_RELAXED);
+		copy->last = __atomic_load_n(&stats->last, __ATOMIC_RELAXED);
+		copy->min = __atomic_load_n(&stats->min, __ATOMIC_RELAXED);
+		copy->max = __atomic_load_n(&stats->max, __ATOMIC_RELAXED);
+		copy->total = __atomic_load_n(&stats->total, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || seq != __atomic_load_n(&stats->seq, __ATOMIC_RELAXED));
+	copy->seq = seq;
+}
+
+static inline int spa_graph_node_profile_input(void *data)
+{
+	struct spa_graph_node_profile *profile = ((struct spa_graph_node *) data)->profile;
+	uint64_t start = spa_graph_get_time();
+	int res;
+
+	res = profile->callbacks->process_input(profile->callbacks_data);
+	spa_graph_stats_add(&profile->input, spa_graph_get_time() - start);
+
+	return res;
+}
+
+static inline int spa_graph_node_profile_output(void *data)
+{
+	struct spa_graph_node_profile *profile = ((struct spa_graph_node *) data)->profile;
+	uint64_t start = spa_graph_get_time();
+	int res;
+
+	res = profile->callbacks->process_output(profile->callbacks_data);
+	spa_graph_stats_add(&profile->output, spa_graph_get_time() - start);
+
+	return res;
+}
+
+static const struct spa_graph_node_callbacks spa_graph_node_profile_callbacks = {
+	SPA_VERSION_GRAPH_NODE_CALLBACKS,
+	spa_graph_node_profile_input,
+	spa_graph_node_profile_output,
+};
+
+/** Measure the callbacks of \a node in \a profile, or stop measuring them
+ * when \a profile is NULL. The callbacks of a node that is not profiled are
+ * called without any overhead. This swaps the callbacks of the node, it is
+ * done before the node is added to a graph or while it does not run. */
+static inline void
+spa_graph_node_set_profile(struct spa_graph_node *node,
+			   struct spa_graph_node_profile *profile)
+{
+	if (node->profile == profile)
+		return;
+
+	if (node->profile) {
+		node->callbacks = node->profile->callbacks;
+		node->callbacks_data = node->profile->callbacks_data;
+	}
+	if (profile) {
+		spa_graph_stats_reset(&profile->input);
+		spa_graph_stats_reset(&profile->output);
+		profile->callbacks = node->callbacks;
+		profile->callbacks_data = node->callbacks_data;
+		node->callbacks = &spa_graph_node_profile_callbacks;
+		node->callbacks_data = node;
+	}
+	node->profile = profile;
+	spa_graph_node_changed(node);
+}
+
 static inline void
 spa_graph_node_set_callbacks(struct spa_graph_node *node,
 			     const struct spa_graph_node_callbacks *callbacks,
 			     void *data)
 {
-	node->callbacks = callbacks;
-	node->callbacks_data = data;
+	if (node->profile) {
+		node->profile->callbacks = callbacks;
+		node->profile->callbacks_data = data;
+	} else {
+		node->callbacks = callbacks;
+		node->callbacks_data = data;
+	}
+	spa_graph_node_changed(node);
 }
 
 static inline void
@@ -120,7 +307,9 @@ spa_graph_node_add(struct spa_graph *graph,
 	node->state = SPA_RESULT_NEED_BUFFER;
 	node->action = SPA_GRAPH_ACTION_OUT;
 	node->ready_link.next = NULL;
-	spa_list_insert(graph->nodes.prev, &node->link);
+	node->graph = graph;
+	spa_graph_list_append(&graph->nodes, &node->link);
+	__atomic_add_fetch(&graph->version, 1, __ATOMIC_RELEASE);
 	debug("node %p add\n", node);
 }
 
@@ -153,18 +342,23 @@ spa_graph_port_add(struct spa_graph_node *node,
 {
 	debug("port %p add to node %p\n", port, node);
 	port->node = node;
-	spa_list_insert(node->ports[port->direction].prev, &port->link);
-	node->max_in++;
+	/* counted before the port is visible, a walk that does not see the
+	 * port yet waits for one input more instead of running without it */
+	__atomic_add_fetch(&node->max_in, 1, __ATOMIC_SEQ_CST);
 	if (!(port->flags & SPA_PORT_INFO_FLAG_OPTIONAL) && port->direction == SPA_DIRECTION_INPUT)
-		node->required_in++;
+		__atomic_add_fetch(&node->required_in, 1, __ATOMIC_SEQ_CST);
+	spa_graph_list_append(&node->ports[port->direction], &port->link);
+	spa_graph_node_changed(node);
 }
 
 static inline void spa_graph_node_remove(struct spa_graph_node *node)
 {
 	debug("node %p remove\n", node);
+	spa_graph_node_changed(node);
 	spa_list_remove(&node->link);
 	if (node->ready_link.next)
 		spa_list_remove(&node->ready_link);
+	node->graph = NULL;
 }
 
 static inline void spa_graph_port_remove(struct spa_graph_port *port)
@@ -172,15 +366,18 @@ static inline void spa_graph_port_remove(struct spa_graph_port *port)
 	debug("port %p remove\n", port);
 	spa_list_remove(&port->link);
 	if (!(port->flags & SPA_PORT_INFO_FLAG_OPTIONAL) && port->direction == SPA_DIRECTION_INPUT)
-		port->node->required_in--;
+		__atomic_sub_fetch(&port->node->required_in, 1, __ATOMIC_SEQ_CST);
+	spa_graph_node_changed(port->node);
 }
 
 static inline void
 spa_graph_port_link(struct spa_graph_port *out, struct spa_graph_port *in)
 {
 	debug("port %p link to %p \n", out, in);
-	out->peer = in;
-	in->peer = out;
+	__atomic_store_n(&out->peer, in, __ATOMIC_RELEASE);
+	__atomic_store_n(&in->peer, out, __ATOMIC_RELEASE);
+	spa_graph_node_changed(out->node);
+	spa_graph_node_changed(in->node);
 }
 
 static inline void
@@ -188,6 +385,8 @@ spa_graph_port_unlink(struct spa_graph_port *port)
 {
 	debug("port %p unlink from %p \n", port, port->peer);
 	if (port->peer) {
+		spa_graph_node_changed(port->node);
+		spa_graph_node_changed(port->peer->node);
 		port->peer->peer = NULL;
 		port->peer = NULL;
 	}
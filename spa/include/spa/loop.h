@@ -58,6 +58,7 @@ struct spa_source {
 	int fd;
 	enum spa_io mask;
 	enum spa_io rmask;
+	void *priv;	/**< private data of the loop implementation */
 };
 
 typedef int (*spa_invoke_func_t) (struct spa_loop *loop,
@@ -106,12 +107,16 @@ struct spa_loop {
 
 /** Control hooks */
 struct spa_loop_control_hooks {
-#define SPA_VERSION_LOOP_CONTROL_HOOKS	0
+#define SPA_VERSION_LOOP_CONTROL_HOOKS	1
 	uint32_t version;
 	/** Executed right before waiting for events */
 	void (*before) (void *data);
 	/** Executed right after waiting for events */
 	void (*after) (void *data);
+	/** Check for pending work while the loop spins, since version 1.
+	 * Called often from the loop thread, it must be cheap and can't block.
+	 * Returns true when the next wait will not block for long */
+	bool (*check) (void *data);
 };
 
 /**
@@ -40,6 +40,7 @@ extern "C" {
 #define SPA_TYPE_META__VideoCrop	SPA_TYPE_META_BASE "VideoCrop"
 #define SPA_TYPE_META__Ringbuffer	SPA_TYPE_META_BASE "Ringbuffer"
 #define SPA_TYPE_META__Shared		SPA_TYPE_META_BASE "Shared"
+#define SPA_TYPE_META__AudioLevel	SPA_TYPE_META_BASE "AudioLevel"
 
 struct spa_type_meta {
 	uint32_t Header;
@@ -47,6 +48,7 @@ struct spa_type_meta {
 	uint32_t VideoCrop;
 	uint32_t Ringbuffer;
 	uint32_t Shared;
+	uint32_t AudioLevel;
 };
 
 static inline void spa_type_meta_map(struct spa_type_map *map, struct spa_type_meta *type)
@@ -57,6 +59,7 @@ static inline void spa_type_meta_map(struct spa_type_map *map, struct spa_type_m
 		type->VideoCrop = spa_type_map_get_id(map, SPA_TYPE_META__VideoCrop);
 		type->Ringbuffer = spa_type_map_get_id(map, SPA_TYPE_META__Ringbuffer);
 		type->Shared = spa_type_map_get_id(map, SPA_TYPE_META__Shared);
+		type->AudioLevel = spa_type_map_get_id(map, SPA_TYPE_META__AudioLevel);
 	}
 }
 
@@ -100,6 +103,25 @@ struct spa_meta_shared {
 	uint32_t size;		/**< size of memory */
 };
 
+/** Level of one audio channel, 1.0 is full scale */
+struct spa_meta_audio_level_channel {
+	float peak;		/**< largest absolute sample value */
+	float rms;		/**< root mean square of the samples */
+};
+
+/** Audio level metadata, filled in by the node that produced the
+ * buffer. The size of the metadata limits the number of channels. */
+struct spa_meta_audio_level {
+	uint32_t n_channels;	/**< number of valid channels */
+	uint32_t padding;
+	struct spa_meta_audio_level_channel channels[];	/**< level per channel */
+};
+
+/** The size of audio level metadata for \a n_channels */
+#define spa_meta_audio_level_size(n_channels)	\
+	(sizeof(struct spa_meta_audio_level) +	\
+	 (n_channels) * sizeof(struct spa_meta_audio_level_channel))
+
 /** A metadata element */
 struct spa_meta {
 	uint32_t type;		/**< metadata type */
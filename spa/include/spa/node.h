@@ -58,10 +58,17 @@ struct spa_port_io {
 
 #define SPA_PORT_IO_INIT  (struct spa_port_io) { SPA_RESULT_NEED_BUFFER, SPA_ID_INVALID, }
 
+/** A range of latencies in nanoseconds */
+struct spa_latency_range {
+	uint64_t min;
+	uint64_t max;
+};
+
 /**
  * struct spa_port_info
  * @flags: extra port flags
  * @rate: rate of sequence number increment per second of media data
+ * @latency: the latency that the port adds to the data
  */
 struct spa_port_info {
 #define SPA_PORT_INFO_FLAG_REMOVABLE		(1<<0)	/**< port can be removed */
@@ -76,6 +83,7 @@ struct spa_port_info {
 	uint32_t flags;				/**< port flags */
 	uint32_t rate;				/**< rate of sequence numbers on port */
 	const struct spa_dict *props;		/**< extra port properties */
+	struct spa_latency_range latency;	/**< latency of the data on the port */
 };
 
 
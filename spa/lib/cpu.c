@@ -0,0 +1,172 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#elif defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include <spa/defs.h>
+
+#include "cpu.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+static uint32_t get_xgetbv(void)
+{
+	uint32_t eax, edx;
+
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return eax;
+}
+
+static uint32_t x86_get_flags(void)
+{
+	uint32_t eax, ebx, ecx, edx, max_level;
+	uint32_t flags = 0;
+
+	if (!__get_cpuid(0, &max_level, &ebx, &ecx, &edx))
+		return 0;
+
+	__cpuid(1, eax, ebx, ecx, edx);
+
+	if (edx & bit_MMX)
+		flags |= SPA_CPU_FLAG_MMX;
+	if (edx & bit_SSE)
+		flags |= SPA_CPU_FLAG_SSE;
+	if (edx & bit_SSE2)
+		flags |= SPA_CPU_FLAG_SSE2;
+	if (ecx & bit_SSE3)
+		flags |= SPA_CPU_FLAG_SSE3;
+	if (ecx & bit_SSSE3)
+		flags |= SPA_CPU_FLAG_SSSE3;
+	if (ecx & bit_SSE4_1)
+		flags |= SPA_CPU_FLAG_SSE41;
+	if (ecx & bit_SSE4_2)
+		flags |= SPA_CPU_FLAG_SSE42;
+
+	/* AVX needs the OS to save the YMM state on context switches */
+	if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX) &&
+	    (get_xgetbv() & 0x6) == 0x6) {
+		flags |= SPA_CPU_FLAG_AVX;
+		if (ecx & bit_FMA)
+			flags |= SPA_CPU_FLAG_FMA3;
+
+		if (max_level >= 7) {
+			__cpuid_count(7, 0, eax, ebx, ecx, edx);
+			if (ebx & bit_AVX2)
+				flags |= SPA_CPU_FLAG_AVX2;
+		}
+	}
+	return flags;
+}
+#endif
+
+static uint32_t arch_get_flags(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return x86_get_flags();
+#elif defined(__aarch64__)
+	/* NEON is mandatory on aarch64 */
+	return SPA_CPU_FLAG_NEON;
+#elif defined(__arm__) && defined(HWCAP_NEON)
+	return (getauxval(AT_HWCAP) & HWCAP_NEON) ? SPA_CPU_FLAG_NEON : 0;
+#else
+	return 0;
+#endif
+}
+
+uint32_t spa_cpu_get_flags(void)
+{
+	static bool initialized = false;
+	static uint32_t flags;
+
+	if (!initialized) {
+		flags = arch_get_flags();
+		initialized = true;
+	}
+	return flags;
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+#define MXCSR_DAZ	(1 << 6)
+#define MXCSR_FTZ	(1 << 15)
+
+static int x86_zero_denormals(bool enable)
+{
+	uint32_t flags = spa_cpu_get_flags(), mask = 0, mxcsr;
+
+	if (flags & SPA_CPU_FLAG_SSE)
+		mask |= MXCSR_FTZ;
+	/* not all early SSE CPUs know about DAZ */
+	if (flags & SPA_CPU_FLAG_SSE2)
+		mask |= MXCSR_DAZ;
+	if (mask == 0)
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	__asm__ volatile ("stmxcsr %0" : "=m" (mxcsr));
+	if (enable)
+		mxcsr |= mask;
+	else
+		mxcsr &= ~mask;
+	__asm__ volatile ("ldmxcsr %0" : : "m" (mxcsr));
+
+	return SPA_RESULT_OK;
+}
+#elif defined(__aarch64__) || (defined(__arm__) && defined(__ARM_FP))
+/* the flush-to-zero bit is the same in FPCR and FPSCR */
+#define FPCR_FZ		(1 << 24)
+
+static int arm_zero_denormals(bool enable)
+{
+#if defined(__aarch64__)
+	uint64_t cr;
+	__asm__ volatile ("mrs %0, fpcr" : "=r" (cr));
+	if (enable)
+		cr |= FPCR_FZ;
+	else
+		cr &= ~FPCR_FZ;
+	__asm__ volatile ("msr fpcr, %0" : : "r" (cr));
+#else
+	uint32_t cr;
+	__asm__ volatile ("vmrs %0, fpscr" : "=r" (cr));
+	if (enable)
+		cr |= FPCR_FZ;
+	else
+		cr &= ~FPCR_FZ;
+	__asm__ volatile ("vmsr fpscr, %0" : : "r" (cr));
+#endif
+	return SPA_RESULT_OK;
+}
+#endif
+
+int spa_cpu_zero_denormals(bool enable)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return x86_zero_denormals(enable);
+#elif defined(__aarch64__) || (defined(__arm__) && defined(__ARM_FP))
+	return arm_zero_denormals(enable);
+#else
+	return SPA_RESULT_NOT_IMPLEMENTED;
+#endif
+}
@@ -0,0 +1,72 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_LIBCPU_H__
+#define __SPA_LIBCPU_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* x86 specific */
+#define SPA_CPU_FLAG_MMX	(1<<0)
+#define SPA_CPU_FLAG_SSE	(1<<1)
+#define SPA_CPU_FLAG_SSE2	(1<<2)
+#define SPA_CPU_FLAG_SSE3	(1<<3)
+#define SPA_CPU_FLAG_SSSE3	(1<<4)
+#define SPA_CPU_FLAG_SSE41	(1<<5)
+#define SPA_CPU_FLAG_SSE42	(1<<6)
+#define SPA_CPU_FLAG_AVX	(1<<7)
+#define SPA_CPU_FLAG_AVX2	(1<<8)
+#define SPA_CPU_FLAG_FMA3	(1<<9)
+
+/* arm specific */
+#define SPA_CPU_FLAG_NEON	(1<<16)
+
+/**
+ * Get the features of the CPU we are running on.
+ *
+ * The result is computed once and cached, it is safe to call this
+ * from a realtime thread after the first call.
+ *
+ * Returns: a mask of SPA_CPU_FLAG_* values
+ */
+uint32_t spa_cpu_get_flags(void);
+
+/**
+ * Flush denormal results to zero and treat denormal inputs as zero
+ * in the floating point unit of the calling thread.
+ *
+ * Denormals are very slow to compute with on most CPUs and show up
+ * when signals decay, for example in reverb tails. Call this when
+ * entering a realtime thread that does float processing.
+ *
+ * Returns: SPA_RESULT_OK on success or SPA_RESULT_NOT_IMPLEMENTED when
+ * the CPU has no such mode.
+ */
+int spa_cpu_zero_denormals(bool enable);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __SPA_LIBCPU_H__ */
@@ -97,6 +97,14 @@ int spa_debug_buffer(const struct spa_buffer *buffer)
 			fprintf(stderr, "      fd:     %d\n", h->fd);
 			fprintf(stderr, "      offset: %d\n", h->offset);
 			fprintf(stderr, "      size:   %d\n", h->size);
+		} else if (!strcmp(type_name, SPA_TYPE_META__AudioLevel)) {
+			struct spa_meta_audio_level *h = m->data;
+			uint32_t j;
+			fprintf(stderr, "    struct spa_meta_audio_level:\n");
+			fprintf(stderr, "      n_channels: %u\n", h->n_channels);
+			for (j = 0; j < h->n_channels; j++)
+				fprintf(stderr, "      channel %u: peak %f rms %f\n", j,
+					h->channels[j].peak, h->channels[j].rms);
 		} else {
 			fprintf(stderr, "    Unknown:\n");
 			spa_debug_dump_mem(m->data, m->size);
@@ -0,0 +1,261 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <immintrin.h>
+
+#include "mix.h"
+
+/* Same as the SSE2 versions but on 256 bits registers, the results are
+ * identical to the C versions. */
+
+static void
+add_s16_s16_avx2(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t t;
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		__m256i in = _mm256_loadu_si256((const __m256i *)(s + n));
+		__m256i out = _mm256_loadu_si256((const __m256i *)(d + n));
+		_mm256_storeu_si256((__m256i *)(d + n), _mm256_adds_epi16(out, in));
+	}
+	for (; n < n_samples; n++) {
+		t = d[n] + s[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_f32_f32_avx2(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		__m256 in0 = _mm256_loadu_ps(s + n), in1 = _mm256_loadu_ps(s + n + 8);
+		__m256 out0 = _mm256_loadu_ps(d + n), out1 = _mm256_loadu_ps(d + n + 8);
+		_mm256_storeu_ps(d + n, _mm256_add_ps(out0, in0));
+		_mm256_storeu_ps(d + n + 8, _mm256_add_ps(out1, in1));
+	}
+	for (; n < n_samples; n++)
+		d[n] += s[n];
+}
+
+static inline __m256i
+scale_s16_avx2(__m128i in, __m256 vol)
+{
+	return _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(in)), vol));
+}
+
+static inline __m256i
+pack_s16_avx2(__m256i lo, __m256i hi)
+{
+	/* packs works per 128 bits lane, put the samples back in order */
+	return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+}
+
+static void
+copy_scale_s16_s16_avx2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float v = *(float*)scale;
+	int32_t t;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m256 vol = _mm256_set1_ps(v);
+	__m256i lo, hi;
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		lo = scale_s16_avx2(_mm_loadu_si128((const __m128i *)(s + n)), vol);
+		hi = scale_s16_avx2(_mm_loadu_si128((const __m128i *)(s + n + 8)), vol);
+		_mm256_storeu_si256((__m256i *)(d + n), pack_s16_avx2(lo, hi));
+	}
+	for (; n < n_samples; n++) {
+		t = s[n] * v;
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+copy_scale_f32_f32_avx2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m256 vol = _mm256_set1_ps(v);
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		__m256 in0 = _mm256_loadu_ps(s + n), in1 = _mm256_loadu_ps(s + n + 8);
+		_mm256_storeu_ps(d + n, _mm256_mul_ps(in0, vol));
+		_mm256_storeu_ps(d + n + 8, _mm256_mul_ps(in1, vol));
+	}
+	for (; n < n_samples; n++)
+		d[n] = s[n] * v;
+}
+
+static void
+add_scale_s16_s16_avx2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float v = *(float*)scale;
+	int32_t t;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m256 vol = _mm256_set1_ps(v);
+	__m256i lo, hi;
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		lo = scale_s16_avx2(_mm_loadu_si128((const __m128i *)(s + n)), vol);
+		hi = scale_s16_avx2(_mm_loadu_si128((const __m128i *)(s + n + 8)), vol);
+		lo = _mm256_add_epi32(lo, _mm256_cvtepi16_epi32(
+					_mm_loadu_si128((const __m128i *)(d + n))));
+		hi = _mm256_add_epi32(hi, _mm256_cvtepi16_epi32(
+					_mm_loadu_si128((const __m128i *)(d + n + 8))));
+		_mm256_storeu_si256((__m256i *)(d + n), pack_s16_avx2(lo, hi));
+	}
+	for (; n < n_samples; n++) {
+		t = d[n] + (int32_t) (s[n] * v);
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_scale_f32_f32_avx2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m256 vol = _mm256_set1_ps(v);
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		__m256 in0 = _mm256_loadu_ps(s + n), in1 = _mm256_loadu_ps(s + n + 8);
+		__m256 out0 = _mm256_loadu_ps(d + n), out1 = _mm256_loadu_ps(d + n + 8);
+		_mm256_storeu_ps(d + n, _mm256_add_ps(out0, _mm256_mul_ps(in0, vol)));
+		_mm256_storeu_ps(d + n + 8, _mm256_add_ps(out1, _mm256_mul_ps(in1, vol)));
+	}
+	for (; n < n_samples; n++)
+		d[n] += s[n] * v;
+}
+static void
+mix_s16_s16_avx2(void *dst, const void *src[], uint32_t n_src, int n_bytes)
+{
+	int16_t *d = dst;
+	int32_t t;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	uint32_t i;
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		__m256i lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+
+		for (i = 0; i < n_src; i++) {
+			const int16_t *s = src[i];
+			lo = _mm256_add_epi32(lo, _mm256_cvtepi16_epi32(
+						_mm_loadu_si128((const __m128i *)(s + n))));
+			hi = _mm256_add_epi32(hi, _mm256_cvtepi16_epi32(
+						_mm_loadu_si128((const __m128i *)(s + n + 8))));
+		}
+		_mm256_storeu_si256((__m256i *)(d + n), pack_s16_avx2(lo, hi));
+	}
+	for (; n < n_samples; n++) {
+		t = 0;
+		for (i = 0; i < n_src; i++)
+			t += ((const int16_t *) src[i])[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+mix_f32_f32_avx2(void *dst, const void *src[], uint32_t n_src, int n_bytes)
+{
+	float *d = dst;
+	float t;
+	int n, n_samples = n_bytes / sizeof(float);
+	uint32_t i;
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		__m256 out0 = _mm256_setzero_ps(), out1 = _mm256_setzero_ps();
+
+		for (i = 0; i < n_src; i++) {
+			const float *s = src[i];
+			out0 = _mm256_add_ps(out0, _mm256_loadu_ps(s + n));
+			out1 = _mm256_add_ps(out1, _mm256_loadu_ps(s + n + 8));
+		}
+		_mm256_storeu_ps(d + n, out0);
+		_mm256_storeu_ps(d + n + 8, out1);
+	}
+	for (; n < n_samples; n++) {
+		t = 0.0f;
+		for (i = 0; i < n_src; i++)
+			t += ((const float *) src[i])[n];
+		d[n] = t;
+	}
+}
+
+/* the strided versions can only be vectorized when both sides are packed */
+#define STRIDED(name)									\
+static void										\
+name##_i_avx2(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)	\
+{											\
+	if (dst_stride == 1 && src_stride == 1)						\
+		name##_avx2(dst, src, n_bytes);						\
+	else										\
+		name##_i_c(dst, dst_stride, src, src_stride, n_bytes);			\
+}
+#define STRIDED_SCALE(name)							\
+static void									\
+name##_i_avx2(void *dst, int dst_stride, const void *src, int src_stride,	\
+		const void *scale, int n_bytes)					\
+{										\
+	if (dst_stride == 1 && src_stride == 1)					\
+		name##_avx2(dst, src, scale, n_bytes);				\
+	else									\
+		name##_i_c(dst, dst_stride, src, src_stride, scale, n_bytes);	\
+}
+
+STRIDED(add_s16_s16)
+STRIDED(add_f32_f32)
+STRIDED_SCALE(copy_scale_s16_s16)
+STRIDED_SCALE(copy_scale_f32_f32)
+STRIDED_SCALE(add_scale_s16_s16)
+STRIDED_SCALE(add_scale_f32_f32)
+
+void spa_audiomixer_get_ops_avx2(struct spa_audiomixer_ops *ops)
+{
+	/* plain copies are left to memcpy, which is already vectorized */
+	ops->add[CONV_S16_S16] = add_s16_s16_avx2;
+	ops->add[CONV_F32_F32] = add_f32_f32_avx2;
+	ops->copy_scale[CONV_S16_S16] = copy_scale_s16_s16_avx2;
+	ops->copy_scale[CONV_F32_F32] = copy_scale_f32_f32_avx2;
+	ops->add_scale[CONV_S16_S16] = add_scale_s16_s16_avx2;
+	ops->add_scale[CONV_F32_F32] = add_scale_f32_f32_avx2;
+	ops->add_i[CONV_S16_S16] = add_s16_s16_i_avx2;
+	ops->add_i[CONV_F32_F32] = add_f32_f32_i_avx2;
+	ops->copy_scale_i[CONV_S16_S16] = copy_scale_s16_s16_i_avx2;
+	ops->copy_scale_i[CONV_F32_F32] = copy_scale_f32_f32_i_avx2;
+	ops->add_scale_i[CONV_S16_S16] = add_scale_s16_s16_i_avx2;
+	ops->add_scale_i[CONV_F32_F32] = add_scale_f32_f32_i_avx2;
+	ops->mix[CONV_S16_S16] = mix_s16_s16_avx2;
+	ops->mix[CONV_F32_F32] = mix_f32_f32_avx2;
+}
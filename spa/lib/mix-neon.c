@@ -0,0 +1,352 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <arm_neon.h>
+
+#include "mix.h"
+
+/* The s16 samples are scaled as floats, vcvtq_s32_f32 truncates like the
+ * cast in the C version and vqmovn_s32 does the clamping. */
+
+static void
+add_s16_s16_neon(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t t;
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		vst1q_s16(d + n, vqaddq_s16(vld1q_s16(d + n), vld1q_s16(s + n)));
+
+	for (; n < n_samples; n++) {
+		t = d[n] + s[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_f32_f32_neon(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		vst1q_f32(d + n, vaddq_f32(vld1q_f32(d + n), vld1q_f32(s + n)));
+		vst1q_f32(d + n + 4, vaddq_f32(vld1q_f32(d + n + 4), vld1q_f32(s + n + 4)));
+	}
+	for (; n < n_samples; n++)
+		d[n] += s[n];
+}
+
+static inline int32x4_t scale_s16_neon(int16x4_t in, float v)
+{
+	return vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(in)), v));
+}
+
+static void
+copy_scale_s16_s16_neon(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float v = *(float*)scale;
+	int32_t t;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32x4_t lo, hi;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		int16x8_t in = vld1q_s16(s + n);
+		lo = scale_s16_neon(vget_low_s16(in), v);
+		hi = scale_s16_neon(vget_high_s16(in), v);
+		vst1q_s16(d + n, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+	}
+	for (; n < n_samples; n++) {
+		t = s[n] * v;
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+copy_scale_f32_f32_neon(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		vst1q_f32(d + n, vmulq_n_f32(vld1q_f32(s + n), v));
+		vst1q_f32(d + n + 4, vmulq_n_f32(vld1q_f32(s + n + 4), v));
+	}
+	for (; n < n_samples; n++)
+		d[n] = s[n] * v;
+}
+
+static void
+add_scale_s16_s16_neon(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float v = *(float*)scale;
+	int32_t t;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32x4_t lo, hi;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		int16x8_t in = vld1q_s16(s + n), out = vld1q_s16(d + n);
+		lo = vaddw_s16(scale_s16_neon(vget_low_s16(in), v), vget_low_s16(out));
+		hi = vaddw_s16(scale_s16_neon(vget_high_s16(in), v), vget_high_s16(out));
+		vst1q_s16(d + n, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+	}
+	for (; n < n_samples; n++) {
+		t = d[n] + (int32_t) (s[n] * v);
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_scale_f32_f32_neon(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	/* no vmlaq_f32 here, it can be fused and would not round like the C code */
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		vst1q_f32(d + n, vaddq_f32(vld1q_f32(d + n),
+					   vmulq_n_f32(vld1q_f32(s + n), v)));
+		vst1q_f32(d + n + 4, vaddq_f32(vld1q_f32(d + n + 4),
+					       vmulq_n_f32(vld1q_f32(s + n + 4), v)));
+	}
+	for (; n < n_samples; n++)
+		d[n] += s[n] * v;
+}
+static void
+mix_s16_s16_neon(void *dst, const void *src[], uint32_t n_src, int n_bytes)
+{
+	int16_t *d = dst;
+	int32_t t;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	uint32_t i;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		int32x4_t lo = vdupq_n_s32(0), hi = vdupq_n_s32(0);
+
+		for (i = 0; i < n_src; i++) {
+			int16x8_t in = vld1q_s16((const int16_t *) src[i] + n);
+			lo = vaddw_s16(lo, vget_low_s16(in));
+			hi = vaddw_s16(hi, vget_high_s16(in));
+		}
+		vst1q_s16(d + n, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+	}
+	for (; n < n_samples; n++) {
+		t = 0;
+		for (i = 0; i < n_src; i++)
+			t += ((const int16_t *) src[i])[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+mix_f32_f32_neon(void *dst, const void *src[], uint32_t n_src, int n_bytes)
+{
+	float *d = dst;
+	float t;
+	int n, n_samples = n_bytes / sizeof(float);
+	uint32_t i;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		float32x4_t out0 = vdupq_n_f32(0.0f), out1 = vdupq_n_f32(0.0f);
+
+		for (i = 0; i < n_src; i++) {
+			const float *s = src[i];
+			out0 = vaddq_f32(out0, vld1q_f32(s + n));
+			out1 = vaddq_f32(out1, vld1q_f32(s + n + 4));
+		}
+		vst1q_f32(d + n, out0);
+		vst1q_f32(d + n + 4, out1);
+	}
+	for (; n < n_samples; n++) {
+		t = 0.0f;
+		for (i = 0; i < n_src; i++)
+			t += ((const float *) src[i])[n];
+		d[n] = t;
+	}
+}
+
+/* the strided versions can only be vectorized when both sides are packed */
+#define STRIDED(name)									\
+static void										\
+name##_i_neon(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)	\
+{											\
+	if (dst_stride == 1 && src_stride == 1)						\
+		name##_neon(dst, src, n_bytes);						\
+	else										\
+		name##_i_c(dst, dst_stride, src, src_stride, n_bytes);			\
+}
+#define STRIDED_SCALE(name)							\
+static void									\
+name##_i_neon(void *dst, int dst_stride, const void *src, int src_stride,	\
+		const void *scale, int n_bytes)					\
+{										\
+	if (dst_stride == 1 && src_stride == 1)					\
+		name##_neon(dst, src, scale, n_bytes);				\
+	else									\
+		name##_i_c(dst, dst_stride, src, src_stride, scale, n_bytes);	\
+}
+
+STRIDED(add_s16_s16)
+STRIDED(add_f32_f32)
+STRIDED_SCALE(copy_scale_s16_s16)
+STRIDED_SCALE(copy_scale_f32_f32)
+STRIDED_SCALE(add_scale_s16_s16)
+STRIDED_SCALE(add_scale_f32_f32)
+
+static uint32_t
+scrub_f32_neon(void *dst, int n_bytes)
+{
+	uint32_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	uint32x4_t exp = vdupq_n_u32(0x7f800000), bad, acc = vdupq_n_u32(0);
+	uint32x2_t t;
+
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		uint32x4_t in = vld1q_u32(d + n);
+		bad = vceqq_u32(vandq_u32(in, exp), exp);
+		vst1q_u32(d + n, vbicq_u32(in, bad));
+		/* bad lanes are all ones, subtracting counts them */
+		acc = vsubq_u32(acc, bad);
+	}
+	t = vadd_u32(vget_low_u32(acc), vget_high_u32(acc));
+	t = vpadd_u32(t, t);
+
+	return vget_lane_u32(t, 0) +
+	    (n < n_samples ? scrub_f32_c(d + n, (n_samples - n) * sizeof(float)) : 0);
+}
+
+/* the lanes of the accumulators map to the channels when the number of
+ * channels divides 4, other layouts use the C version */
+static inline void
+level_fold_neon(float *peak, float *sum, float32x4_t p, float32x4_t q, uint32_t channels)
+{
+	float tp[4], tq[4];
+	uint32_t i;
+
+	vst1q_f32(tp, p);
+	vst1q_f32(tq, q);
+	for (i = 0; i < 4; i++) {
+		peak[i % channels] = SPA_MAX(peak[i % channels], tp[i]);
+		sum[i % channels] += tq[i];
+	}
+}
+
+static void
+level_s16_neon(float *peak, float *sum, const void *src, uint32_t channels, int n_frames)
+{
+	const int16_t *s = src;
+	int n, n_samples = n_frames * channels;
+	float32x4_t p = vdupq_n_f32(0.0f), q = vdupq_n_f32(0.0f), lo, hi;
+	int16x8_t in;
+
+	if (channels == 0 || 4 % channels != 0) {
+		level_s16_c(peak, sum, src, channels, n_frames);
+		return;
+	}
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		in = vld1q_s16(s + n);
+		lo = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(in))), LEVEL_S16_SCALE);
+		hi = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(in))), LEVEL_S16_SCALE);
+		p = vmaxq_f32(p, vmaxq_f32(vabsq_f32(lo), vabsq_f32(hi)));
+		q = vmlaq_f32(vmlaq_f32(q, lo, lo), hi, hi);
+	}
+	level_fold_neon(peak, sum, p, q, channels);
+
+	if (n < n_samples)
+		level_s16_c(peak, sum, s + n, channels, (n_samples - n) / channels);
+}
+
+static void
+level_s32_neon(float *peak, float *sum, const void *src, uint32_t channels, int n_frames)
+{
+	const int32_t *s = src;
+	int n, n_samples = n_frames * channels;
+	float32x4_t p = vdupq_n_f32(0.0f), q = vdupq_n_f32(0.0f), in;
+
+	if (channels == 0 || 4 % channels != 0) {
+		level_s32_c(peak, sum, src, channels, n_frames);
+		return;
+	}
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		in = vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(s + n)), LEVEL_S32_SCALE);
+		p = vmaxq_f32(p, vabsq_f32(in));
+		q = vmlaq_f32(q, in, in);
+	}
+	level_fold_neon(peak, sum, p, q, channels);
+
+	if (n < n_samples)
+		level_s32_c(peak, sum, s + n, channels, (n_samples - n) / channels);
+}
+
+static void
+level_f32_neon(float *peak, float *sum, const void *src, uint32_t channels, int n_frames)
+{
+	const float *s = src;
+	int n, n_samples = n_frames * channels;
+	float32x4_t p = vdupq_n_f32(0.0f), q = vdupq_n_f32(0.0f), in;
+
+	if (channels == 0 || 4 % channels != 0) {
+		level_f32_c(peak, sum, src, channels, n_frames);
+		return;
+	}
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		in = vld1q_f32(s + n);
+		p = vmaxq_f32(p, vabsq_f32(in));
+		q = vmlaq_f32(q, in, in);
+	}
+	level_fold_neon(peak, sum, p, q, channels);
+
+	if (n < n_samples)
+		level_f32_c(peak, sum, s + n, channels, (n_samples - n) / channels);
+}
+
+void spa_audiomixer_get_ops_neon(struct spa_audiomixer_ops *ops)
+{
+	/* plain copies are left to memcpy, which is already vectorized */
+	ops->add[CONV_S16_S16] = add_s16_s16_neon;
+	ops->add[CONV_F32_F32] = add_f32_f32_neon;
+	ops->copy_scale[CONV_S16_S16] = copy_scale_s16_s16_neon;
+	ops->copy_scale[CONV_F32_F32] = copy_scale_f32_f32_neon;
+	ops->add_scale[CONV_S16_S16] = add_scale_s16_s16_neon;
+	ops->add_scale[CONV_F32_F32] = add_scale_f32_f32_neon;
+	ops->add_i[CONV_S16_S16] = add_s16_s16_i_neon;
+	ops->add_i[CONV_F32_F32] = add_f32_f32_i_neon;
+	ops->copy_scale_i[CONV_S16_S16] = copy_scale_s16_s16_i_neon;
+	ops->copy_scale_i[CONV_F32_F32] = copy_scale_f32_f32_i_neon;
+	ops->add_scale_i[CONV_S16_S16] = add_scale_s16_s16_i_neon;
+	ops->add_scale_i[CONV_F32_F32] = add_scale_f32_f32_i_neon;
+	ops->mix[CONV_S16_S16] = mix_s16_s16_neon;
+	ops->mix[CONV_F32_F32] = mix_f32_f32_neon;
+	ops->scrub_f32 = scrub_f32_neon;
+	ops->level[CONV_S16_S16] = level_s16_neon;
+	ops->level[CONV_F32_F32] = level_f32_neon;
+	ops->level_s32 = level_s32_neon;
+}
@@ -0,0 +1,376 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <emmintrin.h>
+
+#include "mix.h"
+
+/* All functions produce the same results as the C versions. The s16
+ * samples are scaled as floats and truncated like the C cast,
+ * _mm_adds_epi16 and _mm_packs_epi32 do the clamping. */
+
+static void
+add_s16_s16_sse2(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t t;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m128i in = _mm_loadu_si128((const __m128i *)(s + n));
+		__m128i out = _mm_loadu_si128((const __m128i *)(d + n));
+		_mm_storeu_si128((__m128i *)(d + n), _mm_adds_epi16(out, in));
+	}
+	for (; n < n_samples; n++) {
+		t = d[n] + s[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_f32_f32_sse2(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m128 in0 = _mm_loadu_ps(s + n), in1 = _mm_loadu_ps(s + n + 4);
+		__m128 out0 = _mm_loadu_ps(d + n), out1 = _mm_loadu_ps(d + n + 4);
+		_mm_storeu_ps(d + n, _mm_add_ps(out0, in0));
+		_mm_storeu_ps(d + n + 4, _mm_add_ps(out1, in1));
+	}
+	for (; n < n_samples; n++)
+		d[n] += s[n];
+}
+
+static inline void
+scale_s16_sse2(__m128i in, __m128 vol, __m128i *lo, __m128i *hi)
+{
+	/* sign extend to 32 bits */
+	*lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+	*hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+	*lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(*lo), vol));
+	*hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(*hi), vol));
+}
+
+static void
+copy_scale_s16_s16_sse2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float v = *(float*)scale;
+	int32_t t;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m128 vol = _mm_set1_ps(v);
+	__m128i lo, hi;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		scale_s16_sse2(_mm_loadu_si128((const __m128i *)(s + n)), vol, &lo, &hi);
+		_mm_storeu_si128((__m128i *)(d + n), _mm_packs_epi32(lo, hi));
+	}
+	for (; n < n_samples; n++) {
+		t = s[n] * v;
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+copy_scale_f32_f32_sse2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m128 vol = _mm_set1_ps(v);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m128 in0 = _mm_loadu_ps(s + n), in1 = _mm_loadu_ps(s + n + 4);
+		_mm_storeu_ps(d + n, _mm_mul_ps(in0, vol));
+		_mm_storeu_ps(d + n + 4, _mm_mul_ps(in1, vol));
+	}
+	for (; n < n_samples; n++)
+		d[n] = s[n] * v;
+}
+
+static void
+add_scale_s16_s16_sse2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float v = *(float*)scale;
+	int32_t t;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m128 vol = _mm_set1_ps(v);
+	__m128i lo, hi, out;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		scale_s16_sse2(_mm_loadu_si128((const __m128i *)(s + n)), vol, &lo, &hi);
+		out = _mm_loadu_si128((const __m128i *)(d + n));
+		lo = _mm_add_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(out, out), 16));
+		hi = _mm_add_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(out, out), 16));
+		_mm_storeu_si128((__m128i *)(d + n), _mm_packs_epi32(lo, hi));
+	}
+	for (; n < n_samples; n++) {
+		t = d[n] + (int32_t) (s[n] * v);
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_scale_f32_f32_sse2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m128 vol = _mm_set1_ps(v);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m128 in0 = _mm_loadu_ps(s + n), in1 = _mm_loadu_ps(s + n + 4);
+		__m128 out0 = _mm_loadu_ps(d + n), out1 = _mm_loadu_ps(d + n + 4);
+		_mm_storeu_ps(d + n, _mm_add_ps(out0, _mm_mul_ps(in0, vol)));
+		_mm_storeu_ps(d + n + 4, _mm_add_ps(out1, _mm_mul_ps(in1, vol)));
+	}
+	for (; n < n_samples; n++)
+		d[n] += s[n] * v;
+}
+
+static void
+mix_s16_s16_sse2(void *dst, const void *src[], uint32_t n_src, int n_bytes)
+{
+	int16_t *d = dst;
+	int32_t t;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	uint32_t i;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+		for (i = 0; i < n_src; i++) {
+			__m128i in = _mm_loadu_si128((const __m128i *)((const int16_t *) src[i] + n));
+			/* sign extend to 32 bits */
+			lo = _mm_add_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+			hi = _mm_add_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+		}
+		_mm_storeu_si128((__m128i *)(d + n), _mm_packs_epi32(lo, hi));
+	}
+	for (; n < n_samples; n++) {
+		t = 0;
+		for (i = 0; i < n_src; i++)
+			t += ((const int16_t *) src[i])[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+mix_f32_f32_sse2(void *dst, const void *src[], uint32_t n_src, int n_bytes)
+{
+	float *d = dst;
+	float t;
+	int n, n_samples = n_bytes / sizeof(float);
+	uint32_t i;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m128 out0 = _mm_setzero_ps(), out1 = _mm_setzero_ps();
+
+		for (i = 0; i < n_src; i++) {
+			const float *s = src[i];
+			out0 = _mm_add_ps(out0, _mm_loadu_ps(s + n));
+			out1 = _mm_add_ps(out1, _mm_loadu_ps(s + n + 4));
+		}
+		_mm_storeu_ps(d + n, out0);
+		_mm_storeu_ps(d + n + 4, out1);
+	}
+	for (; n < n_samples; n++) {
+		t = 0.0f;
+		for (i = 0; i < n_src; i++)
+			t += ((const float *) src[i])[n];
+		d[n] = t;
+	}
+}
+
+/* the strided versions can only be vectorized when both sides are packed */
+#define STRIDED(name)									\
+static void										\
+name##_i_sse2(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)	\
+{											\
+	if (dst_stride == 1 && src_stride == 1)						\
+		name##_sse2(dst, src, n_bytes);						\
+	else										\
+		name##_i_c(dst, dst_stride, src, src_stride, n_bytes);			\
+}
+#define STRIDED_SCALE(name)							\
+static void									\
+name##_i_sse2(void *dst, int dst_stride, const void *src, int src_stride,	\
+		const void *scale, int n_bytes)					\
+{										\
+	if (dst_stride == 1 && src_stride == 1)					\
+		name##_sse2(dst, src, scale, n_bytes);				\
+	else									\
+		name##_i_c(dst, dst_stride, src, src_stride, scale, n_bytes);	\
+}
+
+STRIDED(add_s16_s16)
+STRIDED(add_f32_f32)
+STRIDED_SCALE(copy_scale_s16_s16)
+STRIDED_SCALE(copy_scale_f32_f32)
+STRIDED_SCALE(add_scale_s16_s16)
+STRIDED_SCALE(add_scale_f32_f32)
+
+static uint32_t
+scrub_f32_sse2(void *dst, int n_bytes)
+{
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m128i exp = _mm_set1_epi32(0x7f800000);
+	uint32_t count = 0;
+
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		__m128i in = _mm_loadu_si128((__m128i *) (d + n));
+		__m128i bad = _mm_cmpeq_epi32(_mm_and_si128(in, exp), exp);
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(bad));
+
+		/* most of the time all samples are fine */
+		if (SPA_UNLIKELY(mask != 0)) {
+			_mm_storeu_si128((__m128i *) (d + n), _mm_andnot_si128(bad, in));
+			count += __builtin_popcount(mask);
+		}
+	}
+	if (n < n_samples)
+		count += scrub_f32_c(d + n, (n_samples - n) * sizeof(float));
+
+	return count;
+}
+
+/* the lanes of the accumulators map to the channels when the number of
+ * channels divides 4, other layouts use the C version */
+static inline void
+level_fold_sse2(float *peak, float *sum, __m128 p, __m128 q, uint32_t channels)
+{
+	float tp[4], tq[4];
+	uint32_t i;
+
+	_mm_storeu_ps(tp, p);
+	_mm_storeu_ps(tq, q);
+	for (i = 0; i < 4; i++) {
+		peak[i % channels] = SPA_MAX(peak[i % channels], tp[i]);
+		sum[i % channels] += tq[i];
+	}
+}
+
+static void
+level_s16_sse2(float *peak, float *sum, const void *src, uint32_t channels, int n_frames)
+{
+	const int16_t *s = src;
+	int n, n_samples = n_frames * channels;
+	__m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 scale = _mm_set1_ps(LEVEL_S16_SCALE);
+	__m128 p = _mm_setzero_ps(), q = _mm_setzero_ps(), lo, hi;
+	__m128i in;
+
+	if (channels == 0 || 4 % channels != 0) {
+		level_s16_c(peak, sum, src, channels, n_frames);
+		return;
+	}
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		in = _mm_loadu_si128((__m128i *) (s + n));
+		lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+		hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+		lo = _mm_mul_ps(lo, scale);
+		hi = _mm_mul_ps(hi, scale);
+		p = _mm_max_ps(p, _mm_max_ps(_mm_and_ps(lo, abs_mask), _mm_and_ps(hi, abs_mask)));
+		q = _mm_add_ps(q, _mm_add_ps(_mm_mul_ps(lo, lo), _mm_mul_ps(hi, hi)));
+	}
+	level_fold_sse2(peak, sum, p, q, channels);
+
+	if (n < n_samples)
+		level_s16_c(peak, sum, s + n, channels, (n_samples - n) / channels);
+}
+
+static void
+level_s32_sse2(float *peak, float *sum, const void *src, uint32_t channels, int n_frames)
+{
+	const int32_t *s = src;
+	int n, n_samples = n_frames * channels;
+	__m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 scale = _mm_set1_ps(LEVEL_S32_SCALE);
+	__m128 p = _mm_setzero_ps(), q = _mm_setzero_ps(), in;
+
+	if (channels == 0 || 4 % channels != 0) {
+		level_s32_c(peak, sum, src, channels, n_frames);
+		return;
+	}
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		in = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((__m128i *) (s + n))), scale);
+		p = _mm_max_ps(p, _mm_and_ps(in, abs_mask));
+		q = _mm_add_ps(q, _mm_mul_ps(in, in));
+	}
+	level_fold_sse2(peak, sum, p, q, channels);
+
+	if (n < n_samples)
+		level_s32_c(peak, sum, s + n, channels, (n_samples - n) / channels);
+}
+
+static void
+level_f32_sse2(float *peak, float *sum, const void *src, uint32_t channels, int n_frames)
+{
+	const float *s = src;
+	int n, n_samples = n_frames * channels;
+	__m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 p = _mm_setzero_ps(), q = _mm_setzero_ps(), in;
+
+	if (channels == 0 || 4 % channels != 0) {
+		level_f32_c(peak, sum, src, channels, n_frames);
+		return;
+	}
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		in = _mm_loadu_ps(s + n);
+		p = _mm_max_ps(p, _mm_and_ps(in, abs_mask));
+		q = _mm_add_ps(q, _mm_mul_ps(in, in));
+	}
+	level_fold_sse2(peak, sum, p, q, channels);
+
+	if (n < n_samples)
+		level_f32_c(peak, sum, s + n, channels, (n_samples - n) / channels);
+}
+
+void spa_audiomixer_get_ops_sse2(struct spa_audiomixer_ops *ops)
+{
+	/* plain copies are left to memcpy, which is already vectorized */
+	ops->add[CONV_S16_S16] = add_s16_s16_sse2;
+	ops->add[CONV_F32_F32] = add_f32_f32_sse2;
+	ops->copy_scale[CONV_S16_S16] = copy_scale_s16_s16_sse2;
+	ops->copy_scale[CONV_F32_F32] = copy_scale_f32_f32_sse2;
+	ops->add_scale[CONV_S16_S16] = add_scale_s16_s16_sse2;
+	ops->add_scale[CONV_F32_F32] = add_scale_f32_f32_sse2;
+	ops->add_i[CONV_S16_S16] = add_s16_s16_i_sse2;
+	ops->add_i[CONV_F32_F32] = add_f32_f32_i_sse2;
+	ops->copy_scale_i[CONV_S16_S16] = copy_scale_s16_s16_i_sse2;
+	ops->copy_scale_i[CONV_F32_F32] = copy_scale_f32_f32_i_sse2;
+	ops->add_scale_i[CONV_S16_S16] = add_scale_s16_s16_i_sse2;
+	ops->add_scale_i[CONV_F32_F32] = add_scale_f32_f32_i_sse2;
+	ops->mix[CONV_S16_S16] = mix_s16_s16_sse2;
+	ops->mix[CONV_F32_F32] = mix_f32_f32_sse2;
+	ops->scrub_f32 = scrub_f32_sse2;
+	ops->level[CONV_S16_S16] = level_s16_sse2;
+	ops->level[CONV_F32_F32] = level_f32_sse2;
+	ops->level_s32 = level_s32_sse2;
+}
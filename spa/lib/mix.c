@@ -0,0 +1,391 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <math.h>
+
+#include "mix.h"
+
+void
+copy_s16_s16_c(void *dst, const void *src, int n_bytes)
+{
+	memcpy(dst, src, n_bytes);
+}
+
+void
+copy_f32_f32_c(void *dst, const void *src, int n_bytes)
+{
+	memcpy(dst, src, n_bytes);
+}
+
+void
+add_s16_s16_c(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = *d + *s;
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d++;
+		s++;
+	}
+}
+
+void
+add_f32_f32_c(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d += *s;
+		d++;
+		s++;
+	}
+}
+
+void
+copy_scale_s16_s16_c(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float v = *(float*)scale;
+	int32_t t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = *s * v;
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d++;
+		s++;
+	}
+}
+
+void
+copy_scale_f32_f32_c(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d = *s * v;
+		d++;
+		s++;
+	}
+}
+
+void
+add_scale_s16_s16_c(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float v = *(float*)scale;
+	int32_t t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = *d + (int32_t) (*s * v);
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d++;
+		s++;
+	}
+}
+
+void
+add_scale_f32_f32_c(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d += *s * v;
+		d++;
+		s++;
+	}
+}
+
+void
+copy_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		*d = *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+copy_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d = *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+add_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = *d + *s;
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+add_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d += *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+copy_scale_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float v = *(float*)scale;
+	int32_t t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = *s * v;
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+copy_scale_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d = *s * v;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+add_scale_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float v = *(float*)scale;
+	int32_t t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = *d + (int32_t) (*s * v);
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+add_scale_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d += *s * v;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+mix_s16_s16_c(void *dst, const void *src[], uint32_t n_src, int n_bytes)
+{
+	int16_t *d = dst;
+	int32_t t;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	uint32_t i;
+
+	/* accumulate in 32 bits and only clamp the final result */
+	for (n = 0; n < n_samples; n++) {
+		t = 0;
+		for (i = 0; i < n_src; i++)
+			t += ((const int16_t *) src[i])[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+void
+mix_f32_f32_c(void *dst, const void *src[], uint32_t n_src, int n_bytes)
+{
+	float *d = dst;
+	float t;
+	int n, n_samples = n_bytes / sizeof(float);
+	uint32_t i;
+
+	for (n = 0; n < n_samples; n++) {
+		t = 0.0f;
+		for (i = 0; i < n_src; i++)
+			t += ((const float *) src[i])[n];
+		d[n] = t;
+	}
+}
+
+/* a float is NaN or infinite when all exponent bits are set */
+#define F32_EXP_MASK	0x7f800000
+
+uint32_t
+scrub_f32_c(void *dst, int n_bytes)
+{
+	uint32_t *d = dst, count = 0;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	for (n = 0; n < n_samples; n++) {
+		if ((d[n] & F32_EXP_MASK) == F32_EXP_MASK) {
+			d[n] = 0;
+			count++;
+		}
+	}
+	return count;
+}
+
+void
+level_s16_c(float *peak, float *sum, const void *src, uint32_t channels, int n_frames)
+{
+	const int16_t *s = src;
+	int n;
+	uint32_t c;
+	float v;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < channels; c++) {
+			v = *s++ * LEVEL_S16_SCALE;
+			peak[c] = SPA_MAX(peak[c], fabsf(v));
+			sum[c] += v * v;
+		}
+	}
+}
+
+void
+level_s32_c(float *peak, float *sum, const void *src, uint32_t channels, int n_frames)
+{
+	const int32_t *s = src;
+	int n;
+	uint32_t c;
+	float v;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < channels; c++) {
+			v = *s++ * LEVEL_S32_SCALE;
+			peak[c] = SPA_MAX(peak[c], fabsf(v));
+			sum[c] += v * v;
+		}
+	}
+}
+
+void
+level_f32_c(float *peak, float *sum, const void *src, uint32_t channels, int n_frames)
+{
+	const float *s = src;
+	int n;
+	uint32_t c;
+	float v;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < channels; c++) {
+			v = *s++;
+			peak[c] = SPA_MAX(peak[c], fabsf(v));
+			sum[c] += v * v;
+		}
+	}
+}
+
+void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops, uint32_t cpu_flags)
+{
+	ops->copy[CONV_S16_S16] = copy_s16_s16_c;
+	ops->copy[CONV_F32_F32] = copy_f32_f32_c;
+	ops->add[CONV_S16_S16] = add_s16_s16_c;
+	ops->add[CONV_F32_F32] = add_f32_f32_c;
+	ops->copy_scale[CONV_S16_S16] = copy_scale_s16_s16_c;
+	ops->copy_scale[CONV_F32_F32] = copy_scale_f32_f32_c;
+	ops->add_scale[CONV_S16_S16] = add_scale_s16_s16_c;
+	ops->add_scale[CONV_F32_F32] = add_scale_f32_f32_c;
+	ops->copy_i[CONV_S16_S16] = copy_s16_s16_i_c;
+	ops->copy_i[CONV_F32_F32] = copy_f32_f32_i_c;
+	ops->add_i[CONV_S16_S16] = add_s16_s16_i_c;
+	ops->add_i[CONV_F32_F32] = add_f32_f32_i_c;
+	ops->copy_scale_i[CONV_S16_S16] = copy_scale_s16_s16_i_c;
+	ops->copy_scale_i[CONV_F32_F32] = copy_scale_f32_f32_i_c;
+	ops->add_scale_i[CONV_S16_S16] = add_scale_s16_s16_i_c;
+	ops->add_scale_i[CONV_F32_F32] = add_scale_f32_f32_i_c;
+	ops->mix[CONV_S16_S16] = mix_s16_s16_c;
+	ops->mix[CONV_F32_F32] = mix_f32_f32_c;
+	ops->scrub_f32 = scrub_f32_c;
+	ops->level[CONV_S16_S16] = level_s16_c;
+	ops->level[CONV_F32_F32] = level_f32_c;
+	ops->level_s32 = level_s32_c;
+
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		spa_audiomixer_get_ops_sse2(ops);
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		spa_audiomixer_get_ops_avx2(ops);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		spa_audiomixer_get_ops_neon(ops);
+#endif
+}
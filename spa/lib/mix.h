@@ -0,0 +1,136 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_LIBMIX_H__
+#define __SPA_LIBMIX_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+#include <stdio.h>
+#include <spa/defs.h>
+#include <lib/cpu.h>
+
+/* the mix kernels of the audiomixer and volume plugins and the port mixer
+ * of pipewire */
+typedef void (*mix_func_t) (void *dst, const void *src, int n_bytes);
+typedef void (*mix_scale_func_t) (void *dst, const void *src, const void *scale, int n_bytes);
+typedef void (*mix_i_func_t) (void *dst, int dst_stride,
+			      const void *src, int src_stride, int n_bytes);
+typedef void (*mix_scale_i_func_t) (void *dst, int dst_stride,
+				    const void *src, int src_stride, const void *scale, int n_bytes);
+/* mix n_src buffers of n_bytes into dst in one pass, dst is cleared when
+ * n_src is 0 */
+typedef void (*mix_n_func_t) (void *dst, const void *src[], uint32_t n_src, int n_bytes);
+/* replace NaN and infinite samples with 0, returns the number of replaced
+ * samples */
+typedef uint32_t (*scrub_func_t) (void *dst, int n_bytes);
+/* accumulate the peak and the sum of squares of each channel of n_frames
+ * interleaved frames, the values are normalized so that full scale is 1.0 */
+typedef void (*level_func_t) (float *peak, float *sum, const void *src,
+			      uint32_t channels, int n_frames);
+
+/* samples are divided by these for the level */
+#define LEVEL_S16_SCALE	(1.0f / 32768.0f)
+#define LEVEL_S32_SCALE	(1.0f / 2147483648.0f)
+
+/* the level is accumulated after each block of this many frames is
+ * written, while the block is still in the cache */
+#define LEVEL_BLOCK_FRAMES	256
+
+/* the scale of all formats is a float */
+enum {
+	CONV_S16_S16,
+	CONV_F32_F32,
+	CONV_MAX,
+};
+
+struct spa_audiomixer_ops {
+	mix_func_t copy[CONV_MAX];
+	mix_func_t add[CONV_MAX];
+	mix_scale_func_t copy_scale[CONV_MAX];
+	mix_scale_func_t add_scale[CONV_MAX];
+	mix_i_func_t copy_i[CONV_MAX];
+	mix_i_func_t add_i[CONV_MAX];
+	mix_scale_i_func_t copy_scale_i[CONV_MAX];
+	mix_scale_i_func_t add_scale_i[CONV_MAX];
+	mix_n_func_t mix[CONV_MAX];
+	scrub_func_t scrub_f32;
+	level_func_t level[CONV_MAX];
+	level_func_t level_s32;
+};
+
+/* fill ops with the best implementation for the given SPA_CPU_FLAG_* mask,
+ * pass 0 to get the plain C versions */
+void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops, uint32_t cpu_flags);
+
+/* declare the functions of one implementation of the ops */
+#define DECLARE_MIX_OPS(arch)										\
+void copy_s16_s16_##arch(void *dst, const void *src, int n_bytes);					\
+void copy_f32_f32_##arch(void *dst, const void *src, int n_bytes);					\
+void add_s16_s16_##arch(void *dst, const void *src, int n_bytes);					\
+void add_f32_f32_##arch(void *dst, const void *src, int n_bytes);					\
+void copy_scale_s16_s16_##arch(void *dst, const void *src, const void *scale, int n_bytes);		\
+void copy_scale_f32_f32_##arch(void *dst, const void *src, const void *scale, int n_bytes);		\
+void add_scale_s16_s16_##arch(void *dst, const void *src, const void *scale, int n_bytes);		\
+void add_scale_f32_f32_##arch(void *dst, const void *src, const void *scale, int n_bytes);		\
+void copy_s16_s16_i_##arch(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes);	\
+void copy_f32_f32_i_##arch(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes);	\
+void add_s16_s16_i_##arch(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes);	\
+void add_f32_f32_i_##arch(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes);	\
+void copy_scale_s16_s16_i_##arch(void *dst, int dst_stride,						\
+		const void *src, int src_stride, const void *scale, int n_bytes);			\
+void copy_scale_f32_f32_i_##arch(void *dst, int dst_stride,						\
+		const void *src, int src_stride, const void *scale, int n_bytes);			\
+void add_scale_s16_s16_i_##arch(void *dst, int dst_stride,						\
+		const void *src, int src_stride, const void *scale, int n_bytes);			\
+void add_scale_f32_f32_i_##arch(void *dst, int dst_stride,						\
+		const void *src, int src_stride, const void *scale, int n_bytes);			\
+void mix_s16_s16_##arch(void *dst, const void *src[], uint32_t n_src, int n_bytes);			\
+void mix_f32_f32_##arch(void *dst, const void *src[], uint32_t n_src, int n_bytes);			\
+uint32_t scrub_f32_##arch(void *dst, int n_bytes);							\
+void level_s16_##arch(float *peak, float *sum,								\
+		const void *src, uint32_t channels, int n_frames);					\
+void level_s32_##arch(float *peak, float *sum,								\
+		const void *src, uint32_t channels, int n_frames);					\
+void level_f32_##arch(float *peak, float *sum,								\
+		const void *src, uint32_t channels, int n_frames);
+
+/* reference C implementations */
+DECLARE_MIX_OPS(c)
+
+/* the SIMD versions are built in separate objects with the right compiler
+ * flags and only selected when the CPU supports them */
+#if defined (HAVE_SSE2)
+void spa_audiomixer_get_ops_sse2(struct spa_audiomixer_ops *ops);
+#endif
+#if defined (HAVE_AVX2)
+void spa_audiomixer_get_ops_avx2(struct spa_audiomixer_ops *ops);
+#endif
+#if defined (HAVE_NEON)
+void spa_audiomixer_get_ops_neon(struct spa_audiomixer_ops *ops);
+#endif
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __SPA_LIBMIX_H__ */
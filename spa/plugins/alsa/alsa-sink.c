@@ -78,13 +78,18 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 
 	if (props == NULL) {
 		reset_props(&this->props);
-		return SPA_RESULT_OK;
 	} else {
+		uint32_t min_latency = this->props.min_latency;
+
 		spa_props_query(props,
 				this->type.prop_device, -SPA_POD_TYPE_STRING,
 					this->props.device, sizeof(this->props.device),
-				this->type.prop_min_latency, SPA_POD_TYPE_INT, &this->props.min_latency, 0);
+				this->type.prop_min_latency, SPA_POD_TYPE_INT, &min_latency, 0);
+		/* a running device switches at the start of its next cycle */
+		__atomic_store_n(&this->props.min_latency, min_latency, __ATOMIC_RELAXED);
 	}
+	spa_alsa_update_latency(this);
+
 	return SPA_RESULT_OK;
 }
 
@@ -277,6 +277,8 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 	spa_log_info(state->log, "buffer frames %zd, period frames %zd, periods %u, frame_size %zd",
 		     state->buffer_frames, state->period_frames, periods, state->frame_size);
 
+	spa_alsa_update_latency(state);
+
 	/* write the parameters to device */
 	CHECK(snd_pcm_hw_params(hndl, params), "set_hw_params");
 
@@ -417,7 +419,9 @@ push_frames(struct state *state,
 
 		d = b->outbuf->datas;
 
+		/* one quantum per buffer, the rest goes in the next buffers */
 		total_frames = SPA_MIN(frames, d[0].maxsize / state->frame_size);
+		total_frames = SPA_MIN(total_frames, state->threshold);
 		src = SPA_MEMBER(my_areas[0].addr, offset * state->frame_size, uint8_t);
 		n_bytes = total_frames * state->frame_size;
 
@@ -467,6 +471,42 @@ static inline void calc_timeout(size_t target, size_t current,
 	}
 }
 
+/* the frames of one cycle for \a min_latency, at least one more cycle must
+ * fit in the device buffer */
+static inline int get_threshold(struct state *state, uint32_t min_latency)
+{
+	return SPA_MIN((int) min_latency, (int) state->buffer_frames / 2);
+}
+
+/* at least one cycle and at most the complete buffer is in the device. This
+ * is updated when the format or the min-latency is set so that the latency
+ * follows the quantum. */
+void spa_alsa_update_latency(struct state *state)
+{
+	uint32_t threshold;
+
+	if (state->rate == 0)
+		return;
+
+	threshold = get_threshold(state, state->props.min_latency);
+	state->info.latency.min = (uint64_t) threshold * SPA_NSEC_PER_SEC / state->rate;
+	state->info.latency.max = (uint64_t) state->buffer_frames * SPA_NSEC_PER_SEC / state->rate;
+}
+
+/* the threshold follows min-latency at the start of each cycle so that the
+ * quantum can be changed while running */
+static inline void update_threshold(struct state *state)
+{
+	int threshold = get_threshold(state,
+			__atomic_load_n(&state->props.min_latency, __ATOMIC_RELAXED));
+
+	if (threshold != state->threshold) {
+		spa_log_debug(state->log, "alsa %p: threshold %d -> %d", state,
+			      state->threshold, threshold);
+		state->threshold = threshold;
+	}
+}
+
 static void alsa_on_playback_timeout_event(struct spa_source *source)
 {
 	uint64_t exp;
@@ -483,6 +523,8 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 	if (read(state->timerfd, &exp, sizeof(uint64_t)) != sizeof(uint64_t))
 		spa_log_warn(state->log, "error reading timerfd: %s", strerror(errno));
 
+	update_threshold(state);
+
 	snd_pcm_status_alloca(&status);
 
 	if ((res = snd_pcm_status(hndl, status)) < 0) {
@@ -569,6 +611,8 @@ static void alsa_on_capture_timeout_event(struct spa_source *source)
 	if (read(state->timerfd, &exp, sizeof(uint64_t)) != sizeof(uint64_t))
 		spa_log_warn(state->log, "error reading timerfd: %s", strerror(errno));
 
+	update_threshold(state);
+
 	snd_pcm_status_alloca(&status);
 
 	if ((res = snd_pcm_status(hndl, status)) < 0) {
@@ -652,7 +696,7 @@ int spa_alsa_start(struct state *state, bool xrun_recover)
 	state->source.rmask = 0;
 	spa_loop_add_source(state->data_loop, &state->source);
 
-	state->threshold = state->props.min_latency;
+	update_threshold(state);
 
 	if (state->stream == SND_PCM_STREAM_PLAYBACK) {
 		state->alsa_started = false;
@@ -179,6 +179,7 @@ spa_alsa_enum_format(struct state *state,
 		     struct spa_format **format, const struct spa_format *filter, uint32_t index);
 
 int spa_alsa_set_format(struct state *state, struct spa_audio_info *info, uint32_t flags);
+void spa_alsa_update_latency(struct state *state);
 
 int spa_alsa_start(struct state *state, bool xrun_recover);
 int spa_alsa_pause(struct state *state, bool xrun_recover);
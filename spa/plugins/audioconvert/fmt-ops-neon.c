@@ -0,0 +1,204 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <arm_neon.h>
+
+#include "fmt-ops.h"
+
+/* Mono and stereo S16 and the channel mixer are vectorized, the rest uses
+ * the C versions. ARMv7 has no round-to-nearest conversion so the F32 to
+ * S16 path rounds half away from zero, which only differs from lrintf()
+ * on exact ties. */
+
+static inline float32x4_t s16_to_f32_neon(int16x4_t in)
+{
+	return vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(in)), 1.0f / S16_SCALE);
+}
+
+static inline int16x4_t f32_to_s16_neon(float32x4_t in)
+{
+	float32x4_t half = vdupq_n_f32(0.5f);
+	in = vminq_f32(vmaxq_f32(in, vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f));
+	in = vmulq_n_f32(in, S16_SCALE);
+	/* copy the sign of the sample to 0.5 */
+	half = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(half),
+			vandq_u32(vreinterpretq_u32_f32(in), vdupq_n_u32(0x80000000))));
+	return vmovn_s32(vcvtq_s32_f32(vaddq_f32(in, half)));
+}
+
+static void
+conv_s16_to_f32_neon(float **dst, const void *src, uint32_t n_channels, int n_frames)
+{
+	const int16_t *s = src;
+	int n = 0;
+
+	if (n_channels == 1) {
+		float *d = dst[0];
+
+		for (; n + 8 <= n_frames; n += 8) {
+			int16x8_t in = vld1q_s16(s + n);
+			vst1q_f32(d + n, s16_to_f32_neon(vget_low_s16(in)));
+			vst1q_f32(d + n + 4, s16_to_f32_neon(vget_high_s16(in)));
+		}
+	} else if (n_channels == 2) {
+		float *l = dst[0], *r = dst[1];
+
+		for (; n + 4 <= n_frames; n += 4) {
+			int16x4x2_t in = vld2_s16(s + 2 * n);
+			vst1q_f32(l + n, s16_to_f32_neon(in.val[0]));
+			vst1q_f32(r + n, s16_to_f32_neon(in.val[1]));
+		}
+	}
+	if (n < n_frames) {
+		float *d[n_channels];
+		uint32_t c;
+
+		for (c = 0; c < n_channels; c++)
+			d[c] = dst[c] + n;
+		conv_s16_to_f32_c(d, &s[n * n_channels], n_channels, n_frames - n);
+	}
+}
+
+static void
+conv_f32_to_s16_neon(void *dst, const float **src, uint32_t n_channels, int n_frames)
+{
+	int16_t *d = dst;
+	int n = 0;
+
+	if (n_channels == 1) {
+		const float *s = src[0];
+
+		for (; n + 4 <= n_frames; n += 4)
+			vst1_s16(d + n, f32_to_s16_neon(vld1q_f32(s + n)));
+	} else if (n_channels == 2) {
+		const float *l = src[0], *r = src[1];
+
+		for (; n + 4 <= n_frames; n += 4) {
+			int16x4x2_t out;
+			out.val[0] = f32_to_s16_neon(vld1q_f32(l + n));
+			out.val[1] = f32_to_s16_neon(vld1q_f32(r + n));
+			vst2_s16(d + 2 * n, out);
+		}
+	}
+	if (n < n_frames) {
+		const float *s[n_channels];
+		uint32_t c;
+
+		for (c = 0; c < n_channels; c++)
+			s[c] = src[c] + n;
+		conv_f32_to_s16_c(&d[n * n_channels], s, n_channels, n_frames - n);
+	}
+}
+
+static void
+conv_f32_to_f32_neon(float **dst, const void *src, uint32_t n_channels, int n_frames)
+{
+	const float *s = src;
+	int n = 0;
+
+	if (n_channels == 2) {
+		float *l = dst[0], *r = dst[1];
+
+		for (; n + 4 <= n_frames; n += 4) {
+			float32x4x2_t in = vld2q_f32(s + 2 * n);
+			vst1q_f32(l + n, in.val[0]);
+			vst1q_f32(r + n, in.val[1]);
+		}
+	}
+	if (n < n_frames) {
+		float *d[n_channels];
+		uint32_t c;
+
+		for (c = 0; c < n_channels; c++)
+			d[c] = dst[c] + n;
+		conv_f32_to_f32_c(d, &s[n * n_channels], n_channels, n_frames - n);
+	}
+}
+
+static void
+conv_f32_from_f32_neon(void *dst, const float **src, uint32_t n_channels, int n_frames)
+{
+	float *d = dst;
+	int n = 0;
+
+	if (n_channels == 2) {
+		const float *l = src[0], *r = src[1];
+
+		for (; n + 4 <= n_frames; n += 4) {
+			float32x4x2_t out;
+			out.val[0] = vld1q_f32(l + n);
+			out.val[1] = vld1q_f32(r + n);
+			vst2q_f32(d + 2 * n, out);
+		}
+	}
+	if (n < n_frames) {
+		const float *s[n_channels];
+		uint32_t c;
+
+		for (c = 0; c < n_channels; c++)
+			s[c] = src[c] + n;
+		conv_f32_from_f32_c(&d[n * n_channels], s, n_channels, n_frames - n);
+	}
+}
+
+static void
+channelmix_neon(float **dst, uint32_t n_dst, const float **src, uint32_t n_src,
+		const float *matrix, int n_frames)
+{
+	uint32_t i, j;
+	int n;
+
+	for (i = 0; i < n_dst; i++) {
+		float *d = dst[i];
+		bool first = true;
+
+		for (j = 0; j < n_src; j++) {
+			const float *s = src[j];
+			float v = matrix[i * n_src + j];
+
+			if (v == 0.0f)
+				continue;
+
+			if (first) {
+				for (n = 0; n + 4 <= n_frames; n += 4)
+					vst1q_f32(d + n, vmulq_n_f32(vld1q_f32(s + n), v));
+				for (; n < n_frames; n++)
+					d[n] = s[n] * v;
+			} else {
+				for (n = 0; n + 4 <= n_frames; n += 4)
+					vst1q_f32(d + n, vmlaq_n_f32(vld1q_f32(d + n), vld1q_f32(s + n), v));
+				for (; n < n_frames; n++)
+					d[n] += s[n] * v;
+			}
+			first = false;
+		}
+		if (first)
+			memset(d, 0, n_frames * sizeof(float));
+	}
+}
+
+void spa_audioconvert_get_ops_neon(struct spa_audioconvert_ops *ops)
+{
+	ops->to_f32[FMT_S16] = conv_s16_to_f32_neon;
+	ops->to_f32[FMT_F32] = conv_f32_to_f32_neon;
+	ops->from_f32[FMT_S16] = conv_f32_to_s16_neon;
+	ops->from_f32[FMT_F32] = conv_f32_from_f32_neon;
+	ops->channelmix = channelmix_neon;
+}
@@ -0,0 +1,243 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <emmintrin.h>
+
+#include "fmt-ops.h"
+
+/* Only mono and stereo are vectorized, they are by far the most common
+ * layouts and the (de)interleaving is a simple shuffle. Other channel
+ * counts and the packed 24 bits format use the C versions. */
+
+static inline __m128 s16_to_f32_sse2(__m128i in, int hi)
+{
+	__m128i v = hi ? _mm_unpackhi_epi16(in, in) : _mm_unpacklo_epi16(in, in);
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(v, 16)),
+			  _mm_set1_ps(1.0f / S16_SCALE));
+}
+
+static inline __m128i f32_to_s32_sse2(__m128 in, float scale)
+{
+	in = _mm_min_ps(_mm_max_ps(in, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+	return _mm_cvtps_epi32(_mm_mul_ps(in, _mm_set1_ps(scale)));
+}
+
+static void
+conv_s16_to_f32_sse2(float **dst, const void *src, uint32_t n_channels, int n_frames)
+{
+	const int16_t *s = src;
+	int n = 0;
+
+	if (n_channels == 1) {
+		float *d = dst[0];
+
+		for (; n + 8 <= n_frames; n += 8) {
+			__m128i in = _mm_loadu_si128((const __m128i *) &s[n]);
+			_mm_storeu_ps(&d[n], s16_to_f32_sse2(in, 0));
+			_mm_storeu_ps(&d[n + 4], s16_to_f32_sse2(in, 1));
+		}
+	} else if (n_channels == 2) {
+		float *l = dst[0], *r = dst[1];
+
+		for (; n + 4 <= n_frames; n += 4) {
+			__m128i in = _mm_loadu_si128((const __m128i *) &s[2 * n]);
+			__m128 lo = s16_to_f32_sse2(in, 0);
+			__m128 hi = s16_to_f32_sse2(in, 1);
+			_mm_storeu_ps(&l[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(&r[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	if (n < n_frames) {
+		float *d[n_channels];
+		uint32_t c;
+
+		for (c = 0; c < n_channels; c++)
+			d[c] = dst[c] + n;
+		conv_s16_to_f32_c(d, &s[n * n_channels], n_channels, n_frames - n);
+	}
+}
+
+static void
+conv_s32_to_f32_sse2(float **dst, const void *src, uint32_t n_channels, int n_frames)
+{
+	const int32_t *s = src;
+	__m128 scale = _mm_set1_ps(1.0f / S32_SCALE);
+	int n = 0;
+
+	if (n_channels == 1) {
+		float *d = dst[0];
+
+		for (; n + 4 <= n_frames; n += 4) {
+			__m128i in = _mm_loadu_si128((const __m128i *) &s[n]);
+			_mm_storeu_ps(&d[n], _mm_mul_ps(_mm_cvtepi32_ps(in), scale));
+		}
+	} else if (n_channels == 2) {
+		float *l = dst[0], *r = dst[1];
+
+		for (; n + 4 <= n_frames; n += 4) {
+			__m128 lo = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) &s[2 * n]));
+			__m128 hi = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) &s[2 * n + 4]));
+			lo = _mm_mul_ps(lo, scale);
+			hi = _mm_mul_ps(hi, scale);
+			_mm_storeu_ps(&l[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(&r[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	if (n < n_frames) {
+		float *d[n_channels];
+		uint32_t c;
+
+		for (c = 0; c < n_channels; c++)
+			d[c] = dst[c] + n;
+		conv_s32_to_f32_c(d, &s[n * n_channels], n_channels, n_frames - n);
+	}
+}
+
+static void
+conv_f32_to_f32_sse2(float **dst, const void *src, uint32_t n_channels, int n_frames)
+{
+	const float *s = src;
+	int n = 0;
+
+	if (n_channels == 2) {
+		float *l = dst[0], *r = dst[1];
+
+		for (; n + 4 <= n_frames; n += 4) {
+			__m128 lo = _mm_loadu_ps(&s[2 * n]);
+			__m128 hi = _mm_loadu_ps(&s[2 * n + 4]);
+			_mm_storeu_ps(&l[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(&r[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	if (n < n_frames) {
+		float *d[n_channels];
+		uint32_t c;
+
+		for (c = 0; c < n_channels; c++)
+			d[c] = dst[c] + n;
+		conv_f32_to_f32_c(d, &s[n * n_channels], n_channels, n_frames - n);
+	}
+}
+
+static void
+conv_f32_to_s16_sse2(void *dst, const float **src, uint32_t n_channels, int n_frames)
+{
+	int16_t *d = dst;
+	int n = 0;
+
+	if (n_channels == 1) {
+		const float *s = src[0];
+
+		for (; n + 8 <= n_frames; n += 8) {
+			__m128i lo = f32_to_s32_sse2(_mm_loadu_ps(&s[n]), S16_SCALE);
+			__m128i hi = f32_to_s32_sse2(_mm_loadu_ps(&s[n + 4]), S16_SCALE);
+			_mm_storeu_si128((__m128i *) &d[n], _mm_packs_epi32(lo, hi));
+		}
+	} else if (n_channels == 2) {
+		const float *l = src[0], *r = src[1];
+
+		for (; n + 4 <= n_frames; n += 4) {
+			__m128 vl = _mm_loadu_ps(&l[n]), vr = _mm_loadu_ps(&r[n]);
+			__m128i lo = f32_to_s32_sse2(_mm_unpacklo_ps(vl, vr), S16_SCALE);
+			__m128i hi = f32_to_s32_sse2(_mm_unpackhi_ps(vl, vr), S16_SCALE);
+			_mm_storeu_si128((__m128i *) &d[2 * n], _mm_packs_epi32(lo, hi));
+		}
+	}
+	if (n < n_frames) {
+		const float *s[n_channels];
+		uint32_t c;
+
+		for (c = 0; c < n_channels; c++)
+			s[c] = src[c] + n;
+		conv_f32_to_s16_c(&d[n * n_channels], s, n_channels, n_frames - n);
+	}
+}
+
+static void
+conv_f32_from_f32_sse2(void *dst, const float **src, uint32_t n_channels, int n_frames)
+{
+	float *d = dst;
+	int n = 0;
+
+	if (n_channels == 2) {
+		const float *l = src[0], *r = src[1];
+
+		for (; n + 4 <= n_frames; n += 4) {
+			__m128 vl = _mm_loadu_ps(&l[n]), vr = _mm_loadu_ps(&r[n]);
+			_mm_storeu_ps(&d[2 * n], _mm_unpacklo_ps(vl, vr));
+			_mm_storeu_ps(&d[2 * n + 4], _mm_unpackhi_ps(vl, vr));
+		}
+	}
+	if (n < n_frames) {
+		const float *s[n_channels];
+		uint32_t c;
+
+		for (c = 0; c < n_channels; c++)
+			s[c] = src[c] + n;
+		conv_f32_from_f32_c(&d[n * n_channels], s, n_channels, n_frames - n);
+	}
+}
+
+static void
+channelmix_sse2(float **dst, uint32_t n_dst, const float **src, uint32_t n_src,
+		const float *matrix, int n_frames)
+{
+	uint32_t i, j;
+	int n;
+
+	for (i = 0; i < n_dst; i++) {
+		float *d = dst[i];
+		bool first = true;
+
+		for (j = 0; j < n_src; j++) {
+			const float *s = src[j];
+			float v = matrix[i * n_src + j];
+			__m128 vv = _mm_set1_ps(v);
+
+			if (v == 0.0f)
+				continue;
+
+			for (n = 0; n + 4 <= n_frames; n += 4) {
+				__m128 t = _mm_loadu_ps(&s[n]);
+				if (v != 1.0f)
+					t = _mm_mul_ps(t, vv);
+				if (!first)
+					t = _mm_add_ps(t, _mm_loadu_ps(&d[n]));
+				_mm_storeu_ps(&d[n], t);
+			}
+			for (; n < n_frames; n++)
+				d[n] = (first ? 0.0f : d[n]) + s[n] * v;
+
+			first = false;
+		}
+		if (first)
+			memset(d, 0, n_frames * sizeof(float));
+	}
+}
+
+void spa_audioconvert_get_ops_sse2(struct spa_audioconvert_ops *ops)
+{
+	ops->to_f32[FMT_S16] = conv_s16_to_f32_sse2;
+	ops->to_f32[FMT_S32] = conv_s32_to_f32_sse2;
+	ops->to_f32[FMT_F32] = conv_f32_to_f32_sse2;
+	ops->from_f32[FMT_S16] = conv_f32_to_s16_sse2;
+	ops->from_f32[FMT_F32] = conv_f32_from_f32_sse2;
+	ops->channelmix = channelmix_sse2;
+}
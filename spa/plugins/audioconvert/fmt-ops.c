@@ -0,0 +1,221 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <math.h>
+
+#include "fmt-ops.h"
+
+static inline float s16_to_f32(int16_t v)
+{
+	return v * (1.0f / S16_SCALE);
+}
+
+static inline int16_t f32_to_s16(float v)
+{
+	return lrintf(SPA_CLAMP(v, -1.0f, 1.0f) * S16_SCALE);
+}
+
+static inline int32_t read_s24(const uint8_t *s)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	return ((int32_t) (((uint32_t) s[2] << 24) | (s[1] << 16) | (s[0] << 8))) >> 8;
+#else
+	return ((int32_t) (((uint32_t) s[0] << 24) | (s[1] << 16) | (s[2] << 8))) >> 8;
+#endif
+}
+
+static inline void write_s24(uint8_t *d, int32_t v)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	d[0] = v;
+	d[1] = v >> 8;
+	d[2] = v >> 16;
+#else
+	d[0] = v >> 16;
+	d[1] = v >> 8;
+	d[2] = v;
+#endif
+}
+
+void
+conv_s16_to_f32_c(float **dst, const void *src, uint32_t n_channels, int n_frames)
+{
+	const int16_t *s = src;
+	int n;
+	uint32_t c;
+
+	for (n = 0; n < n_frames; n++)
+		for (c = 0; c < n_channels; c++)
+			dst[c][n] = s16_to_f32(*s++);
+}
+
+void
+conv_s24_to_f32_c(float **dst, const void *src, uint32_t n_channels, int n_frames)
+{
+	const uint8_t *s = src;
+	int n;
+	uint32_t c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++) {
+			dst[c][n] = read_s24(s) * (1.0f / S24_SCALE);
+			s += 3;
+		}
+	}
+}
+
+void
+conv_s32_to_f32_c(float **dst, const void *src, uint32_t n_channels, int n_frames)
+{
+	const int32_t *s = src;
+	int n;
+	uint32_t c;
+
+	for (n = 0; n < n_frames; n++)
+		for (c = 0; c < n_channels; c++)
+			dst[c][n] = *s++ * (1.0f / S32_SCALE);
+}
+
+void
+conv_f32_to_f32_c(float **dst, const void *src, uint32_t n_channels, int n_frames)
+{
+	const float *s = src;
+	int n;
+	uint32_t c;
+
+	if (n_channels == 1) {
+		memcpy(dst[0], s, n_frames * sizeof(float));
+		return;
+	}
+	for (n = 0; n < n_frames; n++)
+		for (c = 0; c < n_channels; c++)
+			dst[c][n] = *s++;
+}
+
+void
+conv_f32_to_s16_c(void *dst, const float **src, uint32_t n_channels, int n_frames)
+{
+	int16_t *d = dst;
+	int n;
+	uint32_t c;
+
+	for (n = 0; n < n_frames; n++)
+		for (c = 0; c < n_channels; c++)
+			*d++ = f32_to_s16(src[c][n]);
+}
+
+void
+conv_f32_to_s24_c(void *dst, const float **src, uint32_t n_channels, int n_frames)
+{
+	uint8_t *d = dst;
+	int n;
+	uint32_t c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++) {
+			write_s24(d, lrintf(SPA_CLAMP(src[c][n], -1.0f, 1.0f) * S24_SCALE));
+			d += 3;
+		}
+	}
+}
+
+void
+conv_f32_to_s32_c(void *dst, const float **src, uint32_t n_channels, int n_frames)
+{
+	int32_t *d = dst;
+	int n;
+	uint32_t c;
+	float v;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++) {
+			v = src[c][n] * S32_SCALE;
+			*d++ = lrintf(SPA_CLAMP(v, -S32_SCALE, S32_MAX_F));
+		}
+	}
+}
+
+void
+conv_f32_from_f32_c(void *dst, const float **src, uint32_t n_channels, int n_frames)
+{
+	float *d = dst;
+	int n;
+	uint32_t c;
+
+	if (n_channels == 1) {
+		memcpy(d, src[0], n_frames * sizeof(float));
+		return;
+	}
+	for (n = 0; n < n_frames; n++)
+		for (c = 0; c < n_channels; c++)
+			*d++ = src[c][n];
+}
+
+void
+channelmix_c(float **dst, uint32_t n_dst, const float **src, uint32_t n_src,
+	     const float *matrix, int n_frames)
+{
+	uint32_t i, j;
+	int n;
+	float v;
+
+	for (i = 0; i < n_dst; i++) {
+		float *d = dst[i];
+
+		memset(d, 0, n_frames * sizeof(float));
+
+		for (j = 0; j < n_src; j++) {
+			const float *s = src[j];
+
+			if ((v = matrix[i * n_src + j]) == 0.0f)
+				continue;
+
+			if (v == 1.0f) {
+				for (n = 0; n < n_frames; n++)
+					d[n] += s[n];
+			} else {
+				for (n = 0; n < n_frames; n++)
+					d[n] += s[n] * v;
+			}
+		}
+	}
+}
+
+void spa_audioconvert_get_ops(struct spa_audioconvert_ops *ops, uint32_t cpu_flags)
+{
+	ops->to_f32[FMT_S16] = conv_s16_to_f32_c;
+	ops->to_f32[FMT_S24] = conv_s24_to_f32_c;
+	ops->to_f32[FMT_S32] = conv_s32_to_f32_c;
+	ops->to_f32[FMT_F32] = conv_f32_to_f32_c;
+	ops->from_f32[FMT_S16] = conv_f32_to_s16_c;
+	ops->from_f32[FMT_S24] = conv_f32_to_s24_c;
+	ops->from_f32[FMT_S32] = conv_f32_to_s32_c;
+	ops->from_f32[FMT_F32] = conv_f32_from_f32_c;
+	ops->channelmix = channelmix_c;
+
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		spa_audioconvert_get_ops_sse2(ops);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		spa_audioconvert_get_ops_neon(ops);
+#endif
+}
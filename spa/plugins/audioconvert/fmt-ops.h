@@ -0,0 +1,83 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+#include <spa/defs.h>
+#include <lib/cpu.h>
+
+/* Samples are converted to planar F32, mixed to the output channels and
+ * then converted to the output format.
+ *
+ * to_f32 reads n_frames of n_channels interleaved samples from src and
+ * writes them in the n_channels planes in dst. For planar input it is
+ * called for each plane with n_channels 1. from_f32 does the reverse. */
+typedef void (*convert_to_f32_func_t) (float **dst, const void *src, uint32_t n_channels, int n_frames);
+typedef void (*convert_from_f32_func_t) (void *dst, const float **src, uint32_t n_channels, int n_frames);
+/* mix n_src planes into n_dst planes with the n_dst x n_src matrix */
+typedef void (*channelmix_func_t) (float **dst, uint32_t n_dst,
+				   const float **src, uint32_t n_src,
+				   const float *matrix, int n_frames);
+
+enum {
+	FMT_S16,
+	FMT_S24,
+	FMT_S32,
+	FMT_F32,
+	FMT_MAX,
+};
+
+struct spa_audioconvert_ops {
+	convert_to_f32_func_t to_f32[FMT_MAX];
+	convert_from_f32_func_t from_f32[FMT_MAX];
+	channelmix_func_t channelmix;
+};
+
+/* scale factors between the integer formats and F32 */
+#define S16_SCALE	32767.0f
+#define S24_SCALE	8388607.0f
+#define S32_SCALE	2147483648.0f
+/* largest float below 2^31 */
+#define S32_MAX_F	2147483520.0f
+
+/* fill ops with the best implementation for the given SPA_CPU_FLAG_* mask,
+ * pass 0 to get the plain C versions */
+void spa_audioconvert_get_ops(struct spa_audioconvert_ops *ops, uint32_t cpu_flags);
+
+/* reference C implementations */
+void conv_s16_to_f32_c(float **dst, const void *src, uint32_t n_channels, int n_frames);
+void conv_s24_to_f32_c(float **dst, const void *src, uint32_t n_channels, int n_frames);
+void conv_s32_to_f32_c(float **dst, const void *src, uint32_t n_channels, int n_frames);
+void conv_f32_to_f32_c(float **dst, const void *src, uint32_t n_channels, int n_frames);
+void conv_f32_to_s16_c(void *dst, const float **src, uint32_t n_channels, int n_frames);
+void conv_f32_to_s24_c(void *dst, const float **src, uint32_t n_channels, int n_frames);
+void conv_f32_to_s32_c(void *dst, const float **src, uint32_t n_channels, int n_frames);
+void conv_f32_from_f32_c(void *dst, const float **src, uint32_t n_channels, int n_frames);
+void channelmix_c(float **dst, uint32_t n_dst, const float **src, uint32_t n_src,
+		  const float *matrix, int n_frames);
+
+/* the SIMD versions are built in separate objects with the right compiler
+ * flags and only selected when the CPU supports them */
+#if defined (HAVE_SSE2)
+void spa_audioconvert_get_ops_sse2(struct spa_audioconvert_ops *ops);
+#endif
+#if defined (HAVE_NEON)
+void spa_audioconvert_get_ops_neon(struct spa_audioconvert_ops *ops);
+#endif
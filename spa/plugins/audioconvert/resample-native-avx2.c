@@ -0,0 +1,67 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <immintrin.h>
+
+#include "resample-native.h"
+
+static inline float hsum_avx2(__m256 v)
+{
+	__m128 t = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	t = _mm_add_ps(t, _mm_movehl_ps(t, t));
+	t = _mm_add_ss(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(t);
+}
+
+/* the taps are aligned, the samples are not */
+void inner_product_avx2(float *d, const float *s, const float *taps, uint32_t n_taps)
+{
+	__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+	uint32_t i = 0;
+
+	for (; i + 16 <= n_taps; i += 16) {
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(s + i),
+							 _mm256_load_ps(taps + i)));
+		sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(s + i + 8),
+							 _mm256_load_ps(taps + i + 8)));
+	}
+	if (i < n_taps)
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(s + i),
+							 _mm256_load_ps(taps + i)));
+
+	*d = hsum_avx2(_mm256_add_ps(sum0, sum1));
+}
+
+void inner_product_ip_avx2(float *d, const float *s,
+			   const float *t0, const float *t1, float x, uint32_t n_taps)
+{
+	__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps(), in;
+	uint32_t i;
+	float s0, s1;
+
+	for (i = 0; i < n_taps; i += 8) {
+		in = _mm256_loadu_ps(s + i);
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(in, _mm256_load_ps(t0 + i)));
+		sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(in, _mm256_load_ps(t1 + i)));
+	}
+	s0 = hsum_avx2(sum0);
+	s1 = hsum_avx2(sum1);
+	*d = s0 + (s1 - s0) * x;
+}
@@ -0,0 +1,58 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <arm_neon.h>
+
+#include "resample-native.h"
+
+static inline float hsum_neon(float32x4_t v)
+{
+	float32x2_t t = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+	return vget_lane_f32(vpadd_f32(t, t), 0);
+}
+
+void inner_product_neon(float *d, const float *s, const float *taps, uint32_t n_taps)
+{
+	float32x4_t sum0 = vdupq_n_f32(0.0f), sum1 = vdupq_n_f32(0.0f);
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i += 8) {
+		sum0 = vmlaq_f32(sum0, vld1q_f32(s + i), vld1q_f32(taps + i));
+		sum1 = vmlaq_f32(sum1, vld1q_f32(s + i + 4), vld1q_f32(taps + i + 4));
+	}
+	*d = hsum_neon(vaddq_f32(sum0, sum1));
+}
+
+void inner_product_ip_neon(float *d, const float *s,
+			   const float *t0, const float *t1, float x, uint32_t n_taps)
+{
+	float32x4_t sum0 = vdupq_n_f32(0.0f), sum1 = vdupq_n_f32(0.0f), in;
+	uint32_t i;
+	float s0, s1;
+
+	for (i = 0; i < n_taps; i += 4) {
+		in = vld1q_f32(s + i);
+		sum0 = vmlaq_f32(sum0, in, vld1q_f32(t0 + i));
+		sum1 = vmlaq_f32(sum1, in, vld1q_f32(t1 + i));
+	}
+	s0 = hsum_neon(sum0);
+	s1 = hsum_neon(sum1);
+	*d = s0 + (s1 - s0) * x;
+}
@@ -0,0 +1,60 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <emmintrin.h>
+
+#include "resample-native.h"
+
+static inline float hsum_sse2(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(v);
+}
+
+/* the taps are aligned, the samples are not */
+void inner_product_sse2(float *d, const float *s, const float *taps, uint32_t n_taps)
+{
+	__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(s + i), _mm_load_ps(taps + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(s + i + 4), _mm_load_ps(taps + i + 4)));
+	}
+	*d = hsum_sse2(_mm_add_ps(sum0, sum1));
+}
+
+void inner_product_ip_sse2(float *d, const float *s,
+			   const float *t0, const float *t1, float x, uint32_t n_taps)
+{
+	__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps(), in;
+	uint32_t i;
+	float s0, s1;
+
+	for (i = 0; i < n_taps; i += 4) {
+		in = _mm_loadu_ps(s + i);
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(in, _mm_load_ps(t0 + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(in, _mm_load_ps(t1 + i)));
+	}
+	s0 = hsum_sse2(sum0);
+	s1 = hsum_sse2(sum1);
+	*d = s0 + (s1 - s0) * x;
+}
@@ -0,0 +1,379 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "resample.h"
+#include "resample-native.h"
+
+/* input frames that are buffered per channel on top of the filter length */
+#define BLOCK_SIZE	4096
+/* the exact polyphase filter is only used when the reduced output rate
+ * has at most this many phases, otherwise it interpolates */
+#define MAX_PHASES	1024
+#define MAX_TAPS	2048
+
+struct quality {
+	uint32_t n_taps;
+	double cutoff;
+	/* phases in the interpolated filter */
+	uint32_t n_ip_phases;
+};
+
+static const struct quality qualities[RESAMPLE_QUALITY_MAX] = {
+	{ 16, 0.80, 32, },
+	{ 32, 0.90, 64, },
+	{ 64, 0.95, 128, },
+};
+
+struct native_data {
+	uint32_t n_taps;
+	uint32_t stride;
+	uint32_t in_rate;
+	uint32_t out_rate;
+
+	/* exact filter, n_phases rows, only when n_phases > 0 */
+	uint32_t n_phases;
+	float *filter;
+	/* interpolated filter with n_ip_phases + 1 rows */
+	uint32_t n_ip_phases;
+	float *ip_filter;
+
+	/* position of the next output in the history, as an integer index
+	 * plus a phase for the exact filter or a fraction when
+	 * interpolating */
+	uint32_t index;
+	uint32_t phase;
+	double frac;
+	double step;
+	bool interpolate;
+
+	uint32_t hist;
+	uint32_t hist_size;
+	float **history;
+
+	inner_product_func_t inner_product;
+	inner_product_ip_func_t inner_product_ip;
+
+	void *mem;
+};
+
+static inline double sinc(double x)
+{
+	if (fabs(x) < 1e-9)
+		return 1.0;
+	x *= M_PI;
+	return sin(x) / x;
+}
+
+/* 4 term Blackman-Harris window, x goes from -n_taps/2 to n_taps/2 */
+static inline double window(double x, uint32_t n_taps)
+{
+	double w = 2.0 * M_PI * (x / n_taps + 0.5);
+	return 0.35875 - 0.48829 * cos(w) + 0.14128 * cos(2.0 * w) - 0.01168 * cos(3.0 * w);
+}
+
+/* phase p of n_phases delays the filter by p / n_phases input frames */
+static void build_filter(float *taps, uint32_t stride, uint32_t n_taps,
+			 uint32_t n_phases, uint32_t n_rows, double cutoff)
+{
+	uint32_t i, j;
+	double x, sum;
+
+	for (i = 0; i < n_rows; i++) {
+		float *t = &taps[i * stride];
+
+		for (j = 0, sum = 0.0; j < n_taps; j++) {
+			x = (double) j - n_taps / 2 + 1 - (double) i / n_phases;
+			t[j] = cutoff * sinc(x * cutoff) * window(x, n_taps);
+			sum += t[j];
+		}
+		/* unity gain for DC */
+		for (j = 0; j < n_taps; j++)
+			t[j] /= sum;
+	}
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b != 0) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static void impl_native_update_rate(struct resample *r, double rate)
+{
+	struct native_data *data = r->data;
+
+	r->rate = rate;
+	data->step = (double) data->in_rate * rate / data->out_rate;
+
+	if (rate == 1.0 && data->n_phases > 0) {
+		if (data->interpolate) {
+			data->phase = (uint32_t) lrint(data->frac * data->n_phases) % data->n_phases;
+			data->interpolate = false;
+		}
+	} else if (!data->interpolate) {
+		data->frac = data->n_phases > 0 ? (double) data->phase / data->n_phases : 0.0;
+		data->interpolate = true;
+	}
+}
+
+static void impl_native_process(struct resample *r,
+				const void *src[], uint32_t *in_len,
+				void *dst[], uint32_t *out_len)
+{
+	struct native_data *data = r->data;
+	uint32_t c, in, o, n_taps = data->n_taps;
+	float **history = data->history, **d = (float **) dst;
+
+	in = SPA_MIN(*in_len, data->hist_size - data->hist);
+	for (c = 0; c < r->channels; c++)
+		memcpy(&history[c][data->hist], src[c], in * sizeof(float));
+	data->hist += in;
+
+	/* all channels are processed with the same positions, one channel at
+	 * a time so that only one history and output are used at once */
+	o = 0;
+	if (!data->interpolate) {
+		uint32_t inc = data->in_rate / data->out_rate;
+		uint32_t frac = data->in_rate % data->out_rate;
+		uint32_t index = data->index, phase = data->phase;
+
+		for (c = 0; c < r->channels; c++) {
+			const float *s = history[c];
+
+			index = data->index;
+			phase = data->phase;
+
+			for (o = 0; o < *out_len && index + n_taps <= data->hist; o++) {
+				data->inner_product(&d[c][o], &s[index],
+						&data->filter[phase * data->stride], n_taps);
+
+				index += inc;
+				if ((phase += frac) >= data->out_rate) {
+					phase -= data->out_rate;
+					index++;
+				}
+			}
+		}
+		data->index = index;
+		data->phase = phase;
+	} else {
+		uint32_t n_ip = data->n_ip_phases, index = data->index, p;
+		double frac = data->frac, pos;
+
+		for (c = 0; c < r->channels; c++) {
+			const float *s = history[c];
+
+			index = data->index;
+			frac = data->frac;
+
+			for (o = 0; o < *out_len && index + n_taps <= data->hist; o++) {
+				const float *t0;
+
+				pos = frac * n_ip;
+				p = (uint32_t) pos;
+				t0 = &data->ip_filter[p * data->stride];
+
+				data->inner_product_ip(&d[c][o], &s[index],
+						t0, t0 + data->stride, pos - p, n_taps);
+
+				frac += data->step;
+				p = (uint32_t) frac;
+				index += p;
+				frac -= p;
+			}
+		}
+		data->index = index;
+		data->frac = frac;
+	}
+
+	/* keep the samples that are still needed at the start of the history */
+	if (data->index >= data->hist) {
+		data->index -= data->hist;
+		data->hist = 0;
+	} else if (data->index > 0) {
+		for (c = 0; c < r->channels; c++)
+			memmove(history[c], &history[c][data->index],
+				(data->hist - data->index) * sizeof(float));
+		data->hist -= data->index;
+		data->index = 0;
+	}
+	*in_len = in;
+	*out_len = o;
+}
+
+static void impl_native_reset(struct resample *r)
+{
+	struct native_data *data = r->data;
+	uint32_t c;
+
+	/* prefill with silence so that the first output is centered on the
+	 * first input frame */
+	for (c = 0; c < r->channels; c++)
+		memset(data->history[c], 0, data->hist_size * sizeof(float));
+	data->hist = data->n_taps / 2 - 1;
+	data->index = 0;
+	data->phase = 0;
+	data->frac = 0.0;
+}
+
+static uint32_t impl_native_delay(struct resample *r)
+{
+	struct native_data *data = r->data;
+	return data->n_taps / 2;
+}
+
+static void impl_native_free(struct resample *r)
+{
+	struct native_data *data = r->data;
+
+	if (data) {
+		free(data->mem);
+		free(data);
+	}
+	r->data = NULL;
+}
+
+int resample_native_init(struct resample *r)
+{
+	struct native_data *data;
+	const struct quality *q;
+	uint32_t c, g, n_taps, stride, filter_size, ip_filter_size;
+	double cutoff;
+	size_t size;
+	uint8_t *p;
+
+	spa_return_val_if_fail(r->channels > 0, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(r->i_rate > 0 && r->o_rate > 0, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(r->quality < RESAMPLE_QUALITY_MAX, SPA_RESULT_INVALID_ARGUMENTS);
+
+	q = &qualities[r->quality];
+
+	/* when downsampling, lower the cutoff and make the filter longer to
+	 * keep the same transition band relative to the output rate */
+	cutoff = q->cutoff;
+	n_taps = q->n_taps;
+	if (r->o_rate < r->i_rate) {
+		cutoff = cutoff * r->o_rate / r->i_rate;
+		n_taps = ceil((double) n_taps * r->i_rate / r->o_rate);
+	}
+	n_taps = SPA_MIN(SPA_ROUND_UP_N(n_taps, TAPS_ALIGN), MAX_TAPS);
+	stride = n_taps;
+
+	if ((data = calloc(1, sizeof(struct native_data))) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	g = gcd(r->i_rate, r->o_rate);
+	data->in_rate = r->i_rate / g;
+	data->out_rate = r->o_rate / g;
+	data->n_taps = n_taps;
+	data->stride = stride;
+	data->n_phases = data->out_rate <= MAX_PHASES ? data->out_rate : 0;
+	data->n_ip_phases = q->n_ip_phases;
+	data->hist_size = n_taps + BLOCK_SIZE;
+
+	filter_size = data->n_phases * stride * sizeof(float);
+	ip_filter_size = (data->n_ip_phases + 1) * stride * sizeof(float);
+
+	size = filter_size + ip_filter_size +
+	    r->channels * (sizeof(float *) + data->hist_size * sizeof(float)) + 64;
+
+	if ((data->mem = calloc(1, size)) == NULL) {
+		free(data);
+		return SPA_RESULT_NO_MEMORY;
+	}
+
+	/* the filters are aligned for the SIMD loads */
+	p = (uint8_t *) SPA_ROUND_UP_N((uintptr_t) data->mem, 32);
+	data->filter = (float *) p;
+	data->ip_filter = (float *) (p + filter_size);
+	data->history = (float **) (p + filter_size + ip_filter_size);
+	p += filter_size + ip_filter_size + r->channels * sizeof(float *);
+	for (c = 0; c < r->channels; c++)
+		data->history[c] = (float *) (p + c * data->hist_size * sizeof(float));
+
+	build_filter(data->filter, stride, n_taps, data->n_phases, data->n_phases, cutoff);
+	build_filter(data->ip_filter, stride, n_taps, data->n_ip_phases,
+		     data->n_ip_phases + 1, cutoff);
+
+	data->inner_product = inner_product_c;
+	data->inner_product_ip = inner_product_ip_c;
+#if defined (HAVE_NEON)
+	if (r->cpu_flags & SPA_CPU_FLAG_NEON) {
+		data->inner_product = inner_product_neon;
+		data->inner_product_ip = inner_product_ip_neon;
+	}
+#endif
+#if defined (HAVE_SSE2)
+	if (r->cpu_flags & SPA_CPU_FLAG_SSE2) {
+		data->inner_product = inner_product_sse2;
+		data->inner_product_ip = inner_product_ip_sse2;
+	}
+#endif
+#if defined (HAVE_AVX2)
+	if (r->cpu_flags & SPA_CPU_FLAG_AVX2) {
+		data->inner_product = inner_product_avx2;
+		data->inner_product_ip = inner_product_ip_avx2;
+	}
+#endif
+
+	r->data = data;
+	r->free = impl_native_free;
+	r->update_rate = impl_native_update_rate;
+	r->process = impl_native_process;
+	r->reset = impl_native_reset;
+	r->delay = impl_native_delay;
+
+	data->interpolate = data->n_phases == 0;
+	impl_native_update_rate(r, r->rate > 0.0 ? r->rate : 1.0);
+	impl_native_reset(r);
+
+	return SPA_RESULT_OK;
+}
+
+void inner_product_c(float *d, const float *s, const float *taps, uint32_t n_taps)
+{
+	float sum = 0.0f;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i++)
+		sum += s[i] * taps[i];
+	*d = sum;
+}
+
+void inner_product_ip_c(float *d, const float *s,
+			const float *t0, const float *t1, float x, uint32_t n_taps)
+{
+	float sum0 = 0.0f, sum1 = 0.0f;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i++) {
+		sum0 += s[i] * t0[i];
+		sum1 += s[i] * t1[i];
+	}
+	*d = sum0 + (sum1 - sum0) * x;
+}
@@ -0,0 +1,51 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <spa/defs.h>
+#include <lib/cpu.h>
+
+/* The filter taps are padded to a multiple of this and aligned so that the
+ * SIMD versions don't need to handle tails */
+#define TAPS_ALIGN	8
+
+/* d = sum(s[i] * taps[i]) */
+typedef void (*inner_product_func_t) (float *d, const float *s, const float *taps, uint32_t n_taps);
+/* like inner_product but interpolates linearly between the results of
+ * two filters, x is the position between t0 and t1 */
+typedef void (*inner_product_ip_func_t) (float *d, const float *s,
+					 const float *t0, const float *t1, float x, uint32_t n_taps);
+
+#define DECLARE_INNER_PRODUCT(arch)					\
+void inner_product_##arch(float *d, const float *s,			\
+			  const float *taps, uint32_t n_taps);		\
+void inner_product_ip_##arch(float *d, const float *s,			\
+			     const float *t0, const float *t1, float x,	\
+			     uint32_t n_taps);
+
+DECLARE_INNER_PRODUCT(c)
+#if defined (HAVE_SSE2)
+DECLARE_INNER_PRODUCT(sse2)
+#endif
+#if defined (HAVE_AVX2)
+DECLARE_INNER_PRODUCT(avx2)
+#endif
+#if defined (HAVE_NEON)
+DECLARE_INNER_PRODUCT(neon)
+#endif
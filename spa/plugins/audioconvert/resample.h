@@ -0,0 +1,68 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <spa/defs.h>
+
+enum resample_quality {
+	RESAMPLE_QUALITY_LOW,
+	RESAMPLE_QUALITY_MEDIUM,
+	RESAMPLE_QUALITY_HIGH,
+	RESAMPLE_QUALITY_MAX,
+};
+
+#define RESAMPLE_QUALITY_DEFAULT	RESAMPLE_QUALITY_MEDIUM
+
+/* A resampler for planar F32 samples.
+ *
+ * process() consumes up to *in_len frames of each of the channel planes in
+ * src and writes up to *out_len frames to dst. On return *in_len and
+ * *out_len contain the number of frames that were consumed and produced.
+ * Input that can't be turned into output yet is kept in the resampler. */
+struct resample {
+	uint32_t channels;
+	uint32_t i_rate;
+	uint32_t o_rate;
+	/* extra factor applied to the input rate, used to follow drift
+	 * between clocks */
+	double rate;
+	enum resample_quality quality;
+	uint32_t cpu_flags;
+
+	void (*free)	(struct resample *r);
+	void (*update_rate) (struct resample *r, double rate);
+	void (*process)	(struct resample *r,
+			 const void *src[], uint32_t *in_len,
+			 void *dst[], uint32_t *out_len);
+	void (*reset)	(struct resample *r);
+	/* delay of the resampler in input frames */
+	uint32_t (*delay) (struct resample *r);
+	void *data;
+};
+
+#define resample_free(r)		(r)->free(r)
+#define resample_update_rate(r,...)	(r)->update_rate(r,__VA_ARGS__)
+#define resample_process(r,...)		(r)->process(r,__VA_ARGS__)
+#define resample_reset(r)		(r)->reset(r)
+#define resample_delay(r)		(r)->delay(r)
+
+/* polyphase windowed sinc resampler. channels, i_rate, o_rate, quality and
+ * cpu_flags must be set. Returns a SPA_RESULT code. */
+int resample_native_init(struct resample *r);
+
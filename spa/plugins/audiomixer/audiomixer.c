@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 
 #include <spa/log.h>
 #include <spa/list.h>
@@ -26,20 +27,47 @@
 #include <spa/node.h>
 #include <spa/audio/format-utils.h>
 #include <spa/format-builder.h>
+#include <spa/param-alloc.h>
 #include <lib/format.h>
 #include <lib/props.h>
-
-#include "conv.h"
+#include <lib/mix.h>
 
 #define NAME "audiomixer"
 
 #define MAX_BUFFERS     64
 #define MAX_PORTS       128
+#define MAX_CHANNELS    64
+
+#define DEFAULT_VOLUME	1.0
+#define DEFAULT_MUTE	false
+#define DEFAULT_SCRUB	true
+
+struct props {
+	bool scrub;
+};
+
+static void props_reset(struct props *props)
+{
+	props->scrub = DEFAULT_SCRUB;
+}
+
+struct port_props {
+	double volume;
+	bool mute;
+};
+
+static void port_props_reset(struct port_props *props)
+{
+	props->volume = DEFAULT_VOLUME;
+	props->mute = DEFAULT_MUTE;
+}
 
 struct buffer {
 	struct spa_buffer *outbuf;
 	bool outstanding;
 	struct spa_meta_header *h;
+	struct spa_meta_audio_level *level;
+	uint32_t level_channels;
 	struct spa_list link;
 };
 
@@ -49,6 +77,10 @@ struct port {
 	struct spa_port_io *io;
 
 	struct spa_port_info info;
+	uint8_t params_buffer[256];
+
+	struct port_props props;
+	float scale;
 
 	bool have_format;
 
@@ -63,6 +95,11 @@ struct port {
 struct type {
 	uint32_t node;
 	uint32_t format;
+	uint32_t props;
+	uint32_t prop_volume;
+	uint32_t prop_mute;
+	uint32_t prop_scrub;
+	uint32_t prop_bad_samples;
 	struct spa_type_media_type media_type;
 	struct spa_type_media_subtype media_subtype;
 	struct spa_type_format_audio format_audio;
@@ -70,12 +107,18 @@ struct type {
 	struct spa_type_command_node command_node;
 	struct spa_type_meta meta;
 	struct spa_type_data data;
+	struct spa_type_param_alloc_meta_enable param_alloc_meta_enable;
 };
 
 static inline void init_type(struct type *type, struct spa_type_map *map)
 {
 	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
 	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
+	type->prop_mute = spa_type_map_get_id(map, SPA_TYPE_PROPS__mute);
+	type->prop_scrub = spa_type_map_get_id(map, SPA_TYPE_PROPS__scrub);
+	type->prop_bad_samples = spa_type_map_get_id(map, SPA_TYPE_PROPS__badSamples);
 	spa_type_media_type_map(map, &type->media_type);
 	spa_type_media_subtype_map(map, &type->media_subtype);
 	spa_type_format_audio_map(map, &type->format_audio);
@@ -83,6 +126,7 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	spa_type_command_node_map(map, &type->command_node);
 	spa_type_meta_map(map, &type->meta);
 	spa_type_data_map(map, &type->data);
+	spa_type_param_alloc_meta_enable_map(map, &type->param_alloc_meta_enable);
 }
 
 struct impl {
@@ -95,6 +139,11 @@ struct impl {
 
 	struct spa_audiomixer_ops ops;
 
+	uint8_t props_buffer[512];
+	struct props props;
+	/* number of NaN and infinite samples removed from the mix */
+	uint64_t bad_samples;
+
 	const struct spa_node_callbacks *callbacks;
 	void *user_data;
 
@@ -107,9 +156,17 @@ struct impl {
 	bool have_format;
 	int n_formats;
 	struct spa_audio_info format;
+	/* number of spa_data in each buffer, one per channel when planar */
+	uint32_t n_planes;
+	uint32_t sample_size;
 
 	mix_func_t copy;
 	mix_func_t add;
+	mix_n_func_t mix;
+	mix_scale_func_t copy_scale;
+	mix_scale_func_t add_scale;
+	scrub_func_t scrub;
+	level_func_t level;
 
 	bool started;
 };
@@ -135,14 +192,48 @@ struct impl {
 	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
 			SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
 
+#define PROP_R(f,key,type,...)							\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_READONLY,type,1,__VA_ARGS__)
+
 static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(props != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_pod_builder_init(&b, this->props_buffer, sizeof(this->props_buffer));
+	spa_pod_builder_props(&b, &f[0], this->type.props,
+		PROP(&f[1], this->type.prop_scrub, SPA_POD_TYPE_BOOL,
+			this->props.scrub),
+		PROP_R(&f[1], this->type.prop_bad_samples, SPA_POD_TYPE_LONG,
+			(int64_t) this->bad_samples));
+
+	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	return SPA_RESULT_OK;
 }
 
 static int impl_node_set_props(struct spa_node *node, const struct spa_props *props)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (props == NULL) {
+		props_reset(&this->props);
+	} else {
+		spa_props_query(props,
+				this->type.prop_scrub, SPA_POD_TYPE_BOOL, &this->props.scrub,
+				0);
+	}
+	return SPA_RESULT_OK;
 }
 
 static int impl_node_send_command(struct spa_node *node, const struct spa_command *command)
@@ -246,6 +337,8 @@ static int impl_node_add_port(struct spa_node *node, enum spa_direction directio
 
 	port = GET_IN_PORT (this, port_id);
 	port->valid = true;
+	port_props_reset(&port->props);
+	port->scale = port->props.volume;
 	spa_list_init(&port->queue);
 	port->info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
 			   SPA_PORT_INFO_FLAG_REMOVABLE |
@@ -308,7 +401,7 @@ impl_node_port_enum_formats(struct spa_node *node,
 	struct impl *this;
 	int res;
 	struct spa_format *fmt;
-	uint8_t buffer[256];
+	uint8_t buffer[512];
 	struct spa_pod_builder b = { NULL, };
 	struct spa_pod_frame f[2];
 	uint32_t count, match;
@@ -334,6 +427,10 @@ impl_node_port_enum_formats(struct spa_node *node,
 				this->type.audio_format.S16,
 				this->type.audio_format.S16,
 				this->type.audio_format.F32),
+			PROP_U_EN(&f[1], this->type.format_audio.layout, SPA_POD_TYPE_INT, 3,
+				SPA_AUDIO_LAYOUT_INTERLEAVED,
+				SPA_AUDIO_LAYOUT_INTERLEAVED,
+				SPA_AUDIO_LAYOUT_NON_INTERLEAVED),
 			PROP_U_MM(&f[1], this->type.format_audio.rate, SPA_POD_TYPE_INT,
 				44100,
 				1, INT32_MAX),
@@ -409,13 +506,27 @@ impl_node_port_set_format(struct spa_node *node,
 		} else {
 			this->have_format = true;
 			this->format = info;
+			this->n_planes = info.info.raw.layout == SPA_AUDIO_LAYOUT_NON_INTERLEAVED ?
+				info.info.raw.channels : 1;
 			if (info.info.raw.format == this->type.audio_format.S16) {
 				this->copy = this->ops.copy[CONV_S16_S16];
 				this->add = this->ops.add[CONV_S16_S16];
+				this->mix = this->ops.mix[CONV_S16_S16];
+				this->copy_scale = this->ops.copy_scale[CONV_S16_S16];
+				this->add_scale = this->ops.add_scale[CONV_S16_S16];
+				this->scrub = NULL;
+				this->level = this->ops.level[CONV_S16_S16];
+				this->sample_size = sizeof(int16_t);
 			}
 			else if (info.info.raw.format == this->type.audio_format.F32) {
 				this->copy = this->ops.copy[CONV_F32_F32];
 				this->add = this->ops.add[CONV_F32_F32];
+				this->mix = this->ops.mix[CONV_F32_F32];
+				this->copy_scale = this->ops.copy_scale[CONV_F32_F32];
+				this->add_scale = this->ops.add_scale[CONV_F32_F32];
+				this->scrub = this->ops.scrub_f32;
+				this->level = this->ops.level[CONV_F32_F32];
+				this->sample_size = sizeof(float);
 			}
 		}
 		if (!port->have_format) {
@@ -457,6 +568,8 @@ impl_node_port_get_format(struct spa_node *node,
 		this->type.media_subtype.raw,
 		PROP(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID,
 			this->format.info.raw.format),
+		PROP(&f[1], this->type.format_audio.layout, SPA_POD_TYPE_INT,
+			this->format.info.raw.layout),
 		PROP(&f[1], this->type.format_audio.rate, SPA_POD_TYPE_INT,
 			this->format.info.raw.rate),
 		PROP(&f[1], this->type.format_audio.channels, SPA_POD_TYPE_INT,
@@ -495,7 +608,67 @@ impl_node_port_enum_params(struct spa_node *node,
 			   uint32_t index,
 			   struct spa_param **param)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+	struct port *port;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(param != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+
+	spa_pod_builder_init(&b, port->params_buffer, sizeof(port->params_buffer));
+
+	/* the output can carry the level of the mix */
+	if (direction == SPA_DIRECTION_OUTPUT) {
+		if (!port->have_format || index > 0)
+			return SPA_RESULT_ENUM_END;
+
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+				this->type.meta.AudioLevel),
+			PROP(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+				spa_meta_audio_level_size(SPA_MIN(this->format.info.raw.channels,
+								  MAX_CHANNELS))));
+		*param = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+		return SPA_RESULT_OK;
+	}
+
+	/* the input ports have volume and mute and take the level of the
+	 * streams that are mixed */
+	switch (index) {
+	case 0:
+		spa_pod_builder_props(&b, &f[0], this->type.props,
+			PROP_MM(&f[1], this->type.prop_volume, SPA_POD_TYPE_DOUBLE,
+				port->props.volume,
+				0.0, 10.0),
+			PROP(&f[1], this->type.prop_mute, SPA_POD_TYPE_BOOL,
+				port->props.mute));
+		break;
+	case 1:
+		if (!port->have_format)
+			return SPA_RESULT_ENUM_END;
+
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+				this->type.meta.AudioLevel),
+			PROP_U_MM(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+				spa_meta_audio_level_size(this->format.info.raw.channels),
+				spa_meta_audio_level_size(0),
+				spa_meta_audio_level_size(this->format.info.raw.channels)));
+		break;
+	default:
+		return SPA_RESULT_ENUM_END;
+	}
+	*param = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -504,7 +677,36 @@ impl_node_port_set_param(struct spa_node *node,
 			 uint32_t port_id,
 			 const struct spa_param *param)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+	struct port *port;
+	struct port_props props;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_IN_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_IN_PORT(this, port_id);
+
+	if (param == NULL) {
+		port_props_reset(&props);
+	} else {
+		if (param->object.body.type != this->type.props)
+			return SPA_RESULT_INVALID_ARGUMENTS;
+
+		props = port->props;
+		spa_param_query(param,
+				this->type.prop_volume, SPA_POD_TYPE_DOUBLE, &props.volume,
+				this->type.prop_mute, SPA_POD_TYPE_BOOL, &props.mute, 0);
+	}
+	port->props = props;
+	port->scale = props.volume;
+
+	spa_log_info(this->log, NAME " %p: port %d volume %f mute %d", this, port_id,
+		     props.volume, props.mute);
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -516,7 +718,7 @@ impl_node_port_use_buffers(struct spa_node *node,
 {
 	struct impl *this;
 	struct port *port;
-	uint32_t i;
+	uint32_t i, j;
 
 	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
 
@@ -533,19 +735,37 @@ impl_node_port_use_buffers(struct spa_node *node,
 	for (i = 0; i < n_buffers; i++) {
 		struct buffer *b;
 		struct spa_data *d = buffers[i]->datas;
+		struct spa_meta *m;
 
 		b = &port->buffers[i];
 		b->outbuf = buffers[i];
 		b->outstanding = direction == SPA_DIRECTION_INPUT ? true : false;
 		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
 
-		if (!((d[0].type == this->type.data.MemPtr ||
-		       d[0].type == this->type.data.MemFd ||
-		       d[0].type == this->type.data.DmaBuf) && d[0].data != NULL)) {
-			spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
-				      buffers[i]);
+		b->level = NULL;
+		b->level_channels = 0;
+		if ((m = spa_buffer_get_meta(buffers[i], this->type.meta.AudioLevel)) &&
+		    m->size >= spa_meta_audio_level_size(0)) {
+			b->level = m->data;
+			b->level_channels = (m->size - spa_meta_audio_level_size(0)) /
+				sizeof(struct spa_meta_audio_level_channel);
+		}
+
+		/* planar formats need one data block per channel */
+		if (buffers[i]->n_datas < this->n_planes) {
+			spa_log_error(this->log, NAME " %p: buffer %p needs %d datas", this,
+				      buffers[i], this->n_planes);
 			return SPA_RESULT_ERROR;
 		}
+		for (j = 0; j < this->n_planes; j++) {
+			if (!((d[j].type == this->type.data.MemPtr ||
+			       d[j].type == this->type.data.MemFd ||
+			       d[j].type == this->type.data.DmaBuf) && d[j].data != NULL)) {
+				spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
+					      buffers[i]);
+				return SPA_RESULT_ERROR;
+			}
+		}
 		if (!b->outstanding)
 			spa_list_insert(port->queue.prev, &b->link);
 	}
@@ -627,49 +847,116 @@ impl_node_port_send_command(struct spa_node *node,
 	return SPA_RESULT_NOT_IMPLEMENTED;
 }
 
-static inline void
-add_port_data(struct impl *this, void *out, size_t outsize, struct port *port, int layer)
+static inline void *
+get_port_data(struct impl *this, struct port *port, uint32_t plane, size_t *size)
 {
-	void *in;
-	size_t insize;
 	struct buffer *b;
 	struct spa_data *id;
 
 	b = spa_list_first(&port->queue, struct buffer, link);
 
-	id = b->outbuf->datas;
-	in = SPA_MEMBER(id[0].data, port->queued_offset + id[0].chunk->offset, void);
-	insize = id[0].chunk->size - port->queued_offset;
-	outsize = SPA_MIN(outsize, insize);
+	id = &b->outbuf->datas[plane];
+	*size = id->chunk->size - port->queued_offset;
 
-	if (layer == 0)
-		this->copy(out, in, outsize);
-	else
-		this->add(out, in, outsize);
+	return SPA_MEMBER(id->data, port->queued_offset + id->chunk->offset, void);
+}
+
+static inline void
+consume_port_data(struct impl *this, struct port *port, size_t size)
+{
+	struct buffer *b;
+	size_t insize;
 
-	port->queued_offset += outsize;
-	port->queued_bytes -= outsize;
+	b = spa_list_first(&port->queue, struct buffer, link);
+	insize = b->outbuf->datas[0].chunk->size - port->queued_offset;
+
+	port->queued_offset += size;
+	port->queued_bytes -= size;
 
-	if (outsize == insize) {
+	if (size == insize) {
 		spa_log_trace(this->log, NAME " %p: return buffer %d on port %p %zd",
-			      this, b->outbuf->id, port, outsize);
+			      this, b->outbuf->id, port, size);
 		port->io->buffer_id = b->outbuf->id;
 		spa_list_remove(&b->link);
 		b->outstanding = true;
 		port->queued_offset = 0;
 	} else {
 		spa_log_trace(this->log, NAME " %p: keeping buffer %d on port %p %zd %zd",
-			      this, b->outbuf->id, port, port->queued_bytes, outsize);
+			      this, b->outbuf->id, port, port->queued_bytes, size);
+	}
+}
+
+static void
+write_level(struct buffer *b, const float *peak, const float *sum,
+	    uint32_t channels, uint32_t n_frames)
+{
+	struct spa_meta_audio_level *level = b->level;
+	uint32_t c;
+
+	level->n_channels = SPA_MIN(channels, b->level_channels);
+	for (c = 0; c < level->n_channels; c++) {
+		level->channels[c].peak = peak[c];
+		level->channels[c].rms = n_frames > 0 ? sqrtf(sum[c] / n_frames) : 0.0f;
+	}
+}
+
+/* mix n_bytes of the inputs into dst, the srcs of the unscaled inputs and
+ * the scaled_srcs of the scaled inputs point to the same offset as dst.
+ * Returns the number of inputs that were written to dst. */
+static int mix_block(struct impl *this, void *dst, const void *srcs[], int n_src,
+		     struct port **scaled_ports, const void *scaled_srcs[], int n_scaled,
+		     size_t n_bytes)
+{
+	int i, layer = 0;
+
+	if (this->mix) {
+		/* one pass over the output for all unscaled inputs */
+		if (n_src > 0 || n_scaled == 0) {
+			this->mix(dst, srcs, n_src, n_bytes);
+			layer++;
+		}
+	} else {
+		for (i = 0; i < n_src; i++) {
+			if (layer++ == 0)
+				this->copy(dst, srcs[i], n_bytes);
+			else
+				this->add(dst, srcs[i], n_bytes);
+		}
+	}
+	for (i = 0; i < n_scaled; i++) {
+		struct port *in_port = scaled_ports[i];
+
+		if (in_port->props.mute)
+			continue;
+
+		if (layer++ == 0)
+			this->copy_scale(dst, scaled_srcs[i], &in_port->scale, n_bytes);
+		else
+			this->add_scale(dst, scaled_srcs[i], &in_port->scale, n_bytes);
 	}
+	if (layer == 0)
+		memset(dst, 0, n_bytes);
+
+	return layer;
 }
 
 static int mix_output(struct impl *this, size_t n_bytes)
 {
 	struct buffer *outbuf;
-	int i, layer;
+	int i, n_src, layer;
+	uint32_t p;
 	struct port *outport;
 	struct spa_port_io *outio;
 	struct spa_data *od;
+	struct port *src_ports[MAX_PORTS], *scaled_ports[MAX_PORTS];
+	const void *src_datas[MAX_PORTS], *scaled_datas[MAX_PORTS];
+	const void *srcs[MAX_PORTS], *scaled_srcs[MAX_PORTS];
+	int n_scaled;
+	uint32_t channels = this->format.info.raw.channels;
+	float peak[MAX_CHANNELS], sum[MAX_CHANNELS];
+	uint32_t n_frames, frame_size;
+	size_t offset, block, len;
+	bool do_level;
 
 	outport = GET_OUT_PORT(this, 0);
 	outio = outport->io;
@@ -682,15 +969,16 @@ static int mix_output(struct impl *this, size_t n_bytes)
 	outbuf->outstanding = true;
 
 	od = outbuf->outbuf->datas;
-	n_bytes = SPA_MIN(n_bytes, od[0].maxsize);
-	od[0].chunk->offset = 0;
-	od[0].chunk->size = n_bytes;
-	od[0].chunk->stride = 0;
-
-	spa_log_trace(this->log, NAME " %p: dequeue output buffer %d %zd",
-		      this, outbuf->outbuf->id, n_bytes);
-	for (layer = 0, i = 0; i < this->last_port; i++) {
+	for (p = 0; p < this->n_planes; p++)
+		n_bytes = SPA_MIN(n_bytes, od[p].maxsize);
+
+	/* collect the inputs, all of them contribute the same amount of
+	 * bytes so that the output is complete. Inputs with a volume of 1.0
+	 * go in the single pass mix, the others are scaled and muted inputs
+	 * are skipped. */
+	for (n_src = 0, n_scaled = 0, i = 0; i < this->last_port; i++) {
 		struct port *in_port = GET_IN_PORT(this, i);
+		size_t insize;
 
 		if (in_port->io == NULL || in_port->n_buffers == 0)
 			continue;
@@ -701,8 +989,86 @@ static int mix_output(struct impl *this, size_t n_bytes)
 			in_port->queued_offset = 0;
 			continue;
 		}
-		add_port_data(this, od[0].data, n_bytes, in_port, layer++);
+		if (in_port->props.mute || in_port->scale != 1.0f)
+			scaled_ports[n_scaled++] = in_port;
+		else
+			src_ports[n_src++] = in_port;
+
+		for (p = 0; p < this->n_planes; p++) {
+			get_port_data(this, in_port, p, &insize);
+			n_bytes = SPA_MIN(n_bytes, insize);
+		}
+	}
+
+	spa_log_trace(this->log, NAME " %p: dequeue output buffer %d %zd %d %d",
+		      this, outbuf->outbuf->id, n_bytes, n_src, n_scaled);
+
+	/* all planes hold one channel when planar */
+	frame_size = this->sample_size * (this->n_planes == 1 ? channels : 1);
+	n_frames = n_bytes / frame_size;
+
+	do_level = outbuf->level != NULL && this->level && channels <= MAX_CHANNELS;
+	if (do_level) {
+		memset(peak, 0, channels * sizeof(float));
+		memset(sum, 0, channels * sizeof(float));
+	}
+	/* with a level, the output is mixed and measured one block at a time */
+	block = do_level ? LEVEL_BLOCK_FRAMES * frame_size : n_bytes;
+
+	/* planar buffers have one plane per channel, each plane is mixed
+	 * separately with the same kernels as interleaved data */
+	for (p = 0; p < this->n_planes; p++) {
+		void *dst = od[p].data;
+		size_t insize;
+
+		od[p].chunk->offset = 0;
+		od[p].chunk->size = n_bytes;
+		od[p].chunk->stride = 0;
+
+		for (i = 0; i < n_src; i++)
+			src_datas[i] = get_port_data(this, src_ports[i], p, &insize);
+		for (i = 0; i < n_scaled; i++)
+			scaled_datas[i] = get_port_data(this, scaled_ports[i], p, &insize);
+
+		for (offset = 0; offset < n_bytes; offset += len) {
+			void *d = SPA_MEMBER(dst, offset, void);
+
+			len = SPA_MIN(block, n_bytes - offset);
+
+			for (i = 0; i < n_src; i++)
+				srcs[i] = SPA_MEMBER(src_datas[i], offset, void);
+			for (i = 0; i < n_scaled; i++)
+				scaled_srcs[i] = SPA_MEMBER(scaled_datas[i], offset, void);
+
+			layer = mix_block(this, d, srcs, n_src,
+					  scaled_ports, scaled_srcs, n_scaled, len);
+
+			if (layer > 0 && this->props.scrub && this->scrub) {
+				/* a misbehaving client must not poison the whole mix */
+				uint32_t bad = this->scrub(d, len);
+				if (SPA_UNLIKELY(bad > 0)) {
+					spa_log_trace(this->log, NAME " %p: removed %u bad samples",
+						      this, bad);
+					this->bad_samples += bad;
+				}
+			}
+			/* measure while the block is still in the cache */
+			if (do_level) {
+				if (this->n_planes == 1)
+					this->level(peak, sum, d, channels, len / frame_size);
+				else
+					this->level(&peak[p], &sum[p], d, 1, len / frame_size);
+			}
+		}
 	}
+	if (do_level)
+		write_level(outbuf, peak, sum, channels, n_frames);
+
+	for (i = 0; i < n_src; i++)
+		consume_port_data(this, src_ports[i], n_bytes);
+	for (i = 0; i < n_scaled; i++)
+		consume_port_data(this, scaled_ports[i], n_bytes);
+
 	outio->buffer_id = outbuf->outbuf->id;
 	outio->status = SPA_RESULT_HAVE_BUFFER;
 
@@ -913,7 +1279,8 @@ impl_init(const struct spa_handle_factory *factory,
 	    SPA_PORT_INFO_FLAG_NO_REF;
 	spa_list_init(&port->queue);
 
-	spa_audiomixer_get_ops(&this->ops);
+	spa_audiomixer_get_ops(&this->ops, spa_cpu_get_flags());
+	props_reset(&this->props);
 
 	return SPA_RESULT_OK;
 }
@@ -34,6 +34,9 @@
 #include <spa/format-builder.h>
 #include <lib/format.h>
 #include <lib/props.h>
+#include <lib/cpu.h>
+
+#include "osc.h"
 
 #define NAME "audiotestsrc"
 
@@ -52,6 +55,8 @@ struct type {
 	uint32_t prop_volume;
 	uint32_t wave_sine;
 	uint32_t wave_square;
+	uint32_t wave_white_noise;
+	uint32_t wave_pink_noise;
 	struct spa_type_meta meta;
 	struct spa_type_data data;
 	struct spa_type_media_type media_type;
@@ -76,6 +81,8 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
 	type->wave_sine = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":sine");
 	type->wave_square = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":square");
+	type->wave_white_noise = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":white-noise");
+	type->wave_pink_noise = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":pink-noise");
 	spa_type_meta_map(map, &type->meta);
 	spa_type_data_map(map, &type->data);
 	spa_type_media_type_map(map, &type->media_type);
@@ -97,6 +104,7 @@ struct props {
 
 #define MAX_BUFFERS 16
 #define MAX_PORTS 1
+#define RENDER_BLOCK 256
 
 struct buffer {
 	struct spa_buffer *outbuf;
@@ -139,6 +147,10 @@ struct impl {
 	size_t bpf;
 	render_func_t render_func;
 	double accumulator;
+	osc_sine_func_t osc_sine;
+	uint32_t noise_state;
+	float pink[OSC_PINK_STATES];
+	float wave[RENDER_BLOCK];
 
 	struct buffer buffers[MAX_BUFFERS];
 	uint32_t n_buffers;
@@ -195,10 +207,12 @@ static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 	spa_pod_builder_props(&b, &f[0], this->type.props,
 		PROP(&f[1], this->type.prop_live, SPA_POD_TYPE_BOOL,
 			this->props.live),
-		PROP_EN(&f[1], this->type.prop_wave, SPA_POD_TYPE_ID, 3,
+		PROP_EN(&f[1], this->type.prop_wave, SPA_POD_TYPE_ID, 5,
 			this->props.wave,
 			this->type.wave_sine,
-			this->type.wave_square),
+			this->type.wave_square,
+			this->type.wave_white_noise,
+			this->type.wave_pink_noise),
 		PROP_MM(&f[1], this->type.prop_freq, SPA_POD_TYPE_DOUBLE,
 			this->props.freq,
 			0.0, 50000000.0),
@@ -591,7 +605,8 @@ impl_node_port_set_format(struct spa_node *node,
 		this->bpf = sizes[idx] * info.info.raw.channels;
 		this->current_format = info;
 		this->have_format = true;
-		this->render_func = sine_funcs[idx];
+		this->render_func = render_funcs[idx];
+		memset(this->pink, 0, sizeof(this->pink));
 	}
 
 	if (this->have_format) {
@@ -1014,6 +1029,10 @@ impl_init(const struct spa_handle_factory *factory,
 	this->clock = impl_clock;
 	reset_props(this, &this->props);
 
+	this->osc_sine = osc_get_sine_func(spa_cpu_get_flags());
+	/* any seed but 0 will do */
+	this->noise_state = 22222;
+
 	spa_list_init(&this->empty);
 
 	this->timer_source.func = on_output;
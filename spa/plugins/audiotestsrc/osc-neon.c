@@ -0,0 +1,55 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <math.h>
+#include <arm_neon.h>
+
+#include "osc.h"
+
+/* 4 oscillators, one sample apart, that are rotated by 4 steps at a time */
+void osc_sine_neon(float *dst, double phase, double step, uint32_t n_samples)
+{
+	float32x4_t re, im, t;
+	float lre[4], lim[4], rc, rs;
+	uint32_t i;
+
+	if (n_samples < 8) {
+		osc_sine_c(dst, phase, step, n_samples);
+		return;
+	}
+
+	for (i = 0; i < 4; i++) {
+		lre[i] = cos(phase + i * step);
+		lim[i] = sin(phase + i * step);
+	}
+	re = vld1q_f32(lre);
+	im = vld1q_f32(lim);
+	rc = cos(4.0 * step);
+	rs = sin(4.0 * step);
+
+	for (i = 0; i + 4 <= n_samples; i += 4) {
+		vst1q_f32(&dst[i], im);
+		t = vmlsq_n_f32(vmulq_n_f32(re, rc), im, rs);
+		im = vmlaq_n_f32(vmulq_n_f32(re, rs), im, rc);
+		re = t;
+	}
+	if (i < n_samples)
+		osc_sine_c(&dst[i], phase + i * step, step, n_samples - i);
+}
@@ -0,0 +1,52 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <math.h>
+#include <emmintrin.h>
+
+#include "osc.h"
+
+/* 4 oscillators, one sample apart, that are rotated by 4 steps at a time */
+void osc_sine_sse2(float *dst, double phase, double step, uint32_t n_samples)
+{
+	__m128 re, im, rc, rs, t;
+	uint32_t i;
+
+	if (n_samples < 8) {
+		osc_sine_c(dst, phase, step, n_samples);
+		return;
+	}
+
+	re = _mm_setr_ps(cos(phase), cos(phase + step),
+			 cos(phase + 2.0 * step), cos(phase + 3.0 * step));
+	im = _mm_setr_ps(sin(phase), sin(phase + step),
+			 sin(phase + 2.0 * step), sin(phase + 3.0 * step));
+	rc = _mm_set1_ps(cos(4.0 * step));
+	rs = _mm_set1_ps(sin(4.0 * step));
+
+	for (i = 0; i + 4 <= n_samples; i += 4) {
+		_mm_storeu_ps(&dst[i], im);
+		t = _mm_sub_ps(_mm_mul_ps(re, rc), _mm_mul_ps(im, rs));
+		im = _mm_add_ps(_mm_mul_ps(re, rs), _mm_mul_ps(im, rc));
+		re = t;
+	}
+	if (i < n_samples)
+		osc_sine_c(&dst[i], phase + i * step, step, n_samples - i);
+}
@@ -0,0 +1,90 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <math.h>
+
+#include "osc.h"
+
+void osc_sine_c(float *dst, double phase, double step, uint32_t n_samples)
+{
+	float re = cos(phase), im = sin(phase), rc = cos(step), rs = sin(step), t;
+	uint32_t i;
+
+	for (i = 0; i < n_samples; i++) {
+		dst[i] = im;
+		t = re * rc - im * rs;
+		im = re * rs + im * rc;
+		re = t;
+	}
+}
+
+/* xorshift, good enough for test signals and a lot cheaper than rand() */
+static inline float white_noise(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return (int32_t) x * (1.0f / 2147483648.0f);
+}
+
+void osc_white_noise(float *dst, uint32_t *state, uint32_t n_samples)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_samples; i++)
+		dst[i] = white_noise(state);
+}
+
+/* Paul Kellet's refined filter */
+void osc_pink_noise(float *dst, uint32_t *state, float *b, uint32_t n_samples)
+{
+	float w, p;
+	uint32_t i;
+
+	for (i = 0; i < n_samples; i++) {
+		w = white_noise(state);
+		b[0] = 0.99886f * b[0] + w * 0.0555179f;
+		b[1] = 0.99332f * b[1] + w * 0.0750759f;
+		b[2] = 0.96900f * b[2] + w * 0.1538520f;
+		b[3] = 0.86650f * b[3] + w * 0.3104856f;
+		b[4] = 0.55000f * b[4] + w * 0.5329522f;
+		b[5] = -0.7616f * b[5] - w * 0.0168980f;
+		p = (b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] + w * 0.5362f) * 0.11f;
+		b[6] = w * 0.115926f;
+		dst[i] = SPA_CLAMP(p, -1.0f, 1.0f);
+	}
+}
+
+osc_sine_func_t osc_get_sine_func(uint32_t cpu_flags)
+{
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		return osc_sine_sse2;
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		return osc_sine_neon;
+#endif
+	return osc_sine_c;
+}
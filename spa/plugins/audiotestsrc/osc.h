@@ -0,0 +1,52 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <spa/defs.h>
+#include <lib/cpu.h>
+
+/* Fill dst with n_samples of sin(phase + i * step).
+ *
+ * Instead of calling sin() for every sample, a vector of (cos, sin) is
+ * rotated by step for each sample. The start of each call is computed
+ * exactly so the error does not accumulate over calls; callers should
+ * keep n_samples in the order of a few hundred. */
+typedef void (*osc_sine_func_t) (float *dst, double phase, double step, uint32_t n_samples);
+
+void osc_sine_c(float *dst, double phase, double step, uint32_t n_samples);
+#if defined (HAVE_SSE2)
+void osc_sine_sse2(float *dst, double phase, double step, uint32_t n_samples);
+#endif
+#if defined (HAVE_NEON)
+void osc_sine_neon(float *dst, double phase, double step, uint32_t n_samples);
+#endif
+
+/* the best implementation for the given SPA_CPU_FLAG_* mask */
+osc_sine_func_t osc_get_sine_func(uint32_t cpu_flags);
+
+/* Fill dst with n_samples of white noise in [-1, 1) from the xorshift
+ * generator in state, which must not be 0. */
+void osc_white_noise(float *dst, uint32_t *state, uint32_t n_samples);
+
+#define OSC_PINK_STATES	7
+
+/* Fill dst with n_samples of pink noise, the white noise of state filtered
+ * to -3dB per octave. b holds the OSC_PINK_STATES filter states and starts
+ * out as 0. */
+void osc_pink_noise(float *dst, uint32_t *state, float *b, uint32_t n_samples);
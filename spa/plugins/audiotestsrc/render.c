@@ -21,36 +21,91 @@
 
 #define M_PI_M2 ( M_PI + M_PI )
 
-#define DEFINE_SINE(type,scale)								\
+/* The waveform is generated as floats in blocks of RENDER_BLOCK samples and
+ * then scaled and copied to all channels in the output format. */
+
+static void wave_sine(struct impl *this, float *dst, size_t n_samples, double step)
+{
+	this->osc_sine(dst, this->accumulator, step, n_samples);
+
+	this->accumulator = fmod(this->accumulator + n_samples * step, M_PI_M2);
+}
+
+static void wave_square(struct impl *this, float *dst, size_t n_samples, double step)
+{
+	size_t i;
+
+	for (i = 0; i < n_samples; i++) {
+		this->accumulator += step;
+		if (this->accumulator >= M_PI_M2)
+			this->accumulator -= M_PI_M2;
+		dst[i] = this->accumulator < M_PI ? 1.0f : -1.0f;
+	}
+}
+
+static void wave_white_noise(struct impl *this, float *dst, size_t n_samples, double step)
+{
+	osc_white_noise(dst, &this->noise_state, n_samples);
+}
+
+static void wave_pink_noise(struct impl *this, float *dst, size_t n_samples, double step)
+{
+	osc_pink_noise(dst, &this->noise_state, this->pink, n_samples);
+}
+
+static void render_wave(struct impl *this, float *dst, size_t n_samples)
+{
+	double step = M_PI_M2 * this->props.freq / this->current_format.info.raw.rate;
+
+	if (this->props.wave == this->type.wave_square)
+		wave_square(this, dst, n_samples, step);
+	else if (this->props.wave == this->type.wave_white_noise)
+		wave_white_noise(this, dst, n_samples, step);
+	else if (this->props.wave == this->type.wave_pink_noise)
+		wave_pink_noise(this, dst, n_samples, step);
+	else
+		wave_sine(this, dst, n_samples, step);
+}
+
+#define DEFINE_RENDER(type,scale)							\
 static void										\
-audio_test_src_create_sine_##type (struct impl *this, type *samples, size_t n_samples)	\
+audio_test_src_render_##type (struct impl *this, type *samples, size_t n_samples)	\
 {											\
-	int i, c, channels;								\
-	double step, amp;								\
+	int c, channels;								\
+	size_t i, chunk;								\
+	float amp;									\
+	float *wave = this->wave;							\
 											\
 	channels = this->current_format.info.raw.channels;				\
-	step = M_PI_M2 * this->props.freq / this->current_format.info.raw.rate;		\
 	amp = this->props.volume * scale;						\
 											\
-	for (i = 0; i < n_samples; i++) {						\
-		type val;								\
-		this->accumulator += step;						\
-		if (this->accumulator >= M_PI_M2)					\
-			this->accumulator -= M_PI_M2;					\
-		val = (type) (sin (this->accumulator) * amp);				\
-		for (c = 0; c < channels; ++c)						\
-			*samples++ = val;						\
+	while (n_samples > 0) {								\
+		chunk = SPA_MIN(n_samples, RENDER_BLOCK);				\
+		render_wave(this, wave, chunk);						\
+											\
+		if (channels == 1) {							\
+			for (i = 0; i < chunk; i++)					\
+				samples[i] = (type) (wave[i] * amp);			\
+			samples += chunk;						\
+		} else {								\
+			for (i = 0; i < chunk; i++) {					\
+				type val = (type) (wave[i] * amp);			\
+				for (c = 0; c < channels; ++c)				\
+					*samples++ = val;				\
+			}								\
+		}									\
+		n_samples -= chunk;							\
 	}										\
 }
 
-DEFINE_SINE(int16_t, 32767.0);
-DEFINE_SINE(int32_t, 2147483647.0);
-DEFINE_SINE(float, 1.0);
-DEFINE_SINE(double, 1.0);
+DEFINE_RENDER(int16_t, 32767.0f);
+DEFINE_RENDER(int32_t, 2147483520.0f);
+DEFINE_RENDER(float, 1.0f);
+DEFINE_RENDER(double, 1.0f);
 
-static const render_func_t sine_funcs[] = {
-	(render_func_t) audio_test_src_create_sine_int16_t,
-	(render_func_t) audio_test_src_create_sine_int32_t,
-	(render_func_t) audio_test_src_create_sine_float,
-	(render_func_t) audio_test_src_create_sine_double
+static const render_func_t render_funcs[] = {
+	(render_func_t) audio_test_src_render_int16_t,
+	(render_func_t) audio_test_src_render_int32_t,
+	(render_func_t) audio_test_src_render_float,
+	(render_func_t) audio_test_src_render_double
 };
@@ -27,29 +27,81 @@
 #include <sys/timerfd.h>
 #include <sys/eventfd.h>
 #include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
 #include <pthread.h>
+#ifdef HAVE_IO_URING
+#include <poll.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+#endif
 
 #include <spa/loop.h>
 #include <spa/list.h>
 #include <spa/log.h>
 #include <spa/type-map.h>
-#include <spa/ringbuffer.h>
 
 #define NAME "loop"
 
 #define DATAS_SIZE (4096 * 8)
+#define SLAB_SOURCES	64
+#define MAX_SLABS	1024
+#define SOURCE_NONE	UINT32_MAX	/* the end of the free sources */
+#define SPIN_POLL	128	/* spin iterations between polls of the fds */
 
 /** \cond */
 
+/* completion of a blocking invoke, it lives on the stack of the caller */
+struct invoke_done {
+	uint32_t done;
+	int res;
+};
+
+/* items are placed in the queue by many threads, each item is committed
+ * when it is complete and the loop thread runs the committed items in
+ * order. An item with no func pads the end of the queue. */
 struct invoke_item {
-	size_t item_size;
+	uint32_t item_size;
+	uint32_t committed;
 	spa_invoke_func_t func;
 	uint32_t seq;
 	size_t size;
 	void *data;
-	bool block;
+	struct invoke_done *done;
 	void *user_data;
-	int res;
+};
+
+#define ITEM_ALIGN	8
+#define ITEM_SIZE(s)	SPA_ROUND_UP_N(sizeof(struct invoke_item) + (s), ITEM_ALIGN)
+
+/* all timers of the loop share one timerfd. They are kept in a hierarchical
+ * wheel with WHEEL_LEVELS levels of WHEEL_SIZE slots, the slots of level 0
+ * are one tick long and the slots of each next level are WHEEL_SIZE times
+ * longer. Timers move to lower levels as the wheel turns. */
+#define WHEEL_TICK_SHIFT	20		/* ~1ms ticks */
+#define WHEEL_BITS		6
+#define WHEEL_SIZE		(1 << WHEEL_BITS)
+#define WHEEL_MASK		(WHEEL_SIZE - 1)
+#define WHEEL_LEVELS		4		/* ~4.9 hours */
+#define WHEEL_RANGE		(1ull << (WHEEL_LEVELS * WHEEL_BITS))
+#define WHEEL_NEVER		UINT64_MAX
+
+#define TIMER_IDLE		0		/* not in the wheel */
+#define TIMER_EXPIRED		-1		/* waiting to be dispatched */
+
+struct timer_update {
+	uint64_t expire;
+	uint64_t interval;
+};
+
+struct timer_wheel {
+	struct spa_source *source;	/**< the timerfd of all timers */
+	uint64_t tick;			/**< the current tick */
+	uint64_t next;			/**< time the timerfd fires or WHEEL_NEVER */
+	uint64_t pending[WHEEL_LEVELS];	/**< the slots with timers */
+	struct spa_list slots[WHEEL_LEVELS][WHEEL_SIZE];
 };
 
 struct type {
@@ -77,25 +129,45 @@ struct impl {
         struct type type;
         struct spa_type_map *map;
 
-	struct spa_list source_list;
-	struct spa_list destroy_list;
 	struct spa_hook_list hooks_list;
 
+	pthread_mutex_t lock;		/**< protects the timer updates and new slabs */
+	struct source_slab *slabs[MAX_SLABS];
+	uint32_t n_slabs;
+	uint64_t free_head;		/**< tag << 32 | index of the first free source */
+	uint32_t n_free;		/**< free sources */
+	struct source_impl *destroyed;	/**< free after the current iteration */
+
 	int epoll_fd;
 	pthread_t thread;
+#ifdef HAVE_IO_URING
+	struct uring *uring;		/**< used instead of epoll when not NULL */
+#endif
 
 	struct spa_source *wakeup;
-	int ack_fd;
+	uint32_t wakeup_pending;
+
+	struct timer_wheel wheel;
+	struct spa_list timer_updates;	/**< timers changed by other threads */
+
+	uint32_t doorbell;		/**< changed after each signaled event */
+	uint32_t doorbell_seen;		/**< doorbell before the last wait */
+	uint64_t spin_max;		/**< max time to spin before waiting, in ns */
+	uint64_t spin;			/**< time to spin before the next wait */
 
-	struct spa_ringbuffer buffer;
-	uint8_t buffer_data[DATAS_SIZE];
+	uint32_t write_index;
+	uint32_t read_index;
+	uint8_t buffer_data[DATAS_SIZE] SPA_ALIGNED(ITEM_ALIGN);
 };
 
 struct source_impl {
 	struct spa_source source;
 
 	struct impl *impl;
-	struct spa_list link;
+	uint32_t index;			/**< index in the slabs */
+	bool used;
+	uint32_t next_free;		/**< index of the next free source */
+	struct source_impl *next_destroyed;
 
 	bool close;
 	union {
@@ -107,9 +179,147 @@ struct source_impl {
 	} func;
 	int signal_number;
 	bool enabled;
+
+	struct spa_list timer_link;
+	int timer_slot;			/**< 1 + slot in the wheel or TIMER_* */
+	uint64_t expire;		/**< when the timer fires, in ns */
+	uint64_t interval;		/**< the period of the timer in ns or 0 */
+	struct spa_list update_link;	/**< in timer_updates when queued */
+	bool update_queued;
+	bool destroyed;
+	struct timer_update update;	/**< queued by another thread */
 };
 /** \endcond */
 
+static void process_timer_updates(struct impl *impl);
+
+static inline bool loop_in_thread(struct impl *impl)
+{
+	return impl->thread == 0 || pthread_equal(impl->thread, pthread_self());
+}
+
+/* sources are allocated in slabs that are only freed with the loop. The free
+ * sources are a stack of indexes, the tag in the head makes a pop fail when
+ * the head was popped and pushed again since it was read. Destroyed sources
+ * are pushed on a list that the loop moves to the free sources after the
+ * iteration, all at once. The other threads add slabs, the loop thread
+ * only takes the lock and allocates memory when it used up all sources. */
+struct source_slab {
+	struct source_impl sources[SLAB_SOURCES];
+};
+
+static inline struct source_impl *source_at(struct impl *impl, uint32_t index)
+{
+	return &impl->slabs[index / SLAB_SOURCES]->sources[index % SLAB_SOURCES];
+}
+
+static void push_free(struct impl *impl, struct source_impl *source)
+{
+	uint64_t head = __atomic_load_n(&impl->free_head, __ATOMIC_RELAXED), next;
+
+	do {
+		__atomic_store_n(&source->next_free, (uint32_t) head, __ATOMIC_RELAXED);
+		next = (((head >> 32) + 1) << 32) | source->index;
+	} while (!__atomic_compare_exchange_n(&impl->free_head, &head, next, true,
+					      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	__atomic_add_fetch(&impl->n_free, 1, __ATOMIC_RELAXED);
+}
+
+static struct source_impl *pop_free(struct impl *impl)
+{
+	uint64_t head = __atomic_load_n(&impl->free_head, __ATOMIC_ACQUIRE), next;
+	struct source_impl *source;
+
+	do {
+		if ((uint32_t) head == SOURCE_NONE)
+			return NULL;
+		source = source_at(impl, (uint32_t) head);
+		next = (((head >> 32) + 1) << 32) |
+			__atomic_load_n(&source->next_free, __ATOMIC_RELAXED);
+	} while (!__atomic_compare_exchange_n(&impl->free_head, &head, next, true,
+					      __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+	__atomic_sub_fetch(&impl->n_free, 1, __ATOMIC_RELAXED);
+
+	return source;
+}
+
+static int add_slab(struct impl *impl)
+{
+	struct source_slab *slab;
+	uint32_t i, n;
+
+	pthread_mutex_lock(&impl->lock);
+	n = impl->n_slabs;
+	if (n == MAX_SLABS || (slab = calloc(1, sizeof(struct source_slab))) == NULL) {
+		pthread_mutex_unlock(&impl->lock);
+		return SPA_RESULT_NO_MEMORY;
+	}
+	impl->slabs[n] = slab;
+	impl->n_slabs = n + 1;
+	pthread_mutex_unlock(&impl->lock);
+
+	for (i = 0; i < SLAB_SOURCES; i++) {
+		slab->sources[i].index = n * SLAB_SOURCES + i;
+		push_free(impl, &slab->sources[i]);
+	}
+	return SPA_RESULT_OK;
+}
+
+static struct source_impl *alloc_source(struct impl *impl)
+{
+	struct source_impl *source;
+	uint32_t index;
+
+	/* other threads keep free sources for the loop thread */
+	if (!loop_in_thread(impl) &&
+	    __atomic_load_n(&impl->n_free, __ATOMIC_RELAXED) < SLAB_SOURCES / 2)
+		add_slab(impl);
+
+	while ((source = pop_free(impl)) == NULL) {
+		if (add_slab(impl) < 0)
+			return NULL;
+	}
+	index = source->index;
+	memset(source, 0, sizeof(struct source_impl));
+	source->index = index;
+	source->used = true;
+
+	return source;
+}
+
+/* for a source that was never added to the loop */
+static void free_source(struct impl *impl, struct source_impl *source)
+{
+	source->used = false;
+	push_free(impl, source);
+}
+
+static void unlink_source(struct impl *impl, struct source_impl *source)
+{
+	struct source_impl *head = __atomic_load_n(&impl->destroyed, __ATOMIC_RELAXED);
+
+	source->used = false;
+	do {
+		source->next_destroyed = head;
+	} while (!__atomic_compare_exchange_n(&impl->destroyed, &head, source, true,
+					      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static void reclaim_sources(struct impl *impl)
+{
+	struct source_impl *source, *next;
+
+	/* a source destroyed while we look is reclaimed the next time */
+	if (__atomic_load_n(&impl->destroyed, __ATOMIC_RELAXED) == NULL)
+		return;
+
+	source = __atomic_exchange_n(&impl->destroyed, NULL, __ATOMIC_ACQUIRE);
+	for (; source; source = next) {
+		next = source->next_destroyed;
+		push_free(impl, source);
+	}
+}
+
 static inline uint32_t spa_io_to_epoll(enum spa_io mask)
 {
 	uint32_t events = 0;
@@ -142,12 +352,482 @@ static inline enum spa_io spa_epoll_to_io(uint32_t events)
 	return mask;
 }
 
-static int loop_add_source(struct spa_loop *loop, struct spa_source *source)
+static int
+loop_invoke(struct spa_loop *loop,
+	    spa_invoke_func_t func,
+	    uint32_t seq,
+	    size_t size,
+	    const void *data,
+	    bool block,
+	    void *user_data);
+
+#ifdef HAVE_IO_URING
+/* With io_uring all fds of the loop are watched with one submission per
+ * iteration. Event, timer and signal fds are read by the kernel, the other
+ * fds are polled. The operations are one-shot and are submitted again after
+ * the source was dispatched. The ring is only touched from the loop thread,
+ * other threads change their sources with an invoke. */
+#define URING_ENTRIES	256
+#define URING_CANCEL	((uint64_t) 0)
+#define URING_TIMEOUT	((uint64_t) 1)
+#define URING_BATCH	32
+
+/* io_uring state of a source, it is kept until the kernel completed the
+ * operation that is in flight */
+struct uring_source {
+	struct spa_list link;
+	struct spa_list unarmed_link;	/* on the unarmed list when unarmed */
+	bool unarmed;			/* no room in the ring to submit again */
+	struct spa_source *source;	/* NULL when the source was removed */
+	uint32_t read_size;		/* read the fd instead of polling it */
+	uint32_t inflight;		/* submitted and not completed */
+	int res;			/* result of the last completion */
+	uint64_t data[16];		/* the data that was read */
+};
+
+struct uring {
+	int fd;
+	uint32_t entries;
+	bool exported;			/* the fd is polled by someone else */
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	uint32_t *sq_head, *sq_tail, *sq_mask, *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	uint32_t tail;
+
+	void *cq_ring;
+	size_t cq_ring_size;
+	uint32_t *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	struct __kernel_timespec timeout;
+	struct spa_list sources;
+	struct spa_list unarmed;	/* submitted again with the next iteration */
+};
+
+static inline int uring_enter(struct uring *u, uint32_t to_submit,
+			      uint32_t min_complete, uint32_t flags)
 {
-	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
+	return syscall(__NR_io_uring_enter, u->fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static inline uint32_t uring_pending(struct uring *u)
+{
+	return u->tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+}
+
+static inline uint32_t uring_ready(struct uring *u)
+{
+	return __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE) - *u->cq_head;
+}
+
+static int uring_flush(struct uring *u)
+{
+	uint32_t pending;
+
+	while ((pending = uring_pending(u)) > 0) {
+		if (uring_enter(u, pending, 0, 0) < 0 && errno != EINTR)
+			return SPA_RESULT_ERRNO;
+	}
+	return SPA_RESULT_OK;
+}
+
+/* returns NULL with errno set when the ring is full and the kernel did not
+ * take the pending entries */
+static struct io_uring_sqe *uring_get_sqe(struct uring *u)
+{
+	struct io_uring_sqe *sqe;
+	uint32_t index;
+
+	if (uring_pending(u) >= u->entries &&
+	    uring_flush(u) != SPA_RESULT_OK)
+		return NULL;
+
+	index = u->tail & *u->sq_mask;
+	sqe = &u->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	u->sq_array[index] = index;
+
+	return sqe;
+}
+
+static inline void uring_queue_sqe(struct uring *u)
+{
+	__atomic_store_n(u->sq_tail, ++u->tail, __ATOMIC_RELEASE);
+	/* nobody else would submit it before the next iteration */
+	if (u->exported)
+		uring_flush(u);
+}
+
+static inline uint32_t spa_io_to_poll(enum spa_io mask)
+{
+	uint32_t events = POLLERR | POLLHUP;
+
+	if (mask & SPA_IO_IN)
+		events |= POLLIN;
+	if (mask & SPA_IO_OUT)
+		events |= POLLOUT;
+#if __BYTE_ORDER == __BIG_ENDIAN
+	events = (events << 16) | (events >> 16);
+#endif
+	return events;
+}
+
+static inline enum spa_io spa_poll_to_io(uint32_t events)
+{
+	enum spa_io mask = 0;
+
+	if (events & POLLIN)
+		mask |= SPA_IO_IN;
+	if (events & POLLOUT)
+		mask |= SPA_IO_OUT;
+	if (events & POLLHUP)
+		mask |= SPA_IO_HUP;
+	if (events & POLLERR)
+		mask |= SPA_IO_ERR;
+
+	return mask;
+}
+
+static int uring_arm(struct uring *u, struct uring_source *us)
+{
+	struct spa_source *source = us->source;
+	struct io_uring_sqe *sqe;
+
+	if ((sqe = uring_get_sqe(u)) == NULL)
+		return SPA_RESULT_ERRNO;
+
+	sqe->fd = source->fd;
+	sqe->user_data = (uintptr_t) us;
+	if (us->read_size > 0) {
+		sqe->opcode = IORING_OP_READ;
+		sqe->addr = (uintptr_t) us->data;
+		sqe->len = us->read_size;
+		sqe->off = -1;
+	} else {
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->poll32_events = spa_io_to_poll(source->mask);
+	}
+	us->inflight++;
+	uring_queue_sqe(u);
+
+	return SPA_RESULT_OK;
+}
+
+/* arms the source or keeps it for the next iteration when the ring is full */
+static void uring_rearm(struct uring *u, struct uring_source *us)
+{
+	if (uring_arm(u, us) == SPA_RESULT_OK)
+		return;
+	if (!us->unarmed) {
+		spa_list_insert(u->unarmed.prev, &us->unarmed_link);
+		us->unarmed = true;
+	}
+}
+
+/* when the ring is full, the operation is not cancelled and completes on
+ * its own */
+static int uring_cancel(struct uring *u, struct uring_source *us)
+{
+	struct io_uring_sqe *sqe;
+
+	if ((sqe = uring_get_sqe(u)) == NULL)
+		return SPA_RESULT_ERRNO;
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = (uintptr_t) us;
+	sqe->user_data = URING_CANCEL;
+	uring_queue_sqe(u);
+
+	return SPA_RESULT_OK;
+}
+
+static void uring_free_source(struct uring_source *us)
+{
+	if (us->unarmed)
+		spa_list_remove(&us->unarmed_link);
+	spa_list_remove(&us->link);
+	free(us);
+}
+
+static int uring_init(struct impl *impl)
+{
+	struct uring *u;
+	struct io_uring_params p;
+
+	if ((u = calloc(1, sizeof(struct uring))) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	spa_zero(p);
+	if ((u->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p)) < 0)
+		goto error;
+
+	/* reads on fds that are not ready must wait in the kernel */
+	if (!(p.features & IORING_FEAT_FAST_POLL)) {
+		errno = ENOTSUP;
+		goto error_close;
+	}
+
+	u->entries = p.sq_entries;
+	u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	u->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+	if (u->sq_ring == MAP_FAILED)
+		goto error_close;
+	u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+	if (u->cq_ring == MAP_FAILED)
+		goto error_sq;
+	u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+	if (u->sqes == MAP_FAILED)
+		goto error_cq;
+
+	u->sq_head = SPA_MEMBER(u->sq_ring, p.sq_off.head, uint32_t);
+	u->sq_tail = SPA_MEMBER(u->sq_ring, p.sq_off.tail, uint32_t);
+	u->sq_mask = SPA_MEMBER(u->sq_ring, p.sq_off.ring_mask, uint32_t);
+	u->sq_array = SPA_MEMBER(u->sq_ring, p.sq_off.array, uint32_t);
+	u->tail = *u->sq_tail;
+
+	u->cq_head = SPA_MEMBER(u->cq_ring, p.cq_off.head, uint32_t);
+	u->cq_tail = SPA_MEMBER(u->cq_ring, p.cq_off.tail, uint32_t);
+	u->cq_mask = SPA_MEMBER(u->cq_ring, p.cq_off.ring_mask, uint32_t);
+	u->cqes = SPA_MEMBER(u->cq_ring, p.cq_off.cqes, struct io_uring_cqe);
+
+	spa_list_init(&u->sources);
+	spa_list_init(&u->unarmed);
+	impl->uring = u;
+
+	spa_log_info(impl->log, NAME " %p: io_uring with %u entries", impl, u->entries);
+
+	return SPA_RESULT_OK;
+
+      error_cq:
+	munmap(u->cq_ring, u->cq_ring_size);
+      error_sq:
+	munmap(u->sq_ring, u->sq_ring_size);
+      error_close:
+	close(u->fd);
+      error:
+	spa_log_error(impl->log, NAME " %p: can't set up io_uring: %s", impl, strerror(errno));
+	free(u);
+	return SPA_RESULT_ERRNO;
+}
+
+static void uring_clear(struct impl *impl)
+{
+	struct uring *u = impl->uring;
+	struct uring_source *us, *t;
+
+	/* closing the ring cancels what is still in flight */
+	munmap(u->sqes, u->sqes_size);
+	munmap(u->cq_ring, u->cq_ring_size);
+	munmap(u->sq_ring, u->sq_ring_size);
+	close(u->fd);
+
+	spa_list_for_each_safe(us, t, &u->sources, link)
+		uring_free_source(us);
+	free(u);
+	impl->uring = NULL;
+}
+
+struct uring_op {
+	struct spa_source *source;
+	uint32_t read_size;
+};
+
+static int uring_add_source(struct impl *impl, struct spa_source *source, uint32_t read_size)
+{
+	struct uring_source *us;
+	int res;
+
+	if ((us = calloc(1, sizeof(struct uring_source))) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	us->source = source;
+	us->read_size = read_size;
+	spa_list_insert(impl->uring->sources.prev, &us->link);
+	source->priv = us;
+
+	if ((res = uring_arm(impl->uring, us)) != SPA_RESULT_OK) {
+		spa_log_error(impl->log, NAME " %p: can't submit fd %d: %s",
+			      impl, source->fd, strerror(errno));
+		source->priv = NULL;
+		uring_free_source(us);
+	}
+	return res;
+}
+
+static void uring_update_source(struct impl *impl, struct spa_source *source)
+{
+	struct uring_source *us = source->priv;
 
-	source->loop = loop;
+	/* the poll is submitted again with the new mask when it completes */
+	if (us && us->read_size == 0 && us->inflight > 0 &&
+	    uring_cancel(impl->uring, us) != SPA_RESULT_OK)
+		spa_log_warn(impl->log, NAME " %p: can't cancel the poll of fd %d: %s",
+			     impl, source->fd, strerror(errno));
+}
+
+static void uring_remove_source(struct impl *impl, struct spa_source *source)
+{
+	struct uring_source *us = source->priv;
+
+	if (us == NULL)
+		return;
+
+	us->source = NULL;
+	source->priv = NULL;
+	/* freed when the operation completed, or now when it was not
+	 * submitted again */
+	if (us->unarmed)
+		uring_free_source(us);
+	else if (us->inflight > 0 && uring_cancel(impl->uring, us) != SPA_RESULT_OK)
+		spa_log_warn(impl->log, NAME " %p: can't cancel fd %d: %s",
+			     impl, source->fd, strerror(errno));
+}
+
+static int do_uring_op(struct spa_loop *loop, bool async, uint32_t seq,
+		       size_t size, const void *data, void *user_data)
+{
+	struct impl *impl = user_data;
+	const struct uring_op *op = data;
+
+	switch (seq) {
+	case 0:
+		return uring_add_source(impl, op->source, op->read_size);
+	case 1:
+		uring_update_source(impl, op->source);
+		break;
+	case 2:
+		uring_remove_source(impl, op->source);
+		break;
+	}
+	return SPA_RESULT_OK;
+}
+
+static int uring_op(struct impl *impl, uint32_t op, struct spa_source *source, uint32_t read_size)
+{
+	struct uring_op data = { source, read_size };
+
+	if (loop_in_thread(impl))
+		return do_uring_op(&impl->loop, false, op, sizeof(data), &data, impl);
+
+	return loop_invoke(&impl->loop, do_uring_op, op, sizeof(data), &data, true, impl);
+}
+
+static int uring_iterate(struct impl *impl, int timeout)
+{
+	struct uring *u = impl->uring;
+	struct uring_source *batch[URING_BATCH], *us, *t;
+	struct spa_source *s;
+	uint32_t head, tail, i, n_batch = 0, wait = 0, flags = 0;
+	int res = 0, save_errno = 0;
+
+	spa_list_for_each_safe(us, t, &u->unarmed, unarmed_link) {
+		if (uring_arm(u, us) != SPA_RESULT_OK)
+			break;
+		spa_list_remove(&us->unarmed_link);
+		us->unarmed = false;
+	}
+
+	if (timeout != 0 && uring_ready(u) == 0) {
+		struct io_uring_sqe *sqe = NULL;
+
+		/* without room for the timeout, only take the completions */
+		if (timeout < 0 || (sqe = uring_get_sqe(u)) != NULL) {
+			wait = 1;
+			flags = IORING_ENTER_GETEVENTS;
+		}
+		if (sqe) {
+			u->timeout.tv_sec = timeout / 1000;
+			u->timeout.tv_nsec = (timeout % 1000) * SPA_NSEC_PER_MSEC;
+			sqe->opcode = IORING_OP_TIMEOUT;
+			sqe->addr = (uintptr_t) &u->timeout;
+			sqe->len = 1;
+			/* also completes with the first other completion */
+			sqe->off = 1;
+			sqe->user_data = URING_TIMEOUT;
+			__atomic_store_n(u->sq_tail, ++u->tail, __ATOMIC_RELEASE);
+		}
+	}
+
+	spa_hook_list_call(&impl->hooks_list, struct spa_loop_control_hooks, before);
+
+	if (wait || uring_pending(u) > 0) {
+		if (SPA_UNLIKELY((res = uring_enter(u, uring_pending(u), wait, flags)) < 0))
+			save_errno = errno;
+	}
+
+	spa_hook_list_call(&impl->hooks_list, struct spa_loop_control_hooks, after);
 
+	if (SPA_UNLIKELY(res < 0)) {
+		errno = save_errno;
+		return SPA_RESULT_ERRNO;
+	}
+
+	/* first we set all the rmasks, then call the callbacks, like with epoll */
+	head = *u->cq_head;
+	tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail && n_batch < URING_BATCH; head++) {
+		struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+
+		if (cqe->user_data == URING_CANCEL || cqe->user_data == URING_TIMEOUT)
+			continue;
+
+		us = (struct uring_source *) (uintptr_t) cqe->user_data;
+		us->inflight--;
+		us->res = cqe->res;
+		if ((s = us->source) == NULL) {
+			if (us->inflight == 0)
+				uring_free_source(us);
+			continue;
+		}
+		if (us->res == -ECANCELED)
+			s->rmask = 0;
+		else if (us->read_size > 0)
+			s->rmask = SPA_IO_IN;
+		else if (us->res < 0)
+			s->rmask = SPA_IO_ERR;
+		else
+			s->rmask = spa_poll_to_io(us->res);
+
+		batch[n_batch++] = us;
+	}
+	__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+	for (i = 0; i < n_batch; i++) {
+		if ((s = batch[i]->source) && s->rmask && s->fd != -1)
+			s->func(s);
+	}
+	/* submitted with the next iteration */
+	for (i = 0; i < n_batch; i++) {
+		us = batch[i];
+		if (us->inflight > 0)
+			continue;
+		if (us->source == NULL)
+			uring_free_source(us);
+		else
+			uring_rearm(u, us);
+	}
+	return SPA_RESULT_OK;
+}
+#endif
+
+/* sources with a read_size are read by the loop when it can do that */
+static int add_source(struct impl *impl, struct spa_source *source, uint32_t read_size)
+{
+	source->loop = &impl->loop;
+
+#ifdef HAVE_IO_URING
+	if (impl->uring)
+		return source->fd != -1 ? uring_op(impl, 0, source, read_size) : SPA_RESULT_OK;
+#endif
 	if (source->fd != -1) {
 		struct epoll_event ep;
 
@@ -161,11 +841,22 @@ static int loop_add_source(struct spa_loop *loop, struct spa_source *source)
 	return SPA_RESULT_OK;
 }
 
+static int loop_add_source(struct spa_loop *loop, struct spa_source *source)
+{
+	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
+
+	return add_source(impl, source, 0);
+}
+
 static int loop_update_source(struct spa_source *source)
 {
 	struct spa_loop *loop = source->loop;
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 
+#ifdef HAVE_IO_URING
+	if (impl->uring)
+		return source->fd != -1 ? uring_op(impl, 1, source, 0) : SPA_RESULT_OK;
+#endif
 	if (source->fd != -1) {
 		struct epoll_event ep;
 
@@ -184,12 +875,73 @@ static void loop_remove_source(struct spa_source *source)
 	struct spa_loop *loop = source->loop;
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 
+#ifdef HAVE_IO_URING
+	if (impl->uring) {
+		if (source->fd != -1)
+			uring_op(impl, 2, source, 0);
+	} else
+#endif
 	if (source->fd != -1)
 		epoll_ctl(impl->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
 
 	source->loop = NULL;
 }
 
+static inline void futex_wait(uint32_t *uaddr, uint32_t val)
+{
+	syscall(SYS_futex, uaddr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static inline void futex_wake(uint32_t *uaddr)
+{
+	syscall(SYS_futex, uaddr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/* reserve space for an item of size bytes, the tail of the queue is skipped
+ * when the item does not fit in it */
+static struct invoke_item *reserve_item(struct impl *impl, size_t size)
+{
+	uint32_t idx, offset, l0, total, need = ITEM_SIZE(size);
+	int32_t filled;
+	struct invoke_item *item;
+
+	if (need > DATAS_SIZE)
+		return NULL;
+
+	idx = __atomic_load_n(&impl->write_index, __ATOMIC_RELAXED);
+	do {
+		offset = idx & (DATAS_SIZE - 1);
+		l0 = DATAS_SIZE - offset;
+		total = l0 < need ? l0 + need : need;
+
+		filled = idx - __atomic_load_n(&impl->read_index, __ATOMIC_ACQUIRE);
+		if (filled < 0 || filled > DATAS_SIZE || (uint32_t) (DATAS_SIZE - filled) < total)
+			return NULL;
+	} while (!__atomic_compare_exchange_n(&impl->write_index, &idx, idx + total, true,
+					      __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	if (total != need) {
+		if (l0 >= sizeof(struct invoke_item)) {
+			item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
+			item->item_size = l0;
+			item->func = NULL;
+			__atomic_store_n(&item->committed, 1, __ATOMIC_SEQ_CST);
+		}
+		offset = 0;
+	}
+	item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
+	item->item_size = need;
+
+	return item;
+}
+
+/* only the first change since the loop woke up signals it */
+static void wakeup_loop(struct impl *impl)
+{
+	if (!__atomic_exchange_n(&impl->wakeup_pending, 1, __ATOMIC_SEQ_CST))
+		spa_loop_utils_signal_event(&impl->utils, impl->wakeup);
+}
+
 static int
 loop_invoke(struct spa_loop *loop,
 	    spa_invoke_func_t func,
@@ -202,56 +954,32 @@ loop_invoke(struct spa_loop *loop,
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 	bool in_thread = pthread_equal(impl->thread, pthread_self());
 	struct invoke_item *item;
+	struct invoke_done done = { 0, SPA_RESULT_OK };
 	int res;
 
 	if (in_thread) {
 		res = func(loop, false, seq, size, data, user_data);
 	} else {
-		int32_t filled, avail;
-		uint32_t idx, offset, l0;
-		uint64_t count = 1;
-
-		filled = spa_ringbuffer_get_write_index(&impl->buffer, &idx);
-		if (filled < 0 || filled > impl->buffer.size) {
-			spa_log_warn(impl->log, NAME " %p: queue xrun %d", impl, filled);
+		if ((item = reserve_item(impl, size)) == NULL) {
+			spa_log_warn(impl->log, NAME " %p: queue full for %zd bytes", impl, size);
 			return SPA_RESULT_ERROR;
 		}
-		avail = impl->buffer.size - filled;
-		if (avail < sizeof(struct invoke_item)) {
-			spa_log_warn(impl->log, NAME " %p: queue full %d", impl, avail);
-			return SPA_RESULT_ERROR;
-		}
-		offset = idx & impl->buffer.mask;
-
-		l0 = impl->buffer.size - offset;
-
-		item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
 		item->func = func;
 		item->seq = seq;
 		item->size = size;
-		item->block = block;
+		item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
+		item->done = block ? &done : NULL;
 		item->user_data = user_data;
-
-		if (l0 > sizeof(struct invoke_item) + size) {
-			item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
-			item->item_size = sizeof(struct invoke_item) + size;
-			if (l0 < sizeof(struct invoke_item) + item->item_size)
-				item->item_size = l0;
-		} else {
-			item->data = impl->buffer_data;
-			item->item_size = l0 + size;
-		}
 		memcpy(item->data, data, size);
 
-		spa_ringbuffer_write_update(&impl->buffer, idx + item->item_size);
+		__atomic_store_n(&item->committed, 1, __ATOMIC_SEQ_CST);
 
-		spa_loop_utils_signal_event(&impl->utils, impl->wakeup);
+		wakeup_loop(impl);
 
 		if (block) {
-			if (read(impl->ack_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
-				spa_log_warn(impl->log, NAME " %p: failed to read event fd: %s",
-						impl, strerror(errno));
-			res = item->res;
+			while (__atomic_load_n(&done.done, __ATOMIC_ACQUIRE) == 0)
+				futex_wait(&done.done, 0);
+			res = done.res;
 		}
 		else {
 			if (seq != SPA_ID_INVALID)
@@ -266,21 +994,44 @@ loop_invoke(struct spa_loop *loop,
 static void wakeup_func(struct spa_loop_utils *utils, struct spa_source *source, uint64_t count, void *data)
 {
 	struct impl *impl = data;
-	uint32_t index;
+	uint32_t index, offset;
+
+	__atomic_store_n(&impl->wakeup_pending, 0, __ATOMIC_SEQ_CST);
+
+	process_timer_updates(impl);
+
+	index = impl->read_index;
+	while (index != __atomic_load_n(&impl->write_index, __ATOMIC_ACQUIRE)) {
+		struct invoke_item *item;
+		struct invoke_done *done;
+		int res;
+
+		offset = index & (DATAS_SIZE - 1);
+		if (DATAS_SIZE - offset < sizeof(struct invoke_item)) {
+			index += DATAS_SIZE - offset;
+			continue;
+		}
+		item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
 
-	while (spa_ringbuffer_get_read_index(&impl->buffer, &index) > 0) {
-		struct invoke_item *item =
-		    SPA_MEMBER(impl->buffer_data, index & impl->buffer.mask, struct invoke_item);
-		item->res = item->func(&impl->loop, true, item->seq, item->size, item->data,
-			   item->user_data);
-		spa_ringbuffer_read_update(&impl->buffer, index + item->item_size);
-
-		if (item->block) {
-			uint64_t count = 1;
-			if (write(impl->ack_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
-				spa_log_warn(impl->log, NAME " %p: failed to write event fd: %s",
-						impl, strerror(errno));
+		/* the rest is run when the item is committed, its writer wakes us */
+		if (__atomic_load_n(&item->committed, __ATOMIC_SEQ_CST) == 0)
+			break;
+
+		if (item->func) {
+			done = item->done;
+			res = item->func(&impl->loop, true, item->seq, item->size, item->data,
+					 item->user_data);
+			if (done) {
+				done->res = res;
+				__atomic_store_n(&done->done, 1, __ATOMIC_RELEASE);
+				futex_wake(&done->done);
+			}
 		}
+		/* free space is kept zeroed, any offset in it can become the
+		 * committed field of a new item */
+		index += item->item_size;
+		memset(item, 0, item->item_size);
+		__atomic_store_n(&impl->read_index, index, __ATOMIC_RELEASE);
 	}
 }
 
@@ -288,6 +1039,15 @@ static int loop_get_fd(struct spa_loop_control *ctrl)
 {
 	struct impl *impl = SPA_CONTAINER_OF(ctrl, struct impl, control);
 
+#ifdef HAVE_IO_URING
+	if (impl->uring) {
+		/* the fd is readable when there are completions, everything
+		 * must be submitted for that */
+		impl->uring->exported = true;
+		uring_flush(impl->uring);
+		return impl->uring->fd;
+	}
+#endif
 	return impl->epoll_fd;
 }
 
@@ -314,12 +1074,10 @@ static void loop_leave(struct spa_loop_control *ctrl)
 	impl->thread = 0;
 }
 
-static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
+static int epoll_iterate(struct impl *impl, int timeout)
 {
-	struct impl *impl = SPA_CONTAINER_OF(ctrl, struct impl, control);
 	struct epoll_event ep[32];
 	int i, nfds, save_errno = 0;
-	struct source_impl *source, *tmp;
 
 	spa_hook_list_call(&impl->hooks_list, struct spa_loop_control_hooks, before);
 
@@ -346,12 +1104,95 @@ static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
 			s->func(s);
 		}
 	}
-	spa_list_for_each_safe(source, tmp, &impl->destroy_list, link)
-	    free(source);
+	return SPA_RESULT_OK;
+}
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * SPA_NSEC_PER_SEC + ts.tv_nsec;
+}
 
-	spa_list_init(&impl->destroy_list);
+static inline void cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
 
-	return SPA_RESULT_OK;
+static bool check_hooks(struct impl *impl)
+{
+	struct spa_hook *h;
+
+	spa_list_for_each(h, &impl->hooks_list.list, link) {
+		const struct spa_loop_control_hooks *hooks = h->funcs;
+		if (hooks->version >= 1 && hooks->check && hooks->check(h->data))
+			return true;
+	}
+	return false;
+}
+
+/* check without waiting if one of the fds of the sources is ready, the
+ * events stay for the wait that follows */
+static bool fds_ready(struct impl *impl)
+{
+	struct epoll_event ep;
+
+#ifdef HAVE_IO_URING
+	if (impl->uring)
+		return uring_ready(impl->uring) > 0;
+#endif
+	return epoll_wait(impl->epoll_fd, &ep, 1, 0) > 0;
+}
+
+/* poll the doorbell and the check hooks for some time, the fds of the
+ * sources are polled every SPIN_POLL iterations. The doorbell is rung
+ * after the eventfd is written so when it changes, the wait that follows
+ * returns without sleeping. The spin time shrinks while nothing comes in
+ * and goes back to the max when something does. */
+static void loop_spin(struct impl *impl)
+{
+	uint64_t end = get_time_ns() + impl->spin;
+	uint32_t i;
+
+	for (i = 1;; i++) {
+		if (__atomic_load_n(&impl->doorbell, __ATOMIC_ACQUIRE) != impl->doorbell_seen ||
+		    check_hooks(impl) ||
+		    ((i % SPIN_POLL) == 0 && fds_ready(impl))) {
+			impl->spin = impl->spin_max;
+			break;
+		}
+		if ((i & 63) == 0 && get_time_ns() >= end) {
+			impl->spin = SPA_MAX(impl->spin / 2, impl->spin_max / 16);
+			break;
+		}
+		cpu_relax();
+	}
+}
+
+static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
+{
+	struct impl *impl = SPA_CONTAINER_OF(ctrl, struct impl, control);
+	int res;
+
+	if (impl->spin_max > 0 && timeout != 0)
+		loop_spin(impl);
+	impl->doorbell_seen = __atomic_load_n(&impl->doorbell, __ATOMIC_ACQUIRE);
+
+#ifdef HAVE_IO_URING
+	if (impl->uring)
+		res = uring_iterate(impl, timeout);
+	else
+#endif
+		res = epoll_iterate(impl, timeout);
+
+	/* nothing of this iteration uses the destroyed sources anymore */
+	reclaim_sources(impl);
+
+	return res;
 }
 
 static void source_io_func(struct spa_source *source)
@@ -368,7 +1209,7 @@ static struct spa_source *loop_add_io(struct spa_loop_utils *utils,
 	struct impl *impl = SPA_CONTAINER_OF(utils, struct impl, utils);
 	struct source_impl *source;
 
-	source = calloc(1, sizeof(struct source_impl));
+	source = alloc_source(impl);
 	if (source == NULL)
 		return NULL;
 
@@ -383,8 +1224,6 @@ static struct spa_source *loop_add_io(struct spa_loop_utils *utils,
 
 	spa_loop_add_source(&impl->loop, &source->source);
 
-	spa_list_insert(&impl->source_list, &source->link);
-
 	return &source->source;
 }
 
@@ -407,7 +1246,7 @@ static struct spa_source *loop_add_idle(struct spa_loop_utils *utils,
 	struct impl *impl = SPA_CONTAINER_OF(utils, struct impl, utils);
 	struct source_impl *source;
 
-	source = calloc(1, sizeof(struct source_impl));
+	source = alloc_source(impl);
 	if (source == NULL)
 		return NULL;
 
@@ -422,8 +1261,6 @@ static struct spa_source *loop_add_idle(struct spa_loop_utils *utils,
 
 	spa_loop_add_source(&impl->loop, &source->source);
 
-	spa_list_insert(&impl->source_list, &source->link);
-
 	if (enabled)
 		spa_loop_utils_enable_idle(&impl->utils, &source->source, true);
 
@@ -448,12 +1285,30 @@ static void loop_enable_idle(struct spa_source *source, bool enabled)
 	impl->enabled = enabled;
 }
 
+/* with io_uring the loop already read the data of the source */
+static ssize_t source_read(struct source_impl *impl, void *data, size_t size)
+{
+#ifdef HAVE_IO_URING
+	struct uring_source *us = impl->source.priv;
+
+	if (impl->impl->uring && us) {
+		if (us->res < 0) {
+			errno = -us->res;
+			return -1;
+		}
+		memcpy(data, us->data, SPA_MIN(size, (size_t) us->res));
+		return us->res;
+	}
+#endif
+	return read(impl->source.fd, data, size);
+}
+
 static void source_event_func(struct spa_source *source)
 {
 	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
 	uint64_t count;
 
-	if (read(source->fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+	if (source_read(impl, &count, sizeof(uint64_t)) != sizeof(uint64_t))
 		spa_log_warn(impl->impl->log, NAME " %p: failed to read event fd %d: %s",
 				source, source->fd, strerror(errno));
 
@@ -466,7 +1321,7 @@ static struct spa_source *loop_add_event(struct spa_loop_utils *utils,
 	struct impl *impl = SPA_CONTAINER_OF(utils, struct impl, utils);
 	struct source_impl *source;
 
-	source = calloc(1, sizeof(struct source_impl));
+	source = alloc_source(impl);
 	if (source == NULL)
 		return NULL;
 
@@ -479,9 +1334,7 @@ static struct spa_source *loop_add_event(struct spa_loop_utils *utils,
 	source->close = true;
 	source->func.event = func;
 
-	spa_loop_add_source(&impl->loop, &source->source);
-
-	spa_list_insert(&impl->source_list, &source->link);
+	add_source(impl, &source->source, sizeof(uint64_t));
 
 	return &source->source;
 }
@@ -494,17 +1347,234 @@ static void loop_signal_event(struct spa_source *source)
 	if (write(source->fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
 		spa_log_warn(impl->impl->log, NAME " %p: failed to write event fd %d: %s",
 				source, source->fd, strerror(errno));
+
+	__atomic_add_fetch(&impl->impl->doorbell, 1, __ATOMIC_RELEASE);
 }
 
-static void source_timer_func(struct spa_source *source)
+static inline uint64_t rotate_right(uint64_t bits, uint32_t n)
 {
-	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
-	uint64_t expires;
+	return (bits >> n) | (bits << ((64 - n) & 63));
+}
+
+/* the number of ticks from tick to the next slot of level with timers,
+ * pending must not be 0 */
+static inline uint32_t wheel_distance(uint64_t pending, uint64_t tick)
+{
+	return __builtin_ctzll(rotate_right(pending, tick & WHEEL_MASK));
+}
+
+static void wheel_insert(struct timer_wheel *w, struct source_impl *t)
+{
+	uint64_t e = SPA_MAX(t->expire >> WHEEL_TICK_SHIFT, w->tick), delta;
+	uint32_t level, index;
+
+	/* timers too far away wait in the last slot and are placed again
+	 * when they get there */
+	delta = e - w->tick;
+	if (delta >= WHEEL_RANGE)
+		e = w->tick + (delta = WHEEL_RANGE - 1);
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+		if (delta < 1ull << ((level + 1) * WHEEL_BITS))
+			break;
+	}
+	index = (e >> (level * WHEEL_BITS)) & WHEEL_MASK;
+
+	spa_list_insert(w->slots[level][index].prev, &t->timer_link);
+	w->pending[level] |= 1ull << index;
+	t->timer_slot = 1 + level * WHEEL_SIZE + index;
+}
+
+static void wheel_remove(struct timer_wheel *w, struct source_impl *t)
+{
+	spa_list_remove(&t->timer_link);
+	if (t->timer_slot > 0) {
+		uint32_t level = (t->timer_slot - 1) / WHEEL_SIZE;
+		uint32_t index = (t->timer_slot - 1) % WHEEL_SIZE;
+
+		if (spa_list_is_empty(&w->slots[level][index]))
+			w->pending[level] &= ~(1ull << index);
+	}
+	t->timer_slot = TIMER_IDLE;
+}
+
+/* move the timers of the slots that start at the current tick down */
+static void wheel_cascade(struct timer_wheel *w)
+{
+	struct source_impl *t, *tmp;
+	struct spa_list list;
+	uint32_t level, index;
+
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		index = (w->tick >> (level * WHEEL_BITS)) & WHEEL_MASK;
+
+		if (w->pending[level] & (1ull << index)) {
+			spa_list_init(&list);
+			spa_list_insert_list(&list, &w->slots[level][index]);
+			spa_list_init(&w->slots[level][index]);
+			w->pending[level] &= ~(1ull << index);
+
+			spa_list_for_each_safe(t, tmp, &list, timer_link)
+				wheel_insert(w, t);
+		}
+		if (index != 0)
+			break;
+	}
+}
+
+/* turn the wheel up to now and collect the timers that expired */
+static void wheel_advance(struct timer_wheel *w, uint64_t now, struct spa_list *expired)
+{
+	uint64_t now_tick = now >> WHEEL_TICK_SHIFT, next;
+	struct source_impl *t, *tmp;
+	uint32_t index;
+
+	while (true) {
+		index = w->tick & WHEEL_MASK;
+		spa_list_for_each_safe(t, tmp, &w->slots[0][index], timer_link) {
+			if (t->expire <= now) {
+				wheel_remove(w, t);
+				spa_list_insert(expired->prev, &t->timer_link);
+				t->timer_slot = TIMER_EXPIRED;
+			}
+		}
+		if (w->tick >= now_tick)
+			break;
+
+		/* skip the empty slots up to the next cascade */
+		next = (w->tick | WHEEL_MASK) + 1;
+		if (w->pending[0])
+			next = SPA_MIN(next, w->tick + 1 + wheel_distance(w->pending[0], w->tick + 1));
+		w->tick = SPA_MIN(next, now_tick);
+
+		if ((w->tick & WHEEL_MASK) == 0)
+			wheel_cascade(w);
+	}
+}
+
+/* the first time the wheel needs to turn, that is when a timer of level 0
+ * expires or when a slot of a higher level cascades */
+static uint64_t wheel_next(struct timer_wheel *w)
+{
+	struct source_impl *t;
+	uint64_t res = WHEEL_NEVER, block;
+	uint32_t level, shift, index;
+
+	if (w->pending[0]) {
+		index = (w->tick + wheel_distance(w->pending[0], w->tick)) & WHEEL_MASK;
+		spa_list_for_each(t, &w->slots[0][index], timer_link)
+			res = SPA_MIN(res, t->expire);
+	}
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		if (w->pending[level] == 0)
+			continue;
+		shift = level * WHEEL_BITS;
+		block = (w->tick >> shift) + 1;
+		block += wheel_distance(w->pending[level], block);
+		res = SPA_MIN(res, (block << shift) << WHEEL_TICK_SHIFT);
+	}
+	return res;
+}
+
+static void wheel_arm(struct impl *impl, uint64_t next)
+{
+	struct timer_wheel *w = &impl->wheel;
+	struct itimerspec its;
+
+	if (next == w->next)
+		return;
+
+	spa_zero(its);
+	if (next != WHEEL_NEVER) {
+		its.it_value.tv_sec = next / SPA_NSEC_PER_SEC;
+		its.it_value.tv_nsec = next % SPA_NSEC_PER_SEC;
+		/* 0 would disarm the timer */
+		if (next == 0)
+			its.it_value.tv_nsec = 1;
+	}
+	if (timerfd_settime(w->source->fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+		spa_log_warn(impl->log, NAME " %p: failed to set timer fd %d: %s",
+				impl, w->source->fd, strerror(errno));
+		return;
+	}
+	w->next = next;
+}
 
-	if (read(source->fd, &expires, sizeof(uint64_t)) != sizeof(uint64_t))
-		spa_log_warn(impl->impl->log, NAME " %p: failed to read timer fd %d: %s",
+static void source_wheel_func(struct spa_source *source)
+{
+	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
+	struct impl *loop_impl = impl->impl;
+	struct timer_wheel *w = &loop_impl->wheel;
+	struct spa_list expired;
+	struct source_impl *t;
+	uint64_t expires, now;
+
+	if (source_read(impl, &expires, sizeof(uint64_t)) != sizeof(uint64_t))
+		spa_log_warn(loop_impl->log, NAME " %p: failed to read timer fd %d: %s",
 				source, source->fd, strerror(errno));
+	w->next = WHEEL_NEVER;
+
+	now = get_time_ns();
+	spa_list_init(&expired);
+	wheel_advance(w, now, &expired);
+
+	/* the callbacks can update and destroy any timer */
+	while (!spa_list_is_empty(&expired)) {
+		t = spa_list_first(&expired, struct source_impl, timer_link);
+		spa_list_remove(&t->timer_link);
+		t->timer_slot = TIMER_IDLE;
+
+		/* destroyed in another thread, removed when the loop gets to it */
+		if (__atomic_load_n(&t->destroyed, __ATOMIC_ACQUIRE))
+			continue;
+
+		if (t->interval > 0) {
+			t->expire += ((now - t->expire) / t->interval + 1) * t->interval;
+			wheel_insert(w, t);
+		}
+		t->source.func(&t->source);
+	}
+	wheel_arm(loop_impl, wheel_next(w));
+}
+
+static int wheel_init(struct impl *impl)
+{
+	struct timer_wheel *w = &impl->wheel;
+	struct source_impl *source;
+	uint32_t i, j;
+
+	for (i = 0; i < WHEEL_LEVELS; i++) {
+		for (j = 0; j < WHEEL_SIZE; j++)
+			spa_list_init(&w->slots[i][j]);
+		w->pending[i] = 0;
+	}
+	w->tick = get_time_ns() >> WHEEL_TICK_SHIFT;
+	w->next = WHEEL_NEVER;
 
+	source = alloc_source(impl);
+	if (source == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	source->source.loop = &impl->loop;
+	source->source.func = source_wheel_func;
+	source->source.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	source->source.mask = SPA_IO_IN;
+	source->impl = impl;
+	source->close = true;
+
+	if (source->source.fd == -1) {
+		free_source(impl, source);
+		return SPA_RESULT_ERRNO;
+	}
+	add_source(impl, &source->source, sizeof(uint64_t));
+	w->source = &source->source;
+
+	return SPA_RESULT_OK;
+}
+
+static void source_timer_func(struct spa_source *source)
+{
+	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
 	impl->func.timer(&impl->impl->utils, source, source->data);
 }
 
@@ -514,48 +1584,145 @@ static struct spa_source *loop_add_timer(struct spa_loop_utils *utils,
 	struct impl *impl = SPA_CONTAINER_OF(utils, struct impl, utils);
 	struct source_impl *source;
 
-	source = calloc(1, sizeof(struct source_impl));
+	source = alloc_source(impl);
 	if (source == NULL)
 		return NULL;
 
+	/* dispatched by the timer wheel, without an fd of its own */
 	source->source.loop = &impl->loop;
 	source->source.func = source_timer_func;
 	source->source.data = data;
-	source->source.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-	source->source.mask = SPA_IO_IN;
+	source->source.fd = -1;
 	source->impl = impl;
-	source->close = true;
 	source->func.timer = func;
 
-	spa_loop_add_source(&impl->loop, &source->source);
+	return &source->source;
+}
 
-	spa_list_insert(&impl->source_list, &source->link);
+static void apply_timer_update(struct source_impl *source, const struct timer_update *update)
+{
+	struct impl *impl = source->impl;
 
-	return &source->source;
+	if (source->timer_slot != TIMER_IDLE)
+		wheel_remove(&impl->wheel, source);
+
+	source->expire = update->expire;
+	source->interval = update->interval;
+
+	if (update->expire != WHEEL_NEVER) {
+		wheel_insert(&impl->wheel, source);
+		if (source->expire < impl->wheel.next)
+			wheel_arm(impl, source->expire);
+	}
+}
+
+static void finish_timer(struct source_impl *source)
+{
+	if (source->timer_slot != TIMER_IDLE)
+		wheel_remove(&source->impl->wheel, source);
+	unlink_source(source->impl, source);
+}
+
+/* forget the change another thread queued, the loop thread knows better */
+static void drop_timer_update(struct impl *impl, struct source_impl *source)
+{
+	pthread_mutex_lock(&impl->lock);
+	if (source->update_queued) {
+		spa_list_remove(&source->update_link);
+		source->update_queued = false;
+	}
+	pthread_mutex_unlock(&impl->lock);
+}
+
+/* other threads change and destroy timers without waiting for the loop, the
+ * loop applies the last change of each timer when it wakes up */
+static void queue_timer_update(struct impl *impl, struct source_impl *source,
+			       const struct timer_update *update)
+{
+	pthread_mutex_lock(&impl->lock);
+	if (update)
+		source->update = *update;
+	else
+		__atomic_store_n(&source->destroyed, true, __ATOMIC_RELEASE);
+	if (!source->update_queued) {
+		spa_list_insert(impl->timer_updates.prev, &source->update_link);
+		source->update_queued = true;
+	}
+	pthread_mutex_unlock(&impl->lock);
+
+	wakeup_loop(impl);
+}
+
+static void process_timer_updates(struct impl *impl)
+{
+	struct source_impl *source;
+	struct timer_update update;
+	bool destroyed;
+
+	while (true) {
+		pthread_mutex_lock(&impl->lock);
+		if (spa_list_is_empty(&impl->timer_updates)) {
+			pthread_mutex_unlock(&impl->lock);
+			break;
+		}
+		source = spa_list_first(&impl->timer_updates, struct source_impl, update_link);
+		spa_list_remove(&source->update_link);
+		source->update_queued = false;
+		update = source->update;
+		destroyed = source->destroyed;
+		pthread_mutex_unlock(&impl->lock);
+
+		if (destroyed)
+			finish_timer(source);
+		else
+			apply_timer_update(source, &update);
+	}
+}
+
+static void destroy_timer(struct source_impl *source)
+{
+	struct impl *impl = source->impl;
+
+	if (loop_in_thread(impl)) {
+		drop_timer_update(impl, source);
+		__atomic_store_n(&source->destroyed, true, __ATOMIC_RELEASE);
+		finish_timer(source);
+	} else {
+		queue_timer_update(impl, source, NULL);
+	}
 }
 
 static int
 loop_update_timer(struct spa_source *source,
 		  struct timespec *value, struct timespec *interval, bool absolute)
 {
-	struct itimerspec its;
-	int flags = 0;
+	struct source_impl *s = SPA_CONTAINER_OF(source, struct source_impl, source);
+	struct impl *impl = s->impl;
+	struct timer_update update;
 
-	spa_zero(its);
+	/* with the same meaning as the values of timerfd_settime() */
 	if (value) {
-		its.it_value = *value;
+		update.expire = SPA_TIMESPEC_TO_TIME(value);
 	} else if (interval) {
-		its.it_value = *interval;
+		update.expire = SPA_TIMESPEC_TO_TIME(interval);
 		absolute = true;
+	} else {
+		update.expire = 0;
 	}
-	if (interval)
-		its.it_interval = *interval;
-	if (absolute)
-		flags |= TFD_TIMER_ABSTIME;
+	update.interval = interval ? SPA_TIMESPEC_TO_TIME(interval) : 0;
 
-	if (timerfd_settime(source->fd, flags, &its, NULL) < 0)
-		return SPA_RESULT_ERRNO;
+	if (update.expire == 0)
+		update.expire = WHEEL_NEVER;
+	else if (!absolute)
+		update.expire += get_time_ns();
 
+	/* the wheel belongs to the loop thread */
+	if (loop_in_thread(impl)) {
+		drop_timer_update(impl, s);
+		apply_timer_update(s, &update);
+	} else {
+		queue_timer_update(impl, s, &update);
+	}
 	return SPA_RESULT_OK;
 }
 
@@ -564,7 +1731,7 @@ static void source_signal_func(struct spa_source *source)
 	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
 	struct signalfd_siginfo signal_info;
 
-	if (read(source->fd, &signal_info, sizeof(signal_info)) != sizeof(signal_info))
+	if (source_read(impl, &signal_info, sizeof(signal_info)) != sizeof(signal_info))
 		spa_log_warn(impl->impl->log, NAME " %p: failed to read signal fd %d: %s",
 				source, source->fd, strerror(errno));
 
@@ -579,7 +1746,7 @@ static struct spa_source *loop_add_signal(struct spa_loop_utils *utils,
 	struct source_impl *source;
 	sigset_t mask;
 
-	source = calloc(1, sizeof(struct source_impl));
+	source = alloc_source(impl);
 	if (source == NULL)
 		return NULL;
 
@@ -596,9 +1763,7 @@ static struct spa_source *loop_add_signal(struct spa_loop_utils *utils,
 	source->func.signal = func;
 	source->signal_number = signal_number;
 
-	spa_loop_add_source(&impl->loop, &source->source);
-
-	spa_list_insert(&impl->source_list, &source->link);
+	add_source(impl, &source->source, sizeof(struct signalfd_siginfo));
 
 	return &source->source;
 }
@@ -608,7 +1773,11 @@ static void loop_destroy_source(struct spa_source *source)
 	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
 	struct impl *loop_impl = SPA_CONTAINER_OF(source->loop, struct impl, loop);
 
-	spa_list_remove(&impl->link);
+	if (source->func == source_timer_func) {
+		source->loop = NULL;
+		destroy_timer(impl);
+		return;
+	}
 
 	spa_loop_remove_source(source->loop, source);
 
@@ -617,7 +1786,7 @@ static void loop_destroy_source(struct spa_source *source)
 		source->fd = -1;
 	}
 
-	spa_list_insert(&loop_impl->destroy_list, &impl->link);
+	unlink_source(loop_impl, impl);
 }
 
 static const struct spa_loop impl_loop = {
@@ -675,23 +1844,35 @@ static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id,
 static int impl_clear(struct spa_handle *handle)
 {
 	struct impl *impl;
-	struct source_impl *source, *tmp;
+	uint32_t i, j;
 
 	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
 
 	impl = (struct impl *) handle;
 
-	spa_list_for_each_safe(source, tmp, &impl->source_list, link)
-	    loop_destroy_source(&source->source);
-	spa_list_for_each_safe(source, tmp, &impl->destroy_list, link)
-	    free(source);
-
-	close(impl->ack_fd);
+	for (i = 0; i < impl->n_slabs; i++) {
+		for (j = 0; j < SLAB_SOURCES; j++) {
+			if (impl->slabs[i]->sources[j].used)
+				loop_destroy_source(&impl->slabs[i]->sources[j].source);
+		}
+	}
+	for (i = 0; i < impl->n_slabs; i++)
+		free(impl->slabs[i]);
+	pthread_mutex_destroy(&impl->lock);
+
+#ifdef HAVE_IO_URING
+	if (impl->uring)
+		uring_clear(impl);
+#endif
 	close(impl->epoll_fd);
 
 	return SPA_RESULT_OK;
 }
 
+#ifdef HAVE_IO_URING
+static const struct spa_handle_factory loop_uring_factory;
+#endif
+
 static int
 impl_init(const struct spa_handle_factory *factory,
 	  struct spa_handle *handle,
@@ -700,7 +1881,9 @@ impl_init(const struct spa_handle_factory *factory,
 	  uint32_t n_support)
 {
 	struct impl *impl;
+	const char *str;
 	uint32_t i;
+	int res;
 
 	spa_return_val_if_fail(factory != NULL, SPA_RESULT_INVALID_ARGUMENTS);
 	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
@@ -729,14 +1912,44 @@ impl_init(const struct spa_handle_factory *factory,
 	if (impl->epoll_fd == -1)
 		return SPA_RESULT_ERRNO;
 
-	spa_list_init(&impl->source_list);
-	spa_list_init(&impl->destroy_list);
+#ifdef HAVE_IO_URING
+	if (factory == &loop_uring_factory) {
+		if ((res = uring_init(impl)) < 0) {
+			close(impl->epoll_fd);
+			return res;
+		}
+	}
+#endif
+
 	spa_hook_list_init(&impl->hooks_list);
 
-	spa_ringbuffer_init(&impl->buffer, DATAS_SIZE);
+	pthread_mutex_init(&impl->lock, NULL);
+	impl->n_slabs = 0;
+	impl->free_head = SOURCE_NONE;
+	impl->n_free = 0;
+	impl->destroyed = NULL;
+	spa_list_init(&impl->timer_updates);
+
+	if ((res = add_slab(impl)) < 0) {
+		impl_clear(handle);
+		return res;
+	}
+
+	impl->write_index = impl->read_index = 0;
+	memset(impl->buffer_data, 0, sizeof(impl->buffer_data));
 
 	impl->wakeup = spa_loop_utils_add_event(&impl->utils, wakeup_func, impl);
-	impl->ack_fd = eventfd(0, EFD_CLOEXEC);
+
+	if ((res = wheel_init(impl)) < 0) {
+		impl_clear(handle);
+		return res;
+	}
+
+	/* busy wait before blocking, only useful on a dedicated core */
+	if (info && (str = spa_dict_lookup(info, "loop.spin")) && atoi(str) > 0) {
+		impl->spin = impl->spin_max = atoi(str) * SPA_NSEC_PER_USEC;
+		spa_log_info(impl->log, NAME " %p: spin %dus before waiting", impl, atoi(str));
+	}
 
 	spa_log_info(impl->log, NAME " %p: initialized", impl);
 
@@ -773,8 +1986,23 @@ static const struct spa_handle_factory loop_factory = {
 	impl_enum_interface_info
 };
 
+#ifdef HAVE_IO_URING
+/* the same loop on io_uring, init fails when the kernel can't do it */
+static const struct spa_handle_factory loop_uring_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	NAME "-uring",
+	NULL,
+	sizeof(struct impl),
+	impl_init,
+	impl_enum_interface_info
+};
+#endif
+
 static void reg(void) __attribute__ ((constructor));
 static void reg(void)
 {
 	spa_handle_factory_register(&loop_factory);
+#ifdef HAVE_IO_URING
+	spa_handle_factory_register(&loop_uring_factory);
+#endif
 }
@@ -0,0 +1,152 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <immintrin.h>
+
+#include "volume-ops.h"
+
+/* Same as the SSE2 versions but on 256 bits registers, the results are
+ * identical to the C versions. */
+
+static inline __m256i
+scale_s16_avx2_8(__m128i in, __m256 v)
+{
+	return _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(in)), v));
+}
+
+static inline __m256i
+pack_s16_avx2(__m256i lo, __m256i hi)
+{
+	/* packs works per 128 bits lane, put the samples back in order */
+	return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+}
+
+static inline __m256i
+scale_s32_avx2_8(__m256i in, __m256 v)
+{
+	__m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(in), v);
+	t = _mm256_min_ps(_mm256_max_ps(t, _mm256_set1_ps(S32_MIN_F)), _mm256_set1_ps(S32_MAX_F));
+	return _mm256_cvttps_epi32(t);
+}
+
+static void
+scale_s16_avx2(void *dst, const void *src, float volume, int n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	__m256 vol = _mm256_set1_ps(volume);
+	__m256i lo, hi;
+	int n;
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		lo = scale_s16_avx2_8(_mm_loadu_si128((const __m128i *)(s + n)), vol);
+		hi = scale_s16_avx2_8(_mm_loadu_si128((const __m128i *)(s + n + 8)), vol);
+		_mm256_storeu_si256((__m256i *)(d + n), pack_s16_avx2(lo, hi));
+	}
+	scale_s16_c(d + n, s + n, volume, n_samples - n);
+}
+
+static void
+scale_s32_avx2(void *dst, const void *src, float volume, int n_samples)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	__m256 vol = _mm256_set1_ps(volume);
+	int n;
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		_mm256_storeu_si256((__m256i *)(d + n),
+			scale_s32_avx2_8(_mm256_loadu_si256((const __m256i *)(s + n)), vol));
+
+	scale_s32_c(d + n, s + n, volume, n_samples - n);
+}
+
+static void
+scale_f32_avx2(void *dst, const void *src, float volume, int n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	__m256 vol = _mm256_set1_ps(volume);
+	int n;
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		__m256 in0 = _mm256_loadu_ps(s + n), in1 = _mm256_loadu_ps(s + n + 8);
+		_mm256_storeu_ps(d + n, _mm256_mul_ps(in0, vol));
+		_mm256_storeu_ps(d + n + 8, _mm256_mul_ps(in1, vol));
+	}
+	scale_f32_c(d + n, s + n, volume, n_samples - n);
+}
+
+static void
+ramp_s16_avx2(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	__m256i lo, hi;
+	int n;
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		lo = scale_s16_avx2_8(_mm_loadu_si128((const __m128i *)(s + n)),
+				      _mm256_loadu_ps(volume + n));
+		hi = scale_s16_avx2_8(_mm_loadu_si128((const __m128i *)(s + n + 8)),
+				      _mm256_loadu_ps(volume + n + 8));
+		_mm256_storeu_si256((__m256i *)(d + n), pack_s16_avx2(lo, hi));
+	}
+	ramp_s16_c(d + n, s + n, volume + n, n_samples - n);
+}
+
+static void
+ramp_s32_avx2(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int n;
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		_mm256_storeu_si256((__m256i *)(d + n),
+			scale_s32_avx2_8(_mm256_loadu_si256((const __m256i *)(s + n)),
+					 _mm256_loadu_ps(volume + n)));
+
+	ramp_s32_c(d + n, s + n, volume + n, n_samples - n);
+}
+
+static void
+ramp_f32_avx2(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	int n;
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		_mm256_storeu_ps(d + n, _mm256_mul_ps(_mm256_loadu_ps(s + n),
+						      _mm256_loadu_ps(volume + n)));
+
+	ramp_f32_c(d + n, s + n, volume + n, n_samples - n);
+}
+
+void spa_volume_get_ops_avx2(struct spa_volume_ops *ops)
+{
+	ops->scale[VOLUME_S16] = scale_s16_avx2;
+	ops->scale[VOLUME_S32] = scale_s32_avx2;
+	ops->scale[VOLUME_F32] = scale_f32_avx2;
+	ops->ramp[VOLUME_S16] = ramp_s16_avx2;
+	ops->ramp[VOLUME_S32] = ramp_s32_avx2;
+	ops->ramp[VOLUME_F32] = ramp_f32_avx2;
+}
@@ -0,0 +1,134 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <arm_neon.h>
+
+#include "volume-ops.h"
+
+/* Samples are scaled as floats, vcvtq_s32_f32 truncates like the casts in
+ * the C versions and vqmovn_s32 does the s16 clamping. */
+
+static inline int16x8_t
+scale_s16_neon_8(int16x8_t in, float32x4_t v0, float32x4_t v1)
+{
+	int32x4_t lo = vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(in))), v0));
+	int32x4_t hi = vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(in))), v1));
+	return vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+}
+
+static inline int32x4_t
+scale_s32_neon_4(int32x4_t in, float32x4_t v)
+{
+	float32x4_t t = vmulq_f32(vcvtq_f32_s32(in), v);
+	t = vminq_f32(vmaxq_f32(t, vdupq_n_f32(S32_MIN_F)), vdupq_n_f32(S32_MAX_F));
+	return vcvtq_s32_f32(t);
+}
+
+static void
+scale_s16_neon(void *dst, const void *src, float volume, int n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float32x4_t vol = vdupq_n_f32(volume);
+	int n;
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		vst1q_s16(d + n, scale_s16_neon_8(vld1q_s16(s + n), vol, vol));
+
+	scale_s16_c(d + n, s + n, volume, n_samples - n);
+}
+
+static void
+scale_s32_neon(void *dst, const void *src, float volume, int n_samples)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	float32x4_t vol = vdupq_n_f32(volume);
+	int n;
+
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		vst1q_s32(d + n, scale_s32_neon_4(vld1q_s32(s + n), vol));
+
+	scale_s32_c(d + n, s + n, volume, n_samples - n);
+}
+
+static void
+scale_f32_neon(void *dst, const void *src, float volume, int n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	int n;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		vst1q_f32(d + n, vmulq_n_f32(vld1q_f32(s + n), volume));
+		vst1q_f32(d + n + 4, vmulq_n_f32(vld1q_f32(s + n + 4), volume));
+	}
+	scale_f32_c(d + n, s + n, volume, n_samples - n);
+}
+
+static void
+ramp_s16_neon(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n;
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		vst1q_s16(d + n, scale_s16_neon_8(vld1q_s16(s + n),
+						  vld1q_f32(volume + n), vld1q_f32(volume + n + 4)));
+
+	ramp_s16_c(d + n, s + n, volume + n, n_samples - n);
+}
+
+static void
+ramp_s32_neon(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int n;
+
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		vst1q_s32(d + n, scale_s32_neon_4(vld1q_s32(s + n), vld1q_f32(volume + n)));
+
+	ramp_s32_c(d + n, s + n, volume + n, n_samples - n);
+}
+
+static void
+ramp_f32_neon(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	int n;
+
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		vst1q_f32(d + n, vmulq_f32(vld1q_f32(s + n), vld1q_f32(volume + n)));
+
+	ramp_f32_c(d + n, s + n, volume + n, n_samples - n);
+}
+
+void spa_volume_get_ops_neon(struct spa_volume_ops *ops)
+{
+	ops->scale[VOLUME_S16] = scale_s16_neon;
+	ops->scale[VOLUME_S32] = scale_s32_neon;
+	ops->scale[VOLUME_F32] = scale_f32_neon;
+	ops->ramp[VOLUME_S16] = ramp_s16_neon;
+	ops->ramp[VOLUME_S32] = ramp_s32_neon;
+	ops->ramp[VOLUME_F32] = ramp_f32_neon;
+}
@@ -0,0 +1,144 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <emmintrin.h>
+
+#include "volume-ops.h"
+
+/* All functions produce the same results as the C versions. Samples are
+ * scaled as floats and truncated like the C casts. */
+
+static inline __m128i
+scale_s16_sse2_8(__m128i in, __m128 v0, __m128 v1)
+{
+	/* sign extend to 32 bits */
+	__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+	__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+	lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), v0));
+	hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), v1));
+	return _mm_packs_epi32(lo, hi);
+}
+
+static inline __m128i
+scale_s32_sse2_4(__m128i in, __m128 v)
+{
+	__m128 t = _mm_mul_ps(_mm_cvtepi32_ps(in), v);
+	t = _mm_min_ps(_mm_max_ps(t, _mm_set1_ps(S32_MIN_F)), _mm_set1_ps(S32_MAX_F));
+	return _mm_cvttps_epi32(t);
+}
+
+static void
+scale_s16_sse2(void *dst, const void *src, float volume, int n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	__m128 vol = _mm_set1_ps(volume);
+	int n;
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		_mm_storeu_si128((__m128i *)(d + n),
+			scale_s16_sse2_8(_mm_loadu_si128((const __m128i *)(s + n)), vol, vol));
+
+	scale_s16_c(d + n, s + n, volume, n_samples - n);
+}
+
+static void
+scale_s32_sse2(void *dst, const void *src, float volume, int n_samples)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	__m128 vol = _mm_set1_ps(volume);
+	int n;
+
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		_mm_storeu_si128((__m128i *)(d + n),
+			scale_s32_sse2_4(_mm_loadu_si128((const __m128i *)(s + n)), vol));
+
+	scale_s32_c(d + n, s + n, volume, n_samples - n);
+}
+
+static void
+scale_f32_sse2(void *dst, const void *src, float volume, int n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	__m128 vol = _mm_set1_ps(volume);
+	int n;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m128 in0 = _mm_loadu_ps(s + n), in1 = _mm_loadu_ps(s + n + 4);
+		_mm_storeu_ps(d + n, _mm_mul_ps(in0, vol));
+		_mm_storeu_ps(d + n + 4, _mm_mul_ps(in1, vol));
+	}
+	scale_f32_c(d + n, s + n, volume, n_samples - n);
+}
+
+static void
+ramp_s16_sse2(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n;
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		_mm_storeu_si128((__m128i *)(d + n),
+			scale_s16_sse2_8(_mm_loadu_si128((const __m128i *)(s + n)),
+					 _mm_loadu_ps(volume + n), _mm_loadu_ps(volume + n + 4)));
+
+	ramp_s16_c(d + n, s + n, volume + n, n_samples - n);
+}
+
+static void
+ramp_s32_sse2(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int n;
+
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		_mm_storeu_si128((__m128i *)(d + n),
+			scale_s32_sse2_4(_mm_loadu_si128((const __m128i *)(s + n)),
+					 _mm_loadu_ps(volume + n)));
+
+	ramp_s32_c(d + n, s + n, volume + n, n_samples - n);
+}
+
+static void
+ramp_f32_sse2(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	int n;
+
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		_mm_storeu_ps(d + n, _mm_mul_ps(_mm_loadu_ps(s + n), _mm_loadu_ps(volume + n)));
+
+	ramp_f32_c(d + n, s + n, volume + n, n_samples - n);
+}
+
+void spa_volume_get_ops_sse2(struct spa_volume_ops *ops)
+{
+	ops->scale[VOLUME_S16] = scale_s16_sse2;
+	ops->scale[VOLUME_S32] = scale_s32_sse2;
+	ops->scale[VOLUME_F32] = scale_f32_sse2;
+	ops->ramp[VOLUME_S16] = ramp_s16_sse2;
+	ops->ramp[VOLUME_S32] = ramp_s32_sse2;
+	ops->ramp[VOLUME_F32] = ramp_f32_sse2;
+}
@@ -0,0 +1,122 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "volume-ops.h"
+
+void
+scale_s16_c(void *dst, const void *src, float volume, int n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t t;
+	int n;
+
+	for (n = 0; n < n_samples; n++) {
+		t = s[n] * volume;
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+void
+scale_s32_c(void *dst, const void *src, float volume, int n_samples)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	float t;
+	int n;
+
+	for (n = 0; n < n_samples; n++) {
+		t = s[n] * volume;
+		d[n] = SPA_CLAMP(t, S32_MIN_F, S32_MAX_F);
+	}
+}
+
+void
+scale_f32_c(void *dst, const void *src, float volume, int n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	int n;
+
+	for (n = 0; n < n_samples; n++)
+		d[n] = s[n] * volume;
+}
+
+void
+ramp_s16_c(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t t;
+	int n;
+
+	for (n = 0; n < n_samples; n++) {
+		t = s[n] * volume[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+void
+ramp_s32_c(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	float t;
+	int n;
+
+	for (n = 0; n < n_samples; n++) {
+		t = s[n] * volume[n];
+		d[n] = SPA_CLAMP(t, S32_MIN_F, S32_MAX_F);
+	}
+}
+
+void
+ramp_f32_c(void *dst, const void *src, const float *volume, int n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	int n;
+
+	for (n = 0; n < n_samples; n++)
+		d[n] = s[n] * volume[n];
+}
+
+void spa_volume_get_ops(struct spa_volume_ops *ops, uint32_t cpu_flags)
+{
+	ops->scale[VOLUME_S16] = scale_s16_c;
+	ops->scale[VOLUME_S32] = scale_s32_c;
+	ops->scale[VOLUME_F32] = scale_f32_c;
+	ops->ramp[VOLUME_S16] = ramp_s16_c;
+	ops->ramp[VOLUME_S32] = ramp_s32_c;
+	ops->ramp[VOLUME_F32] = ramp_f32_c;
+
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		spa_volume_get_ops_sse2(ops);
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		spa_volume_get_ops_avx2(ops);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		spa_volume_get_ops_neon(ops);
+#endif
+}
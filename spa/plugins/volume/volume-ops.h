@@ -0,0 +1,74 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+#include <spa/defs.h>
+#include <lib/cpu.h>
+
+/* scale n_samples from src into dst with volume, dst and src can be the same */
+typedef void (*volume_func_t) (void *dst, const void *src, float volume, int n_samples);
+/* scale n_samples from src into dst with a volume per sample */
+typedef void (*volume_ramp_func_t) (void *dst, const void *src, const float *volume, int n_samples);
+
+enum {
+	VOLUME_S16,
+	VOLUME_S32,
+	VOLUME_F32,
+	VOLUME_MAX,
+};
+
+struct spa_volume_ops {
+	volume_func_t scale[VOLUME_MAX];
+	volume_ramp_func_t ramp[VOLUME_MAX];
+};
+
+/* largest float below 2^31, the s32 samples are clamped to this before
+ * converting back */
+#define S32_MAX_F	2147483520.0f
+#define S32_MIN_F	-2147483648.0f
+
+/* fill ops with the best implementation for the given SPA_CPU_FLAG_* mask,
+ * pass 0 to get the plain C versions */
+void spa_volume_get_ops(struct spa_volume_ops *ops, uint32_t cpu_flags);
+
+/* declare the functions of one implementation of the ops */
+#define DECLARE_VOLUME_OPS(arch)							\
+void scale_s16_##arch(void *dst, const void *src, float volume, int n_samples);		\
+void scale_s32_##arch(void *dst, const void *src, float volume, int n_samples);		\
+void scale_f32_##arch(void *dst, const void *src, float volume, int n_samples);		\
+void ramp_s16_##arch(void *dst, const void *src, const float *volume, int n_samples);	\
+void ramp_s32_##arch(void *dst, const void *src, const float *volume, int n_samples);	\
+void ramp_f32_##arch(void *dst, const void *src, const float *volume, int n_samples);
+
+/* reference C implementations */
+DECLARE_VOLUME_OPS(c)
+
+/* the SIMD versions are built in separate objects with the right compiler
+ * flags and only selected when the CPU supports them */
+#if defined (HAVE_SSE2)
+void spa_volume_get_ops_sse2(struct spa_volume_ops *ops);
+#endif
+#if defined (HAVE_AVX2)
+void spa_volume_get_ops_avx2(struct spa_volume_ops *ops);
+#endif
+#if defined (HAVE_NEON)
+void spa_volume_get_ops_neon(struct spa_volume_ops *ops);
+#endif
@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <stddef.h>
+#include <math.h>
 
 #include <spa/log.h>
 #include <spa/type-map.h>
@@ -29,20 +30,32 @@
 #include <spa/param-alloc.h>
 #include <lib/props.h>
 #include <lib/format.h>
+#include <lib/mix.h>
+
+#include "volume-ops.h"
 
 #define NAME "volume"
 
 #define MAX_BUFFERS     16
+#define MAX_CHANNELS    64
+#define MAX_RAMP        1024
+
+/* exponential ramps start and end at -80dB instead of 0 */
+#define RAMP_MIN_GAIN   0.0001f
 
 struct props {
 	double volume;
 	bool mute;
+	uint32_t ramp_type;
+	int32_t ramp_samples;
 };
 
 struct buffer {
 	struct spa_buffer *outbuf;
 	bool outstanding;
 	struct spa_meta_header *h;
+	struct spa_meta_audio_level *level;
+	uint32_t level_channels;
 	void *ptr;
 	size_t size;
 	struct spa_list link;
@@ -67,6 +80,11 @@ struct type {
 	uint32_t props;
 	uint32_t prop_volume;
 	uint32_t prop_mute;
+	uint32_t prop_ramp_type;
+	uint32_t prop_ramp_samples;
+	uint32_t ramp_none;
+	uint32_t ramp_linear;
+	uint32_t ramp_exponential;
 	struct spa_type_meta meta;
 	struct spa_type_data data;
 	struct spa_type_media_type media_type;
@@ -86,6 +104,11 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
 	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
 	type->prop_mute = spa_type_map_get_id(map, SPA_TYPE_PROPS__mute);
+	type->prop_ramp_type = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampType);
+	type->prop_ramp_samples = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampSamples);
+	type->ramp_none = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampType ":none");
+	type->ramp_linear = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampType ":linear");
+	type->ramp_exponential = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampType ":exponential");
 	spa_type_meta_map(map, &type->meta);
 	spa_type_data_map(map, &type->data);
 	spa_type_media_type_map(map, &type->media_type);
@@ -114,6 +137,21 @@ struct impl {
 
 	uint8_t format_buffer[1024];
 	struct spa_audio_info current_format;
+	uint32_t frame_size;
+
+	struct spa_volume_ops ops;
+	struct spa_audiomixer_ops mix_ops;
+	volume_func_t scale;
+	volume_ramp_func_t ramp;
+	level_func_t level;
+
+	/* the gain that is applied and where it is going, only used from
+	 * the data thread */
+	float gain;
+	float target;
+	float ramp_step;
+	uint32_t ramp_left;
+	bool ramp_linear;
 
 	struct port in_ports[1];
 	struct port out_ports[1];
@@ -127,17 +165,23 @@ struct impl {
 
 #define DEFAULT_VOLUME 1.0
 #define DEFAULT_MUTE false
+#define DEFAULT_RAMP_TYPE ramp_linear
+#define DEFAULT_RAMP_SAMPLES 256
 
-static void reset_props(struct props *props)
+static void reset_props(struct impl *this, struct props *props)
 {
 	props->volume = DEFAULT_VOLUME;
 	props->mute = DEFAULT_MUTE;
+	props->ramp_type = this->type.DEFAULT_RAMP_TYPE;
+	props->ramp_samples = DEFAULT_RAMP_SAMPLES;
 }
 
 #define PROP(f,key,type,...)							\
 	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
 #define PROP_MM(f,key,type,...)							\
 	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_EN(f,key,type,n,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
 #define PROP_U_MM(f,key,type,...)						\
 	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
 			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
@@ -163,7 +207,15 @@ static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 			this->props.volume,
 			0.0, 10.0),
 		PROP(&f[1], this->type.prop_mute, SPA_POD_TYPE_BOOL,
-			this->props.mute));
+			this->props.mute),
+		PROP_EN(&f[1], this->type.prop_ramp_type, SPA_POD_TYPE_ID, 4,
+			this->props.ramp_type,
+			this->type.ramp_none,
+			this->type.ramp_linear,
+			this->type.ramp_exponential),
+		PROP_MM(&f[1], this->type.prop_ramp_samples, SPA_POD_TYPE_INT,
+			this->props.ramp_samples,
+			0, INT32_MAX));
 
 	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
 
@@ -179,11 +231,14 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 	this = SPA_CONTAINER_OF(node, struct impl, node);
 
 	if (props == NULL) {
-		reset_props(&this->props);
+		reset_props(this, &this->props);
 	} else {
 		spa_props_query(props,
 				this->type.prop_volume, SPA_POD_TYPE_DOUBLE, &this->props.volume,
-				this->type.prop_mute, SPA_POD_TYPE_BOOL, &this->props.mute, 0);
+				this->type.prop_mute, SPA_POD_TYPE_BOOL, &this->props.mute,
+				this->type.prop_ramp_type, SPA_POD_TYPE_ID, &this->props.ramp_type,
+				this->type.prop_ramp_samples, SPA_POD_TYPE_INT, &this->props.ramp_samples,
+				0);
 	}
 	return SPA_RESULT_OK;
 }
@@ -307,10 +362,11 @@ impl_node_port_enum_formats(struct spa_node *node,
 		spa_pod_builder_format(&b, &f[0], this->type.format,
 			this->type.media_type.audio,
 			this->type.media_subtype.raw,
-			PROP_U_EN(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID, 3,
+			PROP_U_EN(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID, 4,
 				this->type.audio_format.S16,
 				this->type.audio_format.S16,
-				this->type.audio_format.S32),
+				this->type.audio_format.S32,
+				this->type.audio_format.F32),
 			PROP_U_MM(&f[1], this->type.format_audio.rate, SPA_POD_TYPE_INT,
 				44100,
 				1, INT32_MAX),
@@ -377,6 +433,28 @@ impl_node_port_set_format(struct spa_node *node,
 		if (!spa_format_audio_raw_parse(format, &info.info.raw, &this->type.format_audio))
 			return SPA_RESULT_INVALID_MEDIA_TYPE;
 
+		if (info.info.raw.channels == 0 || info.info.raw.channels > MAX_CHANNELS)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (info.info.raw.format == this->type.audio_format.S16) {
+			this->scale = this->ops.scale[VOLUME_S16];
+			this->ramp = this->ops.ramp[VOLUME_S16];
+			this->level = this->mix_ops.level[CONV_S16_S16];
+			this->frame_size = sizeof(int16_t);
+		} else if (info.info.raw.format == this->type.audio_format.S32) {
+			this->scale = this->ops.scale[VOLUME_S32];
+			this->ramp = this->ops.ramp[VOLUME_S32];
+			this->level = this->mix_ops.level_s32;
+			this->frame_size = sizeof(int32_t);
+		} else if (info.info.raw.format == this->type.audio_format.F32) {
+			this->scale = this->ops.scale[VOLUME_F32];
+			this->ramp = this->ops.ramp[VOLUME_F32];
+			this->level = this->mix_ops.level[CONV_F32_F32];
+			this->frame_size = sizeof(float);
+		} else
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		this->frame_size *= info.info.raw.channels;
 		this->current_format = info;
 		port->have_format = true;
 	}
@@ -392,6 +470,8 @@ impl_node_port_get_format(struct spa_node *node,
 {
 	struct impl *this;
 	struct port *port;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
 
 	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
 	spa_return_val_if_fail(format != NULL, SPA_RESULT_INVALID_ARGUMENTS);
@@ -406,7 +486,17 @@ impl_node_port_get_format(struct spa_node *node,
 	if (!port->have_format)
 		return SPA_RESULT_NO_FORMAT;
 
-	*format = NULL;
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+	spa_pod_builder_format(&b, &f[0], this->type.format,
+		this->type.media_type.audio,
+		this->type.media_subtype.raw,
+		PROP(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID,
+			this->current_format.info.raw.format),
+		PROP(&f[1], this->type.format_audio.rate, SPA_POD_TYPE_INT,
+			this->current_format.info.raw.rate),
+		PROP(&f[1], this->type.format_audio.channels, SPA_POD_TYPE_INT,
+			this->current_format.info.raw.channels));
+	*format = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
 
 	return SPA_RESULT_OK;
 }
@@ -480,6 +570,29 @@ impl_node_port_enum_params(struct spa_node *node,
 				sizeof(struct spa_meta_header)));
 		break;
 
+	case 2:
+		if (!port->have_format)
+			return SPA_RESULT_ENUM_END;
+
+		if (direction == SPA_DIRECTION_OUTPUT) {
+			/* the level of the output */
+			spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+				PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+					this->type.meta.AudioLevel),
+				PROP(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+					spa_meta_audio_level_size(this->current_format.info.raw.channels)));
+		} else {
+			/* the input takes the level of a mixer or another volume */
+			spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+				PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+					this->type.meta.AudioLevel),
+				PROP_U_MM(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+					spa_meta_audio_level_size(this->current_format.info.raw.channels),
+					spa_meta_audio_level_size(0),
+					spa_meta_audio_level_size(this->current_format.info.raw.channels)));
+		}
+		break;
+
 	default:
 		return SPA_RESULT_NOT_IMPLEMENTED;
 	}
@@ -526,12 +639,22 @@ impl_node_port_use_buffers(struct spa_node *node,
 	for (i = 0; i < n_buffers; i++) {
 		struct buffer *b;
 		struct spa_data *d = buffers[i]->datas;
+		struct spa_meta *m;
 
 		b = &port->buffers[i];
 		b->outbuf = buffers[i];
 		b->outstanding = true;
 		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
 
+		b->level = NULL;
+		b->level_channels = 0;
+		if ((m = spa_buffer_get_meta(buffers[i], this->type.meta.AudioLevel)) &&
+		    m->size >= spa_meta_audio_level_size(0)) {
+			b->level = m->data;
+			b->level_channels = (m->size - spa_meta_audio_level_size(0)) /
+				sizeof(struct spa_meta_audio_level_channel);
+		}
+
 		if ((d[0].type == this->type.data.MemPtr ||
 		     d[0].type == this->type.data.MemFd ||
 		     d[0].type == this->type.data.DmaBuf) && d[0].data != NULL) {
@@ -652,14 +775,116 @@ static inline void release_buffer(struct impl *this, struct spa_buffer *buffer)
 		this->callbacks->reuse_buffer(this->callbacks_data, 0, buffer->id);
 }
 
+/* called from the data thread, start a ramp to the new volume when the
+ * props changed */
+static void update_target(struct impl *this)
+{
+	float target, from, to;
+	uint32_t n_frames;
+
+	target = this->props.mute ? 0.0f : this->props.volume;
+	if (target == this->target)
+		return;
+
+	this->target = target;
+	n_frames = SPA_MAX(this->props.ramp_samples, 0);
+
+	if (this->props.ramp_type == this->type.ramp_linear && n_frames > 0) {
+		this->ramp_linear = true;
+		this->ramp_step = (target - this->gain) / n_frames;
+		this->ramp_left = n_frames;
+	} else if (this->props.ramp_type == this->type.ramp_exponential && n_frames > 0) {
+		from = SPA_MAX(this->gain, RAMP_MIN_GAIN);
+		to = SPA_MAX(target, RAMP_MIN_GAIN);
+		this->ramp_linear = false;
+		this->gain = from;
+		this->ramp_step = powf(to / from, 1.0f / n_frames);
+		this->ramp_left = n_frames;
+	} else {
+		this->gain = target;
+		this->ramp_left = 0;
+	}
+	spa_log_trace(this->log, NAME " %p: ramp to %f in %u samples", this, target, this->ramp_left);
+}
+
+/* the level is accumulated in \a peak and \a sum right after each block
+ * is written, pass NULL when the output has no level */
+static void process_volume(struct impl *this, void *dst, const void *src, uint32_t n_frames,
+			   float *peak, float *sum)
+{
+	uint32_t channels = this->current_format.info.raw.channels;
+	uint32_t i, c, n, chunk;
+	float gains[MAX_RAMP];
+
+	/* while ramping, the gain of each frame is written in a table that is
+	 * applied with the ramp function */
+	while (this->ramp_left > 0 && n_frames > 0) {
+		chunk = SPA_MIN(n_frames, this->ramp_left);
+		chunk = SPA_MIN(chunk, MAX_RAMP / channels);
+
+		for (i = 0, n = 0; i < chunk; i++) {
+			for (c = 0; c < channels; c++)
+				gains[n++] = this->gain;
+			if (this->ramp_linear)
+				this->gain += this->ramp_step;
+			else
+				this->gain *= this->ramp_step;
+		}
+		this->ramp(dst, src, gains, n);
+		if (peak)
+			this->level(peak, sum, dst, channels, chunk);
+
+		if ((this->ramp_left -= chunk) == 0)
+			this->gain = this->target;
+
+		dst = SPA_MEMBER(dst, chunk * this->frame_size, void);
+		src = SPA_MEMBER(src, chunk * this->frame_size, void);
+		n_frames -= chunk;
+	}
+	if (n_frames == 0)
+		return;
+
+	if (this->gain == 0.0f) {
+		/* silence adds nothing to the level */
+		memset(dst, 0, n_frames * this->frame_size);
+		return;
+	}
+
+	while (n_frames > 0) {
+		chunk = peak ? SPA_MIN(n_frames, LEVEL_BLOCK_FRAMES) : n_frames;
+
+		if (this->gain == 1.0f) {
+			/* nothing to do when processing in place */
+			if (dst != src)
+				memcpy(dst, src, chunk * this->frame_size);
+		} else {
+			this->scale(dst, src, this->gain, chunk * channels);
+		}
+		if (peak)
+			this->level(peak, sum, dst, channels, chunk);
+
+		dst = SPA_MEMBER(dst, chunk * this->frame_size, void);
+		src = SPA_MEMBER(src, chunk * this->frame_size, void);
+		n_frames -= chunk;
+	}
+}
+
 static void do_volume(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
 {
-	uint32_t si, di, i, n_samples, n_bytes, soff, doff;
+	uint32_t si, di, n_bytes, soff, doff, c, n_frames, total_frames = 0;
+	uint32_t channels = this->current_format.info.raw.channels;
 	struct spa_data *sd, *dd;
-	uint16_t *src, *dst;
-	double volume;
+	struct buffer *out = &this->out_ports[0].buffers[dbuf->id];
+	struct spa_meta_audio_level *level = out->level;
+	float peak[MAX_CHANNELS], sum[MAX_CHANNELS];
+	void *src, *dst;
+
+	update_target(this);
 
-	volume = this->props.volume;
+	if (level) {
+		memset(peak, 0, channels * sizeof(float));
+		memset(sum, 0, channels * sizeof(float));
+	}
 
 	si = di = 0;
 	soff = doff = 0;
@@ -671,27 +896,40 @@ static void do_volume(struct impl *this, struct spa_buffer *dbuf, struct spa_buf
 		sd = &sbuf->datas[si];
 		dd = &dbuf->datas[di];
 
-		src = (uint16_t *) ((uint8_t *) sd->data + sd->chunk->offset + soff);
-		dst = (uint16_t *) ((uint8_t *) dd->data + dd->chunk->offset + doff);
+		src = SPA_MEMBER(sd->data, sd->chunk->offset + soff, void);
+		dst = SPA_MEMBER(dd->data, doff, void);
 
-		n_bytes = SPA_MIN(sd->chunk->size - soff, dd->chunk->size - doff);
-		n_samples = n_bytes / sizeof(uint16_t);
+		n_bytes = SPA_MIN(sd->chunk->size - soff, dd->maxsize - doff);
+		n_bytes -= n_bytes % this->frame_size;
 
-		for (i = 0; i < n_samples; i++)
-			*src++ = *dst++ * volume;
+		n_frames = n_bytes / this->frame_size;
+		process_volume(this, dst, src, n_frames,
+			       level ? peak : NULL, level ? sum : NULL);
+		total_frames += n_frames;
 
 		soff += n_bytes;
 		doff += n_bytes;
 
-		if (soff >= sd->chunk->size) {
+		dd->chunk->offset = 0;
+		dd->chunk->size = doff;
+		dd->chunk->stride = 0;
+
+		if (n_bytes == 0 || soff >= sd->chunk->size) {
 			si++;
 			soff = 0;
 		}
-		if (doff >= dd->chunk->size) {
+		if (n_bytes == 0 || doff >= dd->maxsize) {
 			di++;
 			doff = 0;
 		}
 	}
+	if (level) {
+		level->n_channels = SPA_MIN(channels, out->level_channels);
+		for (c = 0; c < level->n_channels; c++) {
+			level->channels[c].peak = peak[c];
+			level->channels[c].rms = total_frames > 0 ? sqrtf(sum[c] / total_frames) : 0.0f;
+		}
+	}
 }
 
 static int impl_node_process_input(struct spa_node *node)
@@ -724,7 +962,7 @@ static int impl_node_process_input(struct spa_node *node)
 
 	input->status = SPA_RESULT_NEED_BUFFER;
 
-	do_volume(this, sbuf, dbuf);
+	do_volume(this, dbuf, sbuf);
 
 	output->buffer_id = dbuf->id;
 	output->status = SPA_RESULT_HAVE_BUFFER;
@@ -844,7 +1082,12 @@ impl_init(const struct spa_handle_factory *factory,
 	init_type(&this->type, this->map);
 
 	this->node = impl_node;
-	reset_props(&this->props);
+	reset_props(this, &this->props);
+
+	this->gain = this->target = this->props.mute ? 0.0f : this->props.volume;
+
+	spa_volume_get_ops(&this->ops, spa_cpu_get_flags());
+	spa_audiomixer_get_ops(&this->mix_ops, spa_cpu_get_flags());
 
 	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
 	    SPA_PORT_INFO_FLAG_IN_PLACE;
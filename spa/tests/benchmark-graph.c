@@ -0,0 +1,82 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <tests/graph-nodes.h>
+
+#define CYCLES		100000
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* pull the sink of the graph for CYCLES cycles, returns the time per cycle
+ * and the number of nodes that processed data per cycle */
+static void run(const struct spa_graph_scheduler_methods *methods, uint32_t g,
+		double *ns, double *calls)
+{
+	static struct test_graph d;
+	uint32_t i, sink, total = 0;
+	uint64_t start;
+
+	spa_zero(d);
+	spa_graph_init(&d.graph);
+	spa_graph_scheduler_init(&d.sched, &d.graph);
+	spa_graph_scheduler_set_methods(&d.sched, methods);
+
+	sink = graphs[g].make(&d, graphs[g].n);
+	spa_graph_scheduler_update(&d.sched);
+
+	start = get_time_ns();
+	for (i = 0; i < CYCLES; i++) {
+		spa_graph_scheduler_pull(&d.sched, &d.nodes[sink].node);
+		while (spa_graph_scheduler_iterate(&d.sched));
+	}
+	*ns = (double) (get_time_ns() - start) / CYCLES;
+
+	for (i = 0; i < d.n_nodes; i++)
+		total += d.nodes[i].calls;
+	*calls = (double) total / CYCLES;
+
+	spa_graph_scheduler_clear(&d.sched);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t g, s;
+	double ns, calls;
+
+	printf("%-10s %-10s %6s %12s %12s\n", "scheduler", "graph", "size", "ns/cycle", "runs/cycle");
+
+	for (s = 0; s < SPA_N_ELEMENTS(spa_graph_schedulers); s++) {
+		for (g = 0; g < SPA_N_ELEMENTS(graphs); g++) {
+			run(spa_graph_schedulers[s], g, &ns, &calls);
+			printf("%-10s %-10s %6d %12.1f %12.2f\n", spa_graph_schedulers[s]->name,
+			       graphs[g].name, graphs[g].n, ns, calls);
+		}
+	}
+	return 0;
+}
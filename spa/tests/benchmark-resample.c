@@ -0,0 +1,172 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <lib/cpu.h>
+
+#include "plugins/audioconvert/resample.h"
+
+#define MAX_CHANNELS	8
+#define MAX_FRAMES	8192
+#define BLOCK		1024
+#define DURATION	2	/* seconds of input per run */
+#define FREQ		997.0
+
+static const char *quality_names[] = { "low", "medium", "high" };
+
+static const struct {
+	uint32_t in_rate;
+	uint32_t out_rate;
+	double rate;
+} tests[] = {
+	{ 44100, 48000, 1.0 },
+	{ 48000, 44100, 1.0 },
+	{ 48000, 96000, 1.0 },
+	{ 96000, 48000, 1.0 },
+	{ 48000, 48000, 1.0001 },
+	{ 44100, 48000, 0.9999 },
+};
+
+static float in_buf[MAX_CHANNELS][MAX_FRAMES];
+static float out_buf[MAX_CHANNELS][MAX_FRAMES * 4];
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* resample DURATION seconds of a sine wave, returns the time it took and
+ * the signal to noise ratio of the first channel */
+static int run(uint32_t cpu_flags, enum resample_quality quality, uint32_t channels,
+	       uint32_t in_rate, uint32_t out_rate, double rate,
+	       uint64_t *time, double *snr)
+{
+	struct resample r;
+	const void *src[MAX_CHANNELS];
+	void *dst[MAX_CHANNELS];
+	uint32_t c, i, in_len, out_len, pos = 0, total = in_rate * DURATION;
+	uint64_t out_pos = 0, start, t = 0;
+	double signal = 0.0, noise = 0.0, step;
+	int res;
+
+	spa_zero(r);
+	r.channels = channels;
+	r.i_rate = in_rate;
+	r.o_rate = out_rate;
+	r.rate = rate;
+	r.quality = quality;
+	r.cpu_flags = cpu_flags;
+
+	if ((res = resample_native_init(&r)) < 0)
+		return res;
+
+	/* input frames per output frame */
+	step = (double) in_rate * rate / out_rate;
+
+	while (pos < total) {
+		in_len = SPA_MIN(BLOCK, total - pos);
+
+		for (c = 0; c < channels; c++) {
+			for (i = 0; i < in_len; i++)
+				in_buf[c][i] = 0.5 * sin(2.0 * M_PI * FREQ * (pos + i) / in_rate);
+			src[c] = in_buf[c];
+			dst[c] = out_buf[c];
+		}
+		out_len = SPA_N_ELEMENTS(out_buf[0]);
+
+		start = get_time_ns();
+		resample_process(&r, src, &in_len, dst, &out_len);
+		t += get_time_ns() - start;
+
+		/* skip the start where the filter is not filled */
+		for (i = 0; i < out_len; i++, out_pos++) {
+			double expected, v = out_buf[0][i];
+
+			if (out_pos < 256)
+				continue;
+			expected = 0.5 * sin(2.0 * M_PI * FREQ * (out_pos * step) / in_rate);
+			signal += expected * expected;
+			noise += (v - expected) * (v - expected);
+		}
+		pos += in_len;
+	}
+	resample_free(&r);
+
+	*time = t;
+	*snr = noise > 0.0 ? 10.0 * log10(signal / noise) : INFINITY;
+
+	return 0;
+}
+
+static void bench(const char *name, uint32_t cpu_flags)
+{
+	uint32_t i, q, channels;
+	uint64_t time;
+	double snr;
+
+	printf("%s:\n", name);
+	printf("  %-8s %-20s %8s %14s %10s\n", "quality", "conversion", "channels",
+	       "Msamples/s/ch", "SNR dB");
+
+	for (i = 0; i < SPA_N_ELEMENTS(tests); i++) {
+		for (q = 0; q < RESAMPLE_QUALITY_MAX; q++) {
+			for (channels = 1; channels <= MAX_CHANNELS; channels *= 8) {
+				char conv[32];
+
+				if (run(cpu_flags, q, channels, tests[i].in_rate,
+					tests[i].out_rate, tests[i].rate, &time, &snr) < 0) {
+					printf("  %s: init failed\n", quality_names[q]);
+					continue;
+				}
+				snprintf(conv, sizeof(conv), "%d->%d%s", tests[i].in_rate,
+					 tests[i].out_rate, tests[i].rate != 1.0 ? " (adj)" : "");
+
+				/* input samples of one channel per second of cpu time */
+				printf("  %-8s %-20s %8d %14.2f %10.1f\n", quality_names[q],
+				       conv, channels,
+				       (double) tests[i].in_rate * DURATION * 1000.0 / time,
+				       snr);
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t flags = spa_cpu_get_flags();
+
+	printf("cpu flags: %08x\n", flags);
+
+	bench("c", 0);
+	if (flags & SPA_CPU_FLAG_SSE2)
+		bench("sse2", SPA_CPU_FLAG_SSE2);
+	if (flags & SPA_CPU_FLAG_AVX2)
+		bench("avx2", SPA_CPU_FLAG_AVX2);
+	if (flags & SPA_CPU_FLAG_NEON)
+		bench("neon", SPA_CPU_FLAG_NEON);
+
+	return 0;
+}
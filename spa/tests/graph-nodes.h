@@ -0,0 +1,182 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_TESTS_GRAPH_NODES_H__
+#define __SPA_TESTS_GRAPH_NODES_H__
+
+#include <spa/graph-scheduler.h>
+
+#define MAX_NODES	64
+#define MAX_PORTS	16
+#define MAX_LINKS	128
+
+/* a node that behaves like a spa node with buffers of one sample, sources
+ * produce in process_output, other nodes consume their input in
+ * process_input and produce on all outputs. calls counts how many times the
+ * node processed data. */
+struct node {
+	struct spa_graph_node node;
+	struct spa_graph_port in[MAX_PORTS];
+	struct spa_graph_port out[MAX_PORTS];
+	uint32_t n_in;
+	uint32_t n_out;
+	uint32_t calls;
+};
+
+/* the graph of the test nodes and the io of their links */
+struct test_graph {
+	struct spa_graph graph;
+	struct spa_graph_scheduler sched;
+	struct node nodes[MAX_NODES];
+	uint32_t n_nodes;
+	struct spa_port_io io[MAX_LINKS];
+	uint32_t n_links;
+};
+
+static inline int node_process_input(void *data)
+{
+	struct node *n = data;
+	uint32_t i;
+
+	n->calls++;
+	for (i = 0; i < n->n_in; i++)
+		n->in[i].io->status = SPA_RESULT_NEED_BUFFER;
+
+	if (n->n_out == 0)
+		return SPA_RESULT_NEED_BUFFER;
+
+	for (i = 0; i < n->n_out; i++)
+		n->out[i].io->status = SPA_RESULT_HAVE_BUFFER;
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
+static inline int node_process_output(void *data)
+{
+	struct node *n = data;
+	uint32_t i;
+
+	if (n->n_in > 0) {
+		for (i = 0; i < n->n_in; i++)
+			n->in[i].io->status = SPA_RESULT_NEED_BUFFER;
+		return SPA_RESULT_NEED_BUFFER;
+	}
+	n->calls++;
+	for (i = 0; i < n->n_out; i++)
+		n->out[i].io->status = SPA_RESULT_HAVE_BUFFER;
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
+static const struct spa_graph_node_callbacks node_callbacks = {
+	SPA_VERSION_GRAPH_NODE_CALLBACKS,
+	node_process_input,
+	node_process_output,
+};
+
+static inline uint32_t add_node(struct test_graph *d)
+{
+	struct node *n = &d->nodes[d->n_nodes];
+
+	spa_zero(*n);
+	spa_graph_node_init(&n->node);
+	spa_graph_node_set_callbacks(&n->node, &node_callbacks, n);
+	spa_graph_node_add(&d->graph, &n->node);
+
+	return d->n_nodes++;
+}
+
+static inline void add_link(struct test_graph *d, uint32_t out, uint32_t in)
+{
+	struct node *o = &d->nodes[out], *i = &d->nodes[in];
+	struct spa_port_io *io = &d->io[d->n_links++];
+	struct spa_graph_port *op = &o->out[o->n_out], *ip = &i->in[i->n_in];
+
+	io->status = SPA_RESULT_NEED_BUFFER;
+	io->buffer_id = SPA_ID_INVALID;
+
+	spa_graph_port_init(op, SPA_DIRECTION_OUTPUT, o->n_out++, 0, io);
+	spa_graph_port_add(&o->node, op);
+	spa_graph_port_init(ip, SPA_DIRECTION_INPUT, i->n_in++, 0, io);
+	spa_graph_port_add(&i->node, ip);
+	spa_graph_port_link(op, ip);
+}
+
+/* source -> n filters -> sink */
+static inline uint32_t make_chain(struct test_graph *d, uint32_t n)
+{
+	uint32_t i, prev, node;
+
+	prev = add_node(d);
+	for (i = 0; i < n; i++) {
+		node = add_node(d);
+		add_link(d, prev, node);
+		prev = node;
+	}
+	node = add_node(d);
+	add_link(d, prev, node);
+
+	return node;
+}
+
+/* n sources -> mixer -> sink */
+static inline uint32_t make_fan(struct test_graph *d, uint32_t n)
+{
+	uint32_t i, mix, sink;
+
+	mix = add_node(d);
+	for (i = 0; i < n; i++)
+		add_link(d, add_node(d), mix);
+	sink = add_node(d);
+	add_link(d, mix, sink);
+
+	return sink;
+}
+
+/* source -> n filters -> mixer -> sink */
+static inline uint32_t make_diamond(struct test_graph *d, uint32_t n)
+{
+	uint32_t i, src, mix, filter, sink;
+
+	src = add_node(d);
+	mix = add_node(d);
+	for (i = 0; i < n; i++) {
+		filter = add_node(d);
+		add_link(d, src, filter);
+		add_link(d, filter, mix);
+	}
+	sink = add_node(d);
+	add_link(d, mix, sink);
+
+	return sink;
+}
+
+/* the graphs, make returns the sink to pull */
+static const struct {
+	const char *name;
+	uint32_t (*make) (struct test_graph *d, uint32_t n);
+	uint32_t n;
+} graphs[] = {
+	{ "chain", make_chain, 1 },
+	{ "chain", make_chain, 16 },
+	{ "fan", make_fan, 2 },
+	{ "fan", make_fan, 16 },
+	{ "diamond", make_diamond, 2 },
+	{ "diamond", make_diamond, 8 },
+};
+
+#endif /* __SPA_TESTS_GRAPH_NODES_H__ */
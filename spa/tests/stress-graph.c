@@ -0,0 +1,192 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sched.h>
+
+#include <spa/graph-scheduler.h>
+
+#define MAX_SOURCES	64
+#define N_ROUNDS	20
+
+/* sources are linked to the sink by the main thread while the data thread
+ * pulls the sink, each node must run once per cycle and the sink must only
+ * run when all the inputs it has have a buffer */
+struct node {
+	struct spa_graph_node node;
+	struct spa_graph_port ports[MAX_SOURCES];
+	struct spa_port_io io;
+	uint32_t n_ports;
+	uint32_t cycle;
+	uint32_t calls;
+};
+
+static struct spa_graph graph;
+static struct spa_graph_scheduler sched;
+static struct node sink, sources[MAX_SOURCES];
+static uint32_t cycle, nfailures;
+static bool running = true;
+
+static int sink_process_input(void *data)
+{
+	struct node *n = data, *src;
+	struct spa_graph_port *p;
+	uint32_t n_ports = 0, n_ready = 0;
+
+	n->calls++;
+	spa_graph_list_for_each(p, &n->node.ports[SPA_DIRECTION_INPUT], link) {
+		/* the port was added after the scheduler looked at the sink */
+		src = SPA_CONTAINER_OF(spa_graph_port_peer(p)->node, struct node, node);
+		if (src->calls == 0)
+			continue;
+		if (p->io->status == SPA_RESULT_HAVE_BUFFER)
+			n_ready++;
+		p->io->status = SPA_RESULT_NEED_BUFFER;
+		n_ports++;
+	}
+	if (n_ready != n_ports) {
+		printf("sink ran with %u of %u inputs in cycle %u\n", n_ready, n_ports, cycle);
+		nfailures++;
+	}
+	return SPA_RESULT_NEED_BUFFER;
+}
+
+static int source_process_output(void *data)
+{
+	struct node *n = data;
+
+	if (n->cycle == cycle) {
+		printf("node %p ran twice in cycle %u\n", n, cycle);
+		nfailures++;
+	}
+	n->cycle = cycle;
+	n->calls++;
+	n->io.status = SPA_RESULT_HAVE_BUFFER;
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
+static const struct spa_graph_node_callbacks sink_callbacks = {
+	SPA_VERSION_GRAPH_NODE_CALLBACKS,
+	sink_process_input,
+	NULL,
+};
+
+static const struct spa_graph_node_callbacks source_callbacks = {
+	SPA_VERSION_GRAPH_NODE_CALLBACKS,
+	NULL,
+	source_process_output,
+};
+
+static void *data_start(void *arg)
+{
+	printf("data thread started on cpu: %d\n", sched_getcpu());
+
+	while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+		cycle++;
+		spa_graph_scheduler_pull(&sched, &sink.node);
+		while (spa_graph_scheduler_iterate(&sched));
+
+		if (sink.calls != cycle) {
+			printf("sink did not run in cycle %u\n", cycle);
+			nfailures++;
+			sink.calls = cycle;
+		}
+	}
+	return NULL;
+}
+
+/* the source is complete and linked before its port on the sink is added */
+static void add_source(struct node *n)
+{
+	struct spa_graph_port *in = &sink.ports[sink.n_ports];
+
+	n->io = SPA_PORT_IO_INIT;
+	n->cycle = 0;
+	spa_graph_node_init(&n->node);
+	spa_graph_node_set_callbacks(&n->node, &source_callbacks, n);
+	spa_graph_port_init(&n->ports[0], SPA_DIRECTION_OUTPUT, 0, 0, &n->io);
+	spa_graph_port_add(&n->node, &n->ports[0]);
+	spa_graph_node_add(&graph, &n->node);
+
+	spa_graph_port_init(in, SPA_DIRECTION_INPUT, sink.n_ports, 0, &n->io);
+	spa_graph_port_link(&n->ports[0], in);
+	spa_graph_port_add(&sink.node, in);
+	__atomic_store_n(&sink.n_ports, sink.n_ports + 1, __ATOMIC_RELEASE);
+
+	spa_graph_scheduler_update(&sched);
+}
+
+static void run_round(void)
+{
+	pthread_t data_thread;
+	uint32_t i, total = 0;
+
+	spa_zero(sink);
+	spa_zero(sources);
+	cycle = 0;
+	running = true;
+
+	spa_graph_init(&graph);
+	spa_graph_scheduler_init(&sched, &graph);
+	spa_graph_scheduler_update(&sched);
+
+	spa_graph_node_init(&sink.node);
+	spa_graph_node_set_callbacks(&sink.node, &sink_callbacks, &sink);
+	spa_graph_node_add(&graph, &sink.node);
+	add_source(&sources[0]);
+
+	pthread_create(&data_thread, NULL, data_start, NULL);
+
+	/* ports are added back to back too, to hit the walk of the sink */
+	for (i = 1; i < MAX_SOURCES; i++) {
+		if (i & 1)
+			usleep(100);
+		add_source(&sources[i]);
+	}
+	usleep(1000);
+
+	__atomic_store_n(&running, false, __ATOMIC_RELEASE);
+	pthread_join(data_thread, NULL);
+
+	for (i = 0; i < MAX_SOURCES; i++) {
+		if (sources[i].calls == 0) {
+			printf("source %u never ran\n", i);
+			nfailures++;
+		}
+		total += sources[i].calls;
+	}
+	printf("%u cycles, %u source runs, %u failures\n", cycle, total, nfailures);
+
+	spa_graph_scheduler_clear(&sched);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t i;
+
+	printf("starting graph stress test\n");
+
+	for (i = 0; i < N_ROUNDS; i++)
+		run_round();
+
+	return nfailures == 0 ? 0 : 1;
+}
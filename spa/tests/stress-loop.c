@@ -0,0 +1,353 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include <spa/loop.h>
+#include <spa/log-impl.h>
+#include <spa/type-map-impl.h>
+
+#define N_THREADS	8
+#define N_INVOKES	100000
+#define N_TIMERS	1000
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+/* several threads invoke on the loop at the same time, the invokes of each
+ * thread must run in order and blocking invokes must get their own result */
+struct invoke_data {
+	uint32_t thread;
+	uint32_t count;
+	uint8_t pad[64];
+};
+
+static struct spa_loop *loop;
+static struct spa_loop_control *control;
+static struct spa_loop_utils *utils;
+static uint32_t next_count[N_THREADS];
+static uint32_t nfailures, timeouts, n_io, n_timers;
+static bool running;
+
+/* timers are set from another thread than the loop, they must all fire
+ * once and never before their time */
+struct timer_data {
+	struct spa_source *source;
+	uint64_t expire;
+	uint64_t fired;
+	uint32_t count;
+};
+static struct timer_data timer_data[N_TIMERS + 1];
+
+static int do_invoke(struct spa_loop *loop, bool async, uint32_t seq,
+		     size_t size, const void *data, void *user_data)
+{
+	const struct invoke_data *d = data;
+
+	if (size != sizeof(*d) || d->thread >= N_THREADS) {
+		printf("invalid invoke of size %zd\n", size);
+		nfailures++;
+		return -1;
+	}
+	if (d->count != next_count[d->thread]) {
+		printf("thread %u: invoke %u, expected %u\n", d->thread, d->count,
+		       next_count[d->thread]);
+		nfailures++;
+	}
+	next_count[d->thread] = d->count + 1;
+	return d->count;
+}
+
+static void on_timeout(struct spa_loop_utils *utils, struct spa_source *source, void *data)
+{
+	timeouts++;
+}
+
+static void on_io(struct spa_loop_utils *utils, struct spa_source *source,
+		  int fd, enum spa_io mask, void *data)
+{
+	uint8_t c;
+
+	if (read(fd, &c, 1) == 1)
+		__atomic_add_fetch(&n_io, 1, __ATOMIC_RELEASE);
+}
+
+/* io sources are added and changed from another thread than the loop */
+static void test_io(void)
+{
+	struct spa_source *io;
+	int fds[2];
+	uint32_t i;
+
+	if (pipe(fds) < 0)
+		return;
+
+	n_io = 0;
+	io = spa_loop_utils_add_io(utils, fds[0], SPA_IO_IN, true, on_io, NULL);
+	for (i = 0; i < 100; i++) {
+		if (write(fds[1], "x", 1) != 1)
+			break;
+		while (__atomic_load_n(&n_io, __ATOMIC_ACQUIRE) == i)
+			sched_yield();
+		spa_loop_utils_update_io(utils, io, i & 1 ? SPA_IO_IN : SPA_IO_IN | SPA_IO_ERR);
+	}
+	spa_loop_utils_destroy_source(utils, io);
+	close(fds[1]);
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * SPA_NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void on_timer(struct spa_loop_utils *utils, struct spa_source *source, void *data)
+{
+	struct timer_data *t = data;
+
+	t->fired = get_time_ns();
+	__atomic_store_n(&t->count, t->count + 1, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&n_timers, 1, __ATOMIC_RELEASE);
+}
+
+static void set_timer(struct timer_data *t, uint64_t timeout)
+{
+	struct timespec value;
+
+	value.tv_sec = timeout / SPA_NSEC_PER_SEC;
+	value.tv_nsec = timeout % SPA_NSEC_PER_SEC;
+	t->expire = get_time_ns() + timeout;
+	spa_loop_utils_update_timer(utils, t->source, &value, NULL, false);
+}
+
+static void test_timers(void)
+{
+	uint64_t start = get_time_ns();
+	uint32_t i;
+
+	n_timers = 0;
+	for (i = 0; i <= N_TIMERS; i++) {
+		struct timer_data *t = &timer_data[i];
+
+		spa_zero(*t);
+		t->source = spa_loop_utils_add_timer(utils, on_timer, t);
+		if (i == N_TIMERS)
+			set_timer(t, 3600 * SPA_NSEC_PER_SEC);
+		else if (i & 1)
+			set_timer(t, 500 * SPA_NSEC_PER_MSEC + i * SPA_NSEC_PER_USEC);
+		else
+			set_timer(t, (i * 7919 % 200000 + 1) * SPA_NSEC_PER_USEC);
+	}
+	/* move some timers before they fire */
+	for (i = 1; i < N_TIMERS; i += 2)
+		set_timer(&timer_data[i], (i * 131 % 300000 + 1) * SPA_NSEC_PER_USEC);
+
+	while (__atomic_load_n(&n_timers, __ATOMIC_ACQUIRE) < N_TIMERS &&
+	       get_time_ns() - start < 5 * SPA_NSEC_PER_SEC)
+		usleep(1000);
+	usleep(10000);
+
+	for (i = 0; i <= N_TIMERS; i++) {
+		struct timer_data *t = &timer_data[i];
+		uint32_t count = __atomic_load_n(&t->count, __ATOMIC_ACQUIRE);
+
+		if (count != (i < N_TIMERS ? 1 : 0)) {
+			printf("timer %u: fired %u times\n", i, count);
+			nfailures++;
+		}
+		else if (count && t->fired < t->expire) {
+			printf("timer %u: fired %" PRIu64 "ns early\n", i, t->expire - t->fired);
+			nfailures++;
+		}
+		spa_loop_utils_destroy_source(utils, t->source);
+	}
+}
+
+static void *loop_start(void *arg)
+{
+	printf("loop thread started on cpu: %d\n", sched_getcpu());
+
+	spa_loop_control_enter(control);
+	while (__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+		spa_loop_control_iterate(control, 100);
+	spa_loop_control_leave(control);
+
+	return NULL;
+}
+
+static void *invoke_start(void *arg)
+{
+	struct invoke_data d;
+	int res;
+
+	spa_zero(d);
+	d.thread = SPA_PTR_TO_UINT32(arg);
+
+	for (d.count = 0; d.count < N_INVOKES; d.count++) {
+		if (d.count % 16 == 15) {
+			res = spa_loop_invoke(loop, do_invoke, 0, sizeof(d), &d, true, NULL);
+			if (res != (int) d.count) {
+				printf("thread %u: result %d, expected %u\n", d.thread, res, d.count);
+				__atomic_add_fetch(&nfailures, 1, __ATOMIC_RELAXED);
+			}
+		} else {
+			while (spa_loop_invoke(loop, do_invoke, SPA_ID_INVALID, sizeof(d),
+					       &d, false, NULL) < 0)
+				sched_yield();
+		}
+	}
+	/* wait for the last ones to complete */
+	spa_loop_invoke(loop, do_invoke, 0, sizeof(d), &d, true, NULL);
+
+	return NULL;
+}
+
+static int make_loop(struct spa_handle **handle, const char *lib, const char *name,
+		     const struct spa_dict *info)
+{
+	struct spa_support support[2];
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	void *hnd, *iface;
+	uint32_t i;
+	int res;
+
+	if ((hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return SPA_RESULT_ERROR;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return SPA_RESULT_ERROR;
+	}
+
+	support[0].type = SPA_TYPE__TypeMap;
+	support[0].data = &default_map.map;
+	support[1].type = SPA_TYPE__Log;
+	support[1].data = &default_log.log;
+
+	for (i = 0; enum_func(&factory, i) == SPA_RESULT_OK; i++) {
+		if (strcmp(factory->name, name))
+			continue;
+
+		*handle = calloc(1, factory->size);
+		if ((res = spa_handle_factory_init(factory, *handle, info, support, 2)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			free(*handle);
+			return res;
+		}
+		spa_handle_get_interface(*handle,
+				spa_type_map_get_id(&default_map.map, SPA_TYPE__Loop), &iface);
+		loop = iface;
+		spa_handle_get_interface(*handle,
+				spa_type_map_get_id(&default_map.map, SPA_TYPE__LoopControl), &iface);
+		control = iface;
+		spa_handle_get_interface(*handle,
+				spa_type_map_get_id(&default_map.map, SPA_TYPE__LoopUtils), &iface);
+		utils = iface;
+		return SPA_RESULT_OK;
+	}
+	printf("can't find factory %s\n", name);
+	return SPA_RESULT_ENUM_END;
+}
+
+static void run(const char *lib, const char *name, const struct spa_dict *info)
+{
+	struct spa_handle *handle;
+	struct spa_source *timer;
+	struct timespec interval = { 0, 1000000 };
+	pthread_t loop_thread, threads[N_THREADS];
+	uint32_t i;
+
+	if (make_loop(&handle, lib, name, info) < 0) {
+		/* the other loops are optional, io_uring can be missing from
+		 * the build or the kernel */
+		if (strcmp(name, "loop") == 0)
+			nfailures++;
+		else
+			printf("%s: skipped, not available\n", name);
+		return;
+	}
+
+	spa_zero(next_count);
+	timeouts = 0;
+	running = true;
+
+	timer = spa_loop_utils_add_timer(utils, on_timeout, NULL);
+	spa_loop_utils_update_timer(utils, timer, &interval, &interval, false);
+
+	pthread_create(&loop_thread, NULL, loop_start, NULL);
+	for (i = 0; i < N_THREADS; i++)
+		pthread_create(&threads[i], NULL, invoke_start, SPA_UINT32_TO_PTR(i));
+	test_io();
+	test_timers();
+	for (i = 0; i < N_THREADS; i++)
+		pthread_join(threads[i], NULL);
+	usleep(10000);
+
+	__atomic_store_n(&running, false, __ATOMIC_RELEASE);
+	pthread_join(loop_thread, NULL);
+
+	for (i = 0; i < N_THREADS; i++) {
+		if (next_count[i] != N_INVOKES + 1) {
+			printf("thread %u: %u invokes, expected %u\n", i, next_count[i], N_INVOKES + 1);
+			nfailures++;
+		}
+	}
+	if (timeouts == 0) {
+		printf("timer did not fire\n");
+		nfailures++;
+	}
+	if (n_io != 100) {
+		printf("%u io callbacks, expected 100\n", n_io);
+		nfailures++;
+	}
+	printf("%s%s: %u threads, %u invokes each, %u timeouts\n", name, info ? " spin" : "",
+	       N_THREADS, N_INVOKES, timeouts);
+
+	spa_loop_utils_destroy_source(utils, timer);
+	spa_handle_clear(handle);
+	free(handle);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *lib = argc > 1 ? argv[1] : "build/spa/plugins/support/libspa-support.so";
+	struct spa_dict_item spin_items[] = { { "loop.spin", "100" } };
+	struct spa_dict spin_info = SPA_DICT_INIT(1, spin_items);
+
+	printf("starting loop stress test\n");
+
+	run(lib, "loop", NULL);
+	run(lib, "loop-uring", NULL);
+	run(lib, "loop", &spin_info);
+
+	printf("%u failures\n", nfailures);
+
+	return nfailures == 0 ? 0 : 1;
+}
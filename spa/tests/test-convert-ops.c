@@ -0,0 +1,161 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <lib/cpu.h>
+
+#include "plugins/audioconvert/fmt-ops.h"
+
+#define N_FRAMES	1031
+#define MAX_CHANNELS	6
+
+static const char *fmt_names[FMT_MAX] = { "s16", "s24", "s32", "f32" };
+static const uint32_t fmt_sizes[FMT_MAX] = { 2, 3, 4, 4 };
+
+static uint8_t int_src[N_FRAMES * MAX_CHANNELS * 4];
+static float f32_src[MAX_CHANNELS][N_FRAMES];
+static float ref_planes[MAX_CHANNELS][N_FRAMES], dst_planes[MAX_CHANNELS][N_FRAMES];
+static uint8_t ref_out[N_FRAMES * MAX_CHANNELS * 4], dst_out[N_FRAMES * MAX_CHANNELS * 4];
+
+static int n_failed = 0;
+
+static void fill(void)
+{
+	int i, c;
+
+	for (i = 0; i < (int) sizeof(int_src); i++)
+		int_src[i] = rand();
+	/* go a little out of range to check the clipping */
+	for (c = 0; c < MAX_CHANNELS; c++)
+		for (i = 0; i < N_FRAMES; i++)
+			f32_src[c][i] = (rand() / (float) RAND_MAX) * 2.4f - 1.2f;
+}
+
+static void fail(const char *name, const char *op, const char *fmt, uint32_t n_channels)
+{
+	printf("%s: %s %s %d channels failed\n", name, op, fmt, n_channels);
+	n_failed++;
+}
+
+/* integer samples may differ 1 bit on rounding ties */
+static bool int_equal(int fmt, const uint8_t *a, const uint8_t *b)
+{
+	int32_t va, vb;
+
+	switch (fmt) {
+	case FMT_S16:
+		va = *(int16_t *) a;
+		vb = *(int16_t *) b;
+		break;
+	case FMT_S32:
+		va = *(int32_t *) a >> 8;
+		vb = *(int32_t *) b >> 8;
+		break;
+	default:
+		return memcmp(a, b, fmt_sizes[fmt]) == 0;
+	}
+	return abs(va - vb) <= 1;
+}
+
+static void check_ops(const char *name,
+		      const struct spa_audioconvert_ops *ref,
+		      const struct spa_audioconvert_ops *ops)
+{
+	float *rp[MAX_CHANNELS], *dp[MAX_CHANNELS];
+	const float *sp[MAX_CHANNELS];
+	float matrix[MAX_CHANNELS * MAX_CHANNELS];
+	uint32_t fmt, c, n_channels;
+	int i, failed = n_failed;
+
+	for (c = 0; c < MAX_CHANNELS; c++) {
+		rp[c] = ref_planes[c];
+		dp[c] = dst_planes[c];
+		sp[c] = f32_src[c];
+	}
+	for (fmt = 0; fmt < FMT_MAX; fmt++) {
+		for (n_channels = 1; n_channels <= MAX_CHANNELS; n_channels++) {
+			ref->to_f32[fmt](rp, int_src, n_channels, N_FRAMES);
+			ops->to_f32[fmt](dp, int_src, n_channels, N_FRAMES);
+			for (c = 0; c < n_channels; c++) {
+				if (memcmp(rp[c], dp[c], N_FRAMES * sizeof(float)) != 0) {
+					fail(name, "to_f32", fmt_names[fmt], n_channels);
+					break;
+				}
+			}
+
+			ref->from_f32[fmt](ref_out, sp, n_channels, N_FRAMES);
+			ops->from_f32[fmt](dst_out, sp, n_channels, N_FRAMES);
+			for (i = 0; i < N_FRAMES * (int) n_channels; i++) {
+				if (!int_equal(fmt, &ref_out[i * fmt_sizes[fmt]],
+						    &dst_out[i * fmt_sizes[fmt]])) {
+					fail(name, "from_f32", fmt_names[fmt], n_channels);
+					break;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < MAX_CHANNELS * MAX_CHANNELS; i++)
+		matrix[i] = (i % 3) == 0 ? 0.0f : (i % 3) == 1 ? 1.0f : 0.3f;
+
+	for (n_channels = 1; n_channels <= MAX_CHANNELS; n_channels++) {
+		ref->channelmix(rp, n_channels, sp, MAX_CHANNELS - n_channels + 1, matrix, N_FRAMES);
+		ops->channelmix(dp, n_channels, sp, MAX_CHANNELS - n_channels + 1, matrix, N_FRAMES);
+		for (c = 0; c < n_channels; c++) {
+			for (i = 0; i < N_FRAMES; i++) {
+				if (fabsf(rp[c][i] - dp[c][i]) > 1e-6f)
+					break;
+			}
+			if (i < N_FRAMES) {
+				fail(name, "channelmix", "f32", n_channels);
+				break;
+			}
+		}
+	}
+	if (failed == n_failed)
+		printf("%s: ok\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_audioconvert_ops ref, ops;
+	uint32_t flags = spa_cpu_get_flags();
+
+	printf("cpu flags: %08x\n", flags);
+
+	fill();
+	spa_audioconvert_get_ops(&ref, 0);
+
+	if (flags & SPA_CPU_FLAG_SSE2) {
+		spa_audioconvert_get_ops(&ops, SPA_CPU_FLAG_SSE2);
+		check_ops("sse2", &ref, &ops);
+	}
+	if (flags & SPA_CPU_FLAG_NEON) {
+		spa_audioconvert_get_ops(&ops, SPA_CPU_FLAG_NEON);
+		check_ops("neon", &ref, &ops);
+	}
+	spa_audioconvert_get_ops(&ops, flags);
+	check_ops("best", &ref, &ops);
+
+	return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,201 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+
+#include <spa/graph-scheduler.h>
+
+#define MAX_PORTS	4
+#define CYCLES		100
+
+/* A driver cycle pulls two sinks that share their upstream nodes:
+ *
+ *   src1 -> tee1 -> filter1 -> sink1
+ *                -> filter2 -> sink2
+ *   src2 -> tee2 ----------->  sink1
+ *                ----------->  sink2
+ *
+ * every node must run exactly once per cycle, with the one pass of the plan
+ * scheduler and with the recursive pull per target that is used when there
+ * is no plan for the current graph. */
+struct node {
+	const char *name;
+	struct spa_graph_node node;
+	struct spa_graph_port in[MAX_PORTS];
+	struct spa_graph_port out[MAX_PORTS];
+	struct spa_port_io io[MAX_PORTS];
+	uint32_t n_in;
+	uint32_t n_out;
+	uint32_t calls;
+};
+
+enum {
+	SRC1, SRC2, TEE1, TEE2, FILTER1, FILTER2, SINK1, SINK2, N_NODES,
+};
+
+static const char *node_names[] = {
+	"src1", "src2", "tee1", "tee2", "filter1", "filter2", "sink1", "sink2",
+};
+
+static struct spa_graph graph;
+static struct spa_graph_scheduler sched;
+static struct node nodes[N_NODES];
+static uint32_t nfailures;
+
+static void node_run(struct node *n)
+{
+	uint32_t i;
+
+	n->calls++;
+	for (i = 0; i < n->n_in; i++) {
+		if (n->in[i].io->status != SPA_RESULT_HAVE_BUFFER) {
+			printf("%s ran without input on port %u\n", n->name, i);
+			nfailures++;
+		}
+		n->in[i].io->status = SPA_RESULT_NEED_BUFFER;
+	}
+	for (i = 0; i < n->n_out; i++)
+		n->out[i].io->status = SPA_RESULT_HAVE_BUFFER;
+}
+
+static int node_process_input(void *data)
+{
+	struct node *n = data;
+
+	node_run(n);
+	return n->n_out == 0 ? SPA_RESULT_NEED_BUFFER : SPA_RESULT_HAVE_BUFFER;
+}
+
+static int node_process_output(void *data)
+{
+	struct node *n = data;
+	uint32_t i;
+
+	/* ask for more input when the output was consumed, input that is
+	 * already there is kept for the next process_input */
+	if (n->n_in > 0) {
+		for (i = 0; i < n->n_out; i++) {
+			if (n->out[i].io->status == SPA_RESULT_HAVE_BUFFER)
+				return SPA_RESULT_HAVE_BUFFER;
+		}
+		for (i = 0; i < n->n_in; i++) {
+			if (n->in[i].io->status != SPA_RESULT_HAVE_BUFFER)
+				n->in[i].io->status = SPA_RESULT_NEED_BUFFER;
+		}
+		return SPA_RESULT_NEED_BUFFER;
+	}
+	node_run(n);
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
+static const struct spa_graph_node_callbacks node_callbacks = {
+	SPA_VERSION_GRAPH_NODE_CALLBACKS,
+	node_process_input,
+	node_process_output,
+};
+
+static void add_link(uint32_t out, uint32_t in)
+{
+	struct node *o = &nodes[out], *i = &nodes[in];
+	struct spa_port_io *io = &o->io[o->n_out];
+	struct spa_graph_port *op = &o->out[o->n_out], *ip = &i->in[i->n_in];
+
+	*io = SPA_PORT_IO_INIT;
+	io->status = SPA_RESULT_NEED_BUFFER;
+
+	spa_graph_port_init(op, SPA_DIRECTION_OUTPUT, o->n_out++, 0, io);
+	spa_graph_port_add(&o->node, op);
+	spa_graph_port_init(ip, SPA_DIRECTION_INPUT, i->n_in++, 0, io);
+	spa_graph_port_add(&i->node, ip);
+	spa_graph_port_link(op, ip);
+}
+
+static void make_graph(void)
+{
+	uint32_t i;
+
+	spa_zero(nodes);
+	spa_graph_init(&graph);
+
+	/* add the sinks first so that the plan has to sort the nodes */
+	for (i = N_NODES; i-- > 0;) {
+		nodes[i].name = node_names[i];
+		spa_graph_node_init(&nodes[i].node);
+		spa_graph_node_set_callbacks(&nodes[i].node, &node_callbacks, &nodes[i]);
+		spa_graph_node_add(&graph, &nodes[i].node);
+	}
+	add_link(SRC1, TEE1);
+	add_link(TEE1, FILTER1);
+	add_link(TEE1, FILTER2);
+	add_link(FILTER1, SINK1);
+	add_link(FILTER2, SINK2);
+	add_link(SRC2, TEE2);
+	add_link(TEE2, SINK1);
+	add_link(TEE2, SINK2);
+}
+
+static void run(const char *name, const struct spa_graph_scheduler_methods *methods,
+		bool stale)
+{
+	struct spa_graph_node *targets[2];
+	uint32_t i, cycle, fails = nfailures;
+
+	make_graph();
+	spa_graph_scheduler_init(&sched, &graph);
+	spa_graph_scheduler_set_methods(&sched, methods);
+	spa_graph_scheduler_update(&sched);
+	if (stale) {
+		/* the plan is made for an older graph, the cycle must fall back
+		 * to pulling the targets one by one */
+		__atomic_add_fetch(&graph.version, 1, __ATOMIC_RELEASE);
+	}
+
+	for (cycle = 1; cycle <= CYCLES; cycle++) {
+		/* both orders, like the targets of a driver come in */
+		targets[0] = &nodes[cycle & 1 ? SINK1 : SINK2].node;
+		targets[1] = &nodes[cycle & 1 ? SINK2 : SINK1].node;
+
+		spa_graph_scheduler_cycle(&sched, targets, 2);
+
+		for (i = 0; i < N_NODES; i++) {
+			if (nodes[i].calls != cycle) {
+				printf("%s: cycle %u: %s ran %u times\n", name, cycle,
+				       nodes[i].name, nodes[i].calls - (cycle - 1));
+				nfailures++;
+				nodes[i].calls = cycle;
+			}
+		}
+	}
+	printf("%s: %s\n", name, nfailures == fails ? "ok" : "FAILED");
+
+	spa_graph_scheduler_clear(&sched);
+}
+
+int main(int argc, char *argv[])
+{
+	printf("starting cycle test\n");
+
+	run("plan", &spa_graph_scheduler_plan, false);
+	run("plan without plan", &spa_graph_scheduler_plan, true);
+	run("recursive", &spa_graph_scheduler_recursive, false);
+
+	printf("%u failures\n", nfailures);
+
+	return nfailures == 0 ? 0 : 1;
+}
@@ -36,7 +36,7 @@
 #include <spa/format-utils.h>
 #include <spa/format-builder.h>
 #include <spa/graph.h>
-#include <spa/graph-scheduler1.h>
+#include <spa/graph-scheduler.h>
 
 static SPA_TYPE_MAP_IMPL(default_map, 4096);
 static SPA_LOG_IMPL(default_log);
@@ -340,13 +340,13 @@ static int make_nodes(struct data *data, const char *device)
 	spa_node_port_set_io(data->sink, SPA_DIRECTION_INPUT, 0, &data->volume_sink_io[0]);
 
 	spa_graph_node_init(&data->source_node);
-	spa_graph_node_set_callbacks(&data->source_node, &spa_graph_scheduler_default, data->source);
+	spa_graph_node_set_callbacks(&data->source_node, &spa_graph_node_scheduler_default, data->source);
 	spa_graph_node_add(&data->graph, &data->source_node);
 	spa_graph_port_init(&data->source_out, SPA_DIRECTION_OUTPUT, 0, 0, &data->source_volume_io[0]);
 	spa_graph_port_add(&data->source_node, &data->source_out);
 
 	spa_graph_node_init(&data->volume_node);
-	spa_graph_node_set_callbacks(&data->volume_node, &spa_graph_scheduler_default, data->volume);
+	spa_graph_node_set_callbacks(&data->volume_node, &spa_graph_node_scheduler_default, data->volume);
 	spa_graph_node_add(&data->graph, &data->volume_node);
 	spa_graph_port_init(&data->volume_in, SPA_DIRECTION_INPUT, 0, 0, &data->source_volume_io[0]);
 	spa_graph_port_add(&data->volume_node, &data->volume_in);
@@ -357,7 +357,7 @@ static int make_nodes(struct data *data, const char *device)
 	spa_graph_port_add(&data->volume_node, &data->volume_out);
 
 	spa_graph_node_init(&data->sink_node);
-	spa_graph_node_set_callbacks(&data->sink_node, &spa_graph_scheduler_default, data->sink);
+	spa_graph_node_set_callbacks(&data->sink_node, &spa_graph_node_scheduler_default, data->sink);
 	spa_graph_node_add(&data->graph, &data->sink_node);
 	spa_graph_port_init(&data->sink_in, SPA_DIRECTION_INPUT, 0, 0, &data->volume_sink_io[0]);
 	spa_graph_port_add(&data->sink_node, &data->sink_in);
@@ -533,6 +533,7 @@ int main(int argc, char *argv[])
 
 	spa_graph_init(&data.graph);
 	spa_graph_scheduler_init(&data.sched, &data.graph);
+	spa_graph_scheduler_set_methods(&data.sched, &spa_graph_scheduler_queue);
 
 	data.map = &default_map.map;
 	data.log = &default_log.log;
@@ -0,0 +1,254 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <lib/cpu.h>
+#include <lib/mix.h>
+
+#define N_SAMPLES	1031
+#define MAX_STRIDE	2
+#define MAX_SRC		5
+
+static int16_t s16_src[N_SAMPLES * MAX_STRIDE], s16_ref[N_SAMPLES * MAX_STRIDE], s16_dst[N_SAMPLES * MAX_STRIDE];
+static float f32_src[N_SAMPLES * MAX_STRIDE], f32_ref[N_SAMPLES * MAX_STRIDE], f32_dst[N_SAMPLES * MAX_STRIDE];
+static int32_t s32_src[N_SAMPLES * MAX_STRIDE];
+static int16_t s16_srcs[MAX_SRC][N_SAMPLES];
+static float f32_srcs[MAX_SRC][N_SAMPLES];
+
+static int n_failed = 0;
+
+static void fill(void)
+{
+	int i;
+
+	for (i = 0; i < N_SAMPLES * MAX_STRIDE; i++) {
+		s16_src[i] = (rand() % 65536) - 32768;
+		s16_ref[i] = s16_dst[i] = (rand() % 65536) - 32768;
+		f32_src[i] = (rand() / (float) RAND_MAX) * 2.0f - 1.0f;
+		f32_ref[i] = f32_dst[i] = (rand() / (float) RAND_MAX) * 2.0f - 1.0f;
+		s32_src[i] = (int32_t) ((uint32_t) rand() * 2u);
+	}
+	for (i = 0; i < N_SAMPLES; i++) {
+		int j;
+		for (j = 0; j < MAX_SRC; j++) {
+			s16_srcs[j][i] = (rand() % 65536) - 32768;
+			f32_srcs[j][i] = (rand() / (float) RAND_MAX) * 2.0f - 1.0f;
+		}
+	}
+}
+
+static void compare(const char *name, const char *op, int conv, int n_samples)
+{
+	int i;
+
+	for (i = 0; i < n_samples; i++) {
+		if (conv == CONV_S16_S16 && s16_ref[i] != s16_dst[i]) {
+			fprintf(stderr, "%s %s s16: sample %d: %d != %d\n", name, op, i,
+				s16_dst[i], s16_ref[i]);
+			n_failed++;
+			return;
+		}
+		if (conv == CONV_F32_F32 &&
+		    fabsf(f32_ref[i] - f32_dst[i]) > 1e-6f * fmaxf(1.0f, fabsf(f32_ref[i]))) {
+			fprintf(stderr, "%s %s f32: sample %d: %f != %f\n", name, op, i,
+				f32_dst[i], f32_ref[i]);
+			n_failed++;
+			return;
+		}
+	}
+}
+
+static void check_scrub(const char *name, struct spa_audiomixer_ops *ref, struct spa_audiomixer_ops *ops)
+{
+	int i, n_samples;
+	uint32_t r, o;
+
+	for (n_samples = N_SAMPLES - 7; n_samples <= N_SAMPLES; n_samples++) {
+		fill();
+		for (i = 0; i < n_samples; i += 97) {
+			f32_ref[i] = f32_dst[i] = (i & 1) ? NAN : -INFINITY;
+			if (i + 1 < n_samples)
+				f32_ref[i + 1] = f32_dst[i + 1] = INFINITY;
+		}
+		f32_ref[n_samples - 1] = f32_dst[n_samples - 1] = NAN;
+
+		r = ref->scrub_f32(f32_ref, n_samples * sizeof(float));
+		o = ops->scrub_f32(f32_dst, n_samples * sizeof(float));
+		if (r != o) {
+			fprintf(stderr, "%s scrub: %u != %u bad samples\n", name, o, r);
+			n_failed++;
+			return;
+		}
+		for (i = 0; i < n_samples; i++) {
+			if (!isfinite(f32_dst[i])) {
+				fprintf(stderr, "%s scrub: sample %d not finite\n", name, i);
+				n_failed++;
+				return;
+			}
+		}
+		compare(name, "scrub", CONV_F32_F32, n_samples);
+	}
+}
+
+static void check_level(const char *name, struct spa_audiomixer_ops *ref, struct spa_audiomixer_ops *ops)
+{
+	int conv, n_frames;
+	uint32_t c, channels;
+	float rpeak[8], rsum[8], peak[8], sum[8];
+
+	/* the last one is the s32 level of the volume plugin */
+	for (conv = 0; conv <= CONV_MAX; conv++) {
+		level_func_t rlevel = conv < CONV_MAX ? ref->level[conv] : ref->level_s32;
+		level_func_t level = conv < CONV_MAX ? ops->level[conv] : ops->level_s32;
+		const void *src = conv == CONV_S16_S16 ? (void*)s16_src :
+				  conv == CONV_F32_F32 ? (void*)f32_src : (void*)s32_src;
+
+		for (channels = 1; channels <= 8; channels++) {
+			for (n_frames = N_SAMPLES / channels - 3; n_frames <= N_SAMPLES / channels; n_frames++) {
+				fill();
+				memset(rpeak, 0, sizeof(rpeak));
+				memset(rsum, 0, sizeof(rsum));
+				memset(peak, 0, sizeof(peak));
+				memset(sum, 0, sizeof(sum));
+
+				rlevel(rpeak, rsum, src, channels, n_frames);
+				level(peak, sum, src, channels, n_frames);
+
+				for (c = 0; c < channels; c++) {
+					/* the sums are added in a different order */
+					if (peak[c] != rpeak[c] ||
+					    fabsf(sum[c] - rsum[c]) > 1e-4f * rsum[c]) {
+						fprintf(stderr, "%s level %d: channel %u/%u: %f/%f != %f/%f\n",
+							name, conv, c, channels, peak[c], sum[c],
+							rpeak[c], rsum[c]);
+						n_failed++;
+						return;
+					}
+				}
+			}
+		}
+	}
+}
+
+static void check_ops(const char *name, struct spa_audiomixer_ops *ref, struct spa_audiomixer_ops *ops)
+{
+	int conv, stride, n_samples, n_bytes, j;
+	uint32_t n_src;
+	float scale = 1.7f;
+
+	for (conv = 0; conv < CONV_MAX; conv++) {
+		int size = conv == CONV_S16_S16 ? sizeof(int16_t) : sizeof(float);
+		void *src = conv == CONV_S16_S16 ? (void*)s16_src : (void*)f32_src;
+		void *rdst = conv == CONV_S16_S16 ? (void*)s16_ref : (void*)f32_ref;
+		void *dst = conv == CONV_S16_S16 ? (void*)s16_dst : (void*)f32_dst;
+		const void *srcs[MAX_SRC];
+
+		for (j = 0; j < MAX_SRC; j++)
+			srcs[j] = conv == CONV_S16_S16 ? (void*)s16_srcs[j] : (void*)f32_srcs[j];
+
+		/* also test the unaligned tails */
+		for (n_samples = N_SAMPLES - 7; n_samples <= N_SAMPLES; n_samples++) {
+			n_bytes = n_samples * size;
+
+			fill();
+			ref->copy[conv](rdst, src, n_bytes);
+			ops->copy[conv](dst, src, n_bytes);
+			compare(name, "copy", conv, n_samples);
+
+			fill();
+			ref->add[conv](rdst, src, n_bytes);
+			ops->add[conv](dst, src, n_bytes);
+			compare(name, "add", conv, n_samples);
+
+			fill();
+			ref->copy_scale[conv](rdst, src, &scale, n_bytes);
+			ops->copy_scale[conv](dst, src, &scale, n_bytes);
+			compare(name, "copy_scale", conv, n_samples);
+
+			fill();
+			ref->add_scale[conv](rdst, src, &scale, n_bytes);
+			ops->add_scale[conv](dst, src, &scale, n_bytes);
+			compare(name, "add_scale", conv, n_samples);
+
+			for (n_src = 0; n_src <= MAX_SRC; n_src++) {
+				fill();
+				ref->mix[conv](rdst, srcs, n_src, n_bytes);
+				ops->mix[conv](dst, srcs, n_src, n_bytes);
+				compare(name, "mix", conv, n_samples);
+			}
+
+			for (stride = 1; stride <= MAX_STRIDE; stride++) {
+				fill();
+				ref->copy_i[conv](rdst, stride, src, stride, n_bytes);
+				ops->copy_i[conv](dst, stride, src, stride, n_bytes);
+				compare(name, "copy_i", conv, n_samples * stride);
+
+				fill();
+				ref->add_i[conv](rdst, stride, src, stride, n_bytes);
+				ops->add_i[conv](dst, stride, src, stride, n_bytes);
+				compare(name, "add_i", conv, n_samples * stride);
+
+				fill();
+				ref->copy_scale_i[conv](rdst, stride, src, stride, &scale, n_bytes);
+				ops->copy_scale_i[conv](dst, stride, src, stride, &scale, n_bytes);
+				compare(name, "copy_scale_i", conv, n_samples * stride);
+
+				fill();
+				ref->add_scale_i[conv](rdst, stride, src, stride, &scale, n_bytes);
+				ops->add_scale_i[conv](dst, stride, src, stride, &scale, n_bytes);
+				compare(name, "add_scale_i", conv, n_samples * stride);
+			}
+		}
+	}
+	check_scrub(name, ref, ops);
+	check_level(name, ref, ops);
+
+	printf("%s: %s\n", name, n_failed ? "FAILED" : "ok");
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_audiomixer_ops ref, ops;
+	uint32_t flags = spa_cpu_get_flags();
+
+	printf("cpu flags: %08x\n", flags);
+
+	spa_audiomixer_get_ops(&ref, 0);
+
+	if (flags & SPA_CPU_FLAG_SSE2) {
+		spa_audiomixer_get_ops(&ops, SPA_CPU_FLAG_SSE2);
+		check_ops("sse2", &ref, &ops);
+	}
+	if (flags & SPA_CPU_FLAG_AVX2) {
+		spa_audiomixer_get_ops(&ops, SPA_CPU_FLAG_AVX2);
+		check_ops("avx2", &ref, &ops);
+	}
+	if (flags & SPA_CPU_FLAG_NEON) {
+		spa_audiomixer_get_ops(&ops, SPA_CPU_FLAG_NEON);
+		check_ops("neon", &ref, &ops);
+	}
+	spa_audiomixer_get_ops(&ops, flags);
+	check_ops("best", &ref, &ops);
+
+	return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
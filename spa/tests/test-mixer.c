@@ -31,7 +31,7 @@
 #include <spa/log-impl.h>
 #include <spa/loop.h>
 #include <spa/graph.h>
-#include <spa/graph-scheduler1.h>
+#include <spa/graph-scheduler.h>
 #include <spa/type-map.h>
 #include <spa/type-map-impl.h>
 #include <spa/audio/format-utils.h>
@@ -416,19 +416,19 @@ static int make_nodes(struct data *data, const char *device)
 
 #ifdef USE_GRAPH
 	spa_graph_node_init(&data->source1_node);
-	spa_graph_node_set_callbacks(&data->source1_node, &spa_graph_scheduler_default, data->source1);
+	spa_graph_node_set_callbacks(&data->source1_node, &spa_graph_node_scheduler_default, data->source1);
 	spa_graph_port_init(&data->source1_out, SPA_DIRECTION_OUTPUT, 0, 0, &data->source1_mix_io[0]);
 	spa_graph_port_add(&data->source1_node, &data->source1_out);
 	spa_graph_node_add(&data->graph, &data->source1_node);
 
 	spa_graph_node_init(&data->source2_node);
-	spa_graph_node_set_callbacks(&data->source2_node, &spa_graph_scheduler_default, data->source2);
+	spa_graph_node_set_callbacks(&data->source2_node, &spa_graph_node_scheduler_default, data->source2);
 	spa_graph_port_init(&data->source2_out, SPA_DIRECTION_OUTPUT, 0, 0, &data->source2_mix_io[0]);
 	spa_graph_port_add(&data->source2_node, &data->source2_out);
 	spa_graph_node_add(&data->graph, &data->source2_node);
 
 	spa_graph_node_init(&data->mix_node);
-	spa_graph_node_set_callbacks(&data->mix_node, &spa_graph_scheduler_default, data->mix);
+	spa_graph_node_set_callbacks(&data->mix_node, &spa_graph_node_scheduler_default, data->mix);
 	spa_graph_port_init(&data->mix_in[0], SPA_DIRECTION_INPUT,
 			    data->mix_ports[0], 0, &data->source1_mix_io[0]);
 	spa_graph_port_add(&data->mix_node, &data->mix_in[0]);
@@ -444,7 +444,7 @@ static int make_nodes(struct data *data, const char *device)
 	spa_graph_port_add(&data->mix_node, &data->mix_out);
 
 	spa_graph_node_init(&data->sink_node);
-	spa_graph_node_set_callbacks(&data->sink_node, &spa_graph_scheduler_default, data->sink);
+	spa_graph_node_set_callbacks(&data->sink_node, &spa_graph_node_scheduler_default, data->sink);
 	spa_graph_port_init(&data->sink_in, SPA_DIRECTION_INPUT, 0, 0, &data->mix_sink_io[0]);
 	spa_graph_port_add(&data->sink_node, &data->sink_in);
 	spa_graph_node_add(&data->graph, &data->sink_node);
@@ -652,6 +652,7 @@ int main(int argc, char *argv[])
 
 	spa_graph_init(&data.graph);
 	spa_graph_scheduler_init(&data.sched, &data.graph);
+	spa_graph_scheduler_set_methods(&data.sched, &spa_graph_scheduler_queue);
 
 	if ((str = getenv("SPA_DEBUG")))
 		data.log->level = atoi(str);
@@ -0,0 +1,240 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <lib/cpu.h>
+
+#include "plugins/audiotestsrc/osc.h"
+
+#define M_PI_M2		( M_PI + M_PI )
+
+/* the block size of audiotestsrc */
+#define BLOCK		256
+#define MAX_SAMPLES	(BLOCK + 8)
+/* one minute of audio, in blocks like audiotestsrc renders it */
+#define LONG_SECONDS	60
+#define NOISE_SAMPLES	(1 << 22)
+
+/* the errors of a float rotated for one block and of the float filter */
+#define SINE_ERROR	4e-5
+#define PINK_ERROR	1e-4
+
+static float dst[MAX_SAMPLES + 1];
+static float noise[NOISE_SAMPLES], ref[NOISE_SAMPLES];
+
+static int n_failed = 0;
+
+static double sine_error(const float *d, double phase, double step, uint32_t n_samples)
+{
+	double err = 0.0;
+	uint32_t i;
+
+	for (i = 0; i < n_samples; i++)
+		err = fmax(err, fabs(d[i] - sin(phase + i * step)));
+
+	return err;
+}
+
+/* all lengths around the vector size and block size, nothing may be written
+ * past the end */
+static void check_sine_lengths(const char *name, osc_sine_func_t sine)
+{
+	double phase, step = M_PI_M2 * 997.0 / 48000.0, err;
+	uint32_t n_samples;
+
+	for (n_samples = 1; n_samples <= MAX_SAMPLES; n_samples++) {
+		phase = (rand() / (double) RAND_MAX) * M_PI_M2;
+		dst[n_samples] = 42.0f;
+
+		sine(dst, phase, step, n_samples);
+
+		err = sine_error(dst, phase, step, n_samples);
+		if (err > SINE_ERROR) {
+			fprintf(stderr, "%s sine: %u samples: error %g\n", name, n_samples, err);
+			n_failed++;
+			return;
+		}
+		if (dst[n_samples] != 42.0f) {
+			fprintf(stderr, "%s sine: %u samples: wrote past the end\n", name, n_samples);
+			n_failed++;
+			return;
+		}
+	}
+}
+
+/* render blocks like audiotestsrc does, the error may not grow over the
+ * run */
+static void check_sine_drift(const char *name, osc_sine_func_t sine, double freq, double rate)
+{
+	double step = M_PI_M2 * freq / rate, accumulator = 0.0, err, max_err = 0.0;
+	uint64_t i, n_blocks = LONG_SECONDS * rate / BLOCK;
+
+	for (i = 0; i < n_blocks; i++) {
+		sine(dst, accumulator, step, BLOCK);
+
+		/* the exact phase of this block */
+		err = sine_error(dst, fmod(i * BLOCK * step, M_PI_M2), step, BLOCK);
+		max_err = fmax(max_err, err);
+
+		accumulator = fmod(accumulator + BLOCK * step, M_PI_M2);
+	}
+	if (max_err > SINE_ERROR) {
+		fprintf(stderr, "%s sine %gHz at %g: error %g after %u seconds\n",
+			name, freq, rate, max_err, LONG_SECONDS);
+		n_failed++;
+	}
+}
+
+static void check_sine(const char *name, osc_sine_func_t sine)
+{
+	static const double freqs[] = { 20.0, 440.0, 1000.0, 15000.0 };
+	static const double rates[] = { 44100.0, 48000.0 };
+	uint32_t f, r;
+
+	check_sine_lengths(name, sine);
+	for (f = 0; f < SPA_N_ELEMENTS(freqs); f++)
+		for (r = 0; r < SPA_N_ELEMENTS(rates); r++)
+			check_sine_drift(name, sine, freqs[f], rates[r]);
+
+	printf("%s: %s\n", name, n_failed ? "FAILED" : "ok");
+}
+
+/* renders all the noise in blocks of odd sizes and checks that it is the
+ * same as rendering it at once */
+static void render_noise(float *d, bool pink, uint32_t *state, float *b)
+{
+	uint32_t i, n;
+
+	for (i = 0; i < NOISE_SAMPLES; i += n) {
+		n = (rand() % MAX_SAMPLES) + 1;
+		n = SPA_MIN(n, NOISE_SAMPLES - i);
+		if (pink)
+			osc_pink_noise(&d[i], state, b, n);
+		else
+			osc_white_noise(&d[i], state, n);
+	}
+}
+
+static void check_white_noise(void)
+{
+	uint32_t i, state = 22222, rstate = 22222;
+	double mean = 0.0, var = 0.0, cor = 0.0;
+
+	render_noise(noise, false, &state, NULL);
+	osc_white_noise(ref, &rstate, NOISE_SAMPLES);
+
+	if (state != rstate || memcmp(noise, ref, sizeof(noise)) != 0) {
+		fprintf(stderr, "white noise: blocks differ from one run\n");
+		n_failed++;
+	}
+	for (i = 0; i < NOISE_SAMPLES; i++) {
+		if (noise[i] < -1.0f || noise[i] >= 1.0f) {
+			fprintf(stderr, "white noise: sample %u out of range: %f\n", i, noise[i]);
+			n_failed++;
+			return;
+		}
+		mean += noise[i];
+		var += noise[i] * noise[i];
+		if (i > 0)
+			cor += noise[i] * noise[i - 1];
+	}
+	mean /= NOISE_SAMPLES;
+	var /= NOISE_SAMPLES;
+	cor /= NOISE_SAMPLES * var;
+
+	/* uniform in [-1, 1) has a variance of 1/3 and no correlation */
+	if (fabs(mean) > 1e-3 || fabs(var - 1.0 / 3.0) > 1e-3 || fabs(cor) > 1e-2) {
+		fprintf(stderr, "white noise: mean %g variance %g correlation %g\n", mean, var, cor);
+		n_failed++;
+	}
+	printf("white noise: %s\n", n_failed ? "FAILED" : "ok");
+}
+
+/* the filter in double precision on the same white noise */
+static void pink_reference(float *d, const float *white, uint32_t n_samples)
+{
+	double b[OSC_PINK_STATES] = { 0.0, }, w, p;
+	uint32_t i;
+
+	for (i = 0; i < n_samples; i++) {
+		w = white[i];
+		b[0] = 0.99886 * b[0] + w * 0.0555179;
+		b[1] = 0.99332 * b[1] + w * 0.0750759;
+		b[2] = 0.96900 * b[2] + w * 0.1538520;
+		b[3] = 0.86650 * b[3] + w * 0.3104856;
+		b[4] = 0.55000 * b[4] + w * 0.5329522;
+		b[5] = -0.7616 * b[5] - w * 0.0168980;
+		p = (b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] + w * 0.5362) * 0.11;
+		b[6] = w * 0.115926;
+		d[i] = SPA_CLAMP(p, -1.0, 1.0);
+	}
+}
+
+static void check_pink_noise(void)
+{
+	float b[OSC_PINK_STATES] = { 0.0f, };
+	uint32_t i, state = 22222, rstate = 22222;
+	double err = 0.0, var = 0.0, cor = 0.0;
+
+	render_noise(noise, true, &state, b);
+	osc_white_noise(ref, &rstate, NOISE_SAMPLES);
+	pink_reference(ref, ref, NOISE_SAMPLES);
+
+	for (i = 0; i < NOISE_SAMPLES; i++) {
+		err = fmax(err, fabs(noise[i] - ref[i]));
+		var += noise[i] * noise[i];
+		if (i > 0)
+			cor += noise[i] * noise[i - 1];
+	}
+	cor /= var;
+
+	/* the float filter must not drift away from the double one */
+	if (err > PINK_ERROR) {
+		fprintf(stderr, "pink noise: error %g\n", err);
+		n_failed++;
+	}
+	/* most of the power is in the low frequencies */
+	if (cor < 0.5) {
+		fprintf(stderr, "pink noise: correlation %g\n", cor);
+		n_failed++;
+	}
+	printf("pink noise: %s\n", n_failed ? "FAILED" : "ok");
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t flags = spa_cpu_get_flags();
+
+	printf("cpu flags: %08x\n", flags);
+
+	check_sine("c", osc_get_sine_func(0));
+	if (flags & SPA_CPU_FLAG_SSE2)
+		check_sine("sse2", osc_get_sine_func(SPA_CPU_FLAG_SSE2));
+	if (flags & SPA_CPU_FLAG_NEON)
+		check_sine("neon", osc_get_sine_func(SPA_CPU_FLAG_NEON));
+
+	check_white_noise();
+	check_pink_noise();
+
+	return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
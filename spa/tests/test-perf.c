@@ -34,7 +34,7 @@
 #include <spa/format-utils.h>
 #include <spa/format-builder.h>
 #include <spa/graph.h>
-#include <spa/graph-scheduler1.h>
+#include <spa/graph-scheduler.h>
 
 #define MODE_SYNC_PUSH          (1<<0)
 #define MODE_SYNC_PULL          (1<<1)
@@ -364,7 +364,7 @@ static int make_nodes(struct data *data)
 	spa_node_port_set_io(data->sink, SPA_DIRECTION_INPUT, 0, &data->source_sink_io[0]);
 
 	spa_graph_node_init(&data->source_node);
-	spa_graph_node_set_callbacks(&data->source_node, &spa_graph_scheduler_default, data->source);
+	spa_graph_node_set_callbacks(&data->source_node, &spa_graph_node_scheduler_default, data->source);
 	spa_graph_node_add(&data->graph, &data->source_node);
 
 	data->source_node.flags = (data->mode & MODE_ASYNC_PUSH) ? SPA_GRAPH_NODE_FLAG_ASYNC : 0;
@@ -372,7 +372,7 @@ static int make_nodes(struct data *data)
 	spa_graph_port_add(&data->source_node, &data->source_out);
 
 	spa_graph_node_init(&data->sink_node);
-	spa_graph_node_set_callbacks(&data->sink_node, &spa_graph_scheduler_default, data->sink);
+	spa_graph_node_set_callbacks(&data->sink_node, &spa_graph_node_scheduler_default, data->sink);
 	spa_graph_node_add(&data->graph, &data->sink_node);
 
 	data->sink_node.flags = (data->mode & MODE_ASYNC_PULL) ? SPA_GRAPH_NODE_FLAG_ASYNC : 0;
@@ -530,6 +530,7 @@ int main(int argc, char *argv[])
 
 	spa_graph_init(&data.graph);
 	spa_graph_scheduler_init(&data.sched, &data.graph);
+	spa_graph_scheduler_set_methods(&data.sched, &spa_graph_scheduler_queue);
 
 	data.map = &default_map.map;
 	data.log = &default_log.log;
@@ -0,0 +1,170 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <lib/cpu.h>
+
+#include "plugins/volume/volume-ops.h"
+
+#define N_SAMPLES	1031
+#define MAX_OFFSET	3
+
+static int16_t s16_src[N_SAMPLES + MAX_OFFSET], s16_ref[N_SAMPLES + MAX_OFFSET], s16_dst[N_SAMPLES + MAX_OFFSET];
+static int32_t s32_src[N_SAMPLES + MAX_OFFSET], s32_ref[N_SAMPLES + MAX_OFFSET], s32_dst[N_SAMPLES + MAX_OFFSET];
+static float f32_src[N_SAMPLES + MAX_OFFSET], f32_ref[N_SAMPLES + MAX_OFFSET], f32_dst[N_SAMPLES + MAX_OFFSET];
+static float ramp[N_SAMPLES + MAX_OFFSET];
+
+/* the large volumes make the integer formats clip */
+static const float volumes[] = { 0.0f, 0.5f, 1.0f, 1.7f, 10.0f };
+
+static int n_failed = 0;
+
+static void fill(void)
+{
+	int i;
+
+	for (i = 0; i < N_SAMPLES + MAX_OFFSET; i++) {
+		s16_src[i] = (rand() % 65536) - 32768;
+		s16_ref[i] = s16_dst[i] = (rand() % 65536) - 32768;
+		s32_src[i] = (int32_t) ((uint32_t) rand() * 2u);
+		s32_ref[i] = s32_dst[i] = (int32_t) ((uint32_t) rand() * 2u);
+		f32_src[i] = (rand() / (float) RAND_MAX) * 2.0f - 1.0f;
+		f32_ref[i] = f32_dst[i] = (rand() / (float) RAND_MAX) * 2.0f - 1.0f;
+	}
+}
+
+/* a ramp from start to end over n_samples, like the volume plugin makes */
+static void fill_ramp(float start, float end, int n_samples)
+{
+	int i;
+
+	for (i = 0; i < n_samples; i++)
+		ramp[i] = start + (end - start) * i / n_samples;
+}
+
+/* the SIMD versions must give the same samples as the C versions, also
+ * past the end nothing can be written */
+static void compare(const char *name, const char *op, int fmt, int n_samples)
+{
+	int i;
+
+	for (i = 0; i < N_SAMPLES + MAX_OFFSET; i++) {
+		if (fmt == VOLUME_S16 && s16_ref[i] != s16_dst[i]) {
+			fprintf(stderr, "%s %s s16: %d samples: sample %d: %d != %d\n", name, op,
+				n_samples, i, s16_dst[i], s16_ref[i]);
+			n_failed++;
+			return;
+		}
+		if (fmt == VOLUME_S32 && s32_ref[i] != s32_dst[i]) {
+			fprintf(stderr, "%s %s s32: %d samples: sample %d: %d != %d\n", name, op,
+				n_samples, i, s32_dst[i], s32_ref[i]);
+			n_failed++;
+			return;
+		}
+		if (fmt == VOLUME_F32 && f32_ref[i] != f32_dst[i]) {
+			fprintf(stderr, "%s %s f32: %d samples: sample %d: %f != %f\n", name, op,
+				n_samples, i, f32_dst[i], f32_ref[i]);
+			n_failed++;
+			return;
+		}
+	}
+}
+
+static void check_ops(const char *name, struct spa_volume_ops *ref, struct spa_volume_ops *ops)
+{
+	int fmt, n_samples, offset;
+	uint32_t v;
+
+	for (fmt = 0; fmt < VOLUME_MAX; fmt++) {
+		int size = fmt == VOLUME_S16 ? sizeof(int16_t) :
+			   fmt == VOLUME_S32 ? sizeof(int32_t) : sizeof(float);
+		uint8_t *src = fmt == VOLUME_S16 ? (void*)s16_src :
+			       fmt == VOLUME_S32 ? (void*)s32_src : (void*)f32_src;
+		uint8_t *rdst = fmt == VOLUME_S16 ? (void*)s16_ref :
+				fmt == VOLUME_S32 ? (void*)s32_ref : (void*)f32_ref;
+		uint8_t *dst = fmt == VOLUME_S16 ? (void*)s16_dst :
+			       fmt == VOLUME_S32 ? (void*)s32_dst : (void*)f32_dst;
+
+		/* the odd lengths and offsets test the unaligned heads and tails */
+		for (n_samples = N_SAMPLES - 17; n_samples <= N_SAMPLES; n_samples++) {
+			for (offset = 0; offset <= MAX_OFFSET; offset++) {
+				int o = offset * size;
+
+				for (v = 0; v < SPA_N_ELEMENTS(volumes); v++) {
+					fill();
+					ref->scale[fmt](rdst + o, src + o, volumes[v], n_samples - offset);
+					ops->scale[fmt](dst + o, src + o, volumes[v], n_samples - offset);
+					compare(name, "scale", fmt, n_samples - offset);
+				}
+
+				/* in place, the volume plugin does this on its own buffers */
+				fill();
+				memcpy(rdst, src, (N_SAMPLES + MAX_OFFSET) * size);
+				memcpy(dst, src, (N_SAMPLES + MAX_OFFSET) * size);
+				ref->scale[fmt](rdst + o, rdst + o, 1.7f, n_samples - offset);
+				ops->scale[fmt](dst + o, dst + o, 1.7f, n_samples - offset);
+				compare(name, "scale in place", fmt, n_samples - offset);
+
+				/* ramps up into clipping and down to silence */
+				fill();
+				fill_ramp(0.0f, 10.0f, n_samples - offset);
+				ref->ramp[fmt](rdst + o, src + o, ramp, n_samples - offset);
+				ops->ramp[fmt](dst + o, src + o, ramp, n_samples - offset);
+				compare(name, "ramp up", fmt, n_samples - offset);
+
+				fill();
+				fill_ramp(1.0f, 0.0f, n_samples - offset);
+				ref->ramp[fmt](rdst + o, src + o, ramp, n_samples - offset);
+				ops->ramp[fmt](dst + o, src + o, ramp, n_samples - offset);
+				compare(name, "ramp down", fmt, n_samples - offset);
+			}
+		}
+	}
+	printf("%s: %s\n", name, n_failed ? "FAILED" : "ok");
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_volume_ops ref, ops;
+	uint32_t flags = spa_cpu_get_flags();
+
+	printf("cpu flags: %08x\n", flags);
+
+	spa_volume_get_ops(&ref, 0);
+
+	if (flags & SPA_CPU_FLAG_SSE2) {
+		spa_volume_get_ops(&ops, SPA_CPU_FLAG_SSE2);
+		check_ops("sse2", &ref, &ops);
+	}
+	if (flags & SPA_CPU_FLAG_AVX2) {
+		spa_volume_get_ops(&ops, SPA_CPU_FLAG_AVX2);
+		check_ops("avx2", &ref, &ops);
+	}
+	if (flags & SPA_CPU_FLAG_NEON) {
+		spa_volume_get_ops(&ops, SPA_CPU_FLAG_NEON);
+		check_ops("neon", &ref, &ops);
+	}
+	spa_volume_get_ops(&ops, flags);
+	check_ops("best", &ref, &ops);
+
+	return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -30,12 +30,14 @@
 
 #include "spa/node.h"
 #include "spa/format-builder.h"
+#include "spa/audio/format-utils.h"
 #include "spa/lib/format.h"
 
 #include "pipewire/pipewire.h"
 #include "pipewire/interfaces.h"
 
 #include "pipewire/core.h"
+#include "pipewire/private.h"
 #include "modules/spa/spa-node.h"
 #include "client-node.h"
 #include "transport.h"
@@ -72,6 +74,7 @@ struct proxy_buffer {
 struct proxy_port {
 	bool valid;
 	struct spa_port_info info;
+	struct spa_latency_range latency;	/**< latency reported by the client */
 	struct spa_format *format;
 	uint32_t n_formats;
 	struct spa_format **formats;
@@ -121,6 +124,9 @@ struct impl {
 
 	struct pw_client_node_transport *transport;
 
+	struct pw_loop *data_loop;		/**< the loop with the check hook */
+	struct spa_hook data_loop_hook;
+
 	struct spa_hook node_listener;
 	struct spa_hook resource_listener;
 
@@ -304,8 +310,10 @@ do_update_port(struct proxy *this,
 			port->params[i] = spa_param_copy(params[i]);
 	}
 
-	if (change_mask & PW_CLIENT_NODE_PORT_UPDATE_INFO && info)
+	if (change_mask & PW_CLIENT_NODE_PORT_UPDATE_INFO && info) {
 		port->info = *info;
+		port->latency = info->latency;
+	}
 
 	if (!port->valid) {
 		spa_log_info(this->log, "proxy %p: adding port %d", this, port_id);
@@ -563,6 +571,71 @@ spa_proxy_node_port_set_io(struct spa_node *node,
 	return SPA_RESULT_OK;
 }
 
+/* the size of one sample of a raw audio format, 0 when unknown */
+static uint32_t sample_size(const struct spa_type_audio_format *t, uint32_t format)
+{
+	if (format == t->S8 || format == t->U8)
+		return 1;
+	if (format == t->S16 || format == t->U16 ||
+	    format == t->S16_OE || format == t->U16_OE)
+		return 2;
+	if (format == t->S24 || format == t->U24 || format == t->S20 || format == t->U20 ||
+	    format == t->S18 || format == t->U18 || format == t->S24_OE || format == t->U24_OE ||
+	    format == t->S20_OE || format == t->U20_OE || format == t->S18_OE || format == t->U18_OE)
+		return 3;
+	if (format == t->S24_32 || format == t->U24_32 || format == t->S32 || format == t->U32 ||
+	    format == t->F32 || format == t->S24_32_OE || format == t->U24_32_OE ||
+	    format == t->S32_OE || format == t->U32_OE || format == t->F32_OE)
+		return 4;
+	if (format == t->F64 || format == t->F64_OE)
+		return 8;
+	return 0;
+}
+
+/* The client holds the buffers of the port until it gives them back through
+ * the transport. For raw audio, one buffer in the transport and at most
+ * all of them are added to the latency that the client reported. */
+static void update_latency(struct proxy *this, struct proxy_port *port,
+			   struct spa_buffer **buffers, uint32_t n_buffers)
+{
+	struct spa_type_media_type media_type = { 0, };
+	struct spa_type_media_subtype media_subtype = { 0, };
+	struct spa_type_format_audio format_audio = { 0, };
+	struct spa_type_audio_format audio_format = { 0, };
+	struct spa_audio_info_raw info = { 0, };
+	uint32_t stride;
+	uint64_t duration;
+
+	port->info.latency = port->latency;
+
+	if (n_buffers == 0 || buffers[0]->n_datas == 0 || port->format == NULL)
+		return;
+
+	spa_type_media_type_map(this->map, &media_type);
+	spa_type_media_subtype_map(this->map, &media_subtype);
+	spa_type_format_audio_map(this->map, &format_audio);
+	spa_type_audio_format_map(this->map, &audio_format);
+
+	if (SPA_FORMAT_MEDIA_TYPE(port->format) != media_type.audio ||
+	    SPA_FORMAT_MEDIA_SUBTYPE(port->format) != media_subtype.raw ||
+	    !spa_format_audio_raw_parse(port->format, &info, &format_audio))
+		return;
+
+	if ((stride = sample_size(&audio_format, info.format)) == 0 || info.rate == 0)
+		return;
+	if (info.layout == SPA_AUDIO_LAYOUT_INTERLEAVED)
+		stride *= info.channels;
+	if (stride == 0)
+		return;
+
+	duration = (uint64_t) (buffers[0]->datas[0].maxsize / stride) * SPA_NSEC_PER_SEC / info.rate;
+	port->info.latency.min += duration;
+	port->info.latency.max += duration * n_buffers;
+
+	spa_log_info(this->log, "proxy %p: latency %" PRIu64 "-%" PRIu64, this,
+		     port->info.latency.min, port->info.latency.max);
+}
+
 static int
 spa_proxy_node_port_use_buffers(struct spa_node *node,
 				enum spa_direction direction,
@@ -603,6 +676,7 @@ spa_proxy_node_port_use_buffers(struct spa_node *node,
 	}
 
 	port->n_buffers = n_buffers;
+	update_latency(this, port, buffers, n_buffers);
 
 	if (this->resource == NULL)
 		return SPA_RESULT_OK;
@@ -1035,6 +1109,49 @@ static int client_node_get_fds(struct pw_client_node *node, int *readfd, int *wr
 	return SPA_RESULT_OK;
 }
 
+/* lets a spinning data loop see messages from the client before the
+ * eventfd wakes it up */
+static bool data_loop_check(void *data)
+{
+	struct impl *impl = data;
+	uint32_t index;
+
+	return spa_ringbuffer_get_read_index(impl->transport->input_buffer, &index) >=
+		(int32_t) sizeof(struct pw_client_node_message);
+}
+
+static const struct spa_loop_control_hooks data_loop_hooks = {
+	SPA_VERSION_LOOP_CONTROL_HOOKS,
+	.check = data_loop_check,
+};
+
+static int
+do_add_hook(struct spa_loop *loop,
+	    bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct impl *impl = user_data;
+	pw_loop_add_hook(impl->data_loop, &impl->data_loop_hook, &data_loop_hooks, impl);
+	return SPA_RESULT_OK;
+}
+
+static int
+do_remove_hook(struct spa_loop *loop,
+	       bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct impl *impl = user_data;
+	spa_hook_remove(&impl->data_loop_hook);
+	return SPA_RESULT_OK;
+}
+
+static void remove_data_loop_hook(struct impl *impl)
+{
+	if (impl->data_loop == NULL)
+		return;
+
+	pw_loop_invoke(impl->data_loop, do_remove_hook, 1, 0, NULL, true, impl);
+	impl->data_loop = NULL;
+}
+
 static void node_initialized(void *data)
 {
 	struct impl *impl = data;
@@ -1052,6 +1169,9 @@ static void node_initialized(void *data)
 
 	client_node_get_fds(this, &readfd, &writefd);
 
+	impl->data_loop = node->data_loop;
+	pw_loop_invoke(impl->data_loop, do_add_hook, 1, 0, NULL, true, impl);
+
 	pw_client_node_resource_transport(this->resource, pw_global_get_id(pw_node_get_global(node)),
 					  readfd, writefd, impl->transport);
 }
@@ -1085,6 +1205,8 @@ static void client_node_resource_destroy(void *data)
 	if (proxy->data_source.fd != -1)
 		spa_loop_remove_source(proxy->data_loop, &proxy->data_source);
 
+	remove_data_loop_hook(impl);
+
 	pw_node_destroy(this->node);
 }
 
@@ -1095,6 +1217,8 @@ static void node_free(void *data)
 	pw_log_debug("client-node %p: free", &impl->this);
 	proxy_clear(&impl->proxy);
 
+	remove_data_loop_hook(impl);
+
 	if (impl->transport)
 		pw_client_node_transport_destroy(impl->transport);
 
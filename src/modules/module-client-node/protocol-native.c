@@ -105,7 +105,9 @@ client_node_marshal_port_update(void *object,
 	if (info) {
 		spa_pod_builder_add(b,
 				    SPA_POD_TYPE_STRUCT, &f[1],
-				    SPA_POD_TYPE_INT, info->flags, SPA_POD_TYPE_INT, info->rate, 0);
+				    SPA_POD_TYPE_INT, info->flags, SPA_POD_TYPE_INT, info->rate,
+				    SPA_POD_TYPE_LONG, info->latency.min,
+				    SPA_POD_TYPE_LONG, info->latency.max, 0);
 		spa_pod_builder_add(b, -SPA_POD_TYPE_STRUCT, &f[1], 0);
 	} else {
 		spa_pod_builder_add(b, SPA_POD_TYPE_POD, NULL, 0);
@@ -722,7 +724,9 @@ static bool client_node_demarshal_port_update(void *object, void *data, size_t s
 		if (!spa_pod_iter_pod(&it2, ipod) ||
 		    !spa_pod_iter_get(&it2,
 				      SPA_POD_TYPE_INT, &info.flags,
-				      SPA_POD_TYPE_INT, &info.rate, 0))
+				      SPA_POD_TYPE_INT, &info.rate,
+				      SPA_POD_TYPE_LONG, &info.latency.min,
+				      SPA_POD_TYPE_LONG, &info.latency.max, 0))
 			return false;
 	}
 
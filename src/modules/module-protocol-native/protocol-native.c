@@ -627,6 +627,16 @@ static bool module_demarshal_info(void *object, void *data, size_t size)
 	return true;
 }
 
+static void marshal_node_timing(struct spa_pod_builder *b, const struct pw_node_timing *t)
+{
+	spa_pod_builder_add(b,
+			    SPA_POD_TYPE_LONG, t->count,
+			    SPA_POD_TYPE_LONG, t->last,
+			    SPA_POD_TYPE_LONG, t->min,
+			    SPA_POD_TYPE_LONG, t->max,
+			    SPA_POD_TYPE_LONG, t->avg, 0);
+}
+
 static void node_marshal_info(void *object, struct pw_node_info *info)
 {
 	struct pw_resource *resource = object;
@@ -666,11 +676,33 @@ static void node_marshal_info(void *object, struct pw_node_info *info)
 				    SPA_POD_TYPE_STRING, info->props->items[i].key,
 				    SPA_POD_TYPE_STRING, info->props->items[i].value, 0);
 	}
+	/* since version 1 */
+	if (pw_resource_get_version(resource) >= 1) {
+		marshal_node_timing(b, &info->profile.input);
+		marshal_node_timing(b, &info->profile.output);
+		marshal_node_timing(b, &info->profile.cycle);
+		spa_pod_builder_add(b,
+				    SPA_POD_TYPE_INT, info->profile.xruns,
+				    SPA_POD_TYPE_LONG, info->capture_latency.min,
+				    SPA_POD_TYPE_LONG, info->capture_latency.max,
+				    SPA_POD_TYPE_LONG, info->playback_latency.min,
+				    SPA_POD_TYPE_LONG, info->playback_latency.max, 0);
+	}
 	spa_pod_builder_add(b, -SPA_POD_TYPE_STRUCT, &f, 0);
 
 	pw_protocol_native_end_resource(resource, b);
 }
 
+static bool demarshal_node_timing(struct spa_pod_iter *it, struct pw_node_timing *t)
+{
+	return spa_pod_iter_get(it,
+				SPA_POD_TYPE_LONG, &t->count,
+				SPA_POD_TYPE_LONG, &t->last,
+				SPA_POD_TYPE_LONG, &t->min,
+				SPA_POD_TYPE_LONG, &t->max,
+				SPA_POD_TYPE_LONG, &t->avg, 0);
+}
+
 static bool node_demarshal_info(void *object, void *data, size_t size)
 {
 	struct pw_proxy *proxy = object;
@@ -718,6 +750,23 @@ static bool node_demarshal_info(void *object, void *data, size_t size)
 				      SPA_POD_TYPE_STRING, &props.items[i].value, 0))
 			return false;
 	}
+
+	/* a version 0 server does not send the profile and the latency */
+	spa_zero(info.profile);
+	spa_zero(info.capture_latency);
+	spa_zero(info.playback_latency);
+	if (spa_pod_iter_has_next(&it) &&
+	    (!demarshal_node_timing(&it, &info.profile.input) ||
+	     !demarshal_node_timing(&it, &info.profile.output) ||
+	     !demarshal_node_timing(&it, &info.profile.cycle) ||
+	     !spa_pod_iter_get(&it,
+			       SPA_POD_TYPE_INT, &info.profile.xruns,
+			       SPA_POD_TYPE_LONG, &info.capture_latency.min,
+			       SPA_POD_TYPE_LONG, &info.capture_latency.max,
+			       SPA_POD_TYPE_LONG, &info.playback_latency.min,
+			       SPA_POD_TYPE_LONG, &info.playback_latency.max, 0)))
+		return false;
+
 	pw_proxy_notify(proxy, struct pw_node_proxy_events, info, &info);
 	return true;
 }
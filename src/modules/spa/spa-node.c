@@ -21,7 +21,7 @@
 #include "config.h"
 #endif
 
-#include <spa/graph-scheduler3.h>
+#include <spa/graph-scheduler.h>
 
 #include <string.h>
 #include <stdio.h>
@@ -314,7 +314,7 @@ core_bind_func(struct pw_global *global,
 struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *properties)
 {
 	struct pw_core *this;
-	const char *name;
+	const char *name, *str;
 
 	this = calloc(1, sizeof(struct pw_core));
 	if (this == NULL)
@@ -373,6 +373,35 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	this->info.name = pw_properties_get(properties, "pipewire.core.name");
 	this->properties = properties;
 
+	if ((str = pw_properties_get(properties, "pipewire.scheduler")) != NULL) {
+		const struct spa_graph_scheduler_methods *methods;
+
+		if ((methods = spa_graph_scheduler_find(str)) != NULL)
+			spa_graph_scheduler_set_methods(&this->rt.sched, methods);
+		else
+			pw_log_warn("core %p: unknown scheduler %s", this, str);
+	}
+	pw_log_debug("core %p: using %s scheduler", this, this->rt.sched.methods->name);
+	/* the plans are compiled here when the graph changes, not on the data thread */
+	spa_graph_scheduler_update(&this->rt.sched);
+
+	if ((str = pw_properties_get(properties, "pipewire.profile")) != NULL)
+		this->profile = pw_properties_parse_bool(str);
+
+	if ((str = pw_properties_get(properties, "pipewire.quantum")) != NULL &&
+	    !pw_properties_parse_int(str, 0, INT32_MAX, (int32_t *) &this->quantum))
+		pw_log_warn("core %p: invalid quantum \"%s\"", this, str);
+
+	/* let one node with a clock start each cycle of the graph */
+	this->rt.drivers = true;
+	if ((str = pw_properties_get(properties, "pipewire.scheduler.driver")) != NULL)
+		this->rt.drivers = pw_properties_parse_bool(str);
+
+	if (this->data_loop_impl->n_workers > 1)
+		spa_graph_scheduler_set_executor(&this->rt.sched,
+						 &this->data_loop_impl->executor,
+						 this->data_loop_impl);
+
 	this->global = pw_core_add_global(this,
 					  NULL,
 					  NULL,
@@ -405,6 +434,8 @@ void pw_core_destroy(struct pw_core *core)
 
 	pw_data_loop_destroy(core->data_loop_impl);
 
+	spa_graph_scheduler_clear(&core->rt.sched);
+
 	pw_properties_free(core->properties);
 
 	pw_map_clear(&core->globals);
@@ -472,6 +503,9 @@ const struct pw_properties *pw_core_get_properties(struct pw_core *core)
 void pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict)
 {
 	struct pw_resource *resource;
+	struct pw_node *node;
+	const char *str;
+	int32_t quantum = core->quantum;
 
 	if (core->properties == NULL) {
 		if (dict)
@@ -487,6 +521,20 @@ void pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict
 	core->info.change_mask = PW_CORE_CHANGE_MASK_PROPS;
 	core->info.props = core->properties ? &core->properties->dict : NULL;
 
+	if (core->properties &&
+	    (str = pw_properties_get(core->properties, "pipewire.quantum")) != NULL &&
+	    !pw_properties_parse_int(str, 0, INT32_MAX, &quantum))
+		pw_log_warn("core %p: invalid quantum \"%s\"", core, str);
+
+	if ((uint32_t) quantum != core->quantum) {
+		core->quantum = quantum;
+		pw_log_debug("core %p: quantum %u", core, core->quantum);
+		spa_list_for_each(node, &core->node_list, link)
+			pw_node_set_quantum(node, core->quantum);
+		/* the devices report a latency for the new quantum */
+		pw_core_update_latency(core);
+	}
+
 	spa_hook_list_call(&core->listener_list, struct pw_core_events, info_changed, &core->info);
 
 	spa_list_for_each(resource, &core->resource_list, link) {
@@ -495,6 +543,27 @@ void pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict
 	core->info.change_mask = 0;
 }
 
+/** Set the quantum of the graph
+ *
+ * \param core a core
+ * \param quantum the number of frames processed in one cycle
+ *
+ * The drivers switch to the new quantum at the start of their next cycle
+ * and the other nodes follow, links and formats stay as they are. The
+ * quantum is also available as the pipewire.quantum property of the core.
+ *
+ * \memberof pw_core
+ */
+void pw_core_set_quantum(struct pw_core *core, uint32_t quantum)
+{
+	char value[16];
+	struct spa_dict_item items[1] = { { "pipewire.quantum", value } };
+	struct spa_dict dict = SPA_DICT_INIT(1, items);
+
+	snprintf(value, sizeof(value), "%u", quantum);
+	pw_core_update_properties(core, &dict);
+}
+
 bool pw_core_for_each_global(struct pw_core *core,
 			     bool (*callback) (void *data, struct pw_global *global),
 			     void *data)
@@ -703,3 +772,181 @@ struct pw_node_factory *pw_core_find_node_factory(struct pw_core *core, const ch
 	}
 	return NULL;
 }
+
+/* the latency that the node adds to the data on the port */
+static void port_own_latency(struct pw_port *port, struct spa_latency_range *latency)
+{
+	const struct spa_port_info *info;
+
+	if (pw_port_get_info(port, &info) >= 0 && info != NULL)
+		*latency = info->latency;
+	else
+		spa_zero(*latency);
+}
+
+/* the data can take any of the paths, keep the smallest and largest latency */
+static void merge_latency(struct spa_latency_range *latency,
+			  const struct spa_latency_range *other, bool *first)
+{
+	if (*first) {
+		*latency = *other;
+		*first = false;
+	} else {
+		latency->min = SPA_MIN(latency->min, other->min);
+		latency->max = SPA_MAX(latency->max, other->max);
+	}
+}
+
+static bool link_is_ready(struct pw_link *link)
+{
+	return link->state == PW_LINK_STATE_PAUSED || link->state == PW_LINK_STATE_RUNNING;
+}
+
+/* The capture latency of an input port comes from the output ports that
+ * link to it, the one of an output port from the input ports of its node.
+ * The port adds its own latency. Links from nodes that are sorted after the
+ * node close a cycle and are left out. */
+static void update_capture_latency(struct pw_port *port)
+{
+	struct spa_latency_range own, capture = { 0, };
+	struct pw_link *link;
+	struct pw_port *p;
+	bool first = true;
+
+	port_own_latency(port, &own);
+
+	if (port->direction == PW_DIRECTION_INPUT) {
+		spa_list_for_each(link, &port->links, input_link) {
+			if (link_is_ready(link) &&
+			    link->output->node->latency_index < port->node->latency_index)
+				merge_latency(&capture, &link->output->capture_latency, &first);
+		}
+	} else {
+		spa_list_for_each(p, &port->node->input_ports, link)
+			merge_latency(&capture, &p->capture_latency, &first);
+	}
+	port->capture_latency.min = capture.min + own.min;
+	port->capture_latency.max = capture.max + own.max;
+}
+
+/* The playback latency goes the other way, from the input ports that an
+ * output port links to and from the output ports of the node of an input
+ * port. */
+static void update_playback_latency(struct pw_port *port)
+{
+	struct spa_latency_range own, playback = { 0, };
+	struct pw_link *link;
+	struct pw_port *p;
+	bool first = true;
+
+	port_own_latency(port, &own);
+
+	if (port->direction == PW_DIRECTION_INPUT) {
+		spa_list_for_each(p, &port->node->output_ports, link)
+			merge_latency(&playback, &p->playback_latency, &first);
+	} else {
+		spa_list_for_each(link, &port->links, output_link) {
+			if (link_is_ready(link) &&
+			    link->input->node->latency_index > port->node->latency_index)
+				merge_latency(&playback, &link->input->playback_latency, &first);
+		}
+	}
+	port->playback_latency.min = playback.min + own.min;
+	port->playback_latency.max = playback.max + own.max;
+}
+
+/* sort the nodes so that the nodes that link to a node come before it, the
+ * nodes of a cycle are added after the sorted ones. The latency_index of the
+ * nodes is their position in \a order. */
+static uint32_t sort_nodes(struct pw_core *core, struct pw_node **order, uint32_t *degree)
+{
+	struct pw_node *node, *peer;
+	struct pw_port *port;
+	struct pw_link *link;
+	uint32_t i = 0, head, tail = 0;
+
+	spa_list_for_each(node, &core->node_list, link) {
+		node->latency_index = i;
+		degree[i] = 0;
+		spa_list_for_each(port, &node->input_ports, link) {
+			spa_list_for_each(link, &port->links, input_link)
+				if (link_is_ready(link))
+					degree[i]++;
+		}
+		if (degree[i] == 0)
+			order[tail++] = node;
+		i++;
+	}
+	for (head = 0; head < tail; head++) {
+		spa_list_for_each(port, &order[head]->output_ports, link) {
+			spa_list_for_each(link, &port->links, output_link) {
+				if (!link_is_ready(link))
+					continue;
+				peer = link->input->node;
+				if (degree[peer->latency_index] > 0 &&
+				    --degree[peer->latency_index] == 0)
+					order[tail++] = peer;
+			}
+		}
+	}
+	if (tail < i) {
+		spa_list_for_each(node, &core->node_list, link)
+			if (degree[node->latency_index] > 0)
+				order[tail++] = node;
+	}
+	for (i = 0; i < tail; i++)
+		order[i]->latency_index = i;
+
+	return tail;
+}
+
+/** Update the latency of all ports and nodes
+ *
+ * \param core the core object
+ *
+ * Add up the latency that the ports report along the links that are ready.
+ * The nodes with a changed latency send their info and a clock update. This
+ * is called when links are set up or destroyed and when the quantum changed.
+ *
+ * The capture latency is added up in one pass over the nodes in topological
+ * order and the playback latency in one pass in reverse order. In a cycle of
+ * the graph, the latency of the ports that close it is left out.
+ *
+ * \memberof pw_core
+ */
+void pw_core_update_latency(struct pw_core *core)
+{
+	struct pw_node *node, **order;
+	struct pw_port *port;
+	uint32_t i, *degree, n_nodes = 0;
+
+	spa_list_for_each(node, &core->node_list, link)
+		n_nodes++;
+	if (n_nodes == 0)
+		return;
+
+	order = malloc(n_nodes * (sizeof(struct pw_node *) + sizeof(uint32_t)));
+	if (order == NULL) {
+		pw_log_error("core %p: no memory to update the latency", core);
+		return;
+	}
+	degree = SPA_MEMBER(order, n_nodes * sizeof(struct pw_node *), uint32_t);
+	n_nodes = sort_nodes(core, order, degree);
+
+	for (i = 0; i < n_nodes; i++) {
+		spa_list_for_each(port, &order[i]->input_ports, link)
+			update_capture_latency(port);
+		spa_list_for_each(port, &order[i]->output_ports, link)
+			update_capture_latency(port);
+	}
+	for (i = n_nodes; i-- > 0;) {
+		spa_list_for_each(port, &order[i]->output_ports, link)
+			update_playback_latency(port);
+		spa_list_for_each(port, &order[i]->input_ports, link)
+			update_playback_latency(port);
+	}
+	free(order);
+
+	spa_list_for_each(node, &core->node_list, link)
+		pw_node_update_latency(node);
+}
@@ -182,6 +182,12 @@ pw_core_find_port(struct pw_core *core,
 struct pw_node_factory *
 pw_core_find_node_factory(struct pw_core *core, const char *name);
 
+/** Update the latency of the ports and nodes after the links changed */
+void pw_core_update_latency(struct pw_core *core);
+
+/** Change the number of frames processed in one cycle of the graph */
+void pw_core_set_quantum(struct pw_core *core, uint32_t quantum);
+
 #ifdef __cplusplus
 }
 #endif
@@ -18,8 +18,14 @@
  */
 
 #include <pthread.h>
+#include <sched.h>
 #include <errno.h>
+#include <unistd.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <lib/cpu.h>
 
 #include "pipewire/log.h"
 #include "pipewire/rtkit.h"
@@ -69,12 +75,239 @@ static void make_realtime(struct pw_data_loop *this)
 	pw_rtkit_bus_free(system_bus);
 }
 
+#define MAX_WORKERS	16
+#define WORKER_QUEUE	256	/* power of 2 */
+#define MAX_SPIN	64
+
+/* a node queue that the owner uses as a stack and that other workers
+ * steal from at the other end */
+struct data_worker {
+	struct pw_data_loop *loop;
+	struct spa_graph_plan *plan;	/**< the plan the worker runs */
+	pthread_t thread;
+	bool running;
+	uint32_t id;
+	int32_t top;
+	int32_t bottom;
+	uint32_t nodes[WORKER_QUEUE];
+};
+
+static bool worker_push(struct data_worker *w, uint32_t index)
+{
+	int32_t b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED);
+	int32_t t = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+
+	if (b - t >= WORKER_QUEUE)
+		return false;
+
+	__atomic_store_n(&w->nodes[b & (WORKER_QUEUE - 1)], index, __ATOMIC_RELAXED);
+	__atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+static bool worker_pop(struct data_worker *w, uint32_t *index)
+{
+	int32_t b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED) - 1;
+	int32_t t;
+	bool res = true;
+
+	__atomic_store_n(&w->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&w->top, __ATOMIC_RELAXED);
+
+	if (t > b) {
+		__atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+		return false;
+	}
+	*index = __atomic_load_n(&w->nodes[b & (WORKER_QUEUE - 1)], __ATOMIC_RELAXED);
+	if (t == b) {
+		/* last one, race against the thieves */
+		res = __atomic_compare_exchange_n(&w->top, &t, t + 1, false,
+						  __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+		__atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+	return res;
+}
+
+static bool worker_steal(struct data_worker *w, uint32_t *index)
+{
+	int32_t t = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+	int32_t b;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&w->bottom, __ATOMIC_ACQUIRE);
+
+	if (t >= b)
+		return false;
+
+	*index = __atomic_load_n(&w->nodes[t & (WORKER_QUEUE - 1)], __ATOMIC_RELAXED);
+	return __atomic_compare_exchange_n(&w->top, &t, t + 1, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+/* wake up \a n threads that sleep on \a futex after changing it, the
+ * syscall is only made when a thread sleeps */
+static void worker_wake(struct pw_data_loop *this, void *futex, int n)
+{
+	if (__atomic_load_n(&this->sleepers, __ATOMIC_SEQ_CST) > 0)
+		syscall(SYS_futex, futex, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+/* sleep while \a futex has \a val */
+static void worker_sleep(struct pw_data_loop *this, void *futex, int32_t val)
+{
+	__atomic_add_fetch(&this->sleepers, 1, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, futex, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+	__atomic_sub_fetch(&this->sleepers, 1, __ATOMIC_SEQ_CST);
+}
+
+static void worker_ready(void *data, uint32_t index)
+{
+	struct data_worker *w = data;
+	struct pw_data_loop *this = w->loop;
+
+	if (!worker_push(w, index))
+		spa_graph_plan_run_node(w->plan, index, worker_ready, w);
+	else {
+		__atomic_add_fetch(&this->work, 1, __ATOMIC_SEQ_CST);
+		worker_wake(this, &this->work, 1);
+	}
+}
+
+static bool worker_get(struct data_worker *w, uint32_t *index)
+{
+	struct pw_data_loop *this = w->loop;
+	uint32_t i;
+
+	if (worker_pop(w, index))
+		return true;
+
+	for (i = 1; i < this->n_workers; i++) {
+		if (worker_steal(&this->workers[(w->id + i) % this->n_workers], index))
+			return true;
+	}
+	return false;
+}
+
+/* run nodes until all nodes of the plan are done. A worker that wakes up
+ * late can get here after the cycle ended, busy counts the workers in here
+ * so that the data loop can wait until none of them uses the plan anymore.
+ * The plan is only taken after busy is raised, the data loop clears it
+ * before it waits, so a late worker sees no plan or the plan of a newer
+ * cycle that waits for it. */
+static void worker_process(struct data_worker *w)
+{
+	struct pw_data_loop *this = w->loop;
+	struct spa_graph_plan *plan;
+	uint32_t index, work, idle = 0;
+
+	__atomic_add_fetch(&this->busy, 1, __ATOMIC_SEQ_CST);
+	w->plan = plan = __atomic_load_n(&this->plan, __ATOMIC_SEQ_CST);
+
+	while (plan != NULL) {
+		/* read before the checks, a change after them ends the sleep */
+		work = __atomic_load_n(&this->work, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&plan->remaining, __ATOMIC_ACQUIRE) == 0)
+			break;
+
+		if (worker_get(w, &index)) {
+			spa_graph_plan_run_node(plan, index, worker_ready, w);
+			if (__atomic_load_n(&plan->remaining, __ATOMIC_ACQUIRE) == 0) {
+				__atomic_add_fetch(&this->work, 1, __ATOMIC_SEQ_CST);
+				worker_wake(this, &this->work, INT32_MAX);
+			}
+			idle = 0;
+		}
+		else if (++idle == MAX_SPIN) {
+			/* sleep until a node is ready or the plan is done, the
+			 * threads we wait for can run when there are fewer
+			 * cores than workers */
+			worker_sleep(this, &this->work, work);
+			idle = 0;
+		}
+	}
+	if (__atomic_sub_fetch(&this->busy, 1, __ATOMIC_SEQ_CST) == 0)
+		worker_wake(this, &this->busy, INT32_MAX);
+}
+
+static void executor_run(void *data, struct spa_graph_plan *plan,
+			 const uint32_t *ready, uint32_t n_ready)
+{
+	struct pw_data_loop *this = data;
+	struct data_worker *w = &this->workers[0];
+	uint32_t i, idle = 0;
+	int32_t busy;
+
+	w->plan = plan;
+	for (i = 0; i < n_ready; i++)
+		worker_ready(w, ready[i]);
+
+	__atomic_store_n(&this->plan, plan, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&this->generation, 1, __ATOMIC_RELEASE);
+	syscall(SYS_futex, &this->generation, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+
+	worker_process(w);
+
+	/* the nodes are done, wait for the workers that still look at the
+	 * plan, the scheduler resets it when this returns */
+	__atomic_store_n(&this->plan, NULL, __ATOMIC_SEQ_CST);
+	while ((busy = __atomic_load_n(&this->busy, __ATOMIC_SEQ_CST)) > 0) {
+		if (++idle == MAX_SPIN) {
+			worker_sleep(this, &this->busy, busy);
+			idle = 0;
+		}
+	}
+}
+
+static const struct spa_graph_executor executor = {
+	SPA_VERSION_GRAPH_EXECUTOR,
+	executor_run,
+};
+
+static void setup_thread(struct pw_data_loop *this)
+{
+	make_realtime(this);
+
+	if (this->zero_denormals) {
+		/* denormals in decaying float signals make the mix very slow */
+		if (spa_cpu_zero_denormals(true) < 0)
+			pw_log_debug("data-loop %p: can't flush denormals to zero", this);
+	}
+}
+
+static void *do_worker(void *user_data)
+{
+	struct data_worker *w = user_data;
+	struct pw_data_loop *this = w->loop;
+	uint32_t generation;
+
+	setup_thread(this);
+
+	generation = __atomic_load_n(&this->generation, __ATOMIC_ACQUIRE);
+
+	pw_log_debug("data-loop %p: enter worker %d", this, w->id);
+	while (true) {
+		while (__atomic_load_n(&this->generation, __ATOMIC_ACQUIRE) == generation)
+			syscall(SYS_futex, &this->generation, FUTEX_WAIT_PRIVATE,
+				generation, NULL, NULL, 0);
+		generation = __atomic_load_n(&this->generation, __ATOMIC_ACQUIRE);
+
+		if (!__atomic_load_n(&this->workers_running, __ATOMIC_ACQUIRE))
+			break;
+
+		worker_process(w);
+	}
+	pw_log_debug("data-loop %p: leave worker %d", this, w->id);
+
+	return NULL;
+}
+
 static void *do_loop(void *user_data)
 {
 	struct pw_data_loop *this = user_data;
 	int res;
 
-	make_realtime(this);
+	setup_thread(this);
 
 	pw_log_debug("data-loop %p: enter thread", this);
 	pw_loop_enter(this->loop);
@@ -104,6 +337,10 @@ static void do_stop(struct spa_loop_utils *utils, struct spa_source *source, uin
 struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 {
 	struct pw_data_loop *this;
+	struct pw_properties *props = NULL;
+	const char *str;
+	uint32_t i;
+	int32_t n_workers = 0;
 
 	this = calloc(1, sizeof(struct pw_data_loop));
 	if (this == NULL)
@@ -111,7 +348,41 @@ struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 
 	pw_log_debug("data-loop %p: new", this);
 
+	this->zero_denormals = true;
+	if (properties &&
+	    (str = pw_properties_get(properties, "pipewire.data-loop.zero-denormals")) != NULL)
+		this->zero_denormals = pw_properties_parse_bool(str);
+
+	/* extra threads that run independent parts of the graph */
+	if (properties &&
+	    (str = pw_properties_get(properties, "pipewire.data-loop.workers")) != NULL &&
+	    !pw_properties_parse_int(str, 0, MAX_WORKERS, &n_workers))
+		pw_log_warn("data-loop %p: invalid number of workers \"%s\"", this, str);
+
+	if (n_workers > 0) {
+		this->n_workers = n_workers + 1;
+		this->workers = calloc(this->n_workers, sizeof(struct data_worker));
+		if (this->workers == NULL)
+			goto no_workers;
+		for (i = 0; i < this->n_workers; i++) {
+			this->workers[i].loop = this;
+			this->workers[i].id = i;
+		}
+		this->executor = executor;
+	}
+
+	/* spin for some microseconds before sleeping, for isolated cores */
+	if (properties &&
+	    (str = pw_properties_get(properties, "pipewire.data-loop.spin")) != NULL) {
+		if ((props = pw_properties_copy(properties)) == NULL)
+			goto no_loop;
+		pw_properties_set(props, "loop.spin", str);
+		properties = props;
+	}
+
 	this->loop = pw_loop_new(properties);
+	if (props)
+		pw_properties_free(props);
 	if (this->loop == NULL)
 		goto no_loop;
 
@@ -122,6 +393,8 @@ struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 	return this;
 
       no_loop:
+	free(this->workers);
+      no_workers:
 	free(this);
 	return NULL;
 }
@@ -140,6 +413,7 @@ void pw_data_loop_destroy(struct pw_data_loop *loop)
 
 	pw_loop_destroy_source(loop->loop, loop->event);
 	pw_loop_destroy(loop->loop);
+	free(loop->workers);
 	free(loop);
 }
 
@@ -168,6 +442,7 @@ pw_data_loop_get_loop(struct pw_data_loop *loop)
 int pw_data_loop_start(struct pw_data_loop *loop)
 {
 	if (!loop->running) {
+		uint32_t i;
 		int err;
 
 		loop->running = true;
@@ -176,6 +451,17 @@ int pw_data_loop_start(struct pw_data_loop *loop)
 			loop->running = false;
 			return SPA_RESULT_ERROR;
 		}
+		loop->workers_running = true;
+		for (i = 1; i < loop->n_workers; i++) {
+			struct data_worker *w = &loop->workers[i];
+
+			if ((err = pthread_create(&w->thread, NULL, do_worker, w)) != 0) {
+				/* the data loop thread does the work of missing workers */
+				pw_log_warn("data-loop %p: can't create worker: %s", loop, strerror(err));
+				continue;
+			}
+			w->running = true;
+		}
 	}
 	return SPA_RESULT_OK;
 }
@@ -191,9 +477,21 @@ int pw_data_loop_start(struct pw_data_loop *loop)
 int pw_data_loop_stop(struct pw_data_loop *loop)
 {
 	if (loop->running) {
+		uint32_t i;
+
 		pw_loop_signal_event(loop->loop, loop->event);
 
 		pthread_join(loop->thread, NULL);
+
+		__atomic_store_n(&loop->workers_running, false, __ATOMIC_RELEASE);
+		__atomic_add_fetch(&loop->generation, 1, __ATOMIC_RELEASE);
+		syscall(SYS_futex, &loop->generation, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+
+		for (i = 1; i < loop->n_workers; i++) {
+			if (loop->workers[i].running)
+				pthread_join(loop->workers[i].thread, NULL);
+			loop->workers[i].running = false;
+		}
 	}
 	return SPA_RESULT_OK;
 }
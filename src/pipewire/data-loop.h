@@ -29,6 +29,21 @@ extern "C" {
 /** \class pw_data_loop
  *
  * PipeWire rt-loop object.
+ *
+ * With the "pipewire.data-loop.workers" property, the nodes of a graph
+ * cycle run on the data loop thread and on the worker threads. The process
+ * functions of the nodes, links and port mixers then run on any of these
+ * threads:
+ *
+ * \li a node runs on one thread at a time and only after the nodes it gets
+ * input from, the state of the node and the io of its links need no locks.
+ * \li nodes that don't depend on each other run at the same time. The
+ * buffers of a tee are refcounted with atomics and the node of the tee
+ * takes its buffers back from one thread at a time. Nodes that share other
+ * state, like client nodes that share a transport, must protect it.
+ * \li the next cycle starts when all threads are done with the previous one.
+ * \li the sources and invoked functions of the loop run on the data loop
+ * thread between cycles.
  */
 struct pw_data_loop;
 
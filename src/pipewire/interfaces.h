@@ -417,7 +417,7 @@ pw_module_proxy_add_listener(struct pw_module_proxy *module,
 
 #define pw_module_resource_info(r,...)	pw_resource_notify(r,struct pw_module_proxy_events,info,__VA_ARGS__)
 
-#define PW_VERSION_NODE			0
+#define PW_VERSION_NODE			1
 
 #define PW_NODE_PROXY_EVENT_INFO	0
 #define PW_NODE_PROXY_EVENT_NUM	1
@@ -244,6 +244,13 @@ struct pw_node_info *pw_node_info_update(struct pw_node_info *info,
 			pw_spa_dict_destroy(info->props);
 		info->props = pw_spa_dict_copy(update->props);
 	}
+	if (update->change_mask & (1 << 7))
+		info->profile = update->profile;
+	if (update->change_mask & (1 << 8)) {
+		info->capture_latency = update->capture_latency;
+		info->playback_latency = update->playback_latency;
+	}
+
 	return info;
 }
 
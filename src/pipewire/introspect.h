@@ -22,6 +22,7 @@
 
 #include <spa/defs.h>
 #include <spa/format.h>
+#include <spa/node.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -130,6 +131,23 @@ pw_client_info_update(struct pw_client_info *info,
 void pw_client_info_free(struct pw_client_info *info);
 
 
+/** Timing of a node callback in the data loop, in nanoseconds \memberof pw_introspect */
+struct pw_node_timing {
+	uint64_t count;		/**< number of calls */
+	uint64_t last;		/**< duration of the last call */
+	uint64_t min;		/**< shortest call */
+	uint64_t max;		/**< longest call */
+	uint64_t avg;		/**< average duration */
+};
+
+/** The profile of a node \memberof pw_introspect */
+struct pw_node_profile {
+	struct pw_node_timing input;	/**< process_input of the node */
+	struct pw_node_timing output;	/**< process_output of the node */
+	struct pw_node_timing cycle;	/**< graph cycles started by the node */
+	uint32_t xruns;			/**< cycles that took longer than the period */
+};
+
 /** The node information. Extra information can be added in later versions \memberof pw_introspect */
 struct pw_node_info {
 	uint64_t change_mask;			/**< bitfield of changed fields since last call */
@@ -145,6 +163,12 @@ struct pw_node_info {
 	enum pw_node_state state;		/**< the current state of the node */
 	const char *error;			/**< an error reason if \a state is error */
 	struct spa_dict *props;			/**< the properties of the node */
+	struct pw_node_profile profile;		/**< timing of the node, when profiling is
+						  *  enabled on the core */
+	struct spa_latency_range capture_latency;	/**< latency of the data from the
+							  *  capture devices to the node */
+	struct spa_latency_range playback_latency;	/**< latency of the data from the
+							  *  node to the playback devices */
 };
 
 struct pw_node_info *
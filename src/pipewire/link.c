@@ -22,6 +22,7 @@
 
 #include <spa/lib/debug.h>
 #include <spa/video/format.h>
+#include <spa/audio/format-utils.h>
 #include <spa/pod-utils.h>
 
 #include <spa/lib/format.h>
@@ -34,6 +35,7 @@
 #include "work-queue.h"
 
 #define MAX_BUFFERS     16
+#define MAX_DATAS       64
 
 /** \cond */
 struct impl {
@@ -46,6 +48,8 @@ struct impl {
 	struct spa_format *format_filter;
 	struct pw_properties *properties;
 
+	struct spa_type_format_audio format_audio;
+
 	struct spa_hook input_port_listener;
 	struct spa_hook input_node_listener;
 	struct spa_hook output_port_listener;
@@ -77,6 +81,11 @@ static void pw_link_update_state(struct pw_link *link, enum pw_link_state state,
 		link->error = error;
 
 		spa_hook_list_call(&link->listener_list, struct pw_link_events, state_changed, old, state, error);
+
+		/* the buffers are known now, or the link does not pass data anymore */
+		if (state == PW_LINK_STATE_PAUSED || old == PW_LINK_STATE_PAUSED ||
+		    old == PW_LINK_STATE_RUNNING)
+			pw_core_update_latency(link->core);
 	}
 }
 
@@ -360,6 +369,28 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 	return buffers;
 }
 
+/* planar audio has one data block per channel, all other formats have one */
+static uint32_t format_n_datas(struct pw_link *this, const struct spa_format *format)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	uint32_t layout = 0, channels = 0;
+
+	if (format == NULL)
+		return 1;
+
+	spa_type_format_audio_map(this->core->type.map, &impl->format_audio);
+
+	if (spa_format_query(format,
+			     impl->format_audio.layout, SPA_POD_TYPE_INT, &layout,
+			     impl->format_audio.channels, SPA_POD_TYPE_INT, &channels, 0) != 2)
+		return 1;
+
+	if (layout != SPA_AUDIO_LAYOUT_NON_INTERLEAVED || channels == 0)
+		return 1;
+
+	return SPA_MIN(channels, MAX_DATAS);
+}
+
 static int
 param_filter(struct pw_link *this,
 	     struct pw_port *in_port,
@@ -561,11 +592,15 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 			impl->buffer_owner = this->input;
 			pw_log_debug("reusing %d input buffers %p", impl->n_buffers, impl->buffers);
 		} else {
-			size_t data_sizes[1];
-			ssize_t data_strides[1];
-
-			data_sizes[0] = minsize;
-			data_strides[0] = stride;
+			uint32_t n_datas = format_n_datas(this, this->info.format);
+			size_t data_sizes[MAX_DATAS];
+			ssize_t data_strides[MAX_DATAS];
+
+			/* the size and stride of the params are per data block */
+			for (i = 0; i < n_datas; i++) {
+				data_sizes[i] = minsize;
+				data_strides[i] = stride;
+			}
 
 			impl->buffer_owner = this;
 			impl->n_buffers = max_buffers;
@@ -573,11 +608,11 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 						      impl->n_buffers,
 						      n_params,
 						      params,
-						      1,
+						      n_datas,
 						      data_sizes, data_strides, &impl->buffer_mem);
 
-			pw_log_debug("allocating %d input buffers %p %zd %zd", impl->n_buffers,
-				     impl->buffers, minsize, stride);
+			pw_log_debug("allocating %d input buffers %p %d %zd %zd", impl->n_buffers,
+				     impl->buffers, n_datas, minsize, stride);
 		}
 
 		if (out_flags & SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS) {
@@ -762,11 +797,27 @@ static void clear_port_buffers(struct pw_link *link, struct pw_port *port)
 		pw_port_use_buffers(port, NULL, 0);
 }
 
+/* give the buffer that was not consumed back to the output port */
+static void release_buffer(struct pw_link *this)
+{
+	struct spa_graph_port *port = &this->rt.out_port;
+
+	if (this->io.status == SPA_RESULT_HAVE_BUFFER && port->callbacks)
+		port->callbacks->reuse_buffer(port->callbacks_data, this->io.buffer_id);
+	this->io.status = SPA_RESULT_NEED_BUFFER;
+	this->io.buffer_id = SPA_ID_INVALID;
+}
+
 static int
 do_remove_input(struct spa_loop *loop,
 	        bool async, uint32_t seq, size_t size, const void *data, void *user_data)
 {
 	struct pw_link *this = user_data;
+	struct pw_port *port = this->input;
+
+	/* the buffer of the link in the mix goes away with the link */
+	if (port->rt.mix_used == &this->rt.in_port)
+		port->rt.mix_used = NULL;
 	spa_graph_port_remove(&this->rt.in_port);
 	return SPA_RESULT_OK;
 }
@@ -781,6 +832,7 @@ static void input_remove(struct pw_link *this, struct pw_port *port)
 
 	pw_loop_invoke(port->node->data_loop,
 		       do_remove_input, 1, 0, NULL, true, this);
+	spa_graph_scheduler_update(port->node->rt.sched);
 
 	clear_port_buffers(this, this->input);
 }
@@ -790,6 +842,7 @@ do_remove_output(struct spa_loop *loop,
 	         bool async, uint32_t seq, size_t size, const void *data, void *user_data)
 {
 	struct pw_link *this = user_data;
+	release_buffer(this);
 	spa_graph_port_remove(&this->rt.out_port);
 	return SPA_RESULT_OK;
 }
@@ -804,6 +857,7 @@ static void output_remove(struct pw_link *this, struct pw_port *port)
 
 	pw_loop_invoke(port->node->data_loop,
 		       do_remove_output, 1, 0, NULL, true, this);
+	spa_graph_scheduler_update(port->node->rt.sched);
 
 	clear_port_buffers(this, this->output);
 }
@@ -849,15 +903,6 @@ static void output_port_destroy(void *data)
 	on_port_destroy(&impl->this, impl->this.output);
 }
 
-static int
-do_activate_link(struct spa_loop *loop,
-		 bool async, uint32_t seq, size_t size, const void *data, void *user_data)
-{
-        struct pw_link *this = user_data;
-	spa_graph_port_link(&this->rt.out_port, &this->rt.in_port);
-	return SPA_RESULT_OK;
-}
-
 bool pw_link_activate(struct pw_link *this)
 {
 	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
@@ -868,8 +913,8 @@ bool pw_link_activate(struct pw_link *this)
 	impl->active = true;
 
 	pw_log_debug("link %p: activate", this);
-	pw_loop_invoke(this->output->node->data_loop,
-		       do_activate_link, SPA_ID_INVALID, 0, NULL, false, this);
+	spa_graph_port_link(&this->rt.out_port, &this->rt.in_port);
+	spa_graph_scheduler_update(this->output->node->rt.sched);
 
 	this->output->node->n_used_output_links++;
 	this->input->node->n_used_input_links++;
@@ -885,6 +930,7 @@ do_deactivate_link(struct spa_loop *loop,
 		   bool async, uint32_t seq, size_t size, const void *data, void *user_data)
 {
         struct pw_link *this = user_data;
+	release_buffer(this);
 	spa_graph_port_unlink(&this->rt.out_port);
 	return SPA_RESULT_OK;
 }
@@ -901,6 +947,7 @@ bool pw_link_deactivate(struct pw_link *this)
 	pw_log_debug("link %p: deactivate", this);
 	pw_loop_invoke(this->output->node->data_loop,
 		       do_deactivate_link, SPA_ID_INVALID, 0, NULL, true, this);
+	spa_graph_scheduler_update(this->output->node->rt.sched);
 
 	input_node = this->input->node;
 	output_node = this->output->node;
@@ -979,20 +1026,16 @@ link_bind_func(struct pw_global *global,
 	return SPA_RESULT_NO_MEMORY;
 }
 
-static int
-do_add_link(struct spa_loop *loop,
-            bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+/* the link ports are added from the main thread, the tee and mix nodes
+ * see them in their next cycle */
+static void add_link(struct pw_link *this, struct pw_port *port)
 {
-        struct pw_link *this = user_data;
-        struct pw_port *port = ((struct pw_port **) data)[0];
+	if (port->direction == PW_DIRECTION_OUTPUT)
+		spa_graph_port_add(&port->rt.mix_node, &this->rt.out_port);
+	else
+		spa_graph_port_add(&port->rt.mix_node, &this->rt.in_port);
 
-        if (port->direction == PW_DIRECTION_OUTPUT) {
-                spa_graph_port_add(&port->rt.mix_node, &this->rt.out_port);
-        } else {
-                spa_graph_port_add(&port->rt.mix_node, &this->rt.in_port);
-        }
-
-        return SPA_RESULT_OK;
+	spa_graph_scheduler_update(port->node->rt.sched);
 }
 
 static const struct pw_port_events input_port_events = {
@@ -1083,6 +1126,7 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	this->info.input_port_id = input ? input->port_id : -1;
 	this->info.format = NULL;
 
+	this->io = SPA_PORT_IO_INIT;
 	spa_graph_port_init(&this->rt.out_port,
 			    PW_DIRECTION_OUTPUT,
 			    this->rt.out_port.port_id,
@@ -1093,13 +1137,13 @@ struct pw_link *pw_link_new(struct pw_core *core,
 			    this->rt.in_port.port_id,
 			    0,
 			    &this->io);
+	/* the output port shares its buffers with all links */
+	spa_graph_port_set_callbacks(&this->rt.out_port,
+				     output->rt.mix_port.callbacks,
+				     output->rt.mix_port.callbacks_data);
 
-	pw_loop_invoke(output_node->data_loop,
-		       do_add_link,
-		       SPA_ID_INVALID, sizeof(struct pw_port *), &output, false, this);
-	pw_loop_invoke(input_node->data_loop,
-		       do_add_link,
-		       SPA_ID_INVALID, sizeof(struct pw_port *), &input, false, this);
+	add_link(this, output);
+	add_link(this, input);
 
 	this->global = pw_core_add_global(core, NULL, parent, core->type.link, PW_VERSION_LINK,
 			   link_bind_func, this);
@@ -1120,6 +1164,7 @@ struct pw_link *pw_link_new(struct pw_core *core,
 void pw_link_destroy(struct pw_link *link)
 {
 	struct impl *impl = SPA_CONTAINER_OF(link, struct impl, this);
+	struct pw_core *core = link->core;
 	struct pw_resource *resource, *tmp;
 
 	pw_log_debug("link %p: destroy", impl);
@@ -1150,6 +1195,8 @@ void pw_link_destroy(struct pw_link *link)
 		pw_memblock_free(&impl->buffer_mem);
 
 	free(impl);
+
+	pw_core_update_latency(core);
 }
 
 void pw_link_add_listener(struct pw_link *link,
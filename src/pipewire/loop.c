@@ -18,6 +18,8 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <spa/loop.h>
 #include <spa/type-map.h>
@@ -38,6 +40,10 @@ struct impl {
 /** \endcond */
 
 /** Create a new loop
+ * \param properties optional properties, pipewire.loop selects the loop
+ *        implementation, the PIPEWIRE_LOOP environment variable is used
+ *        when it is not set. The properties are passed to the loop
+ *        implementation.
  * \returns a newly allocated loop
  * \memberof pw_loop
  */
@@ -46,11 +52,12 @@ struct pw_loop *pw_loop_new(struct pw_properties *properties)
 	int res;
 	struct impl *impl;
 	struct pw_loop *this;
-	const struct spa_handle_factory *factory;
+	const struct spa_handle_factory *factory = NULL;
 	struct spa_type_map *map;
 	void *iface;
 	const struct spa_support *support;
 	uint32_t n_support;
+	const char *name = NULL;
 
 	support = pw_get_support(&n_support);
 	if (support == NULL)
@@ -60,7 +67,16 @@ struct pw_loop *pw_loop_new(struct pw_properties *properties)
 	if (map == NULL)
 		return NULL;
 
-	factory = pw_get_support_factory("loop");
+	if (properties)
+		name = pw_properties_get(properties, "pipewire.loop");
+	if (name == NULL)
+		name = getenv("PIPEWIRE_LOOP");
+	if (name != NULL && (factory = pw_get_support_factory(name)) == NULL)
+		pw_log_warn("loop: unknown loop %s", name);
+
+      again:
+	if (factory == NULL)
+		factory = pw_get_support_factory("loop");
 	if (factory == NULL)
 		return NULL;
 
@@ -74,9 +90,16 @@ struct pw_loop *pw_loop_new(struct pw_properties *properties)
 
 	if ((res = spa_handle_factory_init(factory,
 					   impl->handle,
-					   NULL,
+					   properties ? &properties->dict : NULL,
 					   support,
 					   n_support)) < 0) {
+		if (strcmp(factory->name, "loop") != 0) {
+			/* the kernel might not support it, use the default loop */
+			pw_log_warn("loop: can't make %s: %d", factory->name, res);
+			free(impl);
+			factory = NULL;
+			goto again;
+		}
 		fprintf(stderr, "can't make factory instance: %d\n", res);
 		goto failed;
 	}
@@ -43,6 +43,8 @@ struct impl {
 
 	struct spa_hook node_listener;
 
+	struct spa_source *profile_timer;
+
 	bool registered;
 };
 
@@ -119,15 +121,17 @@ static void node_async_complete(void *data, uint32_t seq, int res)
 	pw_work_queue_complete(impl->work, this, seq, res);
 }
 
-static void send_clock_update(struct pw_node *this)
+#define CLOCK_UPDATE_ALL	(SPA_COMMAND_NODE_CLOCK_UPDATE_TIME |		\
+				 SPA_COMMAND_NODE_CLOCK_UPDATE_SCALE |		\
+				 SPA_COMMAND_NODE_CLOCK_UPDATE_STATE |		\
+				 SPA_COMMAND_NODE_CLOCK_UPDATE_LATENCY)
+
+static void send_clock_update(struct pw_node *this, uint32_t change_mask)
 {
 	int res;
 	struct spa_command_node_clock_update cu =
 		SPA_COMMAND_NODE_CLOCK_UPDATE_INIT(this->core->type.command_node.ClockUpdate,
-						SPA_COMMAND_NODE_CLOCK_UPDATE_TIME |
-						SPA_COMMAND_NODE_CLOCK_UPDATE_SCALE |
-						SPA_COMMAND_NODE_CLOCK_UPDATE_STATE |
-						SPA_COMMAND_NODE_CLOCK_UPDATE_LATENCY,   /* change_mask */
+						change_mask,
 						1,       /* rate */
 						0,       /* ticks */
 						0,       /* monotonic_time */
@@ -137,6 +141,13 @@ static void send_clock_update(struct pw_node *this)
 						0,       /* flags */
 						0);      /* latency */
 
+	/* a node that consumes data wants to know how old it is, a node that
+	 * produces data when it will be played */
+	if (this->info.n_input_ports > 0)
+		cu.body.latency.value = this->info.capture_latency.max;
+	else
+		cu.body.latency.value = this->info.playback_latency.max;
+
 	if (this->clock && this->live) {
 		cu.body.flags.value = SPA_COMMAND_NODE_CLOCK_UPDATE_FLAG_LIVE;
 		res = spa_clock_get_time(this->clock,
@@ -160,26 +171,123 @@ static void node_event(void *data, const struct spa_event *event)
 
 	pw_log_trace("node %p: event %d", this, SPA_EVENT_TYPE(event));
         if (SPA_EVENT_TYPE(event) == this->core->type.event_node.RequestClockUpdate) {
-                send_clock_update(this);
+                send_clock_update(this, CLOCK_UPDATE_ALL);
         }
 }
 
+/* a cycle that takes longer than the time since the previous cycle
+ * started was late for the next period */
+static void profile_cycle(struct pw_node *this, uint64_t start)
+{
+	uint64_t elapsed = spa_graph_get_time() - start;
+
+	if (this->rt.cycle_start != 0 && elapsed > start - this->rt.cycle_start)
+		__atomic_store_n(&this->rt.xruns, this->rt.xruns + 1, __ATOMIC_RELAXED);
+	this->rt.cycle_start = start;
+	spa_graph_stats_add(&this->rt.cycle, elapsed);
+}
+
+/* pull the targets that were collected since the last period in one cycle */
+static void driver_cycle(struct pw_core *core)
+{
+	struct pw_node *node;
+	uint32_t i;
+
+	spa_graph_scheduler_cycle(&core->rt.sched, core->rt.targets, core->rt.n_targets);
+
+	for (i = 0; i < core->rt.n_targets; i++) {
+		node = SPA_CONTAINER_OF(core->rt.targets[i], struct pw_node, rt.node);
+		node->rt.target = false;
+	}
+	core->rt.n_targets = 0;
+}
+
+static bool add_target(struct pw_node *this)
+{
+	struct pw_core *core = this->core;
+
+	if (this->rt.target)
+		return true;
+	if (core->rt.n_targets >= PW_CORE_MAX_TARGETS)
+		return false;
+
+	core->rt.targets[core->rt.n_targets++] = &this->rt.node;
+	this->rt.target = true;
+	return true;
+}
+
+static void remove_target(struct pw_node *this)
+{
+	struct pw_core *core = this->core;
+	uint32_t i;
+
+	if (!this->rt.target)
+		return;
+
+	for (i = 0; i < core->rt.n_targets; i++) {
+		if (core->rt.targets[i] == &this->rt.node) {
+			core->rt.targets[i] = core->rt.targets[--core->rt.n_targets];
+			break;
+		}
+	}
+	this->rt.target = false;
+}
+
+/* returns the driver of the graph, the first node that can drive and
+ * wakes up becomes the driver */
+static struct pw_node *get_driver(struct pw_node *this)
+{
+	struct pw_core *core = this->core;
+
+	if (!core->rt.drivers)
+		return NULL;
+
+	if (core->rt.driver == NULL && this->driver) {
+		pw_log_debug("node %p: driving the graph", this);
+		core->rt.driver = this;
+	}
+	return core->rt.driver;
+}
+
 static void node_need_input(void *data)
 {
         struct impl *impl = data;
 	struct pw_node *this = &impl->this;
+	struct pw_node *driver = get_driver(this);
+	uint64_t start = this->rt.node.profile ? spa_graph_get_time() : 0;
 
-	spa_graph_scheduler_pull(this->rt.sched, &this->rt.node);
-	while (spa_graph_scheduler_iterate(this->rt.sched));
+	/* nodes are pulled when the driver starts the next cycle */
+	if (driver == NULL || !add_target(this)) {
+		spa_graph_scheduler_pull(this->rt.sched, &this->rt.node);
+		while (spa_graph_scheduler_iterate(this->rt.sched));
+	}
+	if (driver == this)
+		driver_cycle(this->core);
+
+	if (start != 0 && (driver == NULL || driver == this))
+		profile_cycle(this, start);
 }
 
 static void node_have_output(void *data)
 {
         struct impl *impl = data;
 	struct pw_node *this = &impl->this;
+	struct pw_node *driver = get_driver(this);
+	uint64_t start = this->rt.node.profile ? spa_graph_get_time() : 0;
+
+	if (driver != NULL && this->core->rt.n_targets > 0) {
+		/* the output is consumed in the cycle of the driver */
+		if (driver != this)
+			return;
+		driver_cycle(this->core);
+	}
+	else {
+		spa_graph_scheduler_push(this->rt.sched, &this->rt.node);
+		while (spa_graph_scheduler_iterate(this->rt.sched));
+	}
 
-	spa_graph_scheduler_push(this->rt.sched, &this->rt.node);
-	while (spa_graph_scheduler_iterate(this->rt.sched));
+	if (start != 0)
+		profile_cycle(this, start);
 }
 
 static void node_unbind_func(void *data)
@@ -287,15 +395,56 @@ node_bind_func(struct pw_global *global,
 	return SPA_RESULT_NO_MEMORY;
 }
 
-static int
-do_node_add(struct spa_loop *loop,
-	    bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+/* the node is added from the main thread, the data thread uses it from the
+ * cycle after the new plan was published */
+static void node_add(struct pw_node *this)
 {
-	struct pw_node *this = user_data;
-
+	if (this->core->profile) {
+		spa_graph_stats_reset(&this->rt.cycle);
+		spa_graph_node_set_profile(&this->rt.node, &this->rt.profile);
+	}
 	spa_graph_node_add(this->rt.sched->graph, &this->rt.node);
+	spa_graph_scheduler_update(this->rt.sched);
+}
 
-	return SPA_RESULT_OK;
+/* the stats are written by the data thread while this runs */
+static void fill_timing(struct pw_node_timing *timing, const struct spa_graph_stats *rt_stats)
+{
+	struct spa_graph_stats stats;
+
+	spa_graph_stats_read(rt_stats, &stats);
+
+	timing->count = stats.count;
+	timing->last = stats.last;
+	timing->min = stats.count ? stats.min : 0;
+	timing->max = stats.max;
+	timing->avg = stats.count ? stats.total / stats.count : 0;
+}
+
+/* send the timing of the node to the clients when it ran since the last time */
+static void on_profile_timeout(struct spa_loop_utils *utils, struct spa_source *source, void *data)
+{
+	struct pw_node *this = data;
+	struct pw_node_profile *profile = &this->info.profile;
+	struct pw_resource *resource;
+
+	if (profile->input.count == __atomic_load_n(&this->rt.profile.input.count, __ATOMIC_RELAXED) &&
+	    profile->output.count == __atomic_load_n(&this->rt.profile.output.count, __ATOMIC_RELAXED) &&
+	    profile->cycle.count == __atomic_load_n(&this->rt.cycle.count, __ATOMIC_RELAXED))
+		return;
+
+	fill_timing(&profile->input, &this->rt.profile.input);
+	fill_timing(&profile->output, &this->rt.profile.output);
+	fill_timing(&profile->cycle, &this->rt.cycle);
+	profile->xruns = __atomic_load_n(&this->rt.xruns, __ATOMIC_RELAXED);
+
+	this->info.change_mask |= 1 << 7;
+	spa_hook_list_call(&this->listener_list, struct pw_node_events, info_changed, &this->info);
+
+	spa_list_for_each(resource, &this->resource_list, link)
+		pw_node_resource_info(resource, &this->info);
+
+	this->info.change_mask = 0;
 }
 
 
@@ -303,12 +452,28 @@ void pw_node_register(struct pw_node *this)
 {
 	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
 	struct pw_core *core = this->core;
+	const char *str;
 
 	pw_log_debug("node %p: register", this);
 
 	update_info(this);
 
-	pw_loop_invoke(this->data_loop, do_node_add, 1, 0, NULL, false, this);
+	if ((str = pw_properties_get(this->properties, "pipewire.driver")) != NULL)
+		this->driver = pw_properties_parse_bool(str);
+	else
+		this->driver = this->clock != NULL;
+
+	pw_node_set_quantum(this, core->quantum);
+
+	node_add(this);
+
+	if (core->profile) {
+		struct timespec interval = { 1, 0 };
+
+		impl->profile_timer = pw_loop_add_timer(core->main_loop, on_profile_timeout, this);
+		pw_loop_update_timer(core->main_loop, impl->profile_timer,
+				     &interval, &interval, false);
+	}
 
 	spa_list_insert(core->node_list.prev, &this->link);
 	this->global = pw_core_add_global(core, this->owner ? this->owner->client : NULL,
@@ -468,6 +633,29 @@ void pw_node_add_listener(struct pw_node *node,
 	spa_hook_list_append(&node->listener_list, listener, events, data);
 }
 
+static void release_driver(struct pw_node *this)
+{
+	struct pw_core *core = this->core;
+
+	remove_target(this);
+	if (core->rt.driver == this) {
+		pw_log_debug("node %p: stop driving the graph", this);
+		core->rt.driver = NULL;
+		/* the nodes ask again with the next driver */
+		while (core->rt.n_targets > 0)
+			remove_target(SPA_CONTAINER_OF(core->rt.targets[0],
+						       struct pw_node, rt.node));
+	}
+}
+
+static int
+do_release_driver(struct spa_loop *loop,
+		  bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	release_driver(user_data);
+	return SPA_RESULT_OK;
+}
+
 static int
 do_node_remove(struct spa_loop *loop,
 	       bool async, uint32_t seq, size_t size, const void *data, void *user_data)
@@ -476,6 +664,7 @@ do_node_remove(struct spa_loop *loop,
 
 	pause_node(this);
 
+	release_driver(this);
 	spa_graph_node_remove(&this->rt.node);
 
 	return SPA_RESULT_OK;
@@ -499,6 +688,10 @@ void pw_node_destroy(struct pw_node *node)
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, destroy);
 
 	pw_loop_invoke(node->data_loop, do_node_remove, 1, 0, NULL, true, node);
+	spa_graph_scheduler_update(node->rt.sched);
+
+	if (impl->profile_timer)
+		pw_loop_destroy_source(node->core->main_loop, impl->profile_timer);
 
 	if (impl->registered) {
 		spa_list_remove(&node->link);
@@ -703,15 +896,17 @@ int pw_node_set_state(struct pw_node *node, enum pw_node_state state)
 
 	case PW_NODE_STATE_SUSPENDED:
 		res = suspend_node(node);
+		pw_loop_invoke(node->data_loop, do_release_driver, 1, 0, NULL, true, node);
 		break;
 
 	case PW_NODE_STATE_IDLE:
 		res = pause_node(node);
+		pw_loop_invoke(node->data_loop, do_release_driver, 1, 0, NULL, true, node);
 		break;
 
 	case PW_NODE_STATE_RUNNING:
 		node_activate(node);
-		send_clock_update(node);
+		send_clock_update(node, CLOCK_UPDATE_ALL);
 		res = start_node(node);
 		break;
 
@@ -768,3 +963,107 @@ void pw_node_update_state(struct pw_node *node, enum pw_node_state state, char *
 		node->info.change_mask = 0;
 	}
 }
+
+/* the smallest and largest latency of \a ports */
+static void ports_latency(struct spa_list *ports, bool capture, struct spa_latency_range *latency)
+{
+	struct pw_port *port;
+	const struct spa_latency_range *l;
+	bool first = true;
+
+	spa_zero(*latency);
+	spa_list_for_each(port, ports, link) {
+		l = capture ? &port->capture_latency : &port->playback_latency;
+		latency->min = first ? l->min : SPA_MIN(latency->min, l->min);
+		latency->max = SPA_MAX(latency->max, l->max);
+		first = false;
+	}
+}
+
+/** Update the latency of the node
+ * \param node the node to update
+ *
+ * The capture latency of the node is the one of its input ports, or of its
+ * output ports when it has no inputs. The playback latency is the one of
+ * its output ports, or of its input ports when it has no outputs. When the
+ * latency changed, the info is sent and the node gets a clock update.
+ *
+ * \memberof pw_node
+ */
+void pw_node_update_latency(struct pw_node *node)
+{
+	struct spa_latency_range capture, playback;
+	struct pw_resource *resource;
+
+	ports_latency(spa_list_is_empty(&node->input_ports) ?
+		      &node->output_ports : &node->input_ports, true, &capture);
+	ports_latency(spa_list_is_empty(&node->output_ports) ?
+		      &node->input_ports : &node->output_ports, false, &playback);
+
+	if (memcmp(&capture, &node->info.capture_latency, sizeof(capture)) == 0 &&
+	    memcmp(&playback, &node->info.playback_latency, sizeof(playback)) == 0)
+		return;
+
+	pw_log_debug("node %p: capture latency %" PRIu64 "-%" PRIu64
+		     ", playback latency %" PRIu64 "-%" PRIu64, node,
+		     capture.min, capture.max, playback.min, playback.max);
+
+	node->info.capture_latency = capture;
+	node->info.playback_latency = playback;
+
+	node->info.change_mask |= 1 << 8;
+	spa_hook_list_call(&node->listener_list, struct pw_node_events, info_changed, &node->info);
+
+	spa_list_for_each(resource, &node->resource_list, link)
+		pw_node_resource_info(resource, &node->info);
+
+	node->info.change_mask = 0;
+
+	send_clock_update(node, SPA_COMMAND_NODE_CLOCK_UPDATE_LATENCY);
+}
+
+/** Set the quantum of a node
+ * \param node a node
+ * \param quantum the number of frames in one cycle, 0 leaves the node as is
+ * \return 0 on success, < 0 on error
+ *
+ * Nodes that drive the graph take the quantum as their min-latency property
+ * and switch at the start of their next cycle. The other nodes follow the
+ * range that is requested from them.
+ *
+ * \memberof pw_node
+ */
+int pw_node_set_quantum(struct pw_node *node, uint32_t quantum)
+{
+	struct pw_type *t = &node->core->type;
+	struct spa_props *props;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+	uint8_t buffer[128];
+	uint32_t id;
+	int32_t min_latency;
+	int res;
+
+	if (quantum == 0 ||
+	    node->implementation->get_props == NULL ||
+	    node->implementation->set_props == NULL)
+		return SPA_RESULT_OK;
+
+	if ((res = node->implementation->get_props(node->implementation_data, &props)) < 0)
+		return res == SPA_RESULT_NOT_IMPLEMENTED ? SPA_RESULT_OK : res;
+
+	/* only nodes with a latency follow the quantum, the props of the node
+	 * are its own and are only read here */
+	id = spa_type_map_get_id(t->map, SPA_TYPE_PROPS__minLatency);
+	if (spa_props_query(props, id, SPA_POD_TYPE_INT, &min_latency, 0) != 1)
+		return SPA_RESULT_OK;
+
+	pw_log_debug("node %p: quantum %u", node, quantum);
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	spa_pod_builder_props(&b, &f[0], t->spa_props,
+		SPA_POD_PROP(&f[1], id, 0, SPA_POD_TYPE_INT, 1, quantum));
+	props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	return node->implementation->set_props(node->implementation_data, props);
+}
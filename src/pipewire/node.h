@@ -161,6 +161,12 @@ int pw_node_set_state(struct pw_node *node, enum pw_node_state state);
 /** Update the state of the node, mostly used by node implementations */
 void pw_node_update_state(struct pw_node *node, enum pw_node_state state, char *error);
 
+/** Update the latency of the node from the latency of its ports */
+void pw_node_update_latency(struct pw_node *node);
+
+/** Make the node process  quantum frames per cycle when it can */
+int pw_node_set_quantum(struct pw_node *node, uint32_t quantum);
+
 #ifdef __cplusplus
 }
 #endif
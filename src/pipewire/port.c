@@ -21,13 +21,25 @@
 #include <stdlib.h>
 #include <errno.h>
 
+#include <spa/audio/format-utils.h>
+#include <lib/cpu.h>
+#include <lib/mix.h>
+
 #include "pipewire/pipewire.h"
 #include "pipewire/private.h"
 #include "pipewire/port.h"
 
 /** \cond */
+#define MAX_MIX	64
+
+/* mixes the buffers of all links of an input port */
+struct port_mix {
+	mix_n_func_t mix;
+};
+
 struct impl {
 	struct pw_port this;
+	struct port_mix mix;
 };
 /** \endcond */
 
@@ -41,22 +53,61 @@ static void port_update_state(struct pw_port *port, enum pw_port_state state)
 	}
 }
 
+/* An output port with many links hands the same buffer to all of them. The
+ * buffer is recycled to the producer when the last link gave it back. The
+ * links of the ports of a node can give back buffers from different workers
+ * at the same time, the node takes them one at a time. */
+static int schedule_tee_reuse_buffer(void *data, uint32_t buffer_id)
+{
+        struct pw_port *this = data;
+	struct pw_node *node = this->node;
+	uint32_t *refs;
+	int res = SPA_RESULT_OK;
+
+	if (buffer_id >= this->n_buffers)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+
+	refs = &this->rt.buffer_refs[buffer_id];
+	if (__atomic_load_n(refs, __ATOMIC_ACQUIRE) == 0)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+	if (__atomic_sub_fetch(refs, 1, __ATOMIC_ACQ_REL) > 0)
+		return SPA_RESULT_OK;
+
+	pw_log_trace("tee %p: recycle buffer %d", this, buffer_id);
+	if (this->implementation->reuse_buffer) {
+		while (__atomic_test_and_set(&node->rt.reuse_lock, __ATOMIC_ACQUIRE));
+		res = this->implementation->reuse_buffer(this->implementation_data, buffer_id);
+		__atomic_clear(&node->rt.reuse_lock, __ATOMIC_RELEASE);
+	}
+	return res;
+}
+
 static int schedule_tee_input(void *data)
 {
         struct pw_port *this = data;
 	struct spa_graph_node *node = &this->rt.mix_node;
 	struct spa_graph_port *p;
 	struct spa_port_io *io = this->rt.mix_port.io;
+	uint32_t n_links = 0;
         int res;
 
-	if (spa_list_is_empty(&node->ports[SPA_DIRECTION_OUTPUT])) {
+	if (__atomic_load_n(&node->ports[SPA_DIRECTION_OUTPUT].next, __ATOMIC_ACQUIRE) ==
+	    &node->ports[SPA_DIRECTION_OUTPUT]) {
 		io->status = SPA_RESULT_NEED_BUFFER;
 		res = SPA_RESULT_NEED_BUFFER;
 	}
 	else {
 		pw_log_trace("tee input %d %d", io->status, io->buffer_id);
-		spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link)
+		spa_graph_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+			/* a buffer that was not consumed is replaced */
+			if (p->io->status == SPA_RESULT_HAVE_BUFFER)
+				schedule_tee_reuse_buffer(this, p->io->buffer_id);
 			*p->io = *io;
+			n_links++;
+		}
+		if (io->buffer_id < this->n_buffers)
+			__atomic_add_fetch(&this->rt.buffer_refs[io->buffer_id], n_links,
+					   __ATOMIC_RELEASE);
 		io->status = SPA_RESULT_OK;
 		io->buffer_id = SPA_ID_INVALID;
 		res = SPA_RESULT_HAVE_BUFFER;
@@ -70,8 +121,14 @@ static int schedule_tee_output(void *data)
 	struct spa_graph_port *p;
 	struct spa_port_io *io = this->rt.mix_port.io;
 
-	spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link)
-		*io = *p->io;
+	spa_graph_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+		if (p->io->status != SPA_RESULT_HAVE_BUFFER &&
+		    p->io->buffer_id != SPA_ID_INVALID) {
+			schedule_tee_reuse_buffer(this, p->io->buffer_id);
+			p->io->buffer_id = SPA_ID_INVALID;
+		}
+		io->range = p->io->range;
+	}
 	io->status = SPA_RESULT_NEED_BUFFER;
 
 	return SPA_RESULT_NEED_BUFFER;
@@ -83,29 +140,149 @@ static const struct spa_graph_node_callbacks schedule_tee_node = {
 	schedule_tee_output,
 };
 
-static int schedule_tee_reuse_buffer(void *data, uint32_t buffer_id)
-{
-	return SPA_RESULT_OK;
-}
-
 static const struct spa_graph_port_callbacks schedule_tee_port = {
 	SPA_VERSION_GRAPH_PORT_CALLBACKS,
 	schedule_tee_reuse_buffer,
 };
 
-static int schedule_mix_input(void *data)
+/* give a buffer back to the output port at the other side of the link */
+static int mix_peer_reuse_buffer(struct spa_graph_port *port, uint32_t buffer_id)
+{
+	struct spa_graph_port *peer = port->peer;
+
+	if (peer == NULL || peer->callbacks == NULL || peer->callbacks->reuse_buffer == NULL)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+
+	return peer->callbacks->reuse_buffer(peer->callbacks_data, buffer_id);
+}
+
+/* give the buffer in the io of the mix back to the link it came from, the
+ * links can have buffers with the same id */
+static void mix_release_used(struct pw_port *this)
+{
+	struct spa_port_io *io = this->rt.mix_port.io;
+
+	if (this->rt.mix_used && io->buffer_id != SPA_ID_INVALID)
+		mix_peer_reuse_buffer(this->rt.mix_used, io->buffer_id);
+	this->rt.mix_used = NULL;
+}
+
+static int schedule_mix_reuse_buffer(void *data, uint32_t buffer_id)
 {
         struct pw_port *this = data;
 	struct spa_graph_node *node = &this->rt.mix_node;
 	struct spa_graph_port *p;
+
+	if (this->rt.mix_used && buffer_id == this->rt.mix_port.io->buffer_id) {
+		mix_release_used(this);
+		return SPA_RESULT_OK;
+	}
+
+	/* the first link that has the buffer in use takes it back */
+	spa_graph_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		if (mix_peer_reuse_buffer(p, buffer_id) == SPA_RESULT_OK)
+			return SPA_RESULT_OK;
+	}
+	return SPA_RESULT_INVALID_BUFFER_ID;
+}
+
+static struct spa_buffer *get_link_buffer(struct spa_graph_port *port, uint32_t buffer_id)
+{
+	struct pw_link *link = SPA_CONTAINER_OF(port, struct pw_link, rt.in_port);
+	struct pw_port *output = link->output;
+
+	if (buffer_id >= output->n_buffers)
+		return NULL;
+	/* only a buffer that is not used by other links can be written to */
+	if (__atomic_load_n(&output->rt.buffer_refs[buffer_id], __ATOMIC_ACQUIRE) != 1)
+		return NULL;
+
+	return output->buffers[buffer_id];
+}
+
+/* mix the \a n_srcs buffers into \a dst, all the planes of the buffers are
+ * mixed in one pass with the mixer kernels.
+ *
+ * The mix is done in place in \a dst, a buffer of the output port of the
+ * first link. This is only safe because get_link_buffer() checks that the
+ * producer handed the buffer to this one link only and the producer does
+ * not touch a buffer again until it is given back with reuse_buffer, so
+ * until mix_release_used() the mix owns it. The \a srcs are only read. */
+static bool mix_buffers(struct port_mix *mix, struct spa_buffer *dst,
+			struct spa_buffer **srcs, uint32_t n_srcs)
+{
+	const void *s[MAX_MIX + 1];
+	struct spa_data *dd, *sd;
+	uint32_t i, j, size;
+	void *d;
+
+	for (i = 0; i < n_srcs; i++) {
+		if (srcs[i]->n_datas != dst->n_datas)
+			return false;
+	}
+	for (j = 0; j < dst->n_datas; j++) {
+		dd = &dst->datas[j];
+		if (dd->data == NULL)
+			return false;
+		size = dd->chunk->size;
+		s[0] = d = SPA_MEMBER(dd->data, dd->chunk->offset, void);
+
+		for (i = 0; i < n_srcs; i++) {
+			sd = &srcs[i]->datas[j];
+			if (sd->data == NULL)
+				return false;
+			s[i + 1] = SPA_MEMBER(sd->data, sd->chunk->offset, void);
+			size = SPA_MIN(size, sd->chunk->size);
+		}
+		mix->mix(d, s, n_srcs + 1, size);
+		dd->chunk->size = size;
+	}
+	return true;
+}
+
+static int schedule_mix_input(void *data)
+{
+        struct pw_port *this = data;
+	struct port_mix *mix = this->mix;
+	struct spa_graph_node *node = &this->rt.mix_node;
+	struct spa_graph_port *p, *used = NULL, *ports[MAX_MIX];
 	struct spa_port_io *io = this->rt.mix_port.io;
+	struct spa_buffer *dst = NULL, *srcs[MAX_MIX];
+	uint32_t i, n_srcs = 0;
 
-	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+	/* the buffer that was processed in the previous cycle */
+	if (io->status != SPA_RESULT_HAVE_BUFFER)
+		mix_release_used(this);
+
+	spa_graph_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
 		pw_log_trace("mix input %p %p->%p %d %d", p, p->io, io, p->io->status, p->io->buffer_id);
-		*io = *p->io;
+		if (used == NULL || (io->status != SPA_RESULT_HAVE_BUFFER &&
+				     p->io->status == SPA_RESULT_HAVE_BUFFER)) {
+			*io = *p->io;
+			used = p;
+			if (mix && io->status == SPA_RESULT_HAVE_BUFFER)
+				dst = get_link_buffer(p, io->buffer_id);
+		}
+		else if (p->io->status == SPA_RESULT_HAVE_BUFFER) {
+			/* the other buffers are mixed into the first one or given back */
+			if (dst && n_srcs < MAX_MIX &&
+			    (srcs[n_srcs] = get_link_buffer(p, p->io->buffer_id)) != NULL)
+				ports[n_srcs++] = p;
+			else
+				mix_peer_reuse_buffer(p, p->io->buffer_id);
+		}
 		p->io->status = SPA_RESULT_OK;
 		p->io->buffer_id = SPA_ID_INVALID;
 	}
+	this->rt.mix_used = used;
+
+	if (n_srcs > 0) {
+		if (!mix_buffers(mix, dst, srcs, n_srcs))
+			pw_log_trace("port %p: can't mix %d buffers", this, n_srcs + 1);
+
+		for (i = 0; i < n_srcs; i++)
+			mix_peer_reuse_buffer(ports[i], srcs[i]->id);
+	}
 	return SPA_RESULT_HAVE_BUFFER;
 }
 
@@ -116,10 +293,12 @@ static int schedule_mix_output(void *data)
 	struct spa_graph_port *p;
 	struct spa_port_io *io = this->rt.mix_port.io;
 
+	mix_release_used(this);
+
 	io->status = SPA_RESULT_NEED_BUFFER;
-	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link)
-		*p->io = *io;
 	io->buffer_id = SPA_ID_INVALID;
+	spa_graph_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link)
+		*p->io = *io;
 
 	return SPA_RESULT_NEED_BUFFER;
 }
@@ -130,10 +309,6 @@ static const struct spa_graph_node_callbacks schedule_mix_node = {
 	schedule_mix_output,
 };
 
-static int schedule_mix_reuse_buffer(void *data, uint32_t buffer_id)
-{
-	return SPA_RESULT_OK;
-}
 static const struct spa_graph_port_callbacks schedule_mix_port = {
 	SPA_VERSION_GRAPH_PORT_CALLBACKS,
 	schedule_mix_reuse_buffer,
@@ -226,17 +401,16 @@ void * pw_port_get_user_data(struct pw_port *port)
 	return port->user_data;
 }
 
-static int do_add_port(struct spa_loop *loop,
-		       bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+/* the graph is changed from the main thread while the data thread runs it,
+ * the mix node is complete before it and the port become visible */
+static void add_port(struct pw_port *this)
 {
-        struct pw_port *this = user_data;
-
-	spa_graph_port_add(&this->node->rt.node, &this->rt.port);
-	spa_graph_node_add(this->rt.graph, &this->rt.mix_node);
 	spa_graph_port_add(&this->rt.mix_node, &this->rt.mix_port);
 	spa_graph_port_link(&this->rt.port, &this->rt.mix_port);
+	spa_graph_node_add(this->rt.graph, &this->rt.mix_node);
+	spa_graph_port_add(&this->node->rt.node, &this->rt.port);
 
-	return SPA_RESULT_OK;
+	spa_graph_scheduler_update(this->node->rt.sched);
 }
 
 void pw_port_add(struct pw_port *port, struct pw_node *node)
@@ -261,7 +435,7 @@ void pw_port_add(struct pw_port *port, struct pw_node *node)
 		port->implementation->set_io(port->implementation_data, &port->io);
 
 	port->rt.graph = node->rt.sched->graph;
-	pw_loop_invoke(node->data_loop, do_add_port, SPA_ID_INVALID, 0, NULL, false, port);
+	add_port(port);
 
 	port_update_state(port, PW_PORT_STATE_CONFIGURE);
 
@@ -296,6 +470,7 @@ void pw_port_destroy(struct pw_port *port)
 
 	if (node) {
 		pw_loop_invoke(port->node->data_loop, do_remove_port, SPA_ID_INVALID, 0, NULL, true, port);
+		spa_graph_scheduler_update(node->rt.sched);
 
 		if (port->direction == PW_DIRECTION_INPUT) {
 			pw_map_remove(&node->input_port_map, port->port_id);
@@ -339,6 +514,69 @@ int pw_port_enum_formats(struct pw_port *port,
 	return res;
 }
 
+/* input ports with raw audio in a format that the mixer kernels can handle
+ * accept more than one link, the buffers of the links are mixed */
+static void update_mix(struct pw_port *port, const struct spa_format *format)
+{
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
+	struct spa_type_map *map = port->node->core->type.map;
+	struct spa_type_media_type media_type = { 0, };
+	struct spa_type_media_subtype media_subtype = { 0, };
+	struct spa_type_format_audio format_audio = { 0, };
+	struct spa_type_audio_format audio_format = { 0, };
+	struct spa_audiomixer_ops ops;
+	struct spa_audio_info_raw info = { 0, };
+
+	port->mix = NULL;
+
+	if (port->direction != PW_DIRECTION_INPUT || format == NULL)
+		return;
+
+	spa_type_media_type_map(map, &media_type);
+	spa_type_media_subtype_map(map, &media_subtype);
+	spa_type_format_audio_map(map, &format_audio);
+	spa_type_audio_format_map(map, &audio_format);
+
+	if (SPA_FORMAT_MEDIA_TYPE(format) != media_type.audio ||
+	    SPA_FORMAT_MEDIA_SUBTYPE(format) != media_subtype.raw)
+		return;
+
+	if (!spa_format_audio_raw_parse(format, &info, &format_audio))
+		return;
+
+	spa_audiomixer_get_ops(&ops, spa_cpu_get_flags());
+
+	if (info.format == audio_format.S16)
+		impl->mix.mix = ops.mix[CONV_S16_S16];
+	else if (info.format == audio_format.F32)
+		impl->mix.mix = ops.mix[CONV_F32_F32];
+	else
+		return;
+
+	pw_log_debug("port %p: mixing links", port);
+	port->mix = &impl->mix;
+}
+
+/* keep a copy of the buffers with a refcount for each of them after it,
+ * the port is paused so the data thread does not use the old ones */
+static int set_buffers(struct pw_port *port, struct spa_buffer **buffers, uint32_t n_buffers)
+{
+	void *p = NULL;
+
+	if (n_buffers > 0) {
+		if ((p = calloc(n_buffers, sizeof(struct spa_buffer *) + sizeof(uint32_t))) == NULL)
+			n_buffers = 0;
+		else
+			memcpy(p, buffers, n_buffers * sizeof(struct spa_buffer *));
+	}
+	free(port->buffers);
+	port->buffers = p;
+	port->n_buffers = n_buffers;
+	port->rt.buffer_refs = p ? SPA_MEMBER(p, n_buffers * sizeof(struct spa_buffer *), uint32_t) : NULL;
+
+	return p || n_buffers == 0 ? SPA_RESULT_OK : SPA_RESULT_NO_MEMORY;
+}
+
 int pw_port_set_format(struct pw_port *port, uint32_t flags, const struct spa_format *format)
 {
 	int res;
@@ -352,10 +590,7 @@ int pw_port_set_format(struct pw_port *port, uint32_t flags, const struct spa_fo
 
 	if (!SPA_RESULT_IS_ASYNC(res)) {
 		if (format == NULL) {
-			if (port->buffers)
-				free(port->buffers);
-			port->buffers = NULL;
-			port->n_buffers = 0;
+			set_buffers(port, NULL, 0);
 			if (port->allocated)
 				pw_memblock_free(&port->buffer_mem);
 			port->allocated = false;
@@ -364,6 +599,7 @@ int pw_port_set_format(struct pw_port *port, uint32_t flags, const struct spa_fo
 		else {
 			port_update_state (port, PW_PORT_STATE_READY);
 		}
+		update_mix(port, format);
 	}
 	return res;
 }
@@ -411,7 +647,6 @@ int pw_port_set_param(struct pw_port *port, struct spa_param *param)
 int pw_port_use_buffers(struct pw_port *port, struct spa_buffer **buffers, uint32_t n_buffers)
 {
 	int res;
-	size_t size;
 
 	if (n_buffers == 0 && port->state <= PW_PORT_STATE_READY)
 		return SPA_RESULT_OK;
@@ -432,12 +667,8 @@ int pw_port_use_buffers(struct pw_port *port, struct spa_buffer **buffers, uint3
 	else
 		res = SPA_RESULT_NOT_IMPLEMENTED;
 
-	size = sizeof(struct spa_buffer *) * n_buffers;
-
-	if (port->buffers)
-		free(port->buffers);
-	port->buffers = size ? memcpy(malloc(size), buffers, size) : NULL;
-	port->n_buffers = n_buffers;
+	if (set_buffers(port, buffers, n_buffers) < 0)
+		res = SPA_RESULT_NO_MEMORY;
 	if (port->allocated)
 		pw_memblock_free(&port->buffer_mem);
 	port->allocated = false;
@@ -455,7 +686,6 @@ int pw_port_alloc_buffers(struct pw_port *port,
 			  struct spa_buffer **buffers, uint32_t *n_buffers)
 {
 	int res;
-	size_t size;
 
 	if (port->state < PW_PORT_STATE_READY)
 		return SPA_RESULT_NO_FORMAT;
@@ -475,12 +705,8 @@ int pw_port_alloc_buffers(struct pw_port *port,
 	else
 		res = SPA_RESULT_NOT_IMPLEMENTED;
 
-	size = sizeof(struct spa_buffer *) * *n_buffers;
-
-	if (port->buffers)
-		free(port->buffers);
-	port->buffers = size ? memcpy(malloc(size), buffers, size) : NULL;
-	port->n_buffers = *n_buffers;
+	if (set_buffers(port, buffers, *n_buffers) < 0)
+		res = SPA_RESULT_NO_MEMORY;
 	port->allocated = true;
 
 	if (!SPA_RESULT_IS_ASYNC(res))
@@ -25,7 +25,7 @@ extern "C" {
 #endif
 
 #include <sys/socket.h>
-#include <spa/graph-scheduler3.h>
+#include <spa/graph-scheduler.h>
 
 #include "pipewire/mem.h"
 #include "pipewire/pipewire.h"
@@ -115,9 +115,17 @@ struct pw_core {
 	struct spa_support support[4];	/**< support for spa plugins */
 	uint32_t n_support;		/**< number of support items */
 
+	bool profile;			/**< measure the timing of the nodes */
+	uint32_t quantum;		/**< frames per cycle of the graph or 0 */
+
+#define PW_CORE_MAX_TARGETS	64
 	struct {
 		struct spa_graph_scheduler sched;
 		struct spa_graph graph;
+		bool drivers;			/**< cycles are started by a driver */
+		struct pw_node *driver;		/**< the driver node or NULL */
+		struct spa_graph_node *targets[PW_CORE_MAX_TARGETS];	/**< pulled in the next cycle */
+		uint32_t n_targets;
 	} rt;
 };
 
@@ -130,6 +138,18 @@ struct pw_data_loop {
 
         bool running;
         pthread_t thread;
+
+	bool zero_denormals;	/**< flush denormals to zero in the thread */
+
+	struct spa_graph_executor executor;	/**< runs graph nodes on the workers */
+	struct data_worker *workers;	/**< worker 0 is the data loop thread */
+	uint32_t n_workers;
+	bool workers_running;
+	uint32_t generation;		/**< futex, bumped to wake up the workers */
+	struct spa_graph_plan *plan;	/**< plan that is being run, NULL between cycles */
+	int32_t busy;			/**< futex, workers that can look at the plan */
+	uint32_t work;			/**< futex, bumped when nodes are ready or done */
+	int32_t sleepers;		/**< threads that wait on work or busy */
 };
 
 struct pw_main_loop {
@@ -194,6 +214,7 @@ struct pw_node {
 
 	bool live;			/**< if the node is live */
 	struct spa_clock *clock;	/**< handle to SPA clock if any */
+	bool driver;			/**< the node can drive the graph */
 
 	struct spa_list resource_list;	/**< list of resources for this node */
 
@@ -211,6 +232,8 @@ struct pw_node {
 	uint32_t n_used_output_links;		/**< number of active output links */
 	uint32_t idle_used_output_links;	/**< number of active output to be idle */
 
+	uint32_t latency_index;		/**< position while the latency is updated */
+
 	struct spa_hook_list listener_list;
 
 	struct pw_loop *data_loop;		/**< the data loop for this node */
@@ -218,6 +241,12 @@ struct pw_node {
 	struct {
 		struct spa_graph_scheduler *sched;
 		struct spa_graph_node node;
+		bool target;		/**< pulled in the next driver cycle */
+		struct spa_graph_node_profile profile;
+		struct spa_graph_stats cycle;	/**< cycles started by the node */
+		uint64_t cycle_start;		/**< start of the last cycle */
+		uint32_t xruns;			/**< cycles that took longer than the period */
+		bool reuse_lock;		/**< taken while a buffer is given back */
 	} rt;
 
         void *user_data;                /**< extra user data */
@@ -249,12 +278,21 @@ struct pw_port {
 
 	void *mix;			/**< optional port buffer mix/split */
 
+	struct spa_latency_range capture_latency;	/**< latency from the capture devices
+							  *  to this port */
+	struct spa_latency_range playback_latency;	/**< latency from this port to the
+							  *  playback devices */
+
 	struct {
 		struct spa_graph *graph;
 		struct spa_graph_port port;
 		struct spa_graph_port mix_port;
 		struct spa_graph_node mix_node;
-	} rt;				/**< data only accessed from the data thread */
+		struct spa_graph_port *mix_used;	/**< the link of the buffer in the
+							  *  io of mix_port */
+		uint32_t *buffer_refs;		/**< links that use each of the n_buffers */
+	} rt;				/**< data only accessed from the data thread and
+					  *  its workers */
 
         void *user_data;                /**< extra user data */
 };
@@ -24,6 +24,10 @@
 //extern "C" {
 #endif
 
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <spa/dict.h>
 
 /** \class pw_properties
@@ -67,6 +71,29 @@ pw_properties_get(const struct pw_properties *properties, const char *key);
 const char *
 pw_properties_iterate(const struct pw_properties *properties, void **state);
 
+/** Parse the value of a boolean property, "true" and non-zero numbers are true */
+static inline bool pw_properties_parse_bool(const char *value)
+{
+	return strcmp(value, "true") == 0 || atoi(value) != 0;
+}
+
+/** Parse the value of an integer property into \a result, returns false and
+ * leaves \a result alone when it is not a number between \a min and \a max */
+static inline bool pw_properties_parse_int(const char *value, int32_t min, int32_t max,
+					   int32_t *result)
+{
+	char *end;
+	long v;
+
+	errno = 0;
+	v = strtol(value, &end, 0);
+	if (errno != 0 || end == value || *end != '\0' || v < min || v > max)
+		return false;
+
+	*result = v;
+	return true;
+}
+
 #ifdef __cplusplus
 }
 #endif
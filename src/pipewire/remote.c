@@ -510,6 +510,7 @@ static void client_node_transport(void *object, uint32_t node_id,
 	}
 	spa_list_for_each(port, &data->node->output_ports, link)
 		spa_graph_port_add(&port->rt.mix_node, &data->out_ports[port->port_id]);
+	spa_graph_scheduler_update(data->node->rt.sched);
 
         data->rtreadfd = readfd;
         data->rtwritefd = writefd;
@@ -98,6 +98,11 @@ uint32_t pw_resource_get_type(struct pw_resource *resource)
 	return resource->type;
 }
 
+uint32_t pw_resource_get_version(struct pw_resource *resource)
+{
+	return resource->version;
+}
+
 struct pw_protocol *pw_resource_get_protocol(struct pw_resource *resource)
 {
 	return resource->client->protocol;
@@ -84,6 +84,8 @@ uint32_t pw_resource_get_permissions(struct pw_resource *resource);
 
 uint32_t pw_resource_get_type(struct pw_resource *resource);
 
+uint32_t pw_resource_get_version(struct pw_resource *resource);
+
 struct pw_protocol *pw_resource_get_protocol(struct pw_resource *resource);
 
 void *pw_resource_get_user_data(struct pw_resource *resource);
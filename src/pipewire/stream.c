@@ -101,6 +101,7 @@ struct stream {
 	int64_t last_ticks;
 	int32_t last_rate;
 	int64_t last_monotonic;
+	int64_t last_latency;
 };
 /** \endcond */
 
@@ -635,9 +636,13 @@ handle_node_command(struct pw_stream *stream, uint32_t seq, const struct spa_com
 					   "pipewire.latency.min", "%" PRId64,
 					   cu->body.latency.value);
 		}
-		impl->last_ticks = cu->body.ticks.value;
-		impl->last_rate = cu->body.rate.value;
-		impl->last_monotonic = cu->body.monotonic_time.value;
+		if (cu->body.change_mask.value & SPA_COMMAND_NODE_CLOCK_UPDATE_TIME) {
+			impl->last_ticks = cu->body.ticks.value;
+			impl->last_rate = cu->body.rate.value;
+			impl->last_monotonic = cu->body.monotonic_time.value;
+		}
+		if (cu->body.change_mask.value & SPA_COMMAND_NODE_CLOCK_UPDATE_LATENCY)
+			impl->last_latency = cu->body.latency.value;
 	} else {
 		pw_log_warn("unhandled node command %d", SPA_COMMAND_TYPE(command));
 		add_async_complete(stream, seq, SPA_RESULT_NOT_IMPLEMENTED);
@@ -1012,6 +1017,7 @@ bool pw_stream_get_time(struct pw_stream *stream, struct pw_time *time)
 
 	time->ticks = impl->last_ticks + (elapsed * impl->last_rate) / SPA_USEC_PER_SEC;
 	time->rate = impl->last_rate;
+	time->latency = impl->last_latency;
 
 	return true;
 }
@@ -226,6 +226,9 @@ struct pw_time {
 	int64_t now;		/**< the monotonic time */
 	int64_t ticks;		/**< the ticks at \a now */
 	int32_t rate;		/**< the rate of \a ticks */
+	int64_t latency;	/**< the latency in nanoseconds from the capture devices
+				  *  to the stream for input, from the stream to the
+				  *  playback devices for output */
 };
 
 /** Create a new unconneced \ref pw_stream \memberof pw_stream
@@ -0,0 +1,114 @@
+/* PipeWire
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/data-loop.h>
+#include <pipewire/private.h>
+
+#include <tests/graph-nodes.h>
+
+#define CYCLES		10000
+
+/* the graphs of benchmark-graph run by the workers of a data loop, each node
+ * must run once per cycle and no worker can still be busy after a cycle */
+struct data {
+	struct pw_data_loop *loop;
+	struct test_graph g;
+	uint32_t sink;
+	uint32_t cycle;
+};
+
+static uint32_t nfailures;
+
+static int do_cycle(struct spa_loop *loop, bool async, uint32_t seq,
+		    size_t size, const void *data, void *user_data)
+{
+	struct data *d = user_data;
+	struct spa_graph_node *sink = &d->g.nodes[d->sink].node;
+	uint32_t i;
+
+	d->cycle++;
+	spa_graph_scheduler_cycle(&d->g.sched, &sink, 1);
+
+	if (__atomic_load_n(&d->loop->busy, __ATOMIC_ACQUIRE) != 0) {
+		printf("cycle %u: workers still busy\n", d->cycle);
+		nfailures++;
+	}
+	for (i = 0; i < d->g.n_nodes; i++) {
+		uint32_t calls = d->g.nodes[i].calls;
+
+		if (calls != d->cycle) {
+			printf("cycle %u: node %u ran %u times\n", d->cycle, i, calls);
+			nfailures++;
+			d->g.nodes[i].calls = d->cycle;
+		}
+	}
+	return SPA_RESULT_OK;
+}
+
+static void run(uint32_t g)
+{
+	static struct data d;
+	struct pw_properties *props;
+	uint32_t i;
+
+	spa_zero(d);
+	props = pw_properties_new("pipewire.data-loop.workers", "3", NULL);
+	d.loop = pw_data_loop_new(props);
+	pw_properties_free(props);
+	if (d.loop == NULL || d.loop->n_workers < 2) {
+		printf("can't make a data loop with workers\n");
+		nfailures++;
+		return;
+	}
+
+	spa_graph_init(&d.g.graph);
+	spa_graph_scheduler_init(&d.g.sched, &d.g.graph);
+	spa_graph_scheduler_set_executor(&d.g.sched, &d.loop->executor, d.loop);
+	d.sink = graphs[g].make(&d.g, graphs[g].n);
+	spa_graph_scheduler_update(&d.g.sched);
+
+	pw_data_loop_start(d.loop);
+	for (i = 0; i < CYCLES; i++)
+		pw_loop_invoke(pw_data_loop_get_loop(d.loop), do_cycle, i, 0, NULL, true, &d);
+	pw_data_loop_stop(d.loop);
+
+	printf("%s %u: %u cycles\n", graphs[g].name, graphs[g].n, d.cycle);
+
+	spa_graph_scheduler_clear(&d.g.sched);
+	pw_data_loop_destroy(d.loop);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t g;
+
+	pw_init(&argc, &argv);
+
+	printf("starting executor test\n");
+
+	for (g = 0; g < SPA_N_ELEMENTS(graphs); g++)
+		run(g);
+
+	printf("%u failures\n", nfailures);
+
+	return nfailures == 0 ? 0 : 1;
+}
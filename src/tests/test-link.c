@@ -0,0 +1,356 @@
+/* PipeWire
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+
+#include <spa/format-builder.h>
+#include <spa/audio/format-utils.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/private.h>
+
+#define MAX_BUFFERS	8
+#define BUFFER_SIZE	1024
+#define MAX_ITERATIONS	100
+
+/* two nodes with an audio port that only use buffers, the link allocates
+ * the buffers and must give planar formats one data block per channel */
+struct type {
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+};
+
+struct endpoint {
+	struct data *data;
+	struct pw_node *node;
+	struct pw_port *port;
+	struct spa_port_info info;
+	uint8_t format_buffer[1024];
+	uint8_t params_buffer[1024];
+	struct spa_param *params[2];
+	struct spa_buffer *buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+};
+
+struct data {
+	struct pw_core *core;
+	struct pw_type *t;
+	struct type type;
+	uint32_t layout;
+	uint32_t channels;
+	struct endpoint src;
+	struct endpoint sink;
+	enum pw_link_state state;
+};
+
+static uint32_t nfailures;
+
+#define PROP(f,key,type,...)							\
+	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+
+static int port_enum_formats(void *data,
+			     struct spa_format **format,
+			     const struct spa_format *filter,
+			     int32_t index)
+{
+	struct endpoint *e = data;
+	struct data *d = e->data;
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(e->format_buffer, sizeof(e->format_buffer));
+	struct spa_pod_frame f[2];
+
+	if (index != 0)
+		return SPA_RESULT_ENUM_END;
+
+	spa_pod_builder_format(&b, &f[0], d->t->spa_format,
+		d->type.media_type.audio,
+		d->type.media_subtype.raw,
+		PROP(&f[1], d->type.format_audio.format, SPA_POD_TYPE_ID,
+			d->type.audio_format.F32),
+		PROP(&f[1], d->type.format_audio.layout, SPA_POD_TYPE_INT,
+			d->layout),
+		PROP(&f[1], d->type.format_audio.rate, SPA_POD_TYPE_INT,
+			44100),
+		PROP(&f[1], d->type.format_audio.channels, SPA_POD_TYPE_INT,
+			d->channels));
+	*format = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+
+	return SPA_RESULT_OK;
+}
+
+static int port_set_format(void *data, uint32_t flags, const struct spa_format *format)
+{
+	struct endpoint *e = data;
+	struct pw_type *t = e->data->t;
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(e->params_buffer, sizeof(e->params_buffer));
+	struct spa_pod_frame f[2];
+
+	if (format == NULL)
+		return SPA_RESULT_OK;
+
+	/* the size is for one data block */
+	spa_pod_builder_object(&b, &f[0], 0, t->param_alloc_buffers.Buffers,
+		PROP(&f[1], t->param_alloc_buffers.size, SPA_POD_TYPE_INT,
+			BUFFER_SIZE),
+		PROP(&f[1], t->param_alloc_buffers.stride, SPA_POD_TYPE_INT,
+			0),
+		PROP(&f[1], t->param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+			4),
+		PROP(&f[1], t->param_alloc_buffers.align, SPA_POD_TYPE_INT,
+			16));
+	e->params[0] = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	spa_pod_builder_object(&b, &f[0], 0, t->param_alloc_meta_enable.MetaEnable,
+		PROP(&f[1], t->param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+			t->meta.Header),
+		PROP(&f[1], t->param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+			sizeof(struct spa_meta_header)));
+	e->params[1] = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	return SPA_RESULT_OK;
+}
+
+static int port_get_format(void *data, const struct spa_format **format)
+{
+	return port_enum_formats(data, (struct spa_format **) format, NULL, 0);
+}
+
+static int port_get_info(void *data, const struct spa_port_info **info)
+{
+	struct endpoint *e = data;
+
+	e->info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	*info = &e->info;
+
+	return SPA_RESULT_OK;
+}
+
+static int port_enum_params(void *data, uint32_t index, struct spa_param **param)
+{
+	struct endpoint *e = data;
+
+	if (index >= 2)
+		return SPA_RESULT_ENUM_END;
+
+	*param = e->params[index];
+
+	return SPA_RESULT_OK;
+}
+
+static int port_use_buffers(void *data, struct spa_buffer **buffers, uint32_t n_buffers)
+{
+	struct endpoint *e = data;
+	uint32_t i;
+
+	if (n_buffers > MAX_BUFFERS)
+		return SPA_RESULT_ERROR;
+
+	for (i = 0; i < n_buffers; i++)
+		e->buffers[i] = buffers[i];
+	e->n_buffers = n_buffers;
+
+	return SPA_RESULT_OK;
+}
+
+static const struct pw_port_implementation port_impl = {
+	PW_VERSION_PORT_IMPLEMENTATION,
+	.enum_formats = port_enum_formats,
+	.set_format = port_set_format,
+	.get_format = port_get_format,
+	.get_info = port_get_info,
+	.enum_params = port_enum_params,
+	.use_buffers = port_use_buffers,
+};
+
+static int node_send_command(void *data, const struct spa_command *command)
+{
+	return SPA_RESULT_OK;
+}
+
+static const struct pw_node_implementation node_impl = {
+	PW_VERSION_NODE_IMPLEMENTATION,
+	.send_command = node_send_command,
+};
+
+static void make_endpoint(struct data *d, struct endpoint *e, enum pw_direction direction)
+{
+	e->data = d;
+	/* the source adds more latency than the sink */
+	e->info.latency.min = direction == PW_DIRECTION_OUTPUT ? 1000 : 10;
+	e->info.latency.max = direction == PW_DIRECTION_OUTPUT ? 2000 : 20;
+	e->node = pw_node_new(d->core, NULL, NULL,
+			      direction == PW_DIRECTION_OUTPUT ? "source" : "sink", NULL, 0);
+	pw_node_set_implementation(e->node, &node_impl, e);
+
+	e->port = pw_port_new(direction, 0, 0);
+	pw_port_set_implementation(e->port, &port_impl, e);
+	pw_port_add(e->port, e->node);
+	pw_node_register(e->node);
+}
+
+static void link_state_changed(void *data, enum pw_link_state old,
+			       enum pw_link_state state, const char *error)
+{
+	struct data *d = data;
+
+	if (state == PW_LINK_STATE_ERROR)
+		printf("link error: %s\n", error);
+	d->state = state;
+}
+
+static const struct pw_link_events link_events = {
+	PW_VERSION_LINK_EVENTS,
+	.state_changed = link_state_changed,
+};
+
+/* every plane has its own chunk and memory of the requested size */
+static void check_buffers(struct data *d, struct endpoint *e, uint32_t n_datas)
+{
+	uint32_t i, j;
+
+	if (e->n_buffers == 0) {
+		printf("%s: no buffers\n", e->node->info.name);
+		nfailures++;
+		return;
+	}
+	for (i = 0; i < e->n_buffers; i++) {
+		struct spa_buffer *b = e->buffers[i];
+
+		if (b->n_datas != n_datas) {
+			printf("%s: buffer %u has %u datas, expected %u\n",
+			       e->node->info.name, i, b->n_datas, n_datas);
+			nfailures++;
+			continue;
+		}
+		for (j = 0; j < n_datas; j++) {
+			struct spa_data *dd = &b->datas[j];
+
+			if (dd->data == NULL || dd->maxsize < BUFFER_SIZE) {
+				printf("%s: buffer %u data %u invalid\n", e->node->info.name, i, j);
+				nfailures++;
+			}
+			if (j > 0 && (dd->chunk == b->datas[j - 1].chunk ||
+				      SPA_PTRDIFF(dd->data, b->datas[j - 1].data) <
+				      (ptrdiff_t) b->datas[j - 1].maxsize)) {
+				printf("%s: buffer %u data %u overlaps\n", e->node->info.name, i, j);
+				nfailures++;
+			}
+		}
+	}
+}
+
+static void check_latency(struct endpoint *e, const struct spa_latency_range *range,
+			  bool capture, uint64_t min, uint64_t max)
+{
+	if (range->min != min || range->max != max) {
+		printf("%s: %s latency %" PRIu64 "-%" PRIu64 ", expected %" PRIu64 "-%" PRIu64 "\n",
+		       e->node->info.name, capture ? "capture" : "playback",
+		       range->min, range->max, min, max);
+		nfailures++;
+	}
+}
+
+static void run(struct pw_main_loop *main_loop, uint32_t layout, uint32_t channels)
+{
+	struct pw_loop *loop = pw_main_loop_get_loop(main_loop);
+	struct data d;
+	struct pw_link *link;
+	struct spa_hook link_listener;
+	char *error = NULL;
+	uint32_t i;
+
+	spa_zero(d);
+	d.core = pw_core_new(loop, NULL);
+	d.t = pw_core_get_type(d.core);
+	d.layout = layout;
+	d.channels = channels;
+	spa_type_media_type_map(d.t->map, &d.type.media_type);
+	spa_type_media_subtype_map(d.t->map, &d.type.media_subtype);
+	spa_type_format_audio_map(d.t->map, &d.type.format_audio);
+	spa_type_audio_format_map(d.t->map, &d.type.audio_format);
+
+	make_endpoint(&d, &d.src, PW_DIRECTION_OUTPUT);
+	make_endpoint(&d, &d.sink, PW_DIRECTION_INPUT);
+
+	link = pw_link_new(d.core, NULL, d.src.port, d.sink.port, NULL, NULL, &error);
+	if (link == NULL) {
+		printf("can't make link: %s\n", error);
+		free(error);
+		nfailures++;
+		goto done;
+	}
+	pw_link_add_listener(link, &link_listener, &link_events, &d);
+	pw_link_activate(link);
+
+	pw_loop_enter(loop);
+	for (i = 0; i < MAX_ITERATIONS; i++) {
+		if (d.state == PW_LINK_STATE_ERROR || d.state >= PW_LINK_STATE_PAUSED)
+			break;
+		pw_loop_iterate(loop, 100);
+	}
+	pw_loop_leave(loop);
+
+	printf("%s %u channels: link %s\n",
+	       layout == SPA_AUDIO_LAYOUT_NON_INTERLEAVED ? "planar" : "interleaved",
+	       channels, pw_link_state_as_string(d.state));
+
+	if (d.state < PW_LINK_STATE_PAUSED) {
+		nfailures++;
+	} else {
+		uint32_t n_datas = layout == SPA_AUDIO_LAYOUT_NON_INTERLEAVED ? channels : 1;
+
+		check_buffers(&d, &d.src, n_datas);
+		check_buffers(&d, &d.sink, n_datas);
+
+		/* each port adds its own latency along the link */
+		check_latency(&d.src, &d.src.port->capture_latency, true, 1000, 2000);
+		check_latency(&d.src, &d.src.port->playback_latency, false, 1010, 2020);
+		check_latency(&d.sink, &d.sink.port->capture_latency, true, 1010, 2020);
+		check_latency(&d.sink, &d.sink.port->playback_latency, false, 10, 20);
+	}
+	pw_link_destroy(link);
+
+      done:
+	pw_node_destroy(d.src.node);
+	pw_node_destroy(d.sink.node);
+	pw_core_destroy(d.core);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_main_loop *main_loop;
+
+	pw_init(&argc, &argv);
+
+	printf("starting link test\n");
+
+	main_loop = pw_main_loop_new(NULL);
+
+	run(main_loop, SPA_AUDIO_LAYOUT_INTERLEAVED, 2);
+	run(main_loop, SPA_AUDIO_LAYOUT_NON_INTERLEAVED, 1);
+	run(main_loop, SPA_AUDIO_LAYOUT_NON_INTERLEAVED, 2);
+	run(main_loop, SPA_AUDIO_LAYOUT_NON_INTERLEAVED, 6);
+
+	pw_main_loop_destroy(main_loop);
+
+	printf("%u failures\n", nfailures);
+
+	return nfailures == 0 ? 0 : 1;
+}
@@ -18,6 +18,7 @@
  */
 
 #include <stdio.h>
+#include <inttypes.h>
 
 #include <spa/lib/debug.h>
 
@@ -119,6 +120,13 @@ static const struct pw_module_proxy_events module_events = {
         .info = module_event_info,
 };
 
+static void print_timing(const char *name, const struct pw_node_timing *t, char mark)
+{
+	printf("%c\t\t%s: %" PRIu64 " calls, last %" PRIu64 " min %" PRIu64
+	       " max %" PRIu64 " avg %" PRIu64 " ns\n", mark, name,
+	       t->count, t->last, t->min, t->max, t->avg);
+}
+
 static void node_event_info(void *object, struct pw_node_info *info)
 {
         struct pw_proxy *proxy = object;
@@ -163,6 +171,18 @@ static void node_event_info(void *object, struct pw_node_info *info)
 		else
 			printf("\n");
 		print_properties(info->props, MARK_CHANGE(6));
+		if (info->profile.input.count || info->profile.output.count ||
+		    info->profile.cycle.count) {
+			printf("%c\tprofile:\n", MARK_CHANGE(7));
+			print_timing("input", &info->profile.input, MARK_CHANGE(7));
+			print_timing("output", &info->profile.output, MARK_CHANGE(7));
+			print_timing("cycle", &info->profile.cycle, MARK_CHANGE(7));
+			printf("%c\t\txruns: %u\n", MARK_CHANGE(7), info->profile.xruns);
+		}
+		printf("%c\tcapture latency: %" PRIu64 "-%" PRIu64 " ns\n", MARK_CHANGE(8),
+		       info->capture_latency.min, info->capture_latency.max);
+		printf("%c\tplayback latency: %" PRIu64 "-%" PRIu64 " ns\n", MARK_CHANGE(8),
+		       info->playback_latency.min, info->playback_latency.max);
 	}
 }
 